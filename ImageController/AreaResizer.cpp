@@ -0,0 +1,376 @@
+/*!
+ * @file	AreaResizer.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "AreaResizer.h"
+#include "SimdSupport.h"
+#include <algorithm>	// std::min, std::max
+#include <cmath>		// std::ceil, std::floor, std::nearbyint
+#include <cstdint>		// std::uint8_t
+#include <cstring>		// std::memcpy
+#include <vector>		// std::vector
+
+namespace Kchary::ImageController::Simd
+{
+	namespace
+	{
+		/*!
+		 * @brief 1方向の縮小に使う重みの表
+		 * @note 出力位置dの値は、入力位置starts[d]からtapCount個の画素にweights[d * tapCount + k]を掛けた和(余った重みは0)
+		 */
+		struct AreaTable
+		{
+			int tapCount = 0;				//!< 1出力あたりの入力画素数の最大値
+			std::vector<int> starts;		//!< 出力位置ごとの先頭の入力位置
+			std::vector<int> counts;		//!< 出力位置ごとの入力画素数
+			std::vector<float> weights;		//!< 出力位置ごとの重み(tapCount個ずつ)
+		};
+
+		/*!
+		 * @brief	出力画素が覆う入力画素とその面積比を、入力位置の昇順に列挙する
+		 * @note	cv::resize(INTER_AREA)の縮小時の重みの求め方(computeResizeAreaTab)と同じ
+		 */
+		template <typename Function>
+		void ForEachAreaTap(int sourceLength, double scale, int destinationIndex, Function function)
+		{
+			const double begin = destinationIndex * scale;
+			const double end = begin + scale;
+			const double cellLength = (std::min)(scale, sourceLength - begin);
+
+			const int last = (std::min)(static_cast<int>(std::floor(end)), sourceLength - 1);
+			const int first = (std::min)(static_cast<int>(std::ceil(begin)), last);
+
+			if (first - begin > 1e-3)
+			{
+				function(first - 1, static_cast<float>((first - begin) / cellLength));
+			}
+			for (int index = first; index < last; ++index)
+			{
+				function(index, static_cast<float>(1.0 / cellLength));
+			}
+			if (end - last > 1e-3)
+			{
+				function(last, static_cast<float>((std::min)((std::min)(end - last, 1.0), cellLength) / cellLength));
+			}
+		}
+
+		AreaTable BuildAreaTable(int sourceLength, int destinationLength)
+		{
+			const double scale = static_cast<double>(sourceLength) / destinationLength;
+
+			AreaTable table;
+			table.starts.resize(destinationLength);
+			table.counts.resize(destinationLength);
+			for (int d = 0; d < destinationLength; ++d)
+			{
+				int count = 0;
+				ForEachAreaTap(sourceLength, scale, d, [&](int index, float)
+					{
+						if (count++ == 0)
+						{
+							table.starts[d] = index;
+						}
+					});
+				table.counts[d] = count;
+				table.tapCount = (std::max)(table.tapCount, count);
+			}
+
+			table.weights.assign(static_cast<size_t>(destinationLength) * table.tapCount, 0.0f);
+			for (int d = 0; d < destinationLength; ++d)
+			{
+				float* weights = table.weights.data() + static_cast<size_t>(d) * table.tapCount;
+				ForEachAreaTap(sourceLength, scale, d, [&](int index, float weight)
+					{
+						weights[index - table.starts[d]] = weight;
+					});
+			}
+
+			return table;
+		}
+
+		void SumRowsScalar(const std::uint8_t* const* rows, const float* weights, int rowCount, float* output, size_t begin, size_t length) noexcept
+		{
+			for (size_t i = begin; i < length; ++i)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < rowCount; ++k)
+				{
+					sum += rows[k][i] * weights[k];
+				}
+				output[i] = sum;
+			}
+		}
+
+#if defined(KCHARY_SIMD_X86)
+		/*!
+		 * @brief	16要素単位で複数行の重み付き和を求め、処理した要素数を返す
+		 * @note	加算の順序はスカラー処理と同じにして、命令セットによって結果が変わらないようにする
+		 */
+		KCHARY_TARGET_AVX2
+		size_t SumRowsAvx2(const std::uint8_t* const* rows, const float* weights, int rowCount, float* output, size_t length) noexcept
+		{
+			size_t i = 0;
+			for (; i + 16 <= length; i += 16)
+			{
+				__m256 sum0 = _mm256_setzero_ps();
+				__m256 sum1 = _mm256_setzero_ps();
+				for (int k = 0; k < rowCount; ++k)
+				{
+					const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+					const __m256 weight = _mm256_set1_ps(weights[k]);
+					sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(pixels)), weight));
+					sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(pixels, 8))), weight));
+				}
+				_mm256_storeu_ps(output + i, sum0);
+				_mm256_storeu_ps(output + i + 8, sum1);
+			}
+
+			return i;
+		}
+
+		size_t SumRowsSse2(const std::uint8_t* const* rows, const float* weights, int rowCount, float* output, size_t length) noexcept
+		{
+			const __m128i zero = _mm_setzero_si128();
+
+			size_t i = 0;
+			for (; i + 16 <= length; i += 16)
+			{
+				__m128 sums[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+				for (int k = 0; k < rowCount; ++k)
+				{
+					const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+					const __m128i low = _mm_unpacklo_epi8(pixels, zero);
+					const __m128i high = _mm_unpackhi_epi8(pixels, zero);
+					const __m128 weight = _mm_set1_ps(weights[k]);
+					sums[0] = _mm_add_ps(sums[0], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), weight));
+					sums[1] = _mm_add_ps(sums[1], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), weight));
+					sums[2] = _mm_add_ps(sums[2], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), weight));
+					sums[3] = _mm_add_ps(sums[3], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), weight));
+				}
+				for (int j = 0; j < 4; ++j)
+				{
+					_mm_storeu_ps(output + i + j * 4, sums[j]);
+				}
+			}
+
+			return i;
+		}
+#elif defined(KCHARY_SIMD_NEON)
+		size_t SumRowsNeon(const std::uint8_t* const* rows, const float* weights, int rowCount, float* output, size_t length) noexcept
+		{
+			size_t i = 0;
+			for (; i + 16 <= length; i += 16)
+			{
+				float32x4_t sums[4] = { vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f), vdupq_n_f32(0.0f) };
+				for (int k = 0; k < rowCount; ++k)
+				{
+					const uint8x16_t pixels = vld1q_u8(rows[k] + i);
+					const uint16x8_t low = vmovl_u8(vget_low_u8(pixels));
+					const uint16x8_t high = vmovl_u8(vget_high_u8(pixels));
+					sums[0] = vmlaq_n_f32(sums[0], vcvtq_f32_u32(vmovl_u16(vget_low_u16(low))), weights[k]);
+					sums[1] = vmlaq_n_f32(sums[1], vcvtq_f32_u32(vmovl_u16(vget_high_u16(low))), weights[k]);
+					sums[2] = vmlaq_n_f32(sums[2], vcvtq_f32_u32(vmovl_u16(vget_low_u16(high))), weights[k]);
+					sums[3] = vmlaq_n_f32(sums[3], vcvtq_f32_u32(vmovl_u16(vget_high_u16(high))), weights[k]);
+				}
+				for (int j = 0; j < 4; ++j)
+				{
+					vst1q_f32(output + i + j * 4, sums[j]);
+				}
+			}
+
+			return i;
+		}
+#endif
+
+		/*!
+		 * @brief	縦方向の縮小(複数行の重み付き和)を求める
+		 * @param	rows		入力行
+		 * @param	weights		行ごとの重み
+		 * @param	rowCount	行数
+		 * @param	output		出力(length要素)
+		 * @param	length		1行の要素数(幅×チャンネル数)
+		 * @param	useSimd		SIMDを使うか(falseの場合はスカラー処理のみ)
+		 */
+		void SumRows(const std::uint8_t* const* rows, const float* weights, int rowCount, float* output, size_t length, bool useSimd) noexcept
+		{
+			size_t processedCount = 0;
+
+#if defined(KCHARY_SIMD_X86)
+			if (useSimd)
+			{
+				processedCount = HasAvx2() ? SumRowsAvx2(rows, weights, rowCount, output, length) : SumRowsSse2(rows, weights, rowCount, output, length);
+			}
+#elif defined(KCHARY_SIMD_NEON)
+			if (useSimd)
+			{
+				processedCount = SumRowsNeon(rows, weights, rowCount, output, length);
+			}
+#else
+			static_cast<void>(useSimd);
+#endif
+
+			SumRowsScalar(rows, weights, rowCount, output, processedCount, length);
+		}
+
+		/*!
+		 * @brief	4Byteにまとめた1画素を書き込む
+		 * @note	3chの場合、行末以外では次の画素の先頭1Byteにも書き込み、次の画素の書き込みで上書きする
+		 */
+		template <int Channels>
+		void StorePixel(std::uint8_t* output, std::uint32_t pixel, bool isLastPixel) noexcept
+		{
+			std::memcpy(output, &pixel, Channels == 4 || !isLastPixel ? 4 : Channels);
+		}
+
+		/*!
+		 * @brief	横方向の縮小を求め、8bitに丸めて出力する(スカラー処理)
+		 * @note	引数はSumColumnsと同じ。丸めはSIMD処理と同じく最近接偶数への丸めとし、命令セットによって出力が変わらないようにする
+		 */
+		template <int Channels>
+		void SumColumnsScalar(const float* source, const AreaTable& table, std::uint8_t* destination, int width) noexcept
+		{
+			const int tapCount = table.tapCount;
+			for (int x = 0; x < width; ++x)
+			{
+				const float* pixel = source + static_cast<size_t>(table.starts[x]) * Channels;
+				const float* weights = table.weights.data() + static_cast<size_t>(x) * tapCount;
+				std::uint8_t* output = destination + static_cast<size_t>(x) * Channels;
+
+				for (int c = 0; c < Channels; ++c)
+				{
+					float sum = pixel[c] * weights[0];
+					for (int k = 1; k < tapCount; ++k)
+					{
+						sum += pixel[k * Channels + c] * weights[k];
+					}
+					output[c] = static_cast<std::uint8_t>((std::min)(std::nearbyint(sum), 255.0f));
+				}
+			}
+		}
+
+		/*!
+		 * @brief	横方向の縮小を求め、8bitに丸めて出力する
+		 * @param	source		縦方向に縮小した行(末尾にtapCount画素分と1要素の0埋めされた余白があること)
+		 * @param	table		横方向の重みの表
+		 * @param	destination	出力行
+		 * @param	width		出力する画素数
+		 * @note	1画素を4要素のベクトルとして積算する(3chの場合は4要素目に隣の画素を読み込み、書き込まない)
+		 */
+		template <int Channels>
+		void SumColumns(const float* source, const AreaTable& table, std::uint8_t* destination, int width) noexcept
+		{
+#if defined(KCHARY_SIMD_X86) || defined(KCHARY_SIMD_NEON)
+			const int tapCount = table.tapCount;
+			for (int x = 0; x < width; ++x)
+			{
+				const float* pixel = source + static_cast<size_t>(table.starts[x]) * Channels;
+				const float* weights = table.weights.data() + static_cast<size_t>(x) * tapCount;
+				std::uint8_t* output = destination + static_cast<size_t>(x) * Channels;
+
+#if defined(KCHARY_SIMD_X86)
+				__m128 sum = _mm_mul_ps(_mm_loadu_ps(pixel), _mm_set1_ps(weights[0]));
+				for (int k = 1; k < tapCount; ++k)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pixel + k * Channels), _mm_set1_ps(weights[k])));
+				}
+
+				// 最近接偶数に丸めて0～255に飽和させる(cv::saturate_castと同じ)
+				const __m128i values = _mm_cvtps_epi32(sum);
+				const __m128i words = _mm_packs_epi32(values, values);
+				StorePixel<Channels>(output, static_cast<std::uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words))), x + 1 == width);
+#elif defined(KCHARY_SIMD_NEON)
+				float32x4_t sum = vmulq_n_f32(vld1q_f32(pixel), weights[0]);
+				for (int k = 1; k < tapCount; ++k)
+				{
+					sum = vmlaq_n_f32(sum, vld1q_f32(pixel + k * Channels), weights[k]);
+				}
+
+				// x86と同じく最近接偶数に丸める(ARMv7には丸めを指定した変換命令がないため、2^23を加減して整数に丸める)
+#if defined(__aarch64__) || defined(_M_ARM64)
+				const int32x4_t values = vcvtnq_s32_f32(sum);
+#else
+				const float32x4_t roundingBias = vdupq_n_f32(8388608.0f);
+				const int32x4_t values = vcvtq_s32_f32(vsubq_f32(vaddq_f32(sum, roundingBias), roundingBias));
+#endif
+				const uint16x4_t words = vqmovun_s32(values);
+				const uint8x8_t bytes = vqmovn_u16(vcombine_u16(words, words));
+				StorePixel<Channels>(output, vget_lane_u32(vreinterpret_u32_u8(bytes), 0), x + 1 == width);
+#endif
+			}
+#else
+			SumColumnsScalar<Channels>(source, table, destination, width);
+#endif
+		}
+
+		template <int Channels>
+		void ResizeAreaImpl(const cv::Mat& source, cv::Mat& destination, bool useSimd)
+		{
+			const AreaTable columnTable = BuildAreaTable(source.cols, destination.cols);
+			const AreaTable rowTable = BuildAreaTable(source.rows, destination.rows);
+
+			const size_t rowLength = static_cast<size_t>(source.cols) * Channels;
+			const size_t bufferLength = (static_cast<size_t>(source.cols) + columnTable.tapCount) * Channels + 1;
+
+			// 出力行を分割して並列に処理する(cv::resizeと同じくOpenCVのスレッドプールを使う)
+			cv::parallel_for_(cv::Range(0, destination.rows), [&](const cv::Range& range)
+				{
+					std::vector<float> rowBuffer(bufferLength, 0.0f);
+					std::vector<const std::uint8_t*> sourceRows(rowTable.tapCount);
+					for (int y = range.start; y < range.end; ++y)
+					{
+						const int rowCount = rowTable.counts[y];
+						for (int k = 0; k < rowCount; ++k)
+						{
+							sourceRows[k] = source.ptr<std::uint8_t>(rowTable.starts[y] + k);
+						}
+
+						SumRows(sourceRows.data(), rowTable.weights.data() + static_cast<size_t>(y) * rowTable.tapCount, rowCount, rowBuffer.data(), rowLength, useSimd);
+						if (useSimd)
+						{
+							SumColumns<Channels>(rowBuffer.data(), columnTable, destination.ptr<std::uint8_t>(y), destination.cols);
+						}
+						else
+						{
+							SumColumnsScalar<Channels>(rowBuffer.data(), columnTable, destination.ptr<std::uint8_t>(y), destination.cols);
+						}
+					}
+				});
+		}
+	}
+
+	namespace
+	{
+		bool ResizeArea(const cv::Mat& source, cv::Mat& destination, bool useSimd)
+		{
+			if (source.empty() || destination.empty() || source.type() != destination.type()
+				|| destination.cols > source.cols || destination.rows > source.rows)
+			{
+				return false;
+			}
+
+			switch (source.type())
+			{
+			case CV_8UC3:
+				ResizeAreaImpl<3>(source, destination, useSimd);
+				return true;
+			case CV_8UC4:
+				ResizeAreaImpl<4>(source, destination, useSimd);
+				return true;
+			default:
+				return false;
+			}
+		}
+	}
+
+	bool ResizeArea(const cv::Mat& source, cv::Mat& destination)
+	{
+		return ResizeArea(source, destination, true);
+	}
+
+	bool ResizeAreaScalar(const cv::Mat& source, cv::Mat& destination)
+	{
+		return ResizeArea(source, destination, false);
+	}
+}
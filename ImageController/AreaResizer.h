@@ -0,0 +1,32 @@
+/*!
+ * @file	AreaResizer.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Simd
+{
+	/*!
+	 * @brief	8bitの画像を面積平均法で縮小しながら書き込み先へ出力する
+	 * @param	source		入力(CV_8UC3またはCV_8UC4)
+	 * @param	destination	書き込み先(sourceと同じ型で、幅・高さがsource以下のサイズで確保済みであること。sourceと重なってはならない)
+	 * @return	成功: True, 失敗: False(未対応の型・拡大を含むサイズ。呼び出し元でcv::resizeを使用する)
+	 * @note	cv::resize(INTER_AREA)と同じ重みを縦方向・横方向に分けて適用する。
+	 *			縦方向の積算はAVX2(実行時に判定)・SSE2・NEONで、横方向の積算はチャンネル数ごとに特殊化して処理する。
+	 *			丸め誤差によりcv::resizeの結果と画素値が最大1異なる場合がある。
+	 *			丸めは全ての命令セットで最近接偶数への丸めとし、ResizeAreaScalar()と同じ出力になる
+	 */
+	bool ResizeArea(const cv::Mat& source, cv::Mat& destination);
+
+	/*!
+	 * @brief	ResizeArea()と同じ縮小をSIMDを使わずに行う
+	 * @param	source		入力(CV_8UC3またはCV_8UC4)
+	 * @param	destination	書き込み先(ResizeArea()と同じ条件)
+	 * @return	成功: True, 失敗: False
+	 * @note	SIMD処理の結果が命令セットによらず一致することを確認するための参照実装
+	 */
+	bool ResizeAreaScalar(const cv::Mat& source, cv::Mat& destination);
+}
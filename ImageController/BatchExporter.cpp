@@ -0,0 +1,473 @@
+/*!
+ * @file	BatchExporter.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "BatchExporter.h"
+#include "ImageReader.h"
+#include "ImageDataWriter.h"
+#include "BoundedQueue.h"
+#include "CancellationToken.h"
+#include "MappedFile.h"
+#include "WritableFile.h"
+#include <algorithm>	// std::max
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>		// std::cerr
+#include <mutex>
+#include <thread>
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Library
+{
+	namespace
+	{
+		using Clock = std::chrono::steady_clock;
+
+		constexpr size_t DefaultMaxPendingBytes = 512ull * 1024 * 1024;	//!< エンコード待ちの画素データの既定の上限
+		constexpr int DefaultJpegQuality = 95;								//!< JPEGの既定の品質
+		constexpr wchar_t TemporarySuffix[] = L".partial";					//!< 書き込み中の一時ファイルの接尾辞
+
+		/*!
+		 * @brief	画像形式に対応するエンコーダーの拡張子を取得する
+		 */
+		const char* GetEncoderExtension(ExportFormat format) noexcept
+		{
+			switch (format)
+			{
+			case ExportFormat::Png:
+				return ".png";
+			case ExportFormat::Bmp:
+				return ".bmp";
+			case ExportFormat::Tiff:
+				return ".tif";
+			default:
+				return ".jpg";
+			}
+		}
+
+		/*!
+		 * @brief	16ビットの画素をそのまま書き出せる画像形式か判定する(JPEG・BMPは8ビットのみ)
+		 */
+		bool SupportsHighBitDepth(ExportFormat format) noexcept
+		{
+			return format == ExportFormat::Png || format == ExportFormat::Tiff;
+		}
+
+		/*!
+		 * @brief	エンコードのパラメータを作成する
+		 */
+		std::vector<int> CreateEncodeParameters(const ExportJob& job)
+		{
+			if (job.format != ExportFormat::Jpeg)
+			{
+				return {};
+			}
+
+			const int quality = job.quality > 0 ? (std::min)(job.quality, 100) : DefaultJpegQuality;
+			return { cv::IMWRITE_JPEG_QUALITY, quality };
+		}
+
+		/*!
+		 * @brief	経過時間をミリ秒で取得する
+		 */
+		double ToMilliseconds(Clock::duration duration) noexcept
+		{
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+
+		/*!
+		 * @brief	エンコード結果を一時ファイルへ書き込み、書き出し先と置き換える
+		 * @param	destinationPath	書き出し先パス
+		 * @param	data			エンコード結果
+		 * @return	成功: True, 失敗: False(一時ファイルは削除する)
+		 */
+		bool WriteFile(const std::wstring& destinationPath, const std::vector<uchar>& data)
+		{
+			const std::wstring temporaryPath = destinationPath + TemporarySuffix;
+
+			IO::WritableFile file;
+			// 置き換えた後に電源が断たれても書き出し先が空・書きかけにならないよう、ストレージへ書き出してから置き換える
+			bool result = file.Open(temporaryPath.c_str(), IO::WritableFile::OpenMode::Truncate) && file.Write(data.data(), data.size()) && file.Flush();
+			file.Close();
+
+			result = result && IO::ReplaceFile(temporaryPath.c_str(), destinationPath.c_str());
+			if (!result)
+			{
+				IO::RemoveFile(temporaryPath.c_str());
+			}
+
+			return result;
+		}
+	}
+
+	/*!
+	 * @brief 工程のスレッドとキュー
+	 */
+	struct BatchExporter::Impl
+	{
+		/*!
+		 * @brief デコード工程からエンコード工程へ渡す画像
+		 */
+		struct Item
+		{
+			ExportResult result;	//!< 書き出し結果
+			ImageData imageData{};	//!< デコード・縮小した画像
+		};
+
+		/*!
+		 * @brief エンコード待ちの画素データの合計を上限以下に抑えるクラス
+		 * @note 上限を超える1枚は、他にエンコード待ちの画像がなければ受け付ける(上限が小さくても処理が止まらないようにする)
+		 */
+		class PendingBudget final
+		{
+		public:
+			explicit PendingBudget(size_t capacity)
+				: m_capacity(capacity)
+			{
+			}
+
+			/*!
+			 * @brief	画素データの分だけ確保する(空きができるまで待つ)
+			 * @return	確保した: True, 中断された: False
+			 */
+			bool Acquire(size_t bytes)
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_released.wait(lock, [this, bytes]() { return m_isAborted || m_pendingBytes == 0 || m_pendingBytes + bytes <= m_capacity; });
+				if (m_isAborted)
+				{
+					return false;
+				}
+
+				m_pendingBytes += bytes;
+				m_peakBytes = (std::max)(m_peakBytes, m_pendingBytes);
+				return true;
+			}
+
+			void Release(size_t bytes)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_pendingBytes -= bytes;
+				}
+				m_released.notify_all();
+			}
+
+			/*!
+			 * @brief	待っている確保を全て失敗させる
+			 */
+			void Abort()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_isAborted = true;
+				}
+				m_released.notify_all();
+			}
+
+			size_t GetPeakBytes()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				return m_peakBytes;
+			}
+
+		private:
+			const size_t m_capacity;				//!< 上限(Byte)
+			std::mutex m_mutex;						//!< 以下のメンバーを保護するミューテックス
+			std::condition_variable m_released;		//!< 解放・中断通知
+			size_t m_pendingBytes = 0;				//!< エンコード待ちの画素データの合計
+			size_t m_peakBytes = 0;					//!< m_pendingBytesの最大値
+			bool m_isAborted = false;				//!< 中断されたか
+		};
+
+		Impl(ImageReader& reader, const BatchExportSettings& settings)
+			: imageReader(reader)
+			, decodeThreadCount(settings.decodeThreadCount > 0 ? settings.decodeThreadCount : (std::max)(1u, std::thread::hardware_concurrency()))
+			, encodeThreadCount(settings.encodeThreadCount > 0 ? settings.encodeThreadCount : (std::max)(1u, std::thread::hardware_concurrency() / 2))
+			, queueDepth(settings.queueDepth > 0 ? settings.queueDepth : static_cast<size_t>(decodeThreadCount) * 2)
+			, maxPendingBytes(settings.maxPendingBytes > 0 ? settings.maxPendingBytes : DefaultMaxPendingBytes)
+			, cancellationToken(std::make_unique<Threading::CancellationToken>())
+		{
+		}
+
+		BatchExportStatistics Run(const std::vector<ExportJob>& exportJobs, const ExportResultCallback& resultCallback)
+		{
+			const auto startTime = Clock::now();
+			{
+				// 中断要求はRun()の開始前に受けたものも有効にするため、ここでは作り直さない
+				std::lock_guard<std::mutex> lock(controlMutex);
+				encodeQueue = std::make_unique<Threading::BoundedQueue<Item>>(queueDepth);
+				pendingBudget = std::make_unique<PendingBudget>(maxPendingBytes);
+				if (cancellationToken->IsCancelled())
+				{
+					encodeQueue->Abort();
+					pendingBudget->Abort();
+				}
+			}
+
+			jobs = &exportJobs;
+			callback = &resultCallback;
+			isReported.assign(exportJobs.size(), false);
+			statistics = BatchExportStatistics{};
+			statistics.jobCount = exportJobs.size();
+			nextIndex.store(0);
+			activeDecoderCount.store(decodeThreadCount);
+
+			std::vector<std::thread> threads;
+			for (unsigned int i = 0; i < decodeThreadCount; ++i)
+			{
+				threads.emplace_back(&Impl::DecodeLoop, this);
+			}
+			for (unsigned int i = 0; i < encodeThreadCount; ++i)
+			{
+				threads.emplace_back(&Impl::EncodeLoop, this);
+			}
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+
+			// 中断により処理しなかった画像も結果を通知する
+			for (size_t index = 0; index < exportJobs.size(); ++index)
+			{
+				if (!isReported[index])
+				{
+					ExportResult result;
+					result.index = index;
+					Report(result);
+				}
+			}
+
+			statistics.peakPendingBytes = pendingBudget->GetPeakBytes();
+			statistics.elapsedSeconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+			jobs = nullptr;
+			callback = nullptr;
+			return statistics;
+		}
+
+		void Cancel()
+		{
+			std::lock_guard<std::mutex> lock(controlMutex);
+			cancellationToken->Cancel();
+			if (encodeQueue)
+			{
+				encodeQueue->Abort();
+				pendingBudget->Abort();
+			}
+		}
+
+		void ResetCancel()
+		{
+			// 実行中のRun()はデコード時に中断要求を参照するため、Run()を実行していない間のみ作り直せる
+			std::lock_guard<std::mutex> lock(controlMutex);
+			cancellationToken = std::make_unique<Threading::CancellationToken>();
+		}
+
+		/*!
+		 * @brief	デコードと縮小の工程
+		 */
+		void DecodeLoop()
+		{
+			for (size_t index = nextIndex.fetch_add(1); index < jobs->size() && !cancellationToken->IsCancelled(); index = nextIndex.fetch_add(1))
+			{
+				const auto& job = (*jobs)[index];
+
+				// RAW画像はサムネイルではなく現像した画像を縮小する。向きはファイルの記録に従って適用する。
+				// 16ビットを書き出せる形式では、元画像(RAW・16ビットPNG/TIFF)の階調を8ビットへ落とさずに書き出す
+				ImageReadSettings imageReadSettings{};
+				imageReadSettings.isRawImage = job.isRawImage;
+				imageReadSettings.isHighBitDepth = SupportsHighBitDepth(job.format);
+				imageReadSettings.resizeLongSideLength = (std::max)(0, job.longSideLength);
+				imageReadSettings.isThumbnailMode = !job.isRawImage && job.longSideLength > 0;
+				imageReadSettings.bypassPyramidCache = true;
+
+				Item item;
+				item.result.index = index;
+
+				const auto decodeStartTime = Clock::now();
+				bool result = false;
+				try
+				{
+					result = imageReader.GetImageData(job.sourcePath.c_str(), imageReadSettings, item.imageData, cancellationToken.get());
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << "BatchExporter::DecodeLoop error: " << e.what() << std::endl;
+				}
+				item.result.decodeMilliseconds = ToMilliseconds(Clock::now() - decodeStartTime);
+
+				if (cancellationToken->IsCancelled())
+				{
+					break;
+				}
+
+				if (!result)
+				{
+					item.result.status = ExportStatus::DecodeFailed;
+					Report(item.result);
+					continue;
+				}
+
+				// エンコード待ちの画素データが上限を超える間は、次のデコードに進まない
+				if (!pendingBudget->Acquire(item.imageData.size) || !encodeQueue->Push(std::move(item)))
+				{
+					break;
+				}
+			}
+
+			// 最後に終わったスレッドが次の工程へ終端を伝える
+			if (activeDecoderCount.fetch_sub(1) == 1)
+			{
+				encodeQueue->Close();
+			}
+		}
+
+		/*!
+		 * @brief	エンコードと書き込みの工程
+		 */
+		void EncodeLoop()
+		{
+			std::vector<uchar> encodedData;		// スレッドごとに再利用し、画像ごとの確保を省く
+			Item item;
+			while (encodeQueue->Pop(item))
+			{
+				const auto& job = (*jobs)[item.result.index];
+				const size_t pendingBytes = item.imageData.size;
+				const auto encodeStartTime = Clock::now();
+
+				item.result.width = item.imageData.width;
+				item.result.height = item.imageData.height;
+				item.result.status = Encode(job, item.imageData, encodedData);
+				if (item.result.status == ExportStatus::Succeeded)
+				{
+					item.result.outputBytes = encodedData.size();
+				}
+				item.result.encodeMilliseconds = ToMilliseconds(Clock::now() - encodeStartTime);
+
+				// 画素バッファをプールへ返却してから、次のデコードを受け付ける
+				item.imageData.buffer.Release();
+				pendingBudget->Release(pendingBytes);
+
+				Report(item.result);
+			}
+		}
+
+		/*!
+		 * @brief	画像をエンコードして書き出し先へ書き込む
+		 */
+		ExportStatus Encode(const ExportJob& job, const ImageData& imageData, std::vector<uchar>& encodedData) const
+		{
+			// デコード結果はBGR(PNG・TIFFへ書き出す場合は16bitの場合がある)
+			const cv::Mat image(imageData.height, imageData.width, Common::ToMatType(imageData.pixelFormat), const_cast<std::byte*>(imageData.buffer.data()), static_cast<size_t>(imageData.stride));
+			encodedData.clear();
+			try
+			{
+				if (!cv::imencode(GetEncoderExtension(job.format), image, encodedData, CreateEncodeParameters(job)))
+				{
+					return ExportStatus::EncodeFailed;
+				}
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "BatchExporter::Encode error: " << e.what() << std::endl;
+				return ExportStatus::EncodeFailed;
+			}
+
+			// 中断された場合は書き出し先を置き換えない
+			if (cancellationToken->IsCancelled())
+			{
+				return ExportStatus::Cancelled;
+			}
+
+			return WriteFile(job.destinationPath, encodedData) ? ExportStatus::Succeeded : ExportStatus::WriteFailed;
+		}
+
+		/*!
+		 * @brief	1枚の結果を集計し、呼び出し元へ通知する
+		 */
+		void Report(const ExportResult& result)
+		{
+			// ファイルシステムへの問い合わせで他のスレッドの通知を待たせないよう、ロックの外で元画像のサイズを取得する
+			IO::FileStatus fileStatus;
+			const bool hasFileStatus = result.status == ExportStatus::Succeeded && IO::GetFileStatus((*jobs)[result.index].sourcePath.c_str(), fileStatus);
+
+			std::lock_guard<std::mutex> lock(reportMutex);
+			isReported[result.index] = true;
+
+			statistics.decodeSeconds += result.decodeMilliseconds / 1000.0;
+			statistics.encodeSeconds += result.encodeMilliseconds / 1000.0;
+			if (result.status == ExportStatus::Succeeded)
+			{
+				if (hasFileStatus)
+				{
+					statistics.inputBytes += fileStatus.length;
+				}
+
+				++statistics.succeededCount;
+				statistics.outputBytes += result.outputBytes;
+				statistics.outputPixels += static_cast<unsigned long long>(result.width) * static_cast<unsigned long long>(result.height);
+			}
+			else if (result.status != ExportStatus::Cancelled)
+			{
+				++statistics.failedCount;
+			}
+
+			if (*callback)
+			{
+				try
+				{
+					(*callback)((*jobs)[result.index], result);
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << "BatchExporter::Report error: " << e.what() << std::endl;
+				}
+			}
+		}
+
+		ImageReader& imageReader;											//!< デコードに使う画像リーダー
+		const unsigned int decodeThreadCount;								//!< デコードスレッド数
+		const unsigned int encodeThreadCount;								//!< エンコードスレッド数
+		const size_t queueDepth;											//!< 工程間のキューの最大要素数
+		const size_t maxPendingBytes;										//!< エンコード待ちの画素データの上限
+
+		std::mutex controlMutex;											//!< 中断要求・キューの生成と中断を保護するミューテックス
+		std::unique_ptr<Threading::CancellationToken> cancellationToken;	//!< 中断要求(ResetCancel()まで以降のRun()も中断する)
+		std::unique_ptr<Threading::BoundedQueue<Item>> encodeQueue;		//!< デコード → エンコード
+		std::unique_ptr<PendingBudget> pendingBudget;						//!< エンコード待ちの画素データの量
+
+		const std::vector<ExportJob>* jobs = nullptr;						//!< 実行中の書き出し内容の一覧
+		const ExportResultCallback* callback = nullptr;						//!< 結果を受け取る関数
+		std::atomic<size_t> nextIndex{ 0 };									//!< 次にデコードする書き出し内容のインデックス
+		std::atomic<unsigned int> activeDecoderCount{ 0 };					//!< 動作中のデコードスレッド数
+
+		std::mutex reportMutex;												//!< 以下のメンバーと結果の通知を保護するミューテックス
+		std::vector<bool> isReported;										//!< 結果を通知したか(書き出し内容ごと)
+		BatchExportStatistics statistics{};									//!< 統計情報
+	};
+
+	BatchExporter::BatchExporter(ImageReader& imageReader, const BatchExportSettings& settings)
+		: m_impl(std::make_unique<Impl>(imageReader, settings))
+	{
+	}
+
+	BatchExporter::~BatchExporter() = default;
+
+	BatchExportStatistics BatchExporter::Run(const std::vector<ExportJob>& jobs, const ExportResultCallback& callback)
+	{
+		return m_impl->Run(jobs, callback);
+	}
+
+	void BatchExporter::Cancel()
+	{
+		m_impl->Cancel();
+	}
+
+	void BatchExporter::ResetCancel()
+	{
+		m_impl->ResetCancel();
+	}
+}
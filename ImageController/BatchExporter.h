@@ -0,0 +1,128 @@
+/*!
+ * @file	BatchExporter.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// C++/CLIからインクルードされる場合に備え、<mutex>・<thread>・<atomic>を必要とする状態は実装ファイルで定義する
+namespace Kchary::ImageController::Library
+{
+	class ImageReader;
+
+	/*!
+	 * @brief 書き出す画像形式
+	 */
+	enum class ExportFormat
+	{
+		Jpeg,
+		Png,
+		Bmp,
+		Tiff,
+	};
+
+	/*!
+	 * @brief 1枚の書き出し内容
+	 */
+	struct ExportJob
+	{
+		std::wstring sourcePath;					//!< 元画像パス
+		std::wstring destinationPath;				//!< 書き出し先パス(既存のファイルは置き換える。フォルダは作成しない)
+		bool isRawImage = false;					//!< RAW画像か
+		int longSideLength = 0;						//!< 書き出す長辺の長さ(0以下: 等倍。元画像より大きい場合は拡大しない)
+		ExportFormat format = ExportFormat::Jpeg;	//!< 画像形式
+		int quality = 0;							//!< JPEGの品質(1～100。0: 95。JPEG以外では使わない)
+	};
+
+	/*!
+	 * @brief 書き出しの結果
+	 */
+	enum class ExportStatus
+	{
+		Succeeded,		//!< 成功
+		DecodeFailed,	//!< 元画像を読み込めなかった
+		EncodeFailed,	//!< エンコードに失敗した
+		WriteFailed,	//!< 書き出し先へ書き込めなかった
+		Cancelled,		//!< 中断により処理しなかった
+	};
+
+	/*!
+	 * @brief 1枚の書き出し結果
+	 */
+	struct ExportResult
+	{
+		size_t index = 0;								//!< Run()に渡した一覧のインデックス
+		ExportStatus status = ExportStatus::Cancelled;	//!< 結果
+		int width = 0;									//!< 書き出した画像の幅(EXIFの向きを適用後)
+		int height = 0;									//!< 書き出した画像の高さ(EXIFの向きを適用後)
+		unsigned long long outputBytes = 0;				//!< 書き出したバイト数
+		double decodeMilliseconds = 0.0;				//!< デコード・縮小に要した時間
+		double encodeMilliseconds = 0.0;				//!< エンコード・書き込みに要した時間
+	};
+
+	/*!
+	 * @brief	1枚の書き出しを終えたときに呼び出される関数
+	 * @note	ワーカースレッドから呼び出す(同時に複数のスレッドから呼び出すことはない)
+	 */
+	using ExportResultCallback = std::function<void(const ExportJob& job, const ExportResult& result)>;
+
+	/*!
+	 * @brief 画像を一括でデコード・縮小・エンコードしてファイルへ書き出すクラス
+	 * @note デコード(ImageReader)とエンコード・書き込みを別のスレッド群で並行に処理する。
+	 *		 工程間のキューは上限付きで、さらにエンコード待ちの画素データの合計がmaxPendingBytesを超える間はデコードを止めるため、
+	 *		 書き出す枚数によらずメモリ使用量は一定の範囲に収まる。
+	 *		 書き出しは一時ファイルへ書き込んでから置き換えるため、中断・失敗しても書き出し先に書きかけのファイルは残らない。
+	 *		 ウィンドウやWPFに依存しないため、Linuxのサーバーでも動作する
+	 */
+	class BatchExporter final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param imageReader	デコードに使う画像リーダー(このインスタンスより長く生存すること)
+		 * @param settings		一括書き出し設定
+		 */
+		BatchExporter(ImageReader& imageReader, const BatchExportSettings& settings);
+
+		/*!
+		 * @brief デストラクタ
+		 */
+		~BatchExporter();
+
+		BatchExporter(const BatchExporter&) = delete;
+		BatchExporter& operator=(const BatchExporter&) = delete;
+
+		/*!
+		 * @brief	一覧の画像を書き出し、全て終えるまで待つ
+		 * @param	jobs		書き出し内容の一覧
+		 * @param	callback	1枚ごとの結果を受け取る関数(nullptrの場合は呼び出さない)
+		 * @return	統計情報(スループットは処理枚数・画素数を経過時間で割って求める)
+		 * @note	全ての書き出し内容について、中断した場合も含めて結果を1回ずつ通知する。
+		 *			同時に複数のスレッドから呼び出さないこと
+		 */
+		BatchExportStatistics Run(const std::vector<ExportJob>& jobs, const ExportResultCallback& callback);
+
+		/*!
+		 * @brief	実行中のRun()を中断する(別のスレッドから呼び出す。処理中の画像は書き出し先へ反映しない)
+		 * @note	中断要求はResetCancel()を呼び出すまで残り、Run()の開始前に呼び出した場合もそのRun()を中断する
+		 *			(全ての画像を書き出さずに中断として通知する)
+		 */
+		void Cancel();
+
+		/*!
+		 * @brief	Cancel()による中断要求を取り消す(Run()を実行していない間に呼び出す)
+		 */
+		void ResetCancel();
+
+	private:
+		struct Impl;
+
+		std::unique_ptr<Impl> m_impl;	//!< 工程のスレッドとキュー
+	};
+}
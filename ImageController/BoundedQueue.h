@@ -0,0 +1,113 @@
+/*!
+ * @file	BoundedQueue.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace Kchary::ImageController::Threading
+{
+	/*!
+	 * @brief 上限付きのブロッキングキュー(複数の送り手・受け手から使用する)
+	 * @note 満杯の間はPush()が待つため、後段の工程が詰まると前段の工程も止まる
+	 */
+	template <typename T>
+	class BoundedQueue final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param capacity	最大要素数(1以上)
+		 */
+		explicit BoundedQueue(size_t capacity)
+			: m_capacity(capacity > 0 ? capacity : 1)
+		{
+		}
+
+		BoundedQueue(const BoundedQueue&) = delete;
+		BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+		/*!
+		 * @brief	要素を積む(満杯の間は空きができるまで待つ)
+		 * @param	item	要素
+		 * @return	積んだ: True, 閉じられた: False
+		 */
+		bool Push(T&& item)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_spaceAvailable.wait(lock, [this]() { return m_isClosed || m_items.size() < m_capacity; });
+				if (m_isClosed)
+				{
+					return false;
+				}
+
+				m_items.push_back(std::move(item));
+			}
+			m_itemAvailable.notify_one();
+			return true;
+		}
+
+		/*!
+		 * @brief	要素を取り出す(空の間は積まれるか閉じられるまで待つ)
+		 * @param	item	要素(out)
+		 * @return	取り出した: True, 閉じられて空になった: False
+		 */
+		bool Pop(T& item)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_itemAvailable.wait(lock, [this]() { return m_isClosed || !m_items.empty(); });
+				if (m_items.empty())
+				{
+					return false;
+				}
+
+				item = std::move(m_items.front());
+				m_items.pop_front();
+			}
+			m_spaceAvailable.notify_one();
+			return true;
+		}
+
+		/*!
+		 * @brief	これ以上積まないことを通知する(積まれている要素は取り出せる)
+		 */
+		void Close()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_isClosed = true;
+			}
+			m_itemAvailable.notify_all();
+			m_spaceAvailable.notify_all();
+		}
+
+		/*!
+		 * @brief	閉じて、積まれている要素を破棄する
+		 */
+		void Abort()
+		{
+			std::deque<T> items;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_isClosed = true;
+				items.swap(m_items);
+			}
+			m_itemAvailable.notify_all();
+			m_spaceAvailable.notify_all();
+		}
+
+	private:
+		const size_t m_capacity;					//!< 最大要素数
+		std::mutex m_mutex;							//!< 以下のメンバーを保護するミューテックス
+		std::condition_variable m_itemAvailable;	//!< 要素の追加・クローズ通知
+		std::condition_variable m_spaceAvailable;	//!< 空き・クローズ通知
+		std::deque<T> m_items;						//!< 要素
+		bool m_isClosed = false;					//!< 閉じられたか
+	};
+}
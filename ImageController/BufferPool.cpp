@@ -0,0 +1,132 @@
+﻿/*!
+ * @file	BufferPool.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "BufferPool.h"
+#include <new>			// std::align_val_t
+
+namespace Kchary::ImageController::Memory
+{
+	namespace
+	{
+		constexpr size_t BlockAlignment = 64;		//!< SIMD・キャッシュライン境界に揃える
+		constexpr size_t MinSizeClass = 4096;		//!< 最小のサイズクラス
+	}
+
+	BufferPool::BufferPool(size_t maxCachedBytes)
+		: m_maxCachedBytes(maxCachedBytes)
+	{
+	}
+
+	BufferPool::~BufferPool()
+	{
+		for (auto& [capacity, blocks] : m_freeBlocks)
+		{
+			for (auto* block : blocks)
+			{
+				FreeBlock(block);
+			}
+		}
+	}
+
+	void BufferPool::SetMaxCachedBytes(size_t maxCachedBytes)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_maxCachedBytes = maxCachedBytes;
+		TrimLocked();
+	}
+
+	BufferPoolStatistics BufferPool::GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return { m_allocationCount, m_reuseCount, m_cachedBytes };
+	}
+
+	size_t BufferPool::GetSizeClass(size_t size) noexcept
+	{
+		if (size <= MinSizeClass)
+		{
+			return MinSizeClass;
+		}
+
+		// 2のべき乗の区間を4分割した刻みに切り上げ、無駄を25%以内に抑える
+		size_t octave = MinSizeClass;
+		while (octave * 2 < size)
+		{
+			octave *= 2;
+		}
+
+		const size_t step = octave / 4;
+		return (size + step - 1) / step * step;
+	}
+
+	std::byte* BufferPool::AllocateBlock(size_t capacity)
+	{
+		// operator newで確保し、値初期化(ゼロ埋め)を行わない
+		return static_cast<std::byte*>(::operator new(capacity, std::align_val_t(BlockAlignment)));
+	}
+
+	void BufferPool::FreeBlock(std::byte* data) noexcept
+	{
+		::operator delete(data, std::align_val_t(BlockAlignment));
+	}
+
+	std::byte* BufferPool::Acquire(size_t capacity)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			const auto it = m_freeBlocks.find(capacity);
+			if (it != m_freeBlocks.end() && !it->second.empty())
+			{
+				auto* block = it->second.back();
+				it->second.pop_back();
+				m_cachedBytes -= capacity;
+				++m_reuseCount;
+				return block;
+			}
+			++m_allocationCount;
+		}
+
+		return AllocateBlock(capacity);
+	}
+
+	void BufferPool::Return(std::byte* data, size_t capacity) noexcept
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (capacity > m_maxCachedBytes)
+		{
+			FreeBlock(data);
+			return;
+		}
+
+		try
+		{
+			m_freeBlocks[capacity].push_back(data);
+		}
+		catch (...)
+		{
+			FreeBlock(data);
+			return;
+		}
+
+		m_cachedBytes += capacity;
+		TrimLocked();
+	}
+
+	void BufferPool::TrimLocked() noexcept
+	{
+		// 大きいサイズクラスから解放する
+		for (auto it = m_freeBlocks.rbegin(); it != m_freeBlocks.rend() && m_cachedBytes > m_maxCachedBytes; ++it)
+		{
+			auto& blocks = it->second;
+			while (!blocks.empty() && m_cachedBytes > m_maxCachedBytes)
+			{
+				FreeBlock(blocks.back());
+				blocks.pop_back();
+				m_cachedBytes -= it->first;
+			}
+		}
+	}
+}
@@ -0,0 +1,98 @@
+﻿/*!
+ * @file	BufferPool.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "PixelBuffer.h"
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace Kchary::ImageController::Memory
+{
+	/*!
+	 * @brief 画素バッファのプール
+	 * @note サイズクラスごとに返却されたバッファを保持し、同じサイズの画像を連続で読み込む場合はヒープ確保を行わない
+	 */
+	class BufferPool final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param maxCachedBytes	プールに保持する最大バイト数
+		 */
+		explicit BufferPool(size_t maxCachedBytes);
+
+		/*!
+		 * @brief デストラクタ
+		 */
+		~BufferPool();
+
+		BufferPool(const BufferPool&) = delete;
+		BufferPool& operator=(const BufferPool&) = delete;
+
+		/*!
+		 * @brief	プールに保持する最大バイト数を変更する(超過分は解放する)
+		 * @param	maxCachedBytes	最大バイト数
+		 */
+		void SetMaxCachedBytes(size_t maxCachedBytes);
+
+		/*!
+		 * @brief	統計情報を取得する
+		 * @return	統計情報
+		 */
+		BufferPoolStatistics GetStatistics() const;
+
+		/*!
+		 * @brief	サイズに対応するサイズクラスを取得する(1オクターブを4分割した刻みに切り上げる)
+		 * @param	size	サイズ(Byte)
+		 * @return	サイズクラス(Byte)
+		 */
+		static size_t GetSizeClass(size_t size) noexcept;
+
+		/*!
+		 * @brief	初期化せずにバッファを確保する
+		 * @param	capacity	サイズ(Byte)
+		 * @return	バッファの先頭
+		 */
+		static std::byte* AllocateBlock(size_t capacity);
+
+		/*!
+		 * @brief	AllocateBlockで確保したバッファを解放する
+		 * @param	data	バッファの先頭
+		 */
+		static void FreeBlock(std::byte* data) noexcept;
+
+	private:
+		friend class PixelBuffer;
+
+		/*!
+		 * @brief	バッファを借りる
+		 * @param	capacity	サイズクラス(Byte)
+		 * @return	バッファの先頭
+		 */
+		std::byte* Acquire(size_t capacity);
+
+		/*!
+		 * @brief	バッファを返却する(上限を超える場合は解放する)
+		 * @param	data		バッファの先頭
+		 * @param	capacity	サイズクラス(Byte)
+		 */
+		void Return(std::byte* data, size_t capacity) noexcept;
+
+		/*!
+		 * @brief	保持しているバッファを上限以下になるまで大きい順に解放する
+		 */
+		void TrimLocked() noexcept;
+
+		mutable std::mutex m_mutex;								//!< ミューテックス
+		std::map<size_t, std::vector<std::byte*>> m_freeBlocks;	//!< サイズクラスごとの返却済みバッファ
+		size_t m_cachedBytes = 0;								//!< 保持しているバイト数
+		size_t m_maxCachedBytes;								//!< 保持する最大バイト数
+		size_t m_allocationCount = 0;							//!< ヒープから確保した回数
+		size_t m_reuseCount = 0;								//!< 再利用した回数
+	};
+}
@@ -0,0 +1,79 @@
+/*!
+ * @file	CancellationToken.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+
+namespace Kchary::ImageController::Threading
+{
+	/*!
+	 * @brief デコードの中断要求を伝えるトークン
+	 * @note 要求側のスレッドがCancel()し、デコード側のスレッドが工程の区切りでIsCancelled()を確認する
+	 */
+	class CancellationToken final
+	{
+	public:
+		CancellationToken() = default;
+
+		CancellationToken(const CancellationToken&) = delete;
+		CancellationToken& operator=(const CancellationToken&) = delete;
+
+		/*!
+		 * @brief	中断を要求する
+		 */
+		void Cancel() noexcept
+		{
+			m_isCancelled.store(true, std::memory_order_relaxed);
+		}
+
+		/*!
+		 * @brief	中断が要求されたか
+		 * @return	要求された: True
+		 */
+		bool IsCancelled() const noexcept
+		{
+			return m_isCancelled.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<bool> m_isCancelled{ false };	//!< 中断要求フラグ
+	};
+
+	/*!
+	 * @brief 中断要求によりデコードを打ち切ったことを示す例外
+	 */
+	class OperationCancelled final : public std::runtime_error
+	{
+	public:
+		OperationCancelled()
+			: std::runtime_error("operation cancelled")
+		{
+		}
+	};
+
+	/*!
+	 * @brief	中断が要求されたか
+	 * @param	cancellationToken	トークン(nullptrの場合は中断しない)
+	 * @return	要求された: True
+	 */
+	inline bool IsCancelled(const CancellationToken* cancellationToken) noexcept
+	{
+		return cancellationToken && cancellationToken->IsCancelled();
+	}
+
+	/*!
+	 * @brief	中断が要求されていればOperationCancelledを送出する
+	 * @param	cancellationToken	トークン(nullptrの場合は中断しない)
+	 */
+	inline void ThrowIfCancelled(const CancellationToken* cancellationToken)
+	{
+		if (IsCancelled(cancellationToken))
+		{
+			throw OperationCancelled();
+		}
+	}
+}
@@ -0,0 +1,131 @@
+/*!
+ * @file	DecodeHandle.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "DecodeHandle.h"
+#include "CancellationToken.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace Kchary::ImageController::Library
+{
+	namespace
+	{
+		bool IsFinal(DecodeStatus status) noexcept
+		{
+			return status == DecodeStatus::Succeeded || status == DecodeStatus::Failed || status == DecodeStatus::Cancelled;
+		}
+	}
+
+	/*!
+	 * @brief 非同期デコードの状態(ハンドルとワーカーで共有する)
+	 */
+	struct DecodeHandle::State
+	{
+		std::mutex mutex;								//!< statusを保護するミューテックス
+		std::condition_variable completed;				//!< 完了通知
+		DecodeStatus status = DecodeStatus::Pending;	//!< 状態
+		Threading::CancellationToken cancellationToken;	//!< 中断要求
+		ImageData imageData{};							//!< デコード結果
+		ImageMetadata metadata{};						//!< デコード時に読み取ったメタデータ
+		CompletionCallback callback;					//!< 完了通知コールバック
+	};
+
+	DecodeStatus DecodeHandle::GetStatus() const
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		return m_state->status;
+	}
+
+	bool DecodeHandle::IsCompleted() const
+	{
+		return IsFinal(GetStatus());
+	}
+
+	bool DecodeHandle::Wait() const
+	{
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+		m_state->completed.wait(lock, [this]() { return IsFinal(m_state->status); });
+		return m_state->status == DecodeStatus::Succeeded;
+	}
+
+	bool DecodeHandle::WaitFor(unsigned int milliseconds) const
+	{
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+		return m_state->completed.wait_for(lock, std::chrono::milliseconds(milliseconds), [this]() { return IsFinal(m_state->status); });
+	}
+
+	void DecodeHandle::Cancel() const
+	{
+		m_state->cancellationToken.Cancel();
+
+		// 開始前であればワーカーを待たずに完了させる(タスクは取り出された時点で何もせずに終わる)
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		if (m_state->status == DecodeStatus::Pending)
+		{
+			m_state->status = DecodeStatus::Cancelled;
+			m_state->completed.notify_all();
+		}
+	}
+
+	ImageData& DecodeHandle::GetImageData() const
+	{
+		return m_state->imageData;
+	}
+
+	ImageMetadata& DecodeHandle::GetMetadata() const
+	{
+		return m_state->metadata;
+	}
+
+	DecodeHandle DecodeHandle::Create(CompletionCallback callback)
+	{
+		DecodeHandle handle;
+		handle.m_state = std::make_shared<State>();
+		handle.m_state->callback = std::move(callback);
+		return handle;
+	}
+
+	bool DecodeHandle::Start() const
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_state->mutex);
+			if (m_state->status == DecodeStatus::Pending)
+			{
+				m_state->status = DecodeStatus::Running;
+				return true;
+			}
+		}
+
+		if (m_state->callback)
+		{
+			m_state->callback(DecodeStatus::Cancelled, m_state->imageData);
+		}
+
+		return false;
+	}
+
+	void DecodeHandle::Complete(bool result) const
+	{
+		const DecodeStatus status = result ? DecodeStatus::Succeeded
+			: m_state->cancellationToken.IsCancelled() ? DecodeStatus::Cancelled : DecodeStatus::Failed;
+
+		// Wait()から戻った呼び出し元とコールバックが同時に画像データへ触れないよう、コールバックの後に完了を通知する
+		if (m_state->callback)
+		{
+			m_state->callback(status, m_state->imageData);
+		}
+
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		m_state->status = status;
+		m_state->completed.notify_all();
+	}
+
+	const Threading::CancellationToken& DecodeHandle::GetCancellationToken() const
+	{
+		return m_state->cancellationToken;
+	}
+}
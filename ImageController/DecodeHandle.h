@@ -0,0 +1,136 @@
+/*!
+ * @file	DecodeHandle.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <functional>
+#include <memory>
+
+// C++/CLIからインクルードされるため、<mutex>・<atomic>を必要とする状態は実装ファイルで定義する
+namespace Kchary::ImageController::Threading
+{
+	class CancellationToken;
+}
+
+namespace Kchary::ImageController::Library
+{
+	/*!
+	 * @brief 非同期デコードの状態
+	 */
+	enum class DecodeStatus
+	{
+		Pending,	//!< 開始待ち
+		Running,	//!< デコード中
+		Succeeded,	//!< 成功
+		Failed,		//!< 失敗
+		Cancelled	//!< 中断
+	};
+
+	/*!
+	 * @brief 非同期デコードの完了待ち・状態確認・中断を行うハンドル
+	 * @note コピーしたハンドルは同じデコードを参照する。全てのハンドルを破棄してもデコードは中断されない。
+	 *		 IsValid()以外のメンバー関数は、有効なハンドルに対してのみ呼び出すこと
+	 */
+	class DecodeHandle final
+	{
+	public:
+		/*!
+		 * @brief	完了通知コールバック(ワーカースレッドから1回だけ呼ばれる。開始後に完了した場合、Wait()はコールバックから戻った後に返る)
+		 * @param	status		最終的な状態(Succeeded, Failed, Cancelled)
+		 * @param	imageData	画像データ(コールバック内でムーブして受け取ってよい)
+		 * @note	開始前に中断された場合は、ワーカースレッドがタスクを取り出した時点でCancelledとして呼ばれる
+		 */
+		using CompletionCallback = std::function<void(DecodeStatus status, ImageData& imageData)>;
+
+		/*!
+		 * @brief コンストラクタ(どのデコードも参照しない無効なハンドルを作る)
+		 */
+		DecodeHandle() = default;
+
+		/*!
+		 * @brief	デコードを参照しているか
+		 * @return	参照している: True
+		 */
+		bool IsValid() const noexcept { return m_state != nullptr; }
+
+		/*!
+		 * @brief	現在の状態を取得する(ブロックしない)
+		 * @return	状態
+		 */
+		DecodeStatus GetStatus() const;
+
+		/*!
+		 * @brief	完了したか(ブロックしない)
+		 * @return	成功・失敗・中断のいずれかで完了した: True
+		 */
+		bool IsCompleted() const;
+
+		/*!
+		 * @brief	完了まで待つ
+		 * @return	成功: True, 失敗・中断: False
+		 */
+		bool Wait() const;
+
+		/*!
+		 * @brief	完了まで指定時間だけ待つ
+		 * @param	milliseconds	待ち時間(ミリ秒)
+		 * @return	完了した: True, 時間切れ: False
+		 */
+		bool WaitFor(unsigned int milliseconds) const;
+
+		/*!
+		 * @brief	中断を要求する(ブロックしない)
+		 * @note	開始前のデコードは直ちに中断として完了し、デコード中の場合は次の工程の区切り(RAWはLibRawの進捗通知)で打ち切る
+		 */
+		void Cancel() const;
+
+		/*!
+		 * @brief	デコード結果を取得する
+		 * @return	画像データ(成功した場合のみ有効。ムーブして受け取ってよい)
+		 * @note	完了前に呼び出してはならない
+		 */
+		ImageData& GetImageData() const;
+
+		/*!
+		 * @brief	デコード時に読み取ったメタデータを取得する
+		 * @return	メタデータ(成功した場合のみ有効)
+		 * @note	完了前に呼び出してはならない
+		 */
+		ImageMetadata& GetMetadata() const;
+
+	private:
+		friend class ImageReader;
+
+		struct State;
+
+		/*!
+		 * @brief	デコードを作成する
+		 * @param	callback	完了通知コールバック(nullptrの場合は通知しない)
+		 * @return	ハンドル
+		 */
+		static DecodeHandle Create(CompletionCallback callback);
+
+		/*!
+		 * @brief	デコードを開始状態にする(ワーカースレッドから呼ぶ)
+		 * @return	開始できた: True, 開始前に中断された: False
+		 */
+		bool Start() const;
+
+		/*!
+		 * @brief	デコードを完了させ、待機中のスレッドとコールバックへ通知する(ワーカースレッドから呼ぶ)
+		 * @param	result	デコード結果
+		 */
+		void Complete(bool result) const;
+
+		/*!
+		 * @brief	中断要求を取得する
+		 * @return	中断要求
+		 */
+		const Threading::CancellationToken& GetCancellationToken() const;
+
+		std::shared_ptr<State> m_state;	//!< デコードの状態(ハンドルとワーカーで共有する)
+	};
+}
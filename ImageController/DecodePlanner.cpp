@@ -0,0 +1,59 @@
+/*!
+ * @file	DecodePlanner.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "DecodePlanner.h"
+#include <algorithm>	// std::max
+
+namespace Kchary::ImageController::Decode
+{
+	namespace
+	{
+		/*!
+		 * @brief DCTスケーリングの縮小率と対応する画像取得モード(縮小率の大きい順)
+		 */
+		constexpr struct
+		{
+			int denominator;
+			cv::ImreadModes imreadMode;
+		} ReducedModes[] = {
+			{ 8, cv::IMREAD_REDUCED_COLOR_8 },
+			{ 4, cv::IMREAD_REDUCED_COLOR_4 },
+			{ 2, cv::IMREAD_REDUCED_COLOR_2 },
+		};
+
+		/*!
+		 * @brief	libjpegと同じく切り上げで縮小後の長さを求める
+		 */
+		constexpr int GetScaledLength(int length, int denominator) noexcept
+		{
+			return (length + denominator - 1) / denominator;
+		}
+	}
+
+	DecodePlan PlanDecode(const ImageHeader& header, int resizeLongSideLength) noexcept
+	{
+		DecodePlan plan;
+
+		if (header.isDctScalable && resizeLongSideLength > 0)
+		{
+			const int longSideLength = (std::max)(header.width, header.height);
+			for (const auto& reducedMode : ReducedModes)
+			{
+				if (GetScaledLength(longSideLength, reducedMode.denominator) >= resizeLongSideLength)
+				{
+					plan.imreadMode = reducedMode.imreadMode;
+					plan.scaleDenominator = reducedMode.denominator;
+					break;
+				}
+			}
+		}
+
+		plan.decodedWidth = GetScaledLength(header.width, plan.scaleDenominator);
+		plan.decodedHeight = GetScaledLength(header.height, plan.scaleDenominator);
+
+		return plan;
+	}
+}
@@ -0,0 +1,34 @@
+/*!
+ * @file	DecodePlanner.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageHeader.h"
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Decode
+{
+	/*!
+	 * @brief デコード方法
+	 */
+	struct DecodePlan
+	{
+		cv::ImreadModes imreadMode = cv::IMREAD_COLOR;	//!< 画像取得モード(OpenCV)
+		int scaleDenominator = 1;						//!< DCTスケーリングの縮小率の分母(1・2・4・8)
+		int decodedWidth = 0;							//!< デコード後の幅(ファイルに保存されている向き。ヘッダーを読めない場合は0)
+		int decodedHeight = 0;							//!< デコード後の高さ(ファイルに保存されている向き。ヘッダーを読めない場合は0)
+	};
+
+	/*!
+	 * @brief	要求サイズを下回らない範囲で最も小さくデコードする方法を求める
+	 * @param	header					画像のヘッダー
+	 * @param	resizeLongSideLength	リサイズする長辺の長さ(0以下の場合は縮小しない)
+	 * @return	デコード方法(残りの縮小はデコード後の画像に対して行う)
+	 * @note	EXIFの向きはデコード後の書き込みで適用するため、デコーダーには保存されている向きのまま出力させる(cv::IMREAD_IGNORE_ORIENTATION)。
+	 *			縮小デコードはJPEGのDCTスケーリングのみ使用する。
+	 *			それ以外の形式でOpenCVの縮小読み込みを使うと、等倍でデコードした後に補間で縮小するため画質が落ちる
+	 */
+	DecodePlan PlanDecode(const ImageHeader& header, int resizeLongSideLength) noexcept;
+}
@@ -0,0 +1,67 @@
+/*!
+ * @file	DecodeProtocol.h
+ * @author	kleon6436
+ * @brief	デコードサーバー(DecodeServer)とワーカー(RunDecodeWorker)の間で受け渡すメッセージ
+ * @note	同じビルドの実行ファイル同士でのみ通信するため、構造体をそのままのバイト列で送る
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <cstdint>
+
+namespace Kchary::ImageController::Service
+{
+	constexpr std::uint32_t ProtocolMagic = 0x4B444357;			//!< ワーカーの準備完了を示す値('KDCW')
+	constexpr std::uint32_t ProtocolVersion = 1;				//!< メッセージの形式のバージョン
+	constexpr std::uint32_t MaxPathLength = 32767;				//!< 受け付けるパスの最大長(wchar_tの数)
+	constexpr wchar_t WorkerArgument[] = L"--decode-worker";	//!< ワーカーとして起動する際の最初の引数
+
+	/*!
+	 * @brief 1枚のデコード結果
+	 */
+	enum class WorkerStatus : std::int32_t
+	{
+		Succeeded,			//!< 成功
+		DecodeFailed,		//!< デコードに失敗した
+		SlotTooSmall,		//!< 画像がスロットに収まらない
+		InvalidRequest,		//!< 要求が不正(スロット・パス長が範囲外)
+	};
+
+	/*!
+	 * @brief ワーカーが起動し、共有メモリをマップできたことを通知するメッセージ
+	 */
+	struct WorkerReady
+	{
+		std::uint32_t magic;		//!< ProtocolMagic
+		std::uint32_t version;		//!< ProtocolVersion
+	};
+
+	/*!
+	 * @brief デコード要求(直後にパスのwchar_tをpathLength個送る)
+	 */
+	struct DecodeRequest
+	{
+		std::uint64_t requestId;				//!< 要求ID(応答で返す)
+		std::uint32_t slotIndex;				//!< 画素を書き込むスロット
+		std::uint32_t pathLength;				//!< パスの長さ(wchar_tの数。終端を含まない)
+		std::uint32_t needsMetadata;			//!< メタデータを返すか(0以外)
+		ImageReadSettings imageReadSettings;	//!< 画像読み込み設定
+	};
+
+	/*!
+	 * @brief デコード結果(画素はスロットへ書き込み済み)
+	 */
+	struct DecodeResponse
+	{
+		std::uint64_t requestId;				//!< 要求ID
+		WorkerStatus status;					//!< 結果
+		std::int32_t width;						//!< 幅
+		std::int32_t height;					//!< 高さ
+		std::int32_t stride;					//!< ストライド
+		ImagePixelFormat pixelFormat;			//!< 画素の形式
+		std::uint32_t size;						//!< 画素データのバイト数
+		std::uint32_t hasMetadata;				//!< メタデータが有効か(0以外)
+		ImageMetadata metadata;					//!< メタデータ
+	};
+}
@@ -0,0 +1,658 @@
+/*!
+ * @file	DecodeServer.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "DecodeServer.h"
+#include "CancellationToken.h"
+#include "DecodeProtocol.h"
+#include "SharedMemory.h"
+#include "WorkerProcess.h"
+#include <algorithm>	// std::max, std::count_if, std::none_of
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cwchar>		// std::wcslen
+#include <mutex>
+#include <thread>
+#include <utility>		// std::exchange
+#include <vector>
+
+namespace Kchary::ImageController::Library
+{
+	namespace
+	{
+		using Clock = std::chrono::steady_clock;
+
+		constexpr size_t DefaultSlotBytes = 64ull * 1024 * 1024;			//!< 1スロットの既定のバイト数
+		constexpr unsigned int DefaultTimeoutMilliseconds = 30000;			//!< 1枚のデコードの既定の上限時間
+		constexpr std::chrono::milliseconds StartTimeout(10000);			//!< ワーカーの起動を待つ上限時間
+		constexpr std::chrono::milliseconds RestartInterval(1000);			//!< 起動に失敗したワーカーを再び起動するまでの間隔
+		constexpr std::chrono::milliseconds WatchInterval(100);				//!< 上限時間を確認する間隔
+		constexpr std::chrono::milliseconds CancellationPollInterval(50);	//!< 空きを待つ間に中断要求を確認する間隔
+
+		/*!
+		 * @brief 共有メモリを固定長のスロットに分け、デコード結果ごとに貸し出すクラス
+		 * @note DecodedImageが返却関数から参照するため、サーバーの停止後も最後の結果を返却するまで共有メモリを保持する
+		 */
+		class SlotPool final
+		{
+		public:
+			SlotPool(size_t slotCount, size_t slotBytes)
+				: m_slotBytes(slotBytes)
+			{
+				// 返却されたスロットを次に貸し出す(キャッシュに残っている可能性が高い)
+				for (size_t slot = slotCount; slot > 0; --slot)
+				{
+					m_freeSlots.push_back(slot - 1);
+				}
+			}
+
+			bool Create()
+			{
+				return m_sharedMemory.Create(m_freeSlots.size() * m_slotBytes);
+			}
+
+			/*!
+			 * @brief	空いているスロットを借りる(空くまで待つ)
+			 * @return	借りた: True, 中断・停止された: False
+			 */
+			bool Acquire(size_t& slot, const Threading::CancellationToken* cancellationToken)
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while (!m_isClosed && m_freeSlots.empty() && !Threading::IsCancelled(cancellationToken))
+				{
+					m_released.wait_for(lock, CancellationPollInterval);
+				}
+				if (m_isClosed || m_freeSlots.empty())
+				{
+					return false;
+				}
+
+				slot = m_freeSlots.back();
+				m_freeSlots.pop_back();
+				return true;
+			}
+
+			void Release(size_t slot)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_freeSlots.push_back(slot);
+				}
+				m_released.notify_one();
+			}
+
+			/*!
+			 * @brief	待っている貸し出しを全て失敗させ、以降も貸し出さない
+			 */
+			void Close()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_isClosed = true;
+				}
+				m_released.notify_all();
+			}
+
+			std::byte* GetSlot(size_t slot) const noexcept { return m_sharedMemory.data() + slot * m_slotBytes; }
+			size_t GetSlotBytes() const noexcept { return m_slotBytes; }
+			std::intptr_t GetHandle() const noexcept { return m_sharedMemory.GetHandle(); }
+
+		private:
+			IO::SharedMemory m_sharedMemory;			//!< スロットを並べた共有メモリ
+			const size_t m_slotBytes;					//!< 1スロットのバイト数
+			std::mutex m_mutex;							//!< 以下のメンバーを保護するミューテックス
+			std::condition_variable m_released;			//!< 返却・停止通知
+			std::vector<size_t> m_freeSlots;			//!< 空いているスロット
+			bool m_isClosed = false;					//!< 停止されたか
+		};
+
+		/*!
+		 * @brief ワーカーの状態
+		 */
+		enum class WorkerState
+		{
+			Stopped,	//!< 起動していない(異常終了・起動失敗を含む)
+			Idle,		//!< 要求を待っている
+			Busy,		//!< 要求を処理中、または起動中(いずれかのスレッドが占有している)
+		};
+
+		/*!
+		 * @brief ワーカープロセスと、その状態
+		 */
+		struct Worker
+		{
+			std::mutex processMutex;					//!< 起動・終了・強制終了を排他するミューテックス(読み書きは占有しているスレッドのみが行う)
+			Service::WorkerProcess process;				//!< ワーカープロセス
+			WorkerState state = WorkerState::Stopped;	//!< 状態(Impl::mutexで保護する)
+			Clock::time_point deadline;					//!< 処理中の要求・起動の上限時刻(Impl::mutexで保護する)
+			Clock::time_point nextStartTime;			//!< 起動を試みてよい時刻(Impl::mutexで保護する)
+			bool isTimedOut = false;					//!< 上限時間を超えたため強制終了したか(Impl::mutexで保護する)
+		};
+
+		DecodeServerStatus ToDecodeServerStatus(Service::WorkerStatus status) noexcept
+		{
+			switch (status)
+			{
+			case Service::WorkerStatus::Succeeded:
+				return DecodeServerStatus::Succeeded;
+			case Service::WorkerStatus::SlotTooSmall:
+				return DecodeServerStatus::SlotTooSmall;
+			default:
+				return DecodeServerStatus::DecodeFailed;
+			}
+		}
+
+		/*!
+		 * @brief	画素の形式の1画素あたりのバイト数を取得する
+		 * @return	バイト数(不明な形式の場合は0)
+		 */
+		size_t GetBytesPerPixel(ImagePixelFormat pixelFormat) noexcept
+		{
+			switch (pixelFormat)
+			{
+			case ImagePixelFormat::Bgr24:
+				return 3;
+			case ImagePixelFormat::Bgra32:
+				return 4;
+			case ImagePixelFormat::Bgr48:
+				return 6;
+			case ImagePixelFormat::Bgra64:
+				return 8;
+			default:
+				return 0;
+			}
+		}
+
+		/*!
+		 * @brief	成功した応答の画像がスロットに収まっているか判定する
+		 * @note	ワーカーは別プロセスのため、応答の値をそのまま信用せずにスロットの外を指さないことを確認する
+		 */
+		bool IsValidResponse(const Service::DecodeResponse& response, size_t slotBytes) noexcept
+		{
+			const size_t bytesPerPixel = GetBytesPerPixel(response.pixelFormat);
+			if (bytesPerPixel == 0 || response.width <= 0 || response.height <= 0 || response.stride <= 0 || response.size > slotBytes)
+			{
+				return false;
+			}
+
+			return static_cast<size_t>(response.stride) >= static_cast<size_t>(response.width) * bytesPerPixel
+				&& static_cast<size_t>(response.stride) * static_cast<size_t>(response.height) <= response.size;
+		}
+
+		/*!
+		 * @brief	固定長の文字列をNUL終端させる
+		 */
+		template <size_t Length>
+		void TerminateString(char (&text)[Length]) noexcept
+		{
+			text[Length - 1] = '\0';
+		}
+	}
+
+	DecodedImage::~DecodedImage()
+	{
+		Release();
+	}
+
+	DecodedImage::DecodedImage(DecodedImage&& other) noexcept
+		: m_imageData(std::move(other.m_imageData))
+		, m_release(std::exchange(other.m_release, nullptr))
+	{
+	}
+
+	DecodedImage& DecodedImage::operator=(DecodedImage&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Release();
+			m_imageData = std::move(other.m_imageData);
+			m_release = std::exchange(other.m_release, nullptr);
+		}
+
+		return *this;
+	}
+
+	void DecodedImage::Release() noexcept
+	{
+		if (m_release)
+		{
+			std::exchange(m_release, nullptr)();
+		}
+		m_imageData = ImageData{};
+	}
+
+	/*!
+	 * @brief ワーカーと共有メモリ
+	 */
+	struct DecodeServer::Impl
+	{
+		explicit Impl(const DecodeServerSettings& settings)
+			: workerPath(settings.workerPath)
+			, workerCount(settings.workerCount > 0 ? settings.workerCount : (std::max)(1u, std::thread::hardware_concurrency() / 2))
+			, slotCount(settings.slotCount > 0 ? settings.slotCount : static_cast<size_t>(workerCount) * 2)
+			, slotBytes(settings.slotBytes > 0 ? settings.slotBytes : DefaultSlotBytes)
+			, timeout(settings.timeoutMilliseconds > 0 ? settings.timeoutMilliseconds : DefaultTimeoutMilliseconds)
+		{
+		}
+
+		~Impl()
+		{
+			Stop();
+		}
+
+		bool Start()
+		{
+			std::lock_guard<std::mutex> controlLock(controlMutex);
+			if (isRunning.load())
+			{
+				return true;
+			}
+
+			auto newSlots = std::make_shared<SlotPool>(slotCount, slotBytes);
+			if (!newSlots->Create())
+			{
+				return false;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slots = newSlots;
+				for (unsigned int i = 0; i < workerCount; ++i)
+				{
+					workers.push_back(std::make_unique<Worker>());
+				}
+				isRunning.store(true);
+			}
+
+			// 起動が終わらないワーカーを強制終了できるよう、監視スレッドを先に開始する
+			watchdog = std::thread(&Impl::WatchLoop, this);
+
+			size_t startedCount = 0;
+			for (auto& worker : workers)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (worker->state != WorkerState::Stopped)
+					{
+						continue;	// 既にデコードの要求が起動した
+					}
+					worker->state = WorkerState::Busy;
+					worker->deadline = Clock::now() + StartTimeout;
+				}
+
+				const bool isStarted = StartWorker(*worker, *newSlots);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					worker->state = isStarted ? WorkerState::Idle : WorkerState::Stopped;
+					worker->nextStartTime = Clock::now() + RestartInterval;
+				}
+				stateChanged.notify_all();
+				startedCount += isStarted ? 1 : 0;
+			}
+
+			if (startedCount == 0)
+			{
+				StopLocked();
+				return false;
+			}
+
+			return true;
+		}
+
+		void Stop()
+		{
+			std::lock_guard<std::mutex> controlLock(controlMutex);
+			StopLocked();
+		}
+
+		/*!
+		 * @brief	停止する(controlMutexを保持して呼び出す)
+		 */
+		void StopLocked()
+		{
+			if (!isRunning.load())
+			{
+				return;
+			}
+
+			std::unique_lock<std::mutex> lock(mutex);
+			isRunning.store(false);
+			lock.unlock();
+			stateChanged.notify_all();
+			watchdog.join();
+			slots->Close();
+
+			// 処理中の要求はワーカーを終了させて打ち切り、占有しているスレッドが手放すまで待つ
+			lock.lock();
+			for (auto& worker : workers)
+			{
+				if (worker->state == WorkerState::Busy)
+				{
+					std::lock_guard<std::mutex> processLock(worker->processMutex);
+					worker->process.Terminate();
+				}
+			}
+			stateChanged.wait(lock, [this]()
+				{
+					return std::none_of(workers.begin(), workers.end(), [](const auto& worker) { return worker->state == WorkerState::Busy; });
+				});
+
+			auto stoppedWorkers = std::move(workers);
+			workers.clear();
+			slots.reset();
+			lock.unlock();
+
+			for (auto& worker : stoppedWorkers)
+			{
+				std::lock_guard<std::mutex> processLock(worker->processMutex);
+				worker->process.Close();
+			}
+		}
+
+		/*!
+		 * @brief	ワーカーで画像をデコードする
+		 * @param	imageData	スロット上の画素を指す画像データ(out)
+		 * @param	release		スロットを返却する関数(out。成功した場合のみ設定する)
+		 */
+		DecodeServerStatus Decode(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& imageData, std::function<void()>& release, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				++statistics.requestCount;
+			}
+
+			const size_t pathLength = imagePath ? std::wcslen(imagePath) : 0;
+			if (pathLength == 0 || pathLength > Service::MaxPathLength)
+			{
+				Count(DecodeServerStatus::DecodeFailed);
+				return DecodeServerStatus::DecodeFailed;
+			}
+
+			std::shared_ptr<SlotPool> slotPool;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slotPool = slots;
+			}
+
+			size_t slot = 0;
+			if (!slotPool || !slotPool->Acquire(slot, cancellationToken))
+			{
+				return Threading::IsCancelled(cancellationToken) ? DecodeServerStatus::Cancelled : DecodeServerStatus::Unavailable;
+			}
+
+			Worker* worker = AcquireWorker(*slotPool, cancellationToken);
+			if (!worker)
+			{
+				slotPool->Release(slot);
+				return Threading::IsCancelled(cancellationToken) ? DecodeServerStatus::Cancelled : DecodeServerStatus::Unavailable;
+			}
+
+			// パスと設定のみ送り、画素はワーカーがスロットへ直接書き込む
+			Service::DecodeRequest request{};
+			request.requestId = nextRequestId.fetch_add(1);
+			request.slotIndex = static_cast<std::uint32_t>(slot);
+			request.pathLength = static_cast<std::uint32_t>(pathLength);
+			request.needsMetadata = metadata ? 1 : 0;
+			request.imageReadSettings = imageReadSettings;
+
+			Service::DecodeResponse response{};
+			const bool isCompleted = worker->process.Write(&request, sizeof(request))
+				&& worker->process.Write(imagePath, pathLength * sizeof(wchar_t))
+				&& worker->process.Read(&response, sizeof(response))
+				&& response.requestId == request.requestId;
+
+			// スロットの外を指す応答を返したワーカーは異常終了したものとして扱う
+			const bool isValid = isCompleted && (response.status != Service::WorkerStatus::Succeeded || IsValidResponse(response, slotPool->GetSlotBytes()));
+			if (!isValid)
+			{
+				// 応答を得られない・応答が不正なワーカーは終了させ、次に必要になった時点で起動し直す
+				std::lock_guard<std::mutex> processLock(worker->processMutex);
+				worker->process.Terminate();
+				worker->process.Close();
+			}
+
+			DecodeServerStatus status = DecodeServerStatus::Unavailable;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (isValid)
+				{
+					worker->state = WorkerState::Idle;
+					status = ToDecodeServerStatus(response.status);
+				}
+				else
+				{
+					worker->state = WorkerState::Stopped;
+					worker->nextStartTime = Clock::now();
+					if (isCompleted)
+					{
+						status = DecodeServerStatus::WorkerCrashed;
+					}
+					else if (isRunning.load())
+					{
+						status = worker->isTimedOut ? DecodeServerStatus::TimedOut : DecodeServerStatus::WorkerCrashed;
+					}
+				}
+			}
+			stateChanged.notify_all();
+			Count(status);
+
+			if (status != DecodeServerStatus::Succeeded)
+			{
+				slotPool->Release(slot);
+				return status;
+			}
+
+			imageData.destination = slotPool->GetSlot(slot);
+			imageData.destinationCapacity = slotPool->GetSlotBytes();
+			imageData.size = response.size;
+			imageData.stride = response.stride;
+			imageData.width = response.width;
+			imageData.height = response.height;
+			imageData.pixelFormat = response.pixelFormat;
+			release = [slotPool, slot]() { slotPool->Release(slot); };
+			if (metadata && response.hasMetadata != 0)
+			{
+				*metadata = response.metadata;
+				TerminateString(metadata->make);
+				TerminateString(metadata->model);
+				TerminateString(metadata->dateTime);
+			}
+
+			return status;
+		}
+
+		DecodeServerStatistics GetStatistics() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto result = statistics;
+			result.runningWorkerCount = static_cast<size_t>(std::count_if(workers.begin(), workers.end(), [](const auto& worker) { return worker->state != WorkerState::Stopped; }));
+			return result;
+		}
+
+	private:
+		/*!
+		 * @brief	ワーカーを起動し、共有メモリをマップして準備ができるまで待つ
+		 * @return	成功: True, 失敗: False
+		 */
+		bool StartWorker(Worker& worker, const SlotPool& slotPool)
+		{
+			const std::vector<std::wstring> arguments{ Service::WorkerArgument, std::to_wstring(slotCount), std::to_wstring(slotBytes) };
+			{
+				std::lock_guard<std::mutex> processLock(worker.processMutex);
+				if (!worker.process.Start(workerPath, arguments, slotPool.GetHandle()))
+				{
+					return false;
+				}
+			}
+
+			Service::WorkerReady ready{};
+			if (worker.process.Read(&ready, sizeof(ready)) && ready.magic == Service::ProtocolMagic && ready.version == Service::ProtocolVersion)
+			{
+				return true;
+			}
+
+			std::lock_guard<std::mutex> processLock(worker.processMutex);
+			worker.process.Terminate();
+			worker.process.Close();
+			return false;
+		}
+
+		/*!
+		 * @brief	空いているワーカーを占有する(なければ停止しているワーカーを起動し直し、それもなければ空くまで待つ)
+		 * @return	ワーカー(停止された、中断された、または全てのワーカーを起動できない場合はnullptr)
+		 */
+		Worker* AcquireWorker(const SlotPool& slotPool, const Threading::CancellationToken* cancellationToken)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (isRunning.load() && !Threading::IsCancelled(cancellationToken))
+			{
+				const auto now = Clock::now();
+				Worker* stoppedWorker = nullptr;
+				bool hasRunningWorker = false;
+				for (auto& worker : workers)
+				{
+					if (worker->state == WorkerState::Idle)
+					{
+						worker->state = WorkerState::Busy;
+						worker->deadline = now + timeout;
+						worker->isTimedOut = false;
+						return worker.get();
+					}
+
+					hasRunningWorker = hasRunningWorker || worker->state == WorkerState::Busy;
+					if (worker->state == WorkerState::Stopped && now >= worker->nextStartTime && !stoppedWorker)
+					{
+						stoppedWorker = worker.get();
+					}
+				}
+
+				if (stoppedWorker)
+				{
+					// 起動中も占有し、起動が終わらない場合は監視スレッドが強制終了する
+					stoppedWorker->state = WorkerState::Busy;
+					stoppedWorker->deadline = now + StartTimeout;
+					stoppedWorker->isTimedOut = false;
+					lock.unlock();
+					const bool isStarted = StartWorker(*stoppedWorker, slotPool);
+					lock.lock();
+
+					if (isStarted)
+					{
+						++statistics.restartCount;
+						stoppedWorker->deadline = Clock::now() + timeout;
+						return stoppedWorker;
+					}
+
+					stoppedWorker->state = WorkerState::Stopped;
+					stoppedWorker->nextStartTime = Clock::now() + RestartInterval;
+					stateChanged.notify_all();
+					continue;
+				}
+
+				if (!hasRunningWorker)
+				{
+					return nullptr;
+				}
+
+				stateChanged.wait_for(lock, CancellationPollInterval);
+			}
+
+			return nullptr;
+		}
+
+		/*!
+		 * @brief	上限時間を超えた要求・起動のワーカーを強制終了する(占有しているスレッドが読み込みの失敗として検出する)
+		 */
+		void WatchLoop()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (isRunning.load())
+			{
+				stateChanged.wait_for(lock, WatchInterval);
+
+				const auto now = Clock::now();
+				for (auto& worker : workers)
+				{
+					if (worker->state == WorkerState::Busy && !worker->isTimedOut && now > worker->deadline)
+					{
+						worker->isTimedOut = true;
+						std::lock_guard<std::mutex> processLock(worker->processMutex);
+						worker->process.Terminate();
+					}
+				}
+			}
+		}
+
+		void Count(DecodeServerStatus status)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			switch (status)
+			{
+			case DecodeServerStatus::Succeeded:
+				++statistics.succeededCount;
+				break;
+			case DecodeServerStatus::DecodeFailed:
+			case DecodeServerStatus::SlotTooSmall:
+				++statistics.failedCount;
+				break;
+			case DecodeServerStatus::WorkerCrashed:
+				++statistics.crashedCount;
+				break;
+			case DecodeServerStatus::TimedOut:
+				++statistics.timedOutCount;
+				break;
+			default:
+				break;
+			}
+		}
+
+	public:
+		const std::wstring workerPath;							//!< ワーカーの実行ファイルのパス
+		const unsigned int workerCount;							//!< ワーカー数
+		const size_t slotCount;									//!< スロット数
+		const size_t slotBytes;									//!< 1スロットのバイト数
+		const std::chrono::milliseconds timeout;				//!< 1枚のデコードの上限時間
+
+		std::mutex controlMutex;								//!< Start()・Stop()を排他するミューテックス
+		std::thread watchdog;									//!< 上限時間の監視スレッド
+		std::atomic<bool> isRunning{ false };					//!< 動作中か(変更はmutexを保持して行う)
+		std::atomic<std::uint64_t> nextRequestId{ 1 };			//!< 次の要求ID
+
+		mutable std::mutex mutex;								//!< 以下のメンバーとワーカーの状態を保護するミューテックス
+		std::condition_variable stateChanged;					//!< ワーカーの状態の変化・停止通知
+		std::shared_ptr<SlotPool> slots;						//!< 共有メモリのスロット
+		std::vector<std::unique_ptr<Worker>> workers;			//!< ワーカー
+		DecodeServerStatistics statistics{};					//!< 統計情報
+	};
+
+	DecodeServer::DecodeServer(const DecodeServerSettings& settings)
+		: m_impl(std::make_unique<Impl>(settings))
+	{
+	}
+
+	DecodeServer::~DecodeServer() = default;
+
+	bool DecodeServer::Start()
+	{
+		return m_impl->Start();
+	}
+
+	void DecodeServer::Stop()
+	{
+		m_impl->Stop();
+	}
+
+	DecodeServerStatus DecodeServer::Decode(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, DecodedImage& image, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken)
+	{
+		image.Release();
+		return m_impl->Decode(imagePath, imageReadSettings, image.m_imageData, image.m_release, metadata, cancellationToken);
+	}
+
+	DecodeServerStatistics DecodeServer::GetStatistics() const
+	{
+		return m_impl->GetStatistics();
+	}
+}
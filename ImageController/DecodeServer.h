@@ -0,0 +1,148 @@
+/*!
+ * @file	DecodeServer.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <functional>
+#include <memory>
+#include <string>
+
+// C++/CLIからインクルードされる場合に備え、<mutex>・<thread>・<atomic>を必要とする状態は実装ファイルで定義する
+namespace Kchary::ImageController::Threading
+{
+	class CancellationToken;
+}
+
+namespace Kchary::ImageController::Library
+{
+	/*!
+	 * @brief デコードサーバーの設定
+	 */
+	struct DecodeServerSettings
+	{
+		std::wstring workerPath;				//!< ワーカーの実行ファイルのパス(mainからService::RunDecodeWorker()を呼び出す実行ファイル)
+		unsigned int workerCount = 0;			//!< ワーカープロセス数(0: 論理コア数の半分)
+		size_t slotCount = 0;					//!< 共有メモリのスロット数(同時に保持できるデコード結果の数。0: ワーカー数の2倍)
+		size_t slotBytes = 0;					//!< 1スロットのバイト数(これより大きい画像はデコードできない。0: 64MB)
+		unsigned int timeoutMilliseconds = 0;	//!< 1枚のデコードの上限時間(超えたワーカーは強制終了する。0: 30秒)
+	};
+
+	/*!
+	 * @brief デコードサーバーでのデコード結果
+	 */
+	enum class DecodeServerStatus
+	{
+		Succeeded,			//!< 成功
+		DecodeFailed,		//!< 画像をデコードできなかった
+		SlotTooSmall,		//!< 画像がスロットに収まらない(縮小して読み込むか、プロセス内でデコードする)
+		WorkerCrashed,		//!< デコード中にワーカーが異常終了した(ワーカーは起動し直す)
+		TimedOut,			//!< 上限時間を超えたためワーカーを強制終了した(ワーカーは起動し直す)
+		Cancelled,			//!< デコードを始める前に中断された
+		Unavailable,		//!< サーバーが停止している、またはワーカーを起動できない
+	};
+
+	/*!
+	 * @brief 共有メモリのスロットに書き込まれたデコード結果
+	 * @note 破棄する(またはRelease()する)までスロットを占有する。DecodeServerより長く保持してもよい
+	 */
+	class DecodedImage final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 */
+		DecodedImage() = default;
+
+		/*!
+		 * @brief デストラクタ(スロットを返却する)
+		 */
+		~DecodedImage();
+
+		DecodedImage(DecodedImage&& other) noexcept;
+		DecodedImage& operator=(DecodedImage&& other) noexcept;
+		DecodedImage(const DecodedImage&) = delete;
+		DecodedImage& operator=(const DecodedImage&) = delete;
+
+		/*!
+		 * @brief	画像データを取得する
+		 * @return	画像データ(destinationが共有メモリ上の画素を指す。Release()するまで有効)
+		 */
+		const ImageData& GetImageData() const noexcept { return m_imageData; }
+
+		/*!
+		 * @brief	デコード結果を保持しているか
+		 */
+		bool IsValid() const noexcept { return static_cast<bool>(m_release); }
+
+		/*!
+		 * @brief	スロットを返却する
+		 */
+		void Release() noexcept;
+
+	private:
+		friend class DecodeServer;
+
+		ImageData m_imageData{};			//!< 共有メモリ上の画素を指す画像データ
+		std::function<void()> m_release;	//!< スロットを返却する関数
+	};
+
+	/*!
+	 * @brief 画像のデコードを子プロセス(ワーカー)で行うサーバー
+	 * @note 不正な画像でデコーダー(LibRawなど)が異常終了しても、呼び出し元のプロセスには影響しない。
+	 *		 ワーカーは共有メモリのスロットへ直接デコードし、通信路ではパスと結果のみを受け渡すため、画素はコピーもシリアライズもしない。
+	 *		 異常終了・上限時間の超過で停止したワーカーは、次にワーカーが必要になった時点で起動し直す。
+	 *		 Decode()は複数のスレッドから同時に呼び出してよく、ワーカー数まで並行にデコードする
+	 */
+	class DecodeServer final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param settings	デコードサーバーの設定
+		 */
+		explicit DecodeServer(const DecodeServerSettings& settings);
+
+		/*!
+		 * @brief デストラクタ(停止する)
+		 */
+		~DecodeServer();
+
+		DecodeServer(const DecodeServer&) = delete;
+		DecodeServer& operator=(const DecodeServer&) = delete;
+
+		/*!
+		 * @brief	共有メモリを作成し、ワーカーを起動する
+		 * @return	成功(1つ以上のワーカーが起動した): True, 失敗: False
+		 */
+		bool Start();
+
+		/*!
+		 * @brief	ワーカーを停止する(処理中の要求はワーカーを終了させて打ち切る)
+		 */
+		void Stop();
+
+		/*!
+		 * @brief	ワーカーで画像をデコードする
+		 * @param	imagePath			画像パス
+		 * @param	imageReadSettings	画像読み込み設定
+		 * @param	image				デコード結果(out。保持していた結果は返却する)
+		 * @param	metadata			メタデータ(out。nullptrの場合は取得しない)
+		 * @param	cancellationToken	中断要求(スロット・ワーカーの空きを待つ間のみ確認する。nullptrの場合は中断しない)
+		 * @return	結果(Unavailableの場合は、呼び出し元のプロセスでデコードするなどで対処する)
+		 */
+		DecodeServerStatus Decode(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, DecodedImage& image, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken);
+
+		/*!
+		 * @brief	統計情報を取得する
+		 */
+		DecodeServerStatistics GetStatistics() const;
+
+	private:
+		struct Impl;
+
+		std::unique_ptr<Impl> m_impl;	//!< ワーカーと共有メモリ
+	};
+}
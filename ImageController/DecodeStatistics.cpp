@@ -0,0 +1,269 @@
+/*!
+ * @file	DecodeStatistics.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "DecodeStatistics.h"
+#include "ImageHeader.h"
+#include <sstream>				// std::ostringstream
+#include <opencv2/opencv.hpp>	// cv::ImreadModes
+
+namespace Kchary::ImageController::Diagnostics
+{
+	namespace
+	{
+		/*!
+		 * @brief	処理時間が属するヒストグラムの区間を求める
+		 * @param	microseconds	処理時間(マイクロ秒)
+		 * @return	区間のインデックス(floor(log2(microseconds))。1マイクロ秒未満は0)
+		 */
+		size_t GetBucketIndex(std::uint64_t microseconds) noexcept
+		{
+			size_t index = 0;
+			while (microseconds > 1 && index + 1 < LatencyBucketCount)
+			{
+				microseconds >>= 1;
+				++index;
+			}
+
+			return index;
+		}
+
+		void UpdateMaximum(std::atomic<std::uint64_t>& maximum, std::uint64_t value) noexcept
+		{
+			std::uint64_t current = maximum.load(std::memory_order_relaxed);
+			while (current < value && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+			{
+			}
+		}
+	}
+
+	std::uint64_t StageLatency::GetPercentileMicroseconds(double percentile) const noexcept
+	{
+		if (count == 0)
+		{
+			return 0;
+		}
+
+		const auto threshold = static_cast<std::uint64_t>(percentile * static_cast<double>(count) + 0.5);
+		std::uint64_t cumulativeCount = 0;
+		for (size_t i = 0; i < LatencyBucketCount; ++i)
+		{
+			cumulativeCount += buckets[i];
+			if (cumulativeCount >= threshold && cumulativeCount > 0)
+			{
+				// 区間の上限(最大値を超える場合は最大値)で近似する
+				const std::uint64_t upperBound = std::uint64_t{ 2 } << i;
+				return upperBound < maxMicroseconds ? upperBound : maxMicroseconds;
+			}
+		}
+
+		return maxMicroseconds;
+	}
+
+	std::string DecodeStatisticsSnapshot::ToJson() const
+	{
+		std::ostringstream json;
+		json << "{\"bytesRead\":" << bytesRead << ",\"bytesCopied\":" << bytesCopied;
+
+		json << ",\"stages\":{";
+		bool isFirst = true;
+		for (size_t i = 0; i < StageCount; ++i)
+		{
+			const auto& stage = stages[i];
+			if (stage.count == 0)
+			{
+				continue;
+			}
+
+			json << (isFirst ? "" : ",") << '"' << GetStageName(static_cast<DecodeStage>(i)) << "\":{"
+				<< "\"count\":" << stage.count
+				<< ",\"totalUs\":" << stage.totalMicroseconds
+				<< ",\"meanUs\":" << stage.totalMicroseconds / stage.count
+				<< ",\"p50Us\":" << stage.GetPercentileMicroseconds(0.50)
+				<< ",\"p99Us\":" << stage.GetPercentileMicroseconds(0.99)
+				<< ",\"maxUs\":" << stage.maxMicroseconds
+				<< ",\"histogramUs\":[";
+			for (size_t bucket = 0; bucket < LatencyBucketCount; ++bucket)
+			{
+				json << (bucket == 0 ? "" : ",") << stage.buckets[bucket];
+			}
+			json << "]}";
+			isFirst = false;
+		}
+		json << '}';
+
+		json << ",\"decodeCountByFormat\":{";
+		for (size_t i = 0; i < FormatCount; ++i)
+		{
+			json << (i == 0 ? "" : ",") << '"' << GetFormatName(static_cast<ImageFormat>(i)) << "\":" << decodeCountByFormat[i];
+		}
+		json << '}';
+
+		json << ",\"decodeCountByMode\":{";
+		for (size_t i = 0; i < DecodeModeCount; ++i)
+		{
+			json << (i == 0 ? "" : ",") << '"' << GetDecodeModeName(static_cast<DecodeMode>(i)) << "\":" << decodeCountByMode[i];
+		}
+		json << "}}";
+
+		return json.str();
+	}
+
+	const char* GetStageName(DecodeStage stage) noexcept
+	{
+		switch (stage)
+		{
+		case DecodeStage::Total:				return "total";
+		case DecodeStage::FileOpen:				return "fileOpen";
+		case DecodeStage::ImageDecode:			return "imageDecode";
+		case DecodeStage::Resize:				return "resize";
+		case DecodeStage::Copy:					return "copy";
+		case DecodeStage::ColorConversion:		return "colorConversion";
+		case DecodeStage::RawOpen:				return "rawOpen";
+		case DecodeStage::RawUnpack:			return "rawUnpack";
+		case DecodeStage::RawUnpackThumbnail:	return "rawUnpackThumbnail";
+		case DecodeStage::RawProcess:			return "rawProcess";
+		case DecodeStage::RawMakeImage:			return "rawMakeImage";
+		case DecodeStage::ThumbnailStoreRead:	return "thumbnailStoreRead";
+		case DecodeStage::TileRead:				return "tileRead";
+		case DecodeStage::PyramidBuild:			return "pyramidBuild";
+		default:								return "unknown";
+		}
+	}
+
+	const char* GetFormatName(ImageFormat format) noexcept
+	{
+		switch (format)
+		{
+		case ImageFormat::Jpeg:		return "jpeg";
+		case ImageFormat::Png:		return "png";
+		case ImageFormat::Tiff:		return "tiff";
+		case ImageFormat::Bmp:		return "bmp";
+		case ImageFormat::Gif:		return "gif";
+		case ImageFormat::WebP:		return "webp";
+		case ImageFormat::Raw:		return "raw";
+		default:					return "other";
+		}
+	}
+
+	const char* GetDecodeModeName(DecodeMode mode) noexcept
+	{
+		switch (mode)
+		{
+		case DecodeMode::Full:			return "full";
+		case DecodeMode::Reduced2:		return "reduced2";
+		case DecodeMode::Reduced4:		return "reduced4";
+		case DecodeMode::Reduced8:		return "reduced8";
+		case DecodeMode::RawHalfSize:	return "rawHalfSize";
+		default:						return "unknown";
+		}
+	}
+
+	void DecodeStatistics::RecordStage(DecodeStage stage, Clock::duration elapsedTime) noexcept
+	{
+		const auto microseconds = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsedTime).count());
+		auto& latency = m_stages[static_cast<size_t>(stage)];
+		latency.count.fetch_add(1, std::memory_order_relaxed);
+		latency.totalMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+		latency.buckets[GetBucketIndex(microseconds)].fetch_add(1, std::memory_order_relaxed);
+		UpdateMaximum(latency.maxMicroseconds, microseconds);
+	}
+
+	void DecodeStatistics::AddBytesRead(std::uint64_t size) noexcept
+	{
+		if (IsEnabled())
+		{
+			m_bytesRead.fetch_add(size, std::memory_order_relaxed);
+		}
+	}
+
+	void DecodeStatistics::AddBytesCopied(std::uint64_t size) noexcept
+	{
+		if (IsEnabled())
+		{
+			m_bytesCopied.fetch_add(size, std::memory_order_relaxed);
+		}
+	}
+
+	void DecodeStatistics::RecordDecode(ImageFormat format, DecodeMode mode) noexcept
+	{
+		if (IsEnabled())
+		{
+			m_decodeCountByFormat[static_cast<size_t>(format)].fetch_add(1, std::memory_order_relaxed);
+			m_decodeCountByMode[static_cast<size_t>(mode)].fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	DecodeStatisticsSnapshot DecodeStatistics::GetSnapshot() const
+	{
+		DecodeStatisticsSnapshot snapshot;
+		for (size_t i = 0; i < StageCount; ++i)
+		{
+			const auto& source = m_stages[i];
+			auto& destination = snapshot.stages[i];
+			destination.count = source.count.load(std::memory_order_relaxed);
+			destination.totalMicroseconds = source.totalMicroseconds.load(std::memory_order_relaxed);
+			destination.maxMicroseconds = source.maxMicroseconds.load(std::memory_order_relaxed);
+			for (size_t bucket = 0; bucket < LatencyBucketCount; ++bucket)
+			{
+				destination.buckets[bucket] = source.buckets[bucket].load(std::memory_order_relaxed);
+			}
+		}
+
+		snapshot.bytesRead = m_bytesRead.load(std::memory_order_relaxed);
+		snapshot.bytesCopied = m_bytesCopied.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < FormatCount; ++i)
+		{
+			snapshot.decodeCountByFormat[i] = m_decodeCountByFormat[i].load(std::memory_order_relaxed);
+		}
+		for (size_t i = 0; i < DecodeModeCount; ++i)
+		{
+			snapshot.decodeCountByMode[i] = m_decodeCountByMode[i].load(std::memory_order_relaxed);
+		}
+
+		return snapshot;
+	}
+
+	void DecodeStatistics::Reset() noexcept
+	{
+		for (auto& latency : m_stages)
+		{
+			latency.count.store(0, std::memory_order_relaxed);
+			latency.totalMicroseconds.store(0, std::memory_order_relaxed);
+			latency.maxMicroseconds.store(0, std::memory_order_relaxed);
+			for (auto& bucket : latency.buckets)
+			{
+				bucket.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		m_bytesRead.store(0, std::memory_order_relaxed);
+		m_bytesCopied.store(0, std::memory_order_relaxed);
+		for (auto& count : m_decodeCountByFormat)
+		{
+			count.store(0, std::memory_order_relaxed);
+		}
+		for (auto& count : m_decodeCountByMode)
+		{
+			count.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	ImageFormat DecodeStatistics::DetectFormat(const unsigned char* data, size_t size) noexcept
+	{
+		return Decode::DetectImageFormat(data, size);
+	}
+
+	DecodeMode DecodeStatistics::GetDecodeMode(int imreadMode) noexcept
+	{
+		switch (imreadMode)
+		{
+		case cv::IMREAD_REDUCED_COLOR_2:	return DecodeMode::Reduced2;
+		case cv::IMREAD_REDUCED_COLOR_4:	return DecodeMode::Reduced4;
+		case cv::IMREAD_REDUCED_COLOR_8:	return DecodeMode::Reduced8;
+		default:							return DecodeMode::Full;
+		}
+	}
+}
@@ -0,0 +1,154 @@
+/*!
+ * @file	DecodeStatistics.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "DecodeStatisticsTypes.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace Kchary::ImageController::Diagnostics
+{
+	/*!
+	 * @brief デコードの統計情報を集計するクラス
+	 * @note 集計はロックを使わずにアトミック変数の加算のみで行うため、常時有効にしてよい
+	 */
+	class DecodeStatistics final
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		/*!
+		 * @brief コンストラクタ
+		 */
+		DecodeStatistics() = default;
+
+		DecodeStatistics(const DecodeStatistics&) = delete;
+		DecodeStatistics& operator=(const DecodeStatistics&) = delete;
+
+		/*!
+		 * @brief	集計の有効・無効を切り替える
+		 * @param	isEnabled	有効: True
+		 */
+		void SetEnabled(bool isEnabled) noexcept { m_isEnabled.store(isEnabled, std::memory_order_relaxed); }
+
+		bool IsEnabled() const noexcept { return m_isEnabled.load(std::memory_order_relaxed); }
+
+		/*!
+		 * @brief	工程の処理時間を記録する
+		 * @param	stage		工程
+		 * @param	elapsedTime	処理時間
+		 */
+		void RecordStage(DecodeStage stage, Clock::duration elapsedTime) noexcept;
+
+		/*!
+		 * @brief	読み込んだファイルのバイト数を加算する
+		 */
+		void AddBytesRead(std::uint64_t size) noexcept;
+
+		/*!
+		 * @brief	書き込み先へ出力したバイト数を加算する
+		 */
+		void AddBytesCopied(std::uint64_t size) noexcept;
+
+		/*!
+		 * @brief	デコード回数を加算する
+		 * @param	format	画像形式
+		 * @param	mode	縮小モード
+		 */
+		void RecordDecode(ImageFormat format, DecodeMode mode) noexcept;
+
+		/*!
+		 * @brief	統計情報を取得する
+		 * @return	統計情報(各値は個別に読み出すため、集計中の値が混在する場合がある)
+		 */
+		DecodeStatisticsSnapshot GetSnapshot() const;
+
+		/*!
+		 * @brief	統計情報を初期化する
+		 */
+		void Reset() noexcept;
+
+		/*!
+		 * @brief	ファイルの先頭のバイト列から画像形式を判定する
+		 * @param	data	ファイルの先頭
+		 * @param	size	バイト数
+		 * @return	画像形式
+		 * @note	判定はヘッダーの読み取りと共通のDecode::DetectImageFormat()で行う
+		 */
+		static ImageFormat DetectFormat(const unsigned char* data, size_t size) noexcept;
+
+		/*!
+		 * @brief	画像取得モード(OpenCV)から縮小モードを取得する
+		 * @param	imreadMode	画像取得モード(cv::ImreadModes)
+		 * @return	縮小モード
+		 */
+		static DecodeMode GetDecodeMode(int imreadMode) noexcept;
+
+	private:
+		/*!
+		 * @brief 工程ごとの集計値
+		 */
+		struct AtomicStageLatency
+		{
+			std::atomic<std::uint64_t> count{ 0 };
+			std::atomic<std::uint64_t> totalMicroseconds{ 0 };
+			std::atomic<std::uint64_t> maxMicroseconds{ 0 };
+			std::array<std::atomic<std::uint64_t>, LatencyBucketCount> buckets{};
+		};
+
+		std::atomic<bool> m_isEnabled{ true };								//!< 集計するか
+		std::array<AtomicStageLatency, StageCount> m_stages{};				//!< 工程ごとの処理時間
+		std::atomic<std::uint64_t> m_bytesRead{ 0 };						//!< 読み込んだバイト数
+		std::atomic<std::uint64_t> m_bytesCopied{ 0 };						//!< 出力したバイト数
+		std::array<std::atomic<std::uint64_t>, FormatCount> m_decodeCountByFormat{};	//!< 形式ごとのデコード回数
+		std::array<std::atomic<std::uint64_t>, DecodeModeCount> m_decodeCountByMode{};	//!< 縮小モードごとのデコード回数
+	};
+
+	/*!
+	 * @brief スコープを抜けるまでの時間を工程の処理時間として記録するクラス
+	 */
+	class ScopedStageTimer final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ(集計が無効の場合は時刻を取得しない)
+		 * @param statistics	記録先
+		 * @param stage			工程
+		 */
+		ScopedStageTimer(DecodeStatistics& statistics, DecodeStage stage) noexcept
+			: m_statistics(statistics)
+			, m_stage(stage)
+			, m_isActive(statistics.IsEnabled())
+		{
+			if (m_isActive)
+			{
+				m_start = DecodeStatistics::Clock::now();
+			}
+		}
+
+		/*!
+		 * @brief デストラクタ
+		 */
+		~ScopedStageTimer()
+		{
+			if (m_isActive)
+			{
+				m_statistics.RecordStage(m_stage, DecodeStatistics::Clock::now() - m_start);
+			}
+		}
+
+		ScopedStageTimer(const ScopedStageTimer&) = delete;
+		ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+	private:
+		DecodeStatistics& m_statistics;					//!< 記録先
+		DecodeStage m_stage;							//!< 工程
+		bool m_isActive;								//!< 計測しているか
+		DecodeStatistics::Clock::time_point m_start{};	//!< 開始時刻
+	};
+}
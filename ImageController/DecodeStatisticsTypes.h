@@ -0,0 +1,111 @@
+/*!
+ * @file	DecodeStatisticsTypes.h
+ * @author	kleon6436
+ * @note	C++/CLIからインクルードされるため、<atomic>などを必要とする集計クラスはDecodeStatistics.hに分ける
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Kchary::ImageController::Diagnostics
+{
+	/*!
+	 * @brief 計測する工程
+	 */
+	enum class DecodeStage
+	{
+		Total,				//!< ImageReader::GetImageData全体
+		FileOpen,			//!< ファイルを開く(メモリマップ・一括読み込み)
+		ImageDecode,		//!< cv::imdecode
+		Resize,				//!< 縮小(書き込み先への出力を含む)
+		Copy,				//!< 書き込み先へのコピー
+		ColorConversion,	//!< RGBからBGRへの並べ替え
+		RawOpen,			//!< LibRaw open_file
+		RawUnpack,			//!< LibRaw unpack
+		RawUnpackThumbnail,	//!< LibRaw unpack_thumb
+		RawProcess,			//!< LibRaw dcraw_process(デモザイク)
+		RawMakeImage,		//!< LibRaw dcraw_make_mem_image
+		ThumbnailStoreRead,	//!< サムネイルストアからの取得
+		TileRead,			//!< ImageReader::GetImageTile全体(縮小レベルのデコードを含む)
+		PyramidBuild,		//!< デコード結果からピラミッドの縮小レベルを作る
+		Count
+	};
+
+	/*!
+	 * @brief デコードした画像の形式
+	 */
+	enum class ImageFormat
+	{
+		Jpeg,
+		Png,
+		Tiff,
+		Bmp,
+		Gif,
+		WebP,
+		Raw,
+		Other,
+		Count
+	};
+
+	/*!
+	 * @brief デコードの縮小モード
+	 */
+	enum class DecodeMode
+	{
+		Full,			//!< 等倍(IMREAD_COLOR、RAWのフル解像度デモザイク)
+		Reduced2,		//!< IMREAD_REDUCED_COLOR_2
+		Reduced4,		//!< IMREAD_REDUCED_COLOR_4
+		Reduced8,		//!< IMREAD_REDUCED_COLOR_8
+		RawHalfSize,	//!< RAWのハーフサイズデモザイク
+		Count
+	};
+
+	constexpr size_t StageCount = static_cast<size_t>(DecodeStage::Count);
+	constexpr size_t FormatCount = static_cast<size_t>(ImageFormat::Count);
+	constexpr size_t DecodeModeCount = static_cast<size_t>(DecodeMode::Count);
+	constexpr size_t LatencyBucketCount = 28;	//!< ヒストグラムの区間数(区間iは[2^i, 2^(i+1))マイクロ秒。最後の区間は上限なし)
+
+	/*!
+	 * @brief 工程ごとの処理時間の集計結果
+	 */
+	struct StageLatency
+	{
+		std::uint64_t count = 0;					//!< 計測回数
+		std::uint64_t totalMicroseconds = 0;		//!< 合計時間
+		std::uint64_t maxMicroseconds = 0;			//!< 最大時間
+		std::array<std::uint64_t, LatencyBucketCount> buckets{};	//!< 処理時間のヒストグラム
+
+		/*!
+		 * @brief	ヒストグラムからパーセンタイルを求める(区間の上限で近似する)
+		 * @param	percentile	パーセンタイル(0.0～1.0)
+		 * @return	処理時間(マイクロ秒。計測していない場合は0)
+		 */
+		std::uint64_t GetPercentileMicroseconds(double percentile) const noexcept;
+	};
+
+	/*!
+	 * @brief デコードの統計情報
+	 */
+	struct DecodeStatisticsSnapshot
+	{
+		std::array<StageLatency, StageCount> stages{};				//!< 工程ごとの処理時間
+		std::uint64_t bytesRead = 0;								//!< 読み込んだファイルのバイト数
+		std::uint64_t bytesCopied = 0;								//!< 書き込み先へ出力したバイト数
+		std::array<std::uint64_t, FormatCount> decodeCountByFormat{};	//!< 形式ごとのデコード回数
+		std::array<std::uint64_t, DecodeModeCount> decodeCountByMode{};	//!< 縮小モードごとのデコード回数
+
+		/*!
+		 * @brief	JSON形式の文字列に変換する
+		 * @return	JSON
+		 */
+		std::string ToJson() const;
+	};
+
+	const char* GetStageName(DecodeStage stage) noexcept;
+	const char* GetFormatName(ImageFormat format) noexcept;
+	const char* GetDecodeModeName(DecodeMode mode) noexcept;
+}
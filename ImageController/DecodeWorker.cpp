@@ -0,0 +1,106 @@
+/*!
+ * @file	DecodeWorker.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "DecodeWorker.h"
+#include "DecodeProtocol.h"
+#include "ImageReader.h"
+#include "SharedMemory.h"
+#include "WorkerProcess.h"
+#include <cstdlib>		// std::strtoull, std::strtoll
+#include <iostream>		// std::cerr
+#include <limits>		// std::numeric_limits
+#include <string>
+
+namespace Kchary::ImageController::Service
+{
+	int RunDecodeWorker(int argc, char* argv[])
+	{
+		if (argc < 5)
+		{
+			std::cerr << "RunDecodeWorker error: invalid arguments" << std::endl;
+			return 2;
+		}
+
+		const auto slotCount = static_cast<size_t>(std::strtoull(argv[2], nullptr, 10));
+		const auto slotBytes = static_cast<size_t>(std::strtoull(argv[3], nullptr, 10));
+		const auto handle = static_cast<std::intptr_t>(std::strtoll(argv[4], nullptr, 10));
+		IO::SharedMemory sharedMemory;
+		if (slotCount == 0 || slotBytes == 0 || slotCount > (std::numeric_limits<size_t>::max)() / slotBytes || !sharedMemory.Attach(handle, slotCount * slotBytes))
+		{
+			std::cerr << "RunDecodeWorker error: failed to attach shared memory" << std::endl;
+			return 2;
+		}
+
+		ParentChannel channel;
+		if (!channel.Open())
+		{
+			std::cerr << "RunDecodeWorker error: failed to open channel" << std::endl;
+			return 2;
+		}
+
+		Library::ImageReader imageReader;
+		const WorkerReady ready{ ProtocolMagic, ProtocolVersion };
+		if (!channel.Write(&ready, sizeof(ready)))
+		{
+			return 1;
+		}
+
+		std::wstring path;
+		DecodeRequest request{};
+		while (channel.Read(&request, sizeof(request)))
+		{
+			// パス長が不正な場合は以降のメッセージの区切りが分からないため終了する(親プロセスが起動し直す)
+			if (request.pathLength == 0 || request.pathLength > MaxPathLength)
+			{
+				std::cerr << "RunDecodeWorker error: invalid path length" << std::endl;
+				return 1;
+			}
+
+			path.assign(request.pathLength, L'\0');
+			if (!channel.Read(path.data(), path.size() * sizeof(wchar_t)))
+			{
+				break;
+			}
+
+			DecodeResponse response{};
+			response.requestId = request.requestId;
+			response.status = WorkerStatus::InvalidRequest;
+			if (request.slotIndex < slotCount)
+			{
+				// 呼び出し元が指定したスロットへ直接出力する
+				ImageData imageData{};
+				imageData.destination = sharedMemory.data() + request.slotIndex * slotBytes;
+				imageData.destinationCapacity = slotBytes;
+
+				bool result = false;
+				try
+				{
+					result = imageReader.GetImageData(path.c_str(), request.imageReadSettings, imageData, request.needsMetadata != 0 ? &response.metadata : nullptr, nullptr);
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << "RunDecodeWorker error: " << e.what() << std::endl;
+				}
+
+				// 書き込み先が足りない場合も、出力するはずだったサイズは設定される
+				response.status = result ? WorkerStatus::Succeeded : static_cast<size_t>(imageData.size) > slotBytes ? WorkerStatus::SlotTooSmall : WorkerStatus::DecodeFailed;
+				response.width = imageData.width;
+				response.height = imageData.height;
+				response.stride = imageData.stride;
+				response.pixelFormat = imageData.pixelFormat;
+				response.size = imageData.size;
+				response.hasMetadata = result && request.needsMetadata != 0 ? 1 : 0;
+			}
+
+			if (!channel.Write(&response, sizeof(response)))
+			{
+				break;
+			}
+		}
+
+		return 0;
+	}
+}
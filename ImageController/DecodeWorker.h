@@ -0,0 +1,19 @@
+/*!
+ * @file	DecodeWorker.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+namespace Kchary::ImageController::Service
+{
+	/*!
+	 * @brief	デコードサーバー(DecodeServer)のワーカーとして、親プロセスの通信路が閉じるまでデコード要求を処理する
+	 * @param	argc	mainの引数の数
+	 * @param	argv	mainの引数(--decode-worker スロット数 スロットのバイト数 共有メモリのハンドル)
+	 * @return	終了コード(0: 親プロセスが通信路を閉じた)
+	 * @note	ワーカーの実行ファイルのmainから呼び出す。
+	 *			画素は共有メモリの指定されたスロットへ直接デコードし、通信路では結果(サイズ・メタデータ)のみ返す
+	 */
+	int RunDecodeWorker(int argc, char* argv[]);
+}
@@ -0,0 +1,524 @@
+/*!
+ * @file	FolderIndexer.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "FolderIndexer.h"
+#include "ImageReader.h"
+#include "ImageHeader.h"
+#include "MappedFile.h"
+#include "WritableFile.h"
+#include <algorithm>		// std::min
+#include <atomic>
+#include <cstdint>			// std::uint32_t, std::uint64_t
+#include <cstring>			// std::memcpy
+#include <cwctype>			// std::towlower
+#include <filesystem>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace Kchary::ImageController::Library
+{
+	namespace
+	{
+		constexpr unsigned int DefaultReadThreadCount = 4;		//!< ヘッダーを読み取る既定のスレッド数(読み取るのは先頭のみのため、I/O待ちを重ねる程度とする)
+		constexpr std::uint32_t IndexMagic = 0x5849464B;		//!< インデックスファイルの識別子("KFIX")
+		constexpr std::uint32_t FormatVersion = 1;				//!< ファイル形式のバージョン
+		constexpr std::uint32_t MaxPathLength = 32767;			//!< パスの最大長(wchar_tの数。壊れたファイルの検出用)
+
+		/*!
+		 * @brief インデックスファイルのヘッダー(直後にフォルダのレコードが続く)
+		 * @note パスはwchar_tのまま書き込むため、wchar_tのサイズが異なる環境で保存したファイルは読み込まない
+		 */
+		struct IndexHeader
+		{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint32_t charSize;			//!< sizeof(wchar_t)
+			std::uint32_t directoryCount;
+		};
+
+		/*!
+		 * @brief フォルダのレコード(直後にフォルダパス、画像のレコードが続く)
+		 */
+		struct DirectoryRecord
+		{
+			std::uint32_t pathLength;
+			std::uint32_t entryCount;
+		};
+
+		/*!
+		 * @brief 画像のレコード(直後に画像パスが続く)
+		 */
+		struct EntryRecord
+		{
+			std::int64_t lastWriteTime;
+			std::uint64_t fileSize;
+			std::uint32_t pathLength;
+			std::uint8_t isRawImage;
+			std::uint8_t hasHeader;
+			std::int32_t width;
+			std::int32_t height;
+			std::int32_t orientation;
+			char dateTime[20];
+		};
+
+		using DirectoryEntries = std::vector<FolderIndexEntry>;
+
+		/*!
+		 * @brief	小文字に変換する
+		 * @param	text	文字列
+		 * @return	小文字の文字列
+		 */
+		std::wstring ToLower(std::wstring text)
+		{
+			std::transform(text.begin(), text.end(), text.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+			return text;
+		}
+
+		/*!
+		 * @brief	拡張子が一覧に含まれるか
+		 * @param	extension	小文字の拡張子
+		 * @param	extensions	小文字の拡張子の一覧
+		 * @return	含まれる: True
+		 */
+		bool ContainsExtension(const std::wstring& extension, const std::vector<std::wstring>& extensions)
+		{
+			return std::find(extensions.begin(), extensions.end(), extension) != extensions.end();
+		}
+
+		template <typename T>
+		void AppendStruct(std::vector<unsigned char>& bytes, const T& value)
+		{
+			const auto* valueBytes = reinterpret_cast<const unsigned char*>(&value);
+			bytes.insert(bytes.end(), valueBytes, valueBytes + sizeof(T));
+		}
+
+		void AppendPath(std::vector<unsigned char>& bytes, const std::wstring& path)
+		{
+			const auto* pathBytes = reinterpret_cast<const unsigned char*>(path.data());
+			bytes.insert(bytes.end(), pathBytes, pathBytes + path.size() * sizeof(wchar_t));
+		}
+
+		/*!
+		 * @brief	ファイルの内容を順に読み出すクラス(範囲外を読もうとした以降は全て失敗する)
+		 */
+		class RecordReader final
+		{
+		public:
+			RecordReader(const unsigned char* data, size_t size) noexcept
+				: m_data(data)
+				, m_size(size)
+			{
+			}
+
+			template <typename T>
+			bool ReadStruct(T& value) noexcept
+			{
+				if (m_size - m_position < sizeof(T))
+				{
+					m_position = m_size;
+					return false;
+				}
+
+				std::memcpy(&value, m_data + m_position, sizeof(T));
+				m_position += sizeof(T);
+				return true;
+			}
+
+			bool ReadPath(std::uint32_t length, std::wstring& path)
+			{
+				const size_t byteCount = size_t{ length } * sizeof(wchar_t);
+				if (length > MaxPathLength || m_size - m_position < byteCount)
+				{
+					m_position = m_size;
+					return false;
+				}
+
+				path.resize(length);
+				std::memcpy(path.data(), m_data + m_position, byteCount);
+				m_position += byteCount;
+				return true;
+			}
+
+		private:
+			const unsigned char* m_data;	//!< ファイルの内容
+			size_t m_size;					//!< バイト数
+			size_t m_position = 0;			//!< 次に読む位置
+		};
+	}
+
+	/*!
+	 * @brief フォルダインデックスの状態
+	 */
+	struct FolderIndexer::Impl
+	{
+		Impl(ImageReader& reader, const FolderIndexSettings& settings)
+			: imageReader(reader)
+			, readThreadCount(settings.readThreadCount > 0 ? settings.readThreadCount : DefaultReadThreadCount)
+		{
+		}
+
+		/*!
+		 * @brief	画像のヘッダーを読み取る
+		 * @param	entry	画像の情報(パスとRAW画像かを設定済みであること。ヘッダーの項目を設定する)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool ReadHeader(FolderIndexEntry& entry) const
+		{
+			ImageMetadata metadata{};
+			if (!imageReader.GetImageMetadata(entry.path.c_str(), entry.isRawImage, metadata))
+			{
+				return false;
+			}
+
+			const bool isTransposed = Decode::IsTransposedOrientation(metadata.orientation);
+			entry.hasHeader = true;
+			entry.width = isTransposed ? metadata.height : metadata.width;
+			entry.height = isTransposed ? metadata.width : metadata.height;
+			entry.orientation = metadata.orientation;
+			std::memcpy(entry.dateTime, metadata.dateTime, sizeof(entry.dateTime));
+			entry.dateTime[sizeof(entry.dateTime) - 1] = '\0';
+			return true;
+		}
+
+		ImageReader& imageReader;					//!< ヘッダーの読み取りに使う画像リーダー
+		const unsigned int readThreadCount;			//!< ヘッダーを読み取るスレッド数
+
+		mutable std::mutex mutex;					//!< directoriesの保護
+		std::unordered_map<std::wstring, std::shared_ptr<const DirectoryEntries>> directories;	//!< フォルダパスごとのインデックス(置き換えのみ行い、書き換えない)
+		std::atomic<bool> isCancelled{ false };		//!< 走査の中断要求
+		mutable std::atomic<bool> hasUnsavedChanges{ false };	//!< 最後に保存・読み込みしてからインデックスが変わったか
+
+		std::atomic<size_t> scanCount{ 0 };			//!< フォルダを走査した回数
+		std::atomic<size_t> enumeratedCount{ 0 };	//!< 列挙した画像数
+		std::atomic<size_t> reusedCount{ 0 };		//!< インデックスの情報を使った画像数
+		std::atomic<size_t> readCount{ 0 };			//!< ヘッダーを読み取った画像数
+		std::atomic<size_t> failedCount{ 0 };		//!< ヘッダーを読み取れなかった画像数
+		std::atomic<size_t> removedCount{ 0 };		//!< インデックスから除いた画像数
+	};
+
+	FolderIndexer::FolderIndexer(ImageReader& imageReader, const FolderIndexSettings& settings)
+		: m_impl(std::make_unique<Impl>(imageReader, settings))
+	{
+	}
+
+	FolderIndexer::~FolderIndexer() = default;
+
+	bool FolderIndexer::Scan(const wchar_t* directory, const std::vector<std::wstring>& extensions, const std::vector<std::wstring>& rawExtensions, std::vector<FolderIndexEntry>& entries)
+	{
+		entries.clear();
+
+		std::vector<std::wstring> lowerExtensions;
+		std::vector<std::wstring> lowerRawExtensions;
+		for (const auto& extension : extensions)
+		{
+			lowerExtensions.push_back(ToLower(extension));
+		}
+		for (const auto& extension : rawExtensions)
+		{
+			lowerRawExtensions.push_back(ToLower(extension));
+		}
+
+		const std::wstring directoryKey = directory;
+		std::shared_ptr<const DirectoryEntries> previousEntries;
+		{
+			std::lock_guard<std::mutex> lock(m_impl->mutex);
+			if (const auto it = m_impl->directories.find(directoryKey); it != m_impl->directories.end())
+			{
+				previousEntries = it->second;
+			}
+		}
+
+		std::unordered_map<std::wstring_view, const FolderIndexEntry*> previousEntryMap;
+		if (previousEntries)
+		{
+			previousEntryMap.reserve(previousEntries->size());
+			for (const auto& entry : *previousEntries)
+			{
+				previousEntryMap.emplace(entry.path, &entry);
+			}
+		}
+
+		// 拡張子ごとに列挙せず、1回の走査で対象の拡張子を選り分ける。
+		// 更新日時・サイズはディレクトリの列挙で得た値を使い(Windowsでは追加のシステムコールが不要)、変わっていない画像はヘッダーを読まない
+		DirectoryEntries scannedEntries;
+		std::vector<size_t> pendingIndices;
+		size_t matchedCount = 0;
+		std::error_code errorCode;
+		for (std::filesystem::directory_iterator entry(std::filesystem::path(directoryKey), errorCode), end; !errorCode && entry != end; entry.increment(errorCode))
+		{
+			if (m_impl->isCancelled.load(std::memory_order_relaxed))
+			{
+				return false;
+			}
+
+			std::error_code statusErrorCode;
+			if (!entry->is_regular_file(statusErrorCode))
+			{
+				continue;
+			}
+
+			const auto extension = ToLower(entry->path().extension().wstring());
+			if (!ContainsExtension(extension, lowerExtensions))
+			{
+				continue;
+			}
+
+			const auto lastWriteTime = entry->last_write_time(statusErrorCode);
+			if (statusErrorCode)
+			{
+				continue;
+			}
+			const auto fileSize = entry->file_size(statusErrorCode);
+			if (statusErrorCode)
+			{
+				continue;
+			}
+
+			FolderIndexEntry scannedEntry;
+			scannedEntry.path = entry->path().wstring();
+			scannedEntry.isRawImage = ContainsExtension(extension, lowerRawExtensions);
+			scannedEntry.lastWriteTime = static_cast<long long>(lastWriteTime.time_since_epoch().count());
+			scannedEntry.fileSize = static_cast<unsigned long long>(fileSize);
+
+			const auto previous = previousEntryMap.find(scannedEntry.path);
+			if (previous != previousEntryMap.end())
+			{
+				++matchedCount;
+				const auto& previousEntry = *previous->second;
+				if (previousEntry.lastWriteTime == scannedEntry.lastWriteTime && previousEntry.fileSize == scannedEntry.fileSize && previousEntry.isRawImage == scannedEntry.isRawImage)
+				{
+					scannedEntries.push_back(previousEntry);
+					continue;
+				}
+			}
+
+			pendingIndices.push_back(scannedEntries.size());
+			scannedEntries.push_back(std::move(scannedEntry));
+		}
+
+		if (errorCode)
+		{
+			return false;
+		}
+
+		// 新規・更新された画像のヘッダーを読み取る(ファイルの先頭のみ読むため、I/O待ちを重ねるように複数スレッドで読む)
+		std::atomic<size_t> nextIndex{ 0 };
+		std::atomic<size_t> failedCount{ 0 };
+		auto readHeaders = [this, &scannedEntries, &pendingIndices, &nextIndex, &failedCount]()
+			{
+				for (size_t i = nextIndex.fetch_add(1); i < pendingIndices.size(); i = nextIndex.fetch_add(1))
+				{
+					if (m_impl->isCancelled.load(std::memory_order_relaxed))
+					{
+						return;
+					}
+
+					if (!m_impl->ReadHeader(scannedEntries[pendingIndices[i]]))
+					{
+						failedCount.fetch_add(1);
+					}
+				}
+			};
+
+		const size_t threadCount = (std::min)(pendingIndices.size(), size_t{ m_impl->readThreadCount });
+		std::vector<std::thread> threads;
+		for (size_t t = 1; t < threadCount; ++t)
+		{
+			threads.emplace_back(readHeaders);
+		}
+		readHeaders();
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		// 読み取っていない画像を失敗として記録しないよう、中断した場合はインデックスを更新しない
+		if (m_impl->isCancelled.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+
+		m_impl->scanCount.fetch_add(1);
+		m_impl->enumeratedCount.fetch_add(scannedEntries.size());
+		m_impl->reusedCount.fetch_add(scannedEntries.size() - pendingIndices.size());
+		m_impl->readCount.fetch_add(pendingIndices.size() - failedCount.load());
+		m_impl->failedCount.fetch_add(failedCount.load());
+		m_impl->removedCount.fetch_add(previousEntryMap.size() - matchedCount);
+
+		const bool isModified = !previousEntries || !pendingIndices.empty() || previousEntryMap.size() != matchedCount;
+		entries = scannedEntries;
+		{
+			std::lock_guard<std::mutex> lock(m_impl->mutex);
+			m_impl->directories[directoryKey] = std::make_shared<const DirectoryEntries>(std::move(scannedEntries));
+			if (isModified)
+			{
+				m_impl->hasUnsavedChanges.store(true);
+			}
+		}
+
+		return true;
+	}
+
+	void FolderIndexer::Cancel()
+	{
+		m_impl->isCancelled.store(true, std::memory_order_relaxed);
+	}
+
+	void FolderIndexer::ResetCancel()
+	{
+		m_impl->isCancelled.store(false, std::memory_order_relaxed);
+	}
+
+	bool FolderIndexer::Load(const wchar_t* indexPath)
+	{
+		IO::MappedFile indexFile;
+		if (!indexFile.Open(indexPath))
+		{
+			return false;
+		}
+
+		RecordReader reader(indexFile.data(), indexFile.size());
+		IndexHeader header{};
+		if (!reader.ReadStruct(header) || header.magic != IndexMagic || header.version != FormatVersion || header.charSize != sizeof(wchar_t))
+		{
+			return false;
+		}
+
+		std::unordered_map<std::wstring, std::shared_ptr<const DirectoryEntries>> directories;
+		for (std::uint32_t i = 0; i < header.directoryCount; ++i)
+		{
+			DirectoryRecord directoryRecord{};
+			std::wstring directoryPath;
+			if (!reader.ReadStruct(directoryRecord) || !reader.ReadPath(directoryRecord.pathLength, directoryPath))
+			{
+				return false;
+			}
+
+			// 壊れたレコードで巨大な領域を確保しないよう、件数はファイルサイズで制限する
+			if (directoryRecord.entryCount > indexFile.size() / sizeof(EntryRecord))
+			{
+				return false;
+			}
+
+			DirectoryEntries directoryEntries(directoryRecord.entryCount);
+			for (auto& entry : directoryEntries)
+			{
+				EntryRecord record{};
+				if (!reader.ReadStruct(record) || !reader.ReadPath(record.pathLength, entry.path))
+				{
+					return false;
+				}
+
+				entry.isRawImage = record.isRawImage != 0;
+				entry.lastWriteTime = record.lastWriteTime;
+				entry.fileSize = record.fileSize;
+				entry.hasHeader = record.hasHeader != 0;
+				entry.width = record.width;
+				entry.height = record.height;
+				entry.orientation = record.orientation;
+				std::memcpy(entry.dateTime, record.dateTime, sizeof(entry.dateTime));
+				entry.dateTime[sizeof(entry.dateTime) - 1] = '\0';
+			}
+
+			directories[std::move(directoryPath)] = std::make_shared<const DirectoryEntries>(std::move(directoryEntries));
+		}
+
+		std::lock_guard<std::mutex> lock(m_impl->mutex);
+		m_impl->directories = std::move(directories);
+		m_impl->hasUnsavedChanges.store(false);
+		return true;
+	}
+
+	bool FolderIndexer::Save(const wchar_t* indexPath) const
+	{
+		// 書き出す間は走査を止めないよう、参照を複製してからロックを外す(書き出す間に走査で変わった場合は未保存のままとする)
+		std::vector<std::pair<std::wstring, std::shared_ptr<const DirectoryEntries>>> directories;
+		{
+			std::lock_guard<std::mutex> lock(m_impl->mutex);
+			directories.assign(m_impl->directories.begin(), m_impl->directories.end());
+			m_impl->hasUnsavedChanges.store(false);
+		}
+
+		std::vector<unsigned char> indexBytes;
+		AppendStruct(indexBytes, IndexHeader{ IndexMagic, FormatVersion, static_cast<std::uint32_t>(sizeof(wchar_t)), static_cast<std::uint32_t>(directories.size()) });
+		for (const auto& [directoryPath, directoryEntries] : directories)
+		{
+			AppendStruct(indexBytes, DirectoryRecord{ static_cast<std::uint32_t>(directoryPath.size()), static_cast<std::uint32_t>(directoryEntries->size()) });
+			AppendPath(indexBytes, directoryPath);
+			for (const auto& entry : *directoryEntries)
+			{
+				EntryRecord record{};
+				record.lastWriteTime = entry.lastWriteTime;
+				record.fileSize = entry.fileSize;
+				record.pathLength = static_cast<std::uint32_t>(entry.path.size());
+				record.isRawImage = static_cast<std::uint8_t>(entry.isRawImage);
+				record.hasHeader = static_cast<std::uint8_t>(entry.hasHeader);
+				record.width = entry.width;
+				record.height = entry.height;
+				record.orientation = entry.orientation;
+				std::memcpy(record.dateTime, entry.dateTime, sizeof(record.dateTime));
+				AppendStruct(indexBytes, record);
+				AppendPath(indexBytes, entry.path);
+			}
+		}
+
+		// 一時ファイルへ書き出してから置き換え、書き込み途中のインデックスが読まれないようにする
+		const std::wstring temporaryPath = std::wstring(indexPath) + L".tmp";
+		IO::WritableFile indexWriter;
+		if (!indexWriter.Open(temporaryPath.c_str(), IO::WritableFile::OpenMode::Truncate)
+			|| !indexWriter.Write(indexBytes.data(), indexBytes.size())
+			|| !indexWriter.Flush())
+		{
+			indexWriter.Close();
+			IO::RemoveFile(temporaryPath.c_str());
+			m_impl->hasUnsavedChanges.store(true);
+			return false;
+		}
+
+		indexWriter.Close();
+		if (!IO::ReplaceFile(temporaryPath.c_str(), indexPath))
+		{
+			IO::RemoveFile(temporaryPath.c_str());
+			m_impl->hasUnsavedChanges.store(true);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool FolderIndexer::HasUnsavedChanges() const noexcept
+	{
+		return m_impl->hasUnsavedChanges.load();
+	}
+
+	void FolderIndexer::Clear()
+	{
+		std::lock_guard<std::mutex> lock(m_impl->mutex);
+		m_impl->directories.clear();
+		m_impl->hasUnsavedChanges.store(true);
+	}
+
+	FolderIndexStatistics FolderIndexer::GetStatistics() const
+	{
+		FolderIndexStatistics statistics{};
+		statistics.scanCount = m_impl->scanCount.load();
+		statistics.enumeratedCount = m_impl->enumeratedCount.load();
+		statistics.reusedCount = m_impl->reusedCount.load();
+		statistics.readCount = m_impl->readCount.load();
+		statistics.failedCount = m_impl->failedCount.load();
+		statistics.removedCount = m_impl->removedCount.load();
+
+		std::lock_guard<std::mutex> lock(m_impl->mutex);
+		for (const auto& [directoryPath, directoryEntries] : m_impl->directories)
+		{
+			statistics.indexedCount += directoryEntries->size();
+		}
+
+		return statistics;
+	}
+}
@@ -0,0 +1,116 @@
+/*!
+ * @file	FolderIndexer.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// C++/CLIからインクルードされるため、<mutex>・<thread>・<atomic>を必要とする状態は実装ファイルで定義する
+namespace Kchary::ImageController::Library
+{
+	class ImageReader;
+
+	/*!
+	 * @brief フォルダインデックスに記録した1画像分の情報
+	 */
+	struct FolderIndexEntry
+	{
+		std::wstring path;					//!< 画像パス
+		bool isRawImage = false;			//!< RAW画像か
+		long long lastWriteTime = 0;		//!< 最終更新日時(WindowsはFILETIME、それ以外はプラットフォーム固有の単位)
+		unsigned long long fileSize = 0;	//!< ファイルサイズ
+		bool hasHeader = false;				//!< ヘッダーを読み取れたか(Falseの場合、以降の項目は初期値)
+		int width = 0;						//!< 幅(EXIFの向きを適用した表示上の幅)
+		int height = 0;						//!< 高さ(EXIFの向きを適用した表示上の高さ)
+		int orientation = 1;				//!< EXIFの向き(1～8)
+		char dateTime[20] = {};				//!< 撮影日時("YYYY:MM:DD HH:MM:SS"。記録がない場合は空文字列)
+	};
+
+	/*!
+	 * @brief フォルダ内の画像を1回の走査で列挙し、ヘッダーの情報(サイズ・向き・撮影日時)を記録するインデックス
+	 * @note 走査のたびに更新日時・サイズが変わった画像のヘッダーのみ読み直し、画素はデコードしない。
+	 *		 サムネイルの作成を待たずに一覧を作成でき、サイズ・撮影日時もデコードせずに得られる。
+	 *		 インデックスはフォルダごとに保持し、ファイルへ保存して次回の起動時に読み込める
+	 */
+	class FolderIndexer final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param imageReader	ヘッダーの読み取りに使う画像リーダー(このインスタンスより長く生存すること)
+		 * @param settings		フォルダインデックスの設定
+		 */
+		FolderIndexer(ImageReader& imageReader, const FolderIndexSettings& settings);
+
+		/*!
+		 * @brief デストラクタ
+		 */
+		~FolderIndexer();
+
+		FolderIndexer(const FolderIndexer&) = delete;
+		FolderIndexer& operator=(const FolderIndexer&) = delete;
+
+		/*!
+		 * @brief	フォルダを走査し、インデックスを更新する
+		 * @param	directory		フォルダパス(サブフォルダは列挙しない。同じフォルダは同じ表記で指定すること)
+		 * @param	extensions		対象とする拡張子(".jpg"など。大文字・小文字を区別しない)
+		 * @param	rawExtensions	RAW画像として読み込む拡張子
+		 * @param	entries			フォルダ内の画像の情報(out。ファイルシステムの列挙順)
+		 * @return	成功: True, 失敗: False(フォルダを列挙できない、またはCancel()で中断した。インデックスは更新しない)
+		 * @note	ヘッダーを読み取れなかった画像もhasHeaderをFalseとして含め、更新されるまで読み直さない
+		 */
+		bool Scan(const wchar_t* directory, const std::vector<std::wstring>& extensions, const std::vector<std::wstring>& rawExtensions, std::vector<FolderIndexEntry>& entries);
+
+		/*!
+		 * @brief	実行中のScan()を中断する
+		 * @note	中断要求はResetCancel()を呼び出すまで残り、Scan()の開始前に呼び出した場合もそのScan()を中断する
+		 */
+		void Cancel();
+
+		/*!
+		 * @brief	Cancel()による中断要求を取り消す(Scan()を実行していない間に呼び出す)
+		 */
+		void ResetCancel();
+
+		/*!
+		 * @brief	保存したインデックスを読み込む(保持しているインデックスは置き換える)
+		 * @param	indexPath	インデックスファイルのパス
+		 * @return	成功: True, 失敗: False(ファイルがない・形式が異なる・破損している。保持しているインデックスは変更しない)
+		 */
+		bool Load(const wchar_t* indexPath);
+
+		/*!
+		 * @brief	インデックスをファイルへ保存する
+		 * @param	indexPath	インデックスファイルのパス
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Save(const wchar_t* indexPath) const;
+
+		/*!
+		 * @brief	最後にSave()・Load()してからインデックスが変わったか
+		 * @return	変わった: True(保存が必要)
+		 */
+		bool HasUnsavedChanges() const noexcept;
+
+		/*!
+		 * @brief	インデックスを破棄する
+		 */
+		void Clear();
+
+		/*!
+		 * @brief	統計情報を取得する
+		 * @return	統計情報
+		 */
+		FolderIndexStatistics GetStatistics() const;
+
+	private:
+		struct Impl;
+
+		std::unique_ptr<Impl> m_impl;	//!< インデックスと走査の状態
+	};
+}
@@ -7,6 +7,11 @@
 
 #include "ImageData.h"
 
+namespace Kchary::ImageController::Threading
+{
+	class CancellationToken;
+}
+
 class IImageController
 {
 public:
@@ -25,7 +30,44 @@ public:
 	 * @param	path							画像パス
 	 * @param	imageReadSettings	画像設定
 	 * @param	imageData				画像データ(out)
+	 * @param	metadata				メタデータ(out。nullptrの場合は取得しない。デコードのために開いたファイルから読み取る)
+	 * @param	cancellationToken		中断要求(nullptrの場合は中断しない)
+	 * @return	成功: True, 失敗: False(中断した場合を含む)
+	 */
+	virtual bool GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata* metadata, const Kchary::ImageController::Threading::CancellationToken* cancellationToken) = 0;
+
+	/*!
+	 * @brief	ファイルに埋め込まれたプレビュー画像を取得する
+	 * @param	path							画像パス
+	 * @param	imageReadSettings	画像設定
+	 * @param	imageData				画像データ(out)
+	 * @return	成功: True, 失敗: False(埋め込みプレビューに対応しない形式)
+	 */
+	virtual bool GetPreviewImageData(const wchar_t* /*path*/, const ImageReadSettings& /*imageReadSettings*/, ImageData& /*imageData*/)
+	{
+		return false;
+	}
+
+	/*!
+	 * @brief	画素データをデコードせずに、デコード後の画像サイズを取得する
+	 * @param	path	画像パス
+	 * @param	width	幅(out。EXIFの向き・RAWの回転を適用後)
+	 * @param	height	高さ(out。EXIFの向き・RAWの回転を適用後)
+	 * @return	成功: True, 失敗: False
+	 */
+	virtual bool GetImageSize(const wchar_t* /*path*/, int& /*width*/, int& /*height*/)
+	{
+		return false;
+	}
+
+	/*!
+	 * @brief	画素データをデコードせずに、メタデータを取得する
+	 * @param	path		画像パス
+	 * @param	metadata	メタデータ(out)
 	 * @return	成功: True, 失敗: False
 	 */
-	virtual bool GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData) = 0;
+	virtual bool GetImageMetadata(const wchar_t* /*path*/, ImageMetadata& /*metadata*/)
+	{
+		return false;
+	}
 };
\ No newline at end of file
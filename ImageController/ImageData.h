@@ -5,18 +5,36 @@
 
 #pragma once
 
-#include <vector>
+#include "PixelBuffer.h"
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * @brief 画素の形式(チャンネルはBGR・BGRAの順。アルファは乗算済みではない)
+ */
+enum class ImagePixelFormat : int
+{
+	Unknown = 0,	// 不明(出力前)
+	Bgr24,			// 8bit/ch 3ch
+	Bgra32,			// 8bit/ch 4ch(アルファあり)
+	Bgr48,			// 16bit/ch 3ch
+	Bgra64,			// 16bit/ch 4ch(アルファあり)
+};
 
 /*!
  * @brief 画像データ
  */
 typedef struct ImageData
 {
-	std::vector<std::byte> buffer;
-	unsigned int size;
-	int stride;
-	int width;
-	int height;
+	Kchary::ImageController::Memory::PixelBuffer buffer;	// 画素バッファ(BufferPoolから貸し出される)
+	std::byte* destination = nullptr;	// 呼び出し元が用意した書き込み先(nullptrの場合はbufferに書き込む)
+	size_t destinationCapacity = 0;		// 書き込み先の容量(Byte)
+	int destinationStride = 0;			// 書き込み先のストライド(0の場合は詰めて書き込む)
+	unsigned int size = 0;
+	int stride = 0;
+	int width = 0;
+	int height = 0;
+	ImagePixelFormat pixelFormat = ImagePixelFormat::Unknown;	// 画素の形式(表示用の既定の読み込みではBgr24)
 } ImageData;
 
 /*!
@@ -27,4 +45,250 @@ typedef struct ImageReadSettings
 	bool isRawImage;
 	bool isThumbnailMode;
 	int resizeLongSideLength;
-} ImageReadSettings;
\ No newline at end of file
+	bool isHighBitDepth;		// 16bit/chの画像は16bit/chのまま出力する(RAW画像は常に16bit/ch。サムネイルモードのRAW画像・JPEGは8bit/ch。falseの場合は8bit/ch)
+	bool preserveAlpha;			// アルファチャンネルを持つ画像はBGRAで出力する(falseの場合はアルファを捨ててBGRで出力する)
+	bool bypassPyramidCache;	// ピラミッドキャッシュを使わない(多数の画像を1回ずつ読む場合。サムネイルストアも使わない)
+	bool useThumbnailStore;		// サムネイルモードの結果をサムネイルストアから取得・追加する(一覧のサムネイルのみ。表示・保存用の画像は指定しない)
+	int orientation;			// 出力に適用するEXIFの向き(0: ファイルの記録に従う、1～8: 指定した向き。1の場合は保存されている向きのまま出力する)
+} ImageReadSettings;
+
+/*!
+* @brief 一括読み込み設定
+*/
+typedef struct BatchReadSettings
+{
+	unsigned int threadCount;	// ワーカースレッド数(0: 論理コア数)
+	size_t queueDepth;			// 未処理タスクの上限数(0: 無制限)
+} BatchReadSettings;
+
+/*!
+* @brief RAW画像処理インスタンス(LibRaw)の統計情報
+*/
+typedef struct RawProcessorStatistics
+{
+	size_t constructedCount;	// 生成した回数
+	size_t reuseCount;			// 再利用した回数
+} RawProcessorStatistics;
+
+/*!
+* @brief サムネイルストアの統計情報
+*/
+typedef struct ThumbnailStoreStatistics
+{
+	size_t hitCount;				// ストアから取得できた回数
+	size_t missCount;				// ストアになくデコードした回数
+	size_t entryCount;				// 保持しているサムネイル数
+	unsigned long long liveBytes;	// 有効なサムネイルのバイト数
+	unsigned long long deadBytes;	// 更新・破棄により不要になったバイト数(コンパクションで解放される)
+} ThumbnailStoreStatistics;
+
+/*!
+* @brief タイル読み込み設定
+*/
+typedef struct TileReadSettings
+{
+	bool isRawImage;
+	int level;		// 縮小レベル(0: 等倍、n: 1/2^n)
+	int x;			// 取得する範囲の左端(縮小レベルの座標系)
+	int y;			// 取得する範囲の上端(縮小レベルの座標系)
+	int width;		// 取得する範囲の幅(画像の外側は切り詰める)
+	int height;		// 取得する範囲の高さ(画像の外側は切り詰める)
+} TileReadSettings;
+
+/*!
+* @brief タイル読み込みする画像の情報
+*/
+typedef struct TiledImageInfo
+{
+	int width;		// 等倍の幅(EXIFの向きを適用後)
+	int height;		// 等倍の高さ(EXIFの向きを適用後)
+	int tileSize;	// タイルの一辺の長さ
+	int levelCount;	// 縮小レベルの数(最も小さいレベルは1タイルに収まる)
+} TiledImageInfo;
+
+/*!
+* @brief タイルキャッシュの統計情報
+*/
+typedef struct TileCacheStatistics
+{
+	size_t hitCount;		// キャッシュから取得できたタイル数
+	size_t missCount;		// キャッシュになかったタイル数
+	size_t decodeCount;		// 縮小レベルをデコードした回数
+	size_t tileCount;		// 保持しているタイル数
+	size_t cachedBytes;		// 保持しているタイルのバイト数
+	size_t capacity;		// 保持するバイト数の上限
+	size_t levelHitCount;	// 保持している縮小レベルの画像から、デコードせずにタイルを切り出した回数
+	size_t levelCount;		// 保持している縮小レベルの画像数
+	size_t cachedLevelBytes;	// 保持している縮小レベルの画像のバイト数
+	size_t levelCapacity;	// 縮小レベルの画像を保持するバイト数の上限
+} TileCacheStatistics;
+
+/*!
+* @brief ピラミッドキャッシュ設定
+*/
+typedef struct PyramidCacheSettings
+{
+	size_t capacity;			// 保持するバイト数の上限(0: ピラミッドキャッシュを使わない)
+	int minLongSideLength;		// ピラミッドを作る縮小要求の長辺の最小値(これより小さい要求は、既存のピラミッドから提供できない場合は直接デコードする。0: 全ての要求で作る)
+} PyramidCacheSettings;
+
+/*!
+* @brief ピラミッドキャッシュの統計情報
+*/
+typedef struct PyramidCacheStatistics
+{
+	size_t hitCount;		// キャッシュから提供できた回数
+	size_t missCount;		// キャッシュから提供できなかった回数
+	size_t decodeCount;		// ピラミッドを作るためにデコードした回数
+	size_t entryCount;		// 保持しているピラミッド数
+	size_t cachedBytes;		// 保持しているピラミッドのバイト数
+	size_t capacity;		// 保持するバイト数の上限
+} PyramidCacheStatistics;
+
+/*!
+* @brief 先読み設定
+*/
+typedef struct PrefetchSettings
+{
+	unsigned int threadCount;	// ワーカースレッド数(0: 論理コア数の半分)
+	unsigned int aheadCount;	// 現在の画像より後ろを先読みする枚数
+	unsigned int behindCount;	// 現在の画像より前を先読みする枚数
+	size_t memoryBudget;		// 先読みした画像を保持するバイト数の上限(表示中の画像を含む)
+} PrefetchSettings;
+
+/*!
+* @brief 先読みの統計情報
+*/
+typedef struct PrefetchStatistics
+{
+	size_t hitCount;		// 要求時にデコード済みだった回数
+	size_t missCount;		// 要求時にデコード中・未着手だった回数
+	size_t decodeCount;		// デコードした枚数(サムネイルを除く)
+	size_t droppedCount;	// 現在位置の変更により破棄・中断した要求の数
+	size_t frameCount;		// 保持している画像の数
+	size_t cachedBytes;		// 保持している画像のバイト数
+} PrefetchStatistics;
+
+/*!
+* @brief サムネイルパイプライン設定
+*/
+typedef struct ThumbnailPipelineSettings
+{
+	unsigned int readThreadCount;	// ファイルを読み込むスレッド数(0: 2)
+	unsigned int decodeThreadCount;	// デコード・縮小するスレッド数(0: 論理コア数)
+	size_t queueDepth;				// 工程間のキューに積む最大数(0: デコードスレッド数の2倍)
+	size_t outputCapacity;			// 取り出されていない結果を保持する最大数(0: 256)
+	bool computeImageHash;			// デコードしたサムネイルから画像ハッシュを計算する(重複・類似画像の検出用)
+} ThumbnailPipelineSettings;
+
+/*!
+* @brief サムネイルパイプラインの統計情報
+*/
+typedef struct ThumbnailPipelineStatistics
+{
+	size_t enumeratedCount;			// 列挙した画像数
+	size_t readCount;				// 読み込んだ画像数
+	unsigned long long readBytes;	// 読み込んだバイト数
+	size_t storedCount;				// サムネイルストアから取得した画像数(読み込み・デコードしない)
+	size_t decodedCount;			// デコードに成功した画像数
+	size_t failedCount;				// 読み込み・デコードに失敗した画像数
+	size_t publishedCount;			// 出力キューへ積んだ画像数
+	size_t hashedCount;				// 画像ハッシュを計算した画像数
+} ThumbnailPipelineStatistics;
+
+/*!
+* @brief 画像ハッシュ(縮小した輝度画像から求める64bitの知覚ハッシュ。似た画像ほどハミング距離が小さい)
+*/
+typedef struct ImageHash
+{
+	std::uint64_t differenceHash;	// dHash(9×8画素の水平方向の輝度差の符号)
+	std::uint64_t perceptualHash;	// pHash(32×32画素のDCTの低周波8×8成分と中央値の大小)
+} ImageHash;
+
+/*!
+* @brief 一括書き出し設定
+*/
+typedef struct BatchExportSettings
+{
+	unsigned int decodeThreadCount;		// デコード・縮小するスレッド数(0: 論理コア数)
+	unsigned int encodeThreadCount;		// エンコード・書き込みするスレッド数(0: 論理コア数の半分)
+	size_t queueDepth;					// 工程間のキューに積む最大数(0: デコードスレッド数の2倍)
+	size_t maxPendingBytes;				// デコード済みでエンコード待ちの画素データの上限(Byte。0: 512MB)
+} BatchExportSettings;
+
+/*!
+* @brief 一括書き出しの統計情報
+*/
+typedef struct BatchExportStatistics
+{
+	size_t jobCount;					// 受け付けた書き出し数
+	size_t succeededCount;				// 書き出しに成功した数
+	size_t failedCount;					// デコード・エンコード・書き込みに失敗した数
+	unsigned long long inputBytes;		// 成功した書き出しの元画像のバイト数
+	unsigned long long outputBytes;		// 書き出したバイト数
+	unsigned long long outputPixels;	// 書き出した画素数
+	size_t peakPendingBytes;			// エンコード待ちの画素データの最大値(Byte)
+	double decodeSeconds;				// デコード・縮小に要した時間の合計(全スレッドの合計)
+	double encodeSeconds;				// エンコード・書き込みに要した時間の合計(全スレッドの合計)
+	double elapsedSeconds;				// 開始から全ての書き出しを終えるまでの経過時間
+} BatchExportStatistics;
+
+/*!
+* @brief デコードサーバーの統計情報
+*/
+typedef struct DecodeServerStatistics
+{
+	size_t requestCount;		// 受け付けたデコード要求の数
+	size_t succeededCount;		// デコードに成功した数
+	size_t failedCount;			// デコードできなかった数(画像が不正・スロットに収まらない)
+	size_t crashedCount;		// デコード中にワーカーが異常終了した数
+	size_t timedOutCount;		// 上限時間を超えてワーカーを強制終了した数
+	size_t restartCount;		// 停止したワーカーを起動し直した回数
+	size_t runningWorkerCount;	// 起動しているワーカー数
+} DecodeServerStatistics;
+
+/*!
+* @brief フォルダインデックスの設定
+*/
+typedef struct FolderIndexSettings
+{
+	unsigned int readThreadCount;	// ヘッダーを読み取るスレッド数(0: 4)
+} FolderIndexSettings;
+
+/*!
+* @brief フォルダインデックスの統計情報
+*/
+typedef struct FolderIndexStatistics
+{
+	size_t scanCount;			// フォルダを走査した回数
+	size_t enumeratedCount;		// 列挙した画像数(全ての走査の合計)
+	size_t reusedCount;			// 更新日時・サイズが一致したため、インデックスの情報を使った画像数
+	size_t readCount;			// ヘッダーを読み取った画像数
+	size_t failedCount;			// ヘッダーを読み取れなかった画像数
+	size_t removedCount;		// 列挙されなくなったため、インデックスから除いた画像数
+	size_t indexedCount;		// インデックスが保持している画像数
+} FolderIndexStatistics;
+
+/*!
+* @brief 画像のメタデータ(デコード時に同じファイルから読み取る)
+*/
+typedef struct ImageMetadata
+{
+	int width;					// 幅(ファイルに保存されている向き。RAW画像はデモザイク後の回転を適用する前のサイズ)
+	int height;					// 高さ(ファイルに保存されている向き)
+	int orientation;			// EXIFの向き(1～8。記録がない場合は1)
+	int bitDepth;				// ビット深度(JPEG・PNG・TIFF・RAWは1チャンネルあたり、BMP・GIFは1画素あたり。0: 不明)
+	double xResolution;			// 水平解像度(dpi。0: 記録なし)
+	double yResolution;			// 垂直解像度(dpi。0: 記録なし)
+	double exposureTime;		// 露光時間(秒。0: 記録なし)
+	double fNumber;				// F値(0: 記録なし)
+	int isoSpeed;				// ISO感度(0: 記録なし)
+	double focalLength;			// 焦点距離(mm。0: 記録なし)
+	int focalLengthIn35mm;		// 35mm判換算の焦点距離(mm。0: 記録なし)
+	int exposureProgram;		// 露出プログラム(EXIFの値。-1: 記録なし)
+	int meteringMode;			// 測光モード(EXIFの値。-1: 記録なし)
+	int whiteBalance;			// ホワイトバランス(EXIFの値。-1: 記録なし)
+	char make[64];				// メーカー名(NUL終端。記録がない場合は空文字列)
+	char model[64];				// モデル名(NUL終端。記録がない場合は空文字列)
+	char dateTime[20];			// 撮影日時("YYYY:MM:DD HH:MM:SS"。記録がない場合は空文字列)
+} ImageMetadata;
\ No newline at end of file
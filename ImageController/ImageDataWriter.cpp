@@ -0,0 +1,175 @@
+﻿/*!
+ * @file	ImageDataWriter.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "ImageDataWriter.h"
+#include "AreaResizer.h"
+#include "BufferPool.h"
+#include "ImageHeader.h"
+#include "OrientationTransform.h"
+#include "PixelConverter.h"
+#include <algorithm>	// std::max
+#include <cmath>		// std::round
+
+namespace Kchary::ImageController::Common
+{
+	namespace
+	{
+		/*!
+		 * @brief	画像を書き込み先のサイズに縮小する
+		 * @param	image	画像
+		 * @param	output	書き込み先(imageと同じ型で確保済みであること)
+		 */
+		void ResizeInto(const cv::Mat& image, cv::Mat& output)
+		{
+			// 8bit 3ch/4chは専用の縮小処理で書き込み先へ直接出力する
+			if (!Simd::ResizeArea(image, output))
+			{
+				// 出力サイズと型が一致するため、cv::resizeは再確保せず書き込み先へ直接出力する
+				cv::resize(image, output, output.size(), 0, 0, cv::INTER_AREA);
+			}
+		}
+	}
+
+	ImagePixelFormat ToPixelFormat(int type) noexcept
+	{
+		switch (type)
+		{
+		case CV_8UC3:
+			return ImagePixelFormat::Bgr24;
+		case CV_8UC4:
+			return ImagePixelFormat::Bgra32;
+		case CV_16UC3:
+			return ImagePixelFormat::Bgr48;
+		case CV_16UC4:
+			return ImagePixelFormat::Bgra64;
+		default:
+			return ImagePixelFormat::Unknown;
+		}
+	}
+
+	int ToMatType(ImagePixelFormat pixelFormat) noexcept
+	{
+		switch (pixelFormat)
+		{
+		case ImagePixelFormat::Bgra32:
+			return CV_8UC4;
+		case ImagePixelFormat::Bgr48:
+			return CV_16UC3;
+		case ImagePixelFormat::Bgra64:
+			return CV_16UC4;
+		default:
+			return CV_8UC3;
+		}
+	}
+
+	ImageDataWriter::ImageDataWriter(std::shared_ptr<Memory::BufferPool> bufferPool)
+		: m_bufferPool(std::move(bufferPool))
+	{
+	}
+
+	bool ImageDataWriter::PrepareOutput(ImageData& imageData, int rows, int cols, int type, cv::Mat& output) const
+	{
+		const size_t rowSize = static_cast<size_t>(cols) * CV_ELEM_SIZE(type);
+		imageData.pixelFormat = ToPixelFormat(type);
+
+		if (imageData.destination)
+		{
+			const size_t stride = imageData.destinationStride > 0 ? static_cast<size_t>(imageData.destinationStride) : rowSize;
+			const size_t dataSize = stride * rows;
+
+			imageData.size = static_cast<unsigned int>(dataSize);
+			imageData.stride = static_cast<int>(stride);
+			imageData.width = cols;
+			imageData.height = rows;
+
+			if (stride < rowSize || imageData.destinationCapacity < dataSize)
+			{
+				return false;
+			}
+
+			output = cv::Mat(rows, cols, type, imageData.destination, stride);
+			return true;
+		}
+
+		const size_t dataSize = rowSize * rows;
+		imageData.buffer.Allocate(dataSize, m_bufferPool); // バッファ確保(ゼロ初期化しない)
+		output = cv::Mat(rows, cols, type, imageData.buffer.data(), rowSize);
+
+		imageData.size = static_cast<unsigned int>(dataSize);
+		imageData.stride = static_cast<int>(rowSize);
+		imageData.width = cols;
+		imageData.height = rows;
+
+		return true;
+	}
+
+	bool ImageDataWriter::Write(const cv::Mat& image, int orientation, ImageData& imageData) const
+	{
+		const bool isTransposed = Decode::IsTransposedOrientation(orientation);
+
+		cv::Mat output;
+		if (!PrepareOutput(imageData, isTransposed ? image.cols : image.rows, isTransposed ? image.rows : image.cols, image.type(), output))
+		{
+			return false;
+		}
+
+		if (orientation == 1)
+		{
+			// 元画像データをコピー（Mat間コピーだと内部最適化が効く）
+			image.copyTo(output);
+			return true;
+		}
+
+		// 回転・反転はコピーと同時に行う
+		return Simd::TransformOrientation(image, orientation, output);
+	}
+
+	bool ImageDataWriter::WriteResized(const cv::Mat& image, double ratio, int orientation, ImageData& imageData) const
+	{
+		const int cols = (std::max)(1, static_cast<int>(std::round(image.cols * ratio)));
+		const int rows = (std::max)(1, static_cast<int>(std::round(image.rows * ratio)));
+		const bool isTransposed = Decode::IsTransposedOrientation(orientation);
+
+		cv::Mat output;
+		if (!PrepareOutput(imageData, isTransposed ? cols : rows, isTransposed ? rows : cols, image.type(), output))
+		{
+			return false;
+		}
+
+		if (orientation == 1)
+		{
+			ResizeInto(image, output);
+			return true;
+		}
+
+		// 縮小結果をプールのバッファへ出力し、回転・反転しながら書き込み先へ出力する
+		const size_t rowSize = static_cast<size_t>(cols) * CV_ELEM_SIZE(image.type());
+		Memory::PixelBuffer resizedBuffer;
+		resizedBuffer.Allocate(rowSize * rows, m_bufferPool);
+		cv::Mat resized(rows, cols, image.type(), resizedBuffer.data(), rowSize);
+
+		ResizeInto(image, resized);
+		return Simd::TransformOrientation(resized, orientation, output);
+	}
+
+	bool ImageDataWriter::WriteDisplayFormat(const ImageData& source, ImageData& imageData) const
+	{
+		const std::byte* data = source.destination ? source.destination : source.buffer.data();
+		if (!data || source.width <= 0 || source.height <= 0)
+		{
+			return false;
+		}
+
+		const cv::Mat image(source.height, source.width, ToMatType(source.pixelFormat), const_cast<std::byte*>(data), static_cast<size_t>(source.stride));
+		cv::Mat output;
+		if (!PrepareOutput(imageData, image.rows, image.cols, CV_MAKETYPE(CV_8U, image.channels()), output))
+		{
+			return false;
+		}
+
+		return Simd::ConvertToDisplayFormat(image, output);
+	}
+}
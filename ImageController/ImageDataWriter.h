@@ -0,0 +1,91 @@
+﻿/*!
+ * @file	ImageDataWriter.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Memory
+{
+	class BufferPool;
+}
+
+namespace Kchary::ImageController::Common
+{
+	/*!
+	 * @brief	画素の型に対応する画素の形式を取得する
+	 * @param	type	画素の型(CV_8UC3など)
+	 * @return	画素の形式(対応しない型の場合はUnknown)
+	 */
+	ImagePixelFormat ToPixelFormat(int type) noexcept;
+
+	/*!
+	 * @brief	画素の形式に対応する画素の型を取得する
+	 * @param	pixelFormat	画素の形式
+	 * @return	画素の型(Unknownの場合は従来の出力と同じCV_8UC3)
+	 */
+	int ToMatType(ImagePixelFormat pixelFormat) noexcept;
+
+	/*!
+	 * @brief ImageDataの書き込み先を管理するクラス
+	 * @note デコード・リサイズ結果を書き込み先へ直接出力させ、画素ごとの書き込みを1回に抑える
+	 */
+	class ImageDataWriter final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param bufferPool	内部バッファの貸し出し元(nullptrの場合はヒープから確保する)
+		 */
+		explicit ImageDataWriter(std::shared_ptr<Memory::BufferPool> bufferPool);
+
+		/*!
+		 * @brief	書き込み先を確保し、書き込み先を参照するcv::Matを取得する
+		 * @param	imageData	画像データ(サイズ情報を更新する)
+		 * @param	rows		高さ
+		 * @param	cols		幅
+		 * @param	type		画素の型(CV_8UC3など)
+		 * @param	output		書き込み先を参照するcv::Mat(out)
+		 * @return	成功: True, 失敗: False(呼び出し元の書き込み先の容量不足)
+		 * @note	容量不足の場合も必要なサイズ・ストライド・画素の形式をimageDataに設定する
+		 */
+		bool PrepareOutput(ImageData& imageData, int rows, int cols, int type, cv::Mat& output) const;
+
+		/*!
+		 * @brief	画像を指定した向きに回転・反転しながら書き込み先へコピーする
+		 * @param	image		画像(ファイルに保存されている向き)
+		 * @param	orientation	適用するEXIFの向き(1～8。1の場合はそのままコピーする)
+		 * @param	imageData	画像データ(out。幅・高さは向きを適用後のサイズ)
+		 * @return	成功: True, 失敗: False
+		 * @note	回転・反転は書き込み先への出力と同時に行い、中間バッファを使わない
+		 */
+		bool Write(const cv::Mat& image, int orientation, ImageData& imageData) const;
+
+		/*!
+		 * @brief	画像を指定倍率でリサイズし、指定した向きに回転・反転しながら書き込み先へ出力する
+		 * @param	image		画像(ファイルに保存されている向き)
+		 * @param	ratio		倍率(1.0未満)
+		 * @param	orientation	適用するEXIFの向き(1～8)
+		 * @param	imageData	画像データ(out。幅・高さは向きを適用後のサイズ)
+		 * @return	成功: True, 失敗: False
+		 * @note	向きが1以外の場合は縮小後の画像をプールのバッファへ出力し、回転・反転しながら書き込み先へ出力する
+		 *			(画素数の少ない縮小後に回転するため、回転の処理量は縮小後の画素数で済む)
+		 */
+		bool WriteResized(const cv::Mat& image, double ratio, int orientation, ImageData& imageData) const;
+
+		/*!
+		 * @brief	画像データを表示用の8bit/ch(Bgr24・Bgra32)へ変換しながら書き込み先へ出力する
+		 * @param	source		画像データ(チャンネル数は変えない)
+		 * @param	imageData	画像データ(out)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool WriteDisplayFormat(const ImageData& source, ImageData& imageData) const;
+
+	private:
+		std::shared_ptr<Memory::BufferPool> m_bufferPool;	//!< 内部バッファの貸し出し元
+	};
+}
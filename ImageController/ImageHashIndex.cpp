@@ -0,0 +1,265 @@
+/*!
+ * @file	ImageHashIndex.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "ImageHashIndex.h"
+#include "PerceptualHash.h"
+#include <algorithm>	// std::sort, std::unique
+#include <numeric>		// std::iota, std::partial_sum
+#include <stdexcept>	// std::length_error
+
+namespace Kchary::ImageController::Hashing
+{
+	namespace
+	{
+		/*!
+		 * @brief	値とのハミング距離がradius以下の値を全て関数へ渡す
+		 * @param	firstBit	反転してよい最下位のビット(同じ値を重複して渡さないよう、反転するビットを昇順に選ぶ)
+		 * @param	bitCount	値のビット数
+		 */
+		template <typename Function>
+		void ForEachValueWithin(std::uint32_t value, int radius, int firstBit, int bitCount, Function& function)
+		{
+			function(value);
+			if (radius == 0)
+			{
+				return;
+			}
+
+			for (int bit = firstBit; bit < bitCount; ++bit)
+			{
+				ForEachValueWithin(value ^ (1u << bit), radius - 1, bit + 1, bitCount, function);
+			}
+		}
+
+		/*!
+		 * @brief	最上位の1のビットのみを残した値を取得する(0の場合は0)
+		 */
+		constexpr std::uint32_t GetHighestBit(std::uint32_t value) noexcept
+		{
+			while ((value & (value - 1)) != 0)
+			{
+				value &= value - 1;	// 最下位の1のビットを消す
+			}
+
+			return value;
+		}
+
+		/*!
+		 * @brief 素集合(クラスタの結合に使う。代表は集合内の最小のインデックス)
+		 */
+		class DisjointSet final
+		{
+		public:
+			explicit DisjointSet(std::uint32_t count)
+				: m_parents(count)
+			{
+				std::iota(m_parents.begin(), m_parents.end(), 0u);
+			}
+
+			std::uint32_t Find(std::uint32_t index) noexcept
+			{
+				while (m_parents[index] != index)
+				{
+					m_parents[index] = m_parents[m_parents[index]];	// 経路を半分に縮める
+					index = m_parents[index];
+				}
+
+				return index;
+			}
+
+			void Unite(std::uint32_t left, std::uint32_t right) noexcept
+			{
+				const auto leftRoot = Find(left);
+				const auto rightRoot = Find(right);
+				if (leftRoot != rightRoot)
+				{
+					m_parents[(std::max)(leftRoot, rightRoot)] = (std::min)(leftRoot, rightRoot);
+				}
+			}
+
+		private:
+			std::vector<std::uint32_t> m_parents;	//!< 親のインデックス
+		};
+	}
+
+	void ImageHashIndex::Build(const std::vector<ImageHash>& hashes)
+	{
+		if (hashes.size() > UINT32_MAX)
+		{
+			throw std::length_error("ImageHashIndex: too many hashes");
+		}
+
+		m_count = hashes.size();
+		const auto count = static_cast<std::uint32_t>(hashes.size());
+		for (int chunk = 0; chunk < ChunkCount; ++chunk)
+		{
+			const int shift = chunk * ChunkBits;
+			auto& offsets = m_bucketOffsets[chunk];
+			auto& entries = m_bucketEntries[chunk];
+
+			// 値ごとの画像数を数えて開始位置を求め、インデックスの順に詰める
+			offsets.assign(ChunkValueCount + 1, 0);
+			for (const auto& hash : hashes)
+			{
+				++offsets[((hash.perceptualHash >> shift) & (ChunkValueCount - 1)) + 1];
+			}
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+			entries.resize(count);
+			std::vector<std::uint32_t> positions(offsets.begin(), offsets.end() - 1);
+			for (std::uint32_t index = 0; index < count; ++index)
+			{
+				entries[positions[(hashes[index].perceptualHash >> shift) & (ChunkValueCount - 1)]++] = Entry{ hashes[index], index };
+			}
+		}
+	}
+
+	bool ImageHashIndex::IsMatch(const ImageHash& left, const ImageHash& right, int maxDistance) noexcept
+	{
+		return GetHammingDistance(left.perceptualHash, right.perceptualHash) <= maxDistance
+			&& GetHammingDistance(left.differenceHash, right.differenceHash) <= maxDistance;
+	}
+
+	void ImageHashIndex::Find(const ImageHash& hash, int maxDistance, std::vector<size_t>& matches) const
+	{
+		matches.clear();
+		if (m_count == 0 || maxDistance < 0)
+		{
+			return;
+		}
+
+		const int radius = (std::min)(maxDistance / ChunkCount, ChunkBits);
+		for (int chunk = 0; chunk < ChunkCount; ++chunk)
+		{
+			const auto& offsets = m_bucketOffsets[chunk];
+			const auto& entries = m_bucketEntries[chunk];
+			auto visitBucket = [&offsets, &entries, &hash, maxDistance, &matches](std::uint32_t value)
+			{
+				for (std::uint32_t position = offsets[value]; position < offsets[value + 1]; ++position)
+				{
+					if (IsMatch(hash, entries[position].hash, maxDistance))
+					{
+						matches.push_back(entries[position].index);
+					}
+				}
+			};
+
+			const auto value = static_cast<std::uint32_t>((hash.perceptualHash >> (chunk * ChunkBits)) & (ChunkValueCount - 1));
+			ForEachValueWithin(value, radius, 0, ChunkBits, visitBucket);
+		}
+
+		// 複数の部分で見つかった画像を1つにする
+		std::sort(matches.begin(), matches.end());
+		matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+	}
+
+	std::vector<std::vector<size_t>> ImageHashIndex::FindClusters(int maxDistance) const
+	{
+		std::vector<std::vector<size_t>> clusters;
+		if (m_count == 0 || maxDistance < 0)
+		{
+			return clusters;
+		}
+
+		// 部分の値の差(d/4ビット以内)の一覧
+		const int radius = (std::min)(maxDistance / ChunkCount, ChunkBits);
+		std::vector<std::uint32_t> differences;
+		auto addDifference = [&differences](std::uint32_t difference) { differences.push_back(difference); };
+		ForEachValueWithin(0, radius, 0, ChunkBits, addDifference);
+
+		const auto count = static_cast<std::uint32_t>(m_count);
+		DisjointSet clusterSet(count);
+
+		// 閾値が大きい(d/4ビット以内の値が多い)場合は、一覧の組の走査が全ての組の照合より多くなるため総当たりで照合する
+		const unsigned long long scanCount = static_cast<unsigned long long>(differences.size()) * (ChunkValueCount / 2) * ChunkCount;
+		const unsigned long long pairCount = static_cast<unsigned long long>(count) * (count - 1) / 2;
+		if (scanCount >= pairCount)
+		{
+			std::vector<ImageHash> hashes(count);
+			for (const auto& entry : m_bucketEntries[0])
+			{
+				hashes[entry.index] = entry.hash;
+			}
+
+			for (std::uint32_t index = 0; index < count; ++index)
+			{
+				for (std::uint32_t pairIndex = index + 1; pairIndex < count; ++pairIndex)
+				{
+					if (IsMatch(hashes[index], hashes[pairIndex], maxDistance))
+					{
+						clusterSet.Unite(index, pairIndex);
+					}
+				}
+			}
+		}
+
+		for (int chunk = 0; chunk < ChunkCount && scanCount < pairCount; ++chunk)
+		{
+			const auto& offsets = m_bucketOffsets[chunk];
+			const auto& entries = m_bucketEntries[chunk];
+			for (const auto difference : differences)
+			{
+				// 差ごとに値の順に走査し、値がvとv^differenceの一覧の組を1回ずつ照合する(差の最上位ビットが0の値のみ走査する)
+				const std::uint32_t highestBit = GetHighestBit(difference);
+				for (std::uint32_t value = 0; value < ChunkValueCount; ++value)
+				{
+					if ((value & highestBit) != 0)
+					{
+						value += highestBit - 1;
+						continue;
+					}
+
+					const std::uint32_t pairValue = value ^ difference;
+					if (offsets[value] == offsets[value + 1] || offsets[pairValue] == offsets[pairValue + 1])
+					{
+						continue;
+					}
+
+					for (std::uint32_t position = offsets[value]; position < offsets[value + 1]; ++position)
+					{
+						const auto& entry = entries[position];
+
+						// 同じ一覧の中では後ろの画像とだけ照合する
+						const std::uint32_t pairBegin = difference == 0 ? position + 1 : offsets[pairValue];
+						for (std::uint32_t pairPosition = pairBegin; pairPosition < offsets[pairValue + 1]; ++pairPosition)
+						{
+							if (IsMatch(entry.hash, entries[pairPosition].hash, maxDistance))
+							{
+								clusterSet.Unite(entry.index, entries[pairPosition].index);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		// 代表は各クラスタの最小のインデックスのため、インデックスの順にたどると先頭の昇順・クラスタ内の昇順に並ぶ
+		std::vector<std::uint32_t> sizes(count, 0);
+		for (std::uint32_t index = 0; index < count; ++index)
+		{
+			++sizes[clusterSet.Find(index)];
+		}
+
+		std::vector<std::uint32_t> clusterIndices(count, UINT32_MAX);
+		for (std::uint32_t index = 0; index < count; ++index)
+		{
+			const auto root = clusterSet.Find(index);
+			if (sizes[root] < 2)
+			{
+				continue;
+			}
+
+			if (clusterIndices[root] == UINT32_MAX)
+			{
+				clusterIndices[root] = static_cast<std::uint32_t>(clusters.size());
+				clusters.emplace_back().reserve(sizes[root]);
+			}
+			clusters[clusterIndices[root]].push_back(index);
+		}
+
+		return clusters;
+	}
+}
@@ -0,0 +1,80 @@
+/*!
+ * @file	ImageHashIndex.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Kchary::ImageController::Hashing
+{
+	/*!
+	 * @brief 画像ハッシュから重複・類似画像を検索する索引
+	 * @note pHashを16bitずつ4つに分けて、それぞれの値ごとの画像の一覧(計数ソートで詰めた配列)を持つ(マルチインデックスハッシング)。
+	 *		 ハミング距離がd以下の2つのハッシュは、4つのうち少なくとも1つの部分の距離がd/4以下になるため、
+	 *		 各部分でd/4ビット以内の値の一覧だけを調べれば全ての候補が見つかる。
+	 *		 候補はpHash・dHashの双方の距離がd以下の場合に一致とする。
+	 *		 一覧にはハッシュの写しを並べ、候補の照合で元の一覧を読みに行かない(画像数×4×24Byte)。
+	 *		 構築後は読み取りのみのため、複数スレッドから同時に検索してよい
+	 */
+	class ImageHashIndex final
+	{
+	public:
+		/*!
+		 * @brief	索引を構築する(構築済みの場合は作り直す)
+		 * @param	hashes	画像ハッシュの一覧(検索結果はこの一覧のインデックスで返す)
+		 */
+		void Build(const std::vector<ImageHash>& hashes);
+
+		/*!
+		 * @brief	登録した画像数を取得する
+		 */
+		size_t GetCount() const noexcept { return m_count; }
+
+		/*!
+		 * @brief	ハッシュが近い画像を検索する
+		 * @param	hash		検索するハッシュ
+		 * @param	maxDistance	一致とするハミング距離の最大値(0: 同一。10前後で再圧縮・縮小・連写の類似画像)
+		 * @param	matches		一致した画像のインデックス(out。昇順)
+		 */
+		void Find(const ImageHash& hash, int maxDistance, std::vector<size_t>& matches) const;
+
+		/*!
+		 * @brief	ハッシュが近い画像をまとめたクラスタを取得する
+		 * @param	maxDistance	一致とするハミング距離の最大値
+		 * @return	2枚以上からなるクラスタの一覧(各クラスタのインデックスは昇順、クラスタは先頭のインデックスの昇順)
+		 * @note	一致する画像を順にたどってまとめる(連写のように少しずつ変化する画像は1つのクラスタになる)。
+		 *			画像ごとに検索せず、部分の値がd/4ビット以内で異なる一覧の組を値の順に走査して照合する(開始位置を連続して読む)。
+		 *			走査する組の数が画像の組の数を上回る場合(閾値が大きい・画像が少ない)は、全ての画像の組を照合する
+		 */
+		std::vector<std::vector<size_t>> FindClusters(int maxDistance) const;
+
+	private:
+		static constexpr int ChunkCount = 4;							//!< pHashを分ける数
+		static constexpr int ChunkBits = 64 / ChunkCount;				//!< 1つの部分のビット数
+		static constexpr std::uint32_t ChunkValueCount = 1u << ChunkBits;	//!< 1つの部分が取り得る値の数
+
+		/*!
+		 * @brief 部分の値ごとの一覧の要素
+		 */
+		struct Entry
+		{
+			ImageHash hash;			//!< 画像ハッシュ
+			std::uint32_t index;	//!< Build()に渡した一覧のインデックス
+		};
+
+		/*!
+		 * @brief	2つのハッシュが一致とみなせるか
+		 */
+		static bool IsMatch(const ImageHash& left, const ImageHash& right, int maxDistance) noexcept;
+
+		size_t m_count = 0;													//!< 登録した画像数
+		std::array<std::vector<std::uint32_t>, ChunkCount> m_bucketOffsets;	//!< 部分の値ごとの一覧の開始位置(値の数+1個)
+		std::array<std::vector<Entry>, ChunkCount> m_bucketEntries;			//!< 部分の値の順に並べた画像
+	};
+}
@@ -0,0 +1,648 @@
+/*!
+ * @file	ImageHeader.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "ImageHeader.h"
+#include <algorithm>	// std::max, std::min
+#include <cstdint>		// std::uint16_t, std::uint32_t
+#include <cstdlib>		// std::abs
+#include <cstring>		// std::memcmp, std::memcpy
+#include <limits>		// std::numeric_limits
+
+namespace Kchary::ImageController::Decode
+{
+	using Diagnostics::ImageFormat;
+
+	namespace
+	{
+		std::uint16_t ReadUint16(const unsigned char* data, bool isBigEndian) noexcept
+		{
+			return isBigEndian
+				? static_cast<std::uint16_t>((data[0] << 8) | data[1])
+				: static_cast<std::uint16_t>(data[0] | (data[1] << 8));
+		}
+
+		std::uint32_t ReadUint32(const unsigned char* data, bool isBigEndian) noexcept
+		{
+			return isBigEndian
+				? (static_cast<std::uint32_t>(data[0]) << 24) | (static_cast<std::uint32_t>(data[1]) << 16) | (static_cast<std::uint32_t>(data[2]) << 8) | data[3]
+				: data[0] | (static_cast<std::uint32_t>(data[1]) << 8) | (static_cast<std::uint32_t>(data[2]) << 16) | (static_cast<std::uint32_t>(data[3]) << 24);
+		}
+
+		/*!
+		 * @brief	幅・高さを設定する
+		 * @return	成功: True, 失敗: False(0またはintの範囲を超える値)
+		 */
+		bool SetSize(ImageHeader& header, std::uint32_t width, std::uint32_t height) noexcept
+		{
+			constexpr auto maxLength = static_cast<std::uint32_t>((std::numeric_limits<int>::max)());
+			if (width == 0 || height == 0 || width > maxLength || height > maxLength)
+			{
+				return false;
+			}
+
+			header.width = static_cast<int>(width);
+			header.height = static_cast<int>(height);
+			return true;
+		}
+
+		/*!
+		 * @brief IFDのエントリ
+		 */
+		struct IfdEntry
+		{
+			std::uint16_t tag = 0;					//!< タグ
+			std::uint16_t type = 0;					//!< 型(2: ASCII, 3: SHORT, 4: LONG, 5: RATIONALなど)
+			std::uint32_t count = 0;				//!< 値の個数
+			const unsigned char* value = nullptr;	//!< 値の先頭(範囲外を指す場合はnullptr)
+			size_t valueEnd = 0;					//!< 値の末尾の位置(値フィールドに格納される場合は0)
+		};
+
+		/*!
+		 * @brief	参照する範囲の末尾を記録する
+		 * @param	requiredSize	これまでに参照した範囲の末尾(nullptrの場合は記録しない)
+		 * @param	end				参照する範囲の末尾
+		 */
+		void Require(size_t* requiredSize, unsigned long long end) noexcept
+		{
+			if (requiredSize)
+			{
+				constexpr auto maxSize = static_cast<unsigned long long>((std::numeric_limits<size_t>::max)());
+				*requiredSize = (std::max)(*requiredSize, static_cast<size_t>((std::min)(end, maxSize)));
+			}
+		}
+
+		/*!
+		 * @brief	IFDの型の値1個あたりのバイト数を取得する
+		 * @return	バイト数(未知の型は0)
+		 */
+		size_t GetIfdTypeSize(std::uint16_t type) noexcept
+		{
+			switch (type)
+			{
+			case 1:		// BYTE
+			case 2:		// ASCII
+			case 6:		// SBYTE
+			case 7:		// UNDEFINED
+				return 1;
+			case 3:		// SHORT
+			case 8:		// SSHORT
+				return 2;
+			case 4:		// LONG
+			case 9:		// SLONG
+			case 11:	// FLOAT
+			case 13:	// IFD
+				return 4;
+			case 5:		// RATIONAL
+			case 10:	// SRATIONAL
+			case 12:	// DOUBLE
+				return 8;
+			default:
+				return 0;
+			}
+		}
+
+		/*!
+		 * @brief	TIFFヘッダーからバイト順とIFD0の位置を読み取る
+		 * @return	成功: True, 失敗: False(TIFFヘッダーの破損)
+		 */
+		bool ReadTiffSignature(const unsigned char* data, size_t size, bool& isBigEndian, size_t& ifdOffset) noexcept
+		{
+			if (size < 8)
+			{
+				return false;
+			}
+
+			if (data[0] == 'M' && data[1] == 'M')
+			{
+				isBigEndian = true;
+			}
+			else if (data[0] == 'I' && data[1] == 'I')
+			{
+				isBigEndian = false;
+			}
+			else
+			{
+				return false;
+			}
+
+			ifdOffset = ReadUint32(data + 4, isBigEndian);
+			return ReadUint16(data + 2, isBigEndian) == 42;
+		}
+
+		/*!
+		 * @brief	IFDのエントリを順に列挙する
+		 * @param	requiredSize	範囲外のIFD・エントリを読むために必要な範囲の末尾(nullptrの場合は記録しない)
+		 * @param	function		エントリごとに呼び出す関数(void(const IfdEntry&))
+		 * @return	成功: True, 失敗: False(IFDの位置が範囲外)
+		 */
+		template<typename Function>
+		bool ForEachIfdEntry(const unsigned char* data, size_t size, size_t ifdOffset, bool isBigEndian, size_t* requiredSize, Function&& function) noexcept
+		{
+			if (size < 2 || ifdOffset > size - 2)
+			{
+				Require(requiredSize, static_cast<unsigned long long>(ifdOffset) + 2);
+				return false;
+			}
+
+			const size_t entryCount = ReadUint16(data + ifdOffset, isBigEndian);
+			for (size_t i = 0; i < entryCount; ++i)
+			{
+				const size_t entryOffset = ifdOffset + 2 + i * 12;
+				if (entryOffset + 12 > size)
+				{
+					Require(requiredSize, static_cast<unsigned long long>(ifdOffset) + 2 + entryCount * 12);
+					break;
+				}
+
+				const unsigned char* entry = data + entryOffset;
+				IfdEntry ifdEntry;
+				ifdEntry.tag = ReadUint16(entry, isBigEndian);
+				ifdEntry.type = ReadUint16(entry + 2, isBigEndian);
+				ifdEntry.count = ReadUint32(entry + 4, isBigEndian);
+
+				// 値が4Byte以内の場合は値フィールドに直接格納され(SHORTは先頭2Byte)、超える場合は値フィールドが値の位置となる
+				const unsigned long long byteCount = static_cast<unsigned long long>(GetIfdTypeSize(ifdEntry.type)) * ifdEntry.count;
+				if (byteCount <= 4)
+				{
+					ifdEntry.value = entry + 8;
+				}
+				else
+				{
+					const size_t valueOffset = ReadUint32(entry + 8, isBigEndian);
+					ifdEntry.valueEnd = static_cast<size_t>((std::min)(valueOffset + byteCount, static_cast<unsigned long long>((std::numeric_limits<size_t>::max)())));
+					if (valueOffset <= size && byteCount <= size - valueOffset)
+					{
+						ifdEntry.value = data + valueOffset;
+					}
+				}
+
+				function(ifdEntry);
+			}
+
+			return true;
+		}
+
+		/*!
+		 * @brief	SHORT・LONGの先頭の値を読み取る
+		 * @return	値(その他の型・値がない場合は0)
+		 */
+		std::uint32_t ReadUnsigned(const IfdEntry& entry, bool isBigEndian) noexcept
+		{
+			if (!entry.value || entry.count == 0)
+			{
+				return 0;
+			}
+
+			return entry.type == 3 ? ReadUint16(entry.value, isBigEndian) : entry.type == 4 ? ReadUint32(entry.value, isBigEndian) : 0;
+		}
+
+		/*!
+		 * @brief	RATIONAL・SRATIONALの先頭の値を読み取る
+		 * @return	値(その他の型・値がない場合・分母が0の場合は0)
+		 */
+		double ReadRational(const IfdEntry& entry, bool isBigEndian) noexcept
+		{
+			if (!entry.value || entry.count == 0 || (entry.type != 5 && entry.type != 10))
+			{
+				return 0.0;
+			}
+
+			const std::uint32_t numerator = ReadUint32(entry.value, isBigEndian);
+			const std::uint32_t denominator = ReadUint32(entry.value + 4, isBigEndian);
+			if (denominator == 0)
+			{
+				return 0.0;
+			}
+
+			return entry.type == 5
+				? static_cast<double>(numerator) / denominator
+				: static_cast<double>(static_cast<std::int32_t>(numerator)) / static_cast<std::int32_t>(denominator);
+		}
+
+		/*!
+		 * @brief	ASCIIの値をNUL終端の文字列として複写する(入りきらない部分と末尾の空白は除く)
+		 */
+		template<size_t Length>
+		void ReadAscii(const IfdEntry& entry, char (&text)[Length]) noexcept
+		{
+			if (!entry.value || entry.type != 2)
+			{
+				return;
+			}
+
+			size_t length = 0;
+			while (length < entry.count && length < Length - 1 && entry.value[length] != '\0')
+			{
+				++length;
+			}
+			while (length > 0 && entry.value[length - 1] == ' ')
+			{
+				--length;
+			}
+
+			std::memcpy(text, entry.value, length);
+			text[length] = '\0';
+		}
+
+		/*!
+		 * @brief	TIFF構造(TIFFファイル・JPEGのEXIF)のIFD0から幅・高さ・ビット深度・向きを読み取る
+		 * @return	成功: True, 失敗: False(TIFFヘッダーの破損)
+		 */
+		bool ReadTiffHeader(const unsigned char* data, size_t size, ImageHeader& header) noexcept
+		{
+			bool isBigEndian = false;
+			size_t ifdOffset = 0;
+			if (!ReadTiffSignature(data, size, isBigEndian, ifdOffset))
+			{
+				return false;
+			}
+
+			std::uint32_t width = 0;
+			std::uint32_t height = 0;
+			const bool result = ForEachIfdEntry(data, size, ifdOffset, isBigEndian, nullptr, [&](const IfdEntry& entry)
+				{
+					const std::uint32_t value = ReadUnsigned(entry, isBigEndian);
+					switch (entry.tag)
+					{
+					case 0x0100:	// ImageWidth
+						width = value;
+						break;
+					case 0x0101:	// ImageLength
+						height = value;
+						break;
+					case 0x0102:	// BitsPerSample(チャンネルごとに並ぶため先頭の値)
+						if (value <= 64)
+						{
+							header.bitDepth = static_cast<int>(value);
+						}
+						break;
+					case 0x0112:	// Orientation
+						if (value >= 1 && value <= 8)
+						{
+							header.orientation = static_cast<int>(value);
+						}
+						break;
+					default:
+						break;
+					}
+				});
+			if (!result)
+			{
+				return false;
+			}
+
+			// EXIFのIFD0は幅・高さを持たないことが多いため、サイズの有無は呼び出し元で判定する
+			SetSize(header, width, height);
+			return true;
+		}
+
+		/*!
+		 * @brief	TIFF構造のIFD0と、そこから参照されるExif IFDから撮影情報を読み取る
+		 * @param	requiredSize	読み取る項目のうち範囲外にあるものを読むために必要な範囲の末尾(TIFF構造の先頭からの位置。nullptrの場合は求めない)
+		 */
+		void ReadExifMetadata(const unsigned char* data, size_t size, ImageMetadata& metadata, size_t* requiredSize) noexcept
+		{
+			bool isBigEndian = false;
+			size_t ifdOffset = 0;
+			if (!ReadTiffSignature(data, size, isBigEndian, ifdOffset))
+			{
+				return;
+			}
+
+			size_t exifIfdOffset = 0;
+			std::uint32_t resolutionUnit = 2;
+			ForEachIfdEntry(data, size, ifdOffset, isBigEndian, requiredSize, [&](const IfdEntry& entry)
+				{
+					switch (entry.tag)
+					{
+					case 0x010F:	// Make
+						ReadAscii(entry, metadata.make);
+						break;
+					case 0x0110:	// Model
+						ReadAscii(entry, metadata.model);
+						break;
+					case 0x011A:	// XResolution
+						metadata.xResolution = ReadRational(entry, isBigEndian);
+						break;
+					case 0x011B:	// YResolution
+						metadata.yResolution = ReadRational(entry, isBigEndian);
+						break;
+					case 0x0128:	// ResolutionUnit(2: インチ, 3: センチメートル)
+						resolutionUnit = ReadUnsigned(entry, isBigEndian);
+						break;
+					case 0x0132:	// DateTime
+						ReadAscii(entry, metadata.dateTime);
+						break;
+					case 0x8769:	// ExifIFDPointer
+						exifIfdOffset = ReadUnsigned(entry, isBigEndian);
+						break;
+					default:
+						return;
+					}
+
+					// 読み取る項目の値のみ参照する(ICCプロファイルなどの大きい値は読み足さない)
+					Require(requiredSize, entry.valueEnd);
+				});
+
+			if (resolutionUnit == 3)
+			{
+				metadata.xResolution *= 2.54;
+				metadata.yResolution *= 2.54;
+			}
+
+			if (exifIfdOffset == 0)
+			{
+				return;
+			}
+
+			ForEachIfdEntry(data, size, exifIfdOffset, isBigEndian, requiredSize, [&](const IfdEntry& entry)
+				{
+					switch (entry.tag)
+					{
+					case 0x829A:	// ExposureTime
+						metadata.exposureTime = ReadRational(entry, isBigEndian);
+						break;
+					case 0x829D:	// FNumber
+						metadata.fNumber = ReadRational(entry, isBigEndian);
+						break;
+					case 0x8822:	// ExposureProgram
+						metadata.exposureProgram = static_cast<int>(ReadUnsigned(entry, isBigEndian));
+						break;
+					case 0x8827:	// PhotographicSensitivity(ISOSpeedRatings)
+						metadata.isoSpeed = static_cast<int>(ReadUnsigned(entry, isBigEndian));
+						break;
+					case 0x9003:	// DateTimeOriginal(IFD0の更新日時より撮影日時を優先する)
+						if (entry.count > 1)
+						{
+							ReadAscii(entry, metadata.dateTime);
+						}
+						break;
+					case 0x9207:	// MeteringMode
+						metadata.meteringMode = static_cast<int>(ReadUnsigned(entry, isBigEndian));
+						break;
+					case 0x920A:	// FocalLength
+						metadata.focalLength = ReadRational(entry, isBigEndian);
+						break;
+					case 0xA403:	// WhiteBalance
+						metadata.whiteBalance = static_cast<int>(ReadUnsigned(entry, isBigEndian));
+						break;
+					case 0xA405:	// FocalLengthIn35mmFilm
+						metadata.focalLengthIn35mm = static_cast<int>(ReadUnsigned(entry, isBigEndian));
+						break;
+					default:
+						return;
+					}
+
+					Require(requiredSize, entry.valueEnd);
+				});
+		}
+
+		/*!
+		 * @brief	JPEGのマーカーを順に読み、SOFから幅・高さ・精度を、APP1(EXIF)から向きとEXIFの位置を読み取る
+		 */
+		bool ReadJpegHeader(const unsigned char* data, size_t size, ImageHeader& header) noexcept
+		{
+			size_t offset = 2;
+			while (offset + 2 <= size)
+			{
+				if (data[offset] != 0xFF)
+				{
+					return false;
+				}
+
+				const unsigned char marker = data[offset + 1];
+				if (marker == 0xFF)
+				{
+					// マーカー前の埋め草
+					++offset;
+					continue;
+				}
+
+				offset += 2;
+				if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+				{
+					// 長さを持たないマーカー
+					continue;
+				}
+				if (marker == 0xD9 || marker == 0xDA || offset + 2 > size)
+				{
+					// SOFより前に画像データ・終端に達した
+					return false;
+				}
+
+				const size_t length = ReadUint16(data + offset, true);
+				if (length < 2 || offset + length > size)
+				{
+					return false;
+				}
+
+				const unsigned char* segment = data + offset + 2;
+				const size_t segmentSize = length - 2;
+				if (marker == 0xE1 && segmentSize >= 6 && std::memcmp(segment, "Exif\0\0", 6) == 0 && header.exifSize == 0)
+				{
+					ImageHeader exifHeader;
+					if (ReadTiffHeader(segment + 6, segmentSize - 6, exifHeader))
+					{
+						header.orientation = exifHeader.orientation;
+						header.exifOffset = static_cast<size_t>(segment + 6 - data);
+						header.exifSize = segmentSize - 6;
+					}
+				}
+				else if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+				{
+					// SOFn: 精度(1Byte)、高さ(2Byte)、幅(2Byte)
+					if (segmentSize < 5)
+					{
+						return false;
+					}
+
+					// libjpegのスケーリングはIDCTで行うため、ロスレス(SOF3・SOF7・SOF11・SOF15)は対象外
+					header.isDctScalable = marker != 0xC3 && marker != 0xC7 && marker != 0xCB && marker != 0xCF;
+					header.bitDepth = segment[0];
+					return SetSize(header, ReadUint16(segment + 3, true), ReadUint16(segment + 1, true));
+				}
+
+				offset += length;
+			}
+
+			return false;
+		}
+
+		bool ReadPngHeader(const unsigned char* data, size_t size, ImageHeader& header) noexcept
+		{
+			// シグネチャ(8Byte)の直後にIHDRチャンク(幅・高さ・ビット深度)がある
+			if (size < 25 || std::memcmp(data + 12, "IHDR", 4) != 0)
+			{
+				return false;
+			}
+
+			header.bitDepth = data[24];
+			return SetSize(header, ReadUint32(data + 16, true), ReadUint32(data + 20, true));
+		}
+
+		bool ReadBmpHeader(const unsigned char* data, size_t size, ImageHeader& header) noexcept
+		{
+			if (size < 26)
+			{
+				return false;
+			}
+
+			if (ReadUint32(data + 14, false) == 12)
+			{
+				// BITMAPCOREHEADER
+				header.bitDepth = ReadUint16(data + 24, false);
+				return SetSize(header, ReadUint16(data + 18, false), ReadUint16(data + 20, false));
+			}
+
+			// BITMAPINFOHEADER以降(高さが負の場合はトップダウン)
+			if (size >= 30)
+			{
+				header.bitDepth = ReadUint16(data + 28, false);
+			}
+
+			const auto width = static_cast<std::int32_t>(ReadUint32(data + 18, false));
+			const auto height = static_cast<std::int32_t>(ReadUint32(data + 22, false));
+			if (width <= 0 || height == (std::numeric_limits<std::int32_t>::min)())
+			{
+				return false;
+			}
+
+			return SetSize(header, static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(std::abs(height)));
+		}
+
+		bool ReadGifHeader(const unsigned char* data, size_t size, ImageHeader& header) noexcept
+		{
+			if (size < 11)
+			{
+				return false;
+			}
+
+			// 論理画面記述子のフラグの下位3bitが(1画素あたりのビット数-1)
+			header.bitDepth = (data[10] & 0x07) + 1;
+			return SetSize(header, ReadUint16(data + 6, false), ReadUint16(data + 8, false));
+		}
+
+		bool ReadWebPHeader(const unsigned char* data, size_t size, ImageHeader& header) noexcept
+		{
+			if (size < 30)
+			{
+				return false;
+			}
+
+			const unsigned char* chunk = data + 12;
+			if (std::memcmp(chunk, "VP8 ", 4) == 0)
+			{
+				// 非可逆: フレームヘッダーの開始コードの後に14bitの幅・高さ
+				return data[23] == 0x9D && data[24] == 0x01 && data[25] == 0x2A
+					&& SetSize(header, ReadUint16(data + 26, false) & 0x3FFF, ReadUint16(data + 28, false) & 0x3FFF);
+			}
+			if (std::memcmp(chunk, "VP8L", 4) == 0)
+			{
+				// 可逆: シグネチャの後に14bitずつ(幅-1)・(高さ-1)
+				const std::uint32_t bits = ReadUint32(data + 21, false);
+				return data[20] == 0x2F && SetSize(header, (bits & 0x3FFF) + 1, ((bits >> 14) & 0x3FFF) + 1);
+			}
+			if (std::memcmp(chunk, "VP8X", 4) == 0)
+			{
+				// 拡張形式: 24bitずつ(キャンバスの幅-1)・(高さ-1)
+				const auto readUint24 = [](const unsigned char* p) { return static_cast<std::uint32_t>(p[0] | (p[1] << 8) | (p[2] << 16)); };
+				return SetSize(header, readUint24(data + 24) + 1, readUint24(data + 27) + 1);
+			}
+
+			return false;
+		}
+	}
+
+	ImageFormat DetectImageFormat(const unsigned char* data, size_t size) noexcept
+	{
+		const auto startsWith = [data, size](size_t offset, const char* signature, size_t length)
+			{
+				return size >= offset + length && std::memcmp(data + offset, signature, length) == 0;
+			};
+
+		if (startsWith(0, "\xFF\xD8\xFF", 3))
+		{
+			return ImageFormat::Jpeg;
+		}
+		if (startsWith(0, "\x89PNG", 4))
+		{
+			return ImageFormat::Png;
+		}
+		if (startsWith(0, "II*\0", 4) || startsWith(0, "MM\0*", 4))
+		{
+			return ImageFormat::Tiff;
+		}
+		if (startsWith(0, "BM", 2))
+		{
+			return ImageFormat::Bmp;
+		}
+		if (startsWith(0, "GIF8", 4))
+		{
+			return ImageFormat::Gif;
+		}
+		if (startsWith(0, "RIFF", 4) && startsWith(8, "WEBP", 4))
+		{
+			return ImageFormat::WebP;
+		}
+
+		return ImageFormat::Other;
+	}
+
+	bool ReadImageHeader(const unsigned char* data, size_t size, ImageHeader& header) noexcept
+	{
+		header = ImageHeader{};
+		header.format = DetectImageFormat(data, size);
+
+		switch (header.format)
+		{
+		case ImageFormat::Jpeg:
+			return ReadJpegHeader(data, size, header);
+		case ImageFormat::Png:
+			return ReadPngHeader(data, size, header);
+		case ImageFormat::Tiff:
+			header.exifSize = size;
+			return ReadTiffHeader(data, size, header) && header.width > 0;
+		case ImageFormat::Bmp:
+			return ReadBmpHeader(data, size, header);
+		case ImageFormat::Gif:
+			return ReadGifHeader(data, size, header);
+		case ImageFormat::WebP:
+			return ReadWebPHeader(data, size, header);
+		default:
+			return false;
+		}
+	}
+
+	void ClearImageMetadata(ImageMetadata& metadata) noexcept
+	{
+		metadata = ImageMetadata{};
+		metadata.orientation = 1;
+		metadata.exposureProgram = -1;
+		metadata.meteringMode = -1;
+		metadata.whiteBalance = -1;
+	}
+
+	void ReadImageMetadata(const unsigned char* data, size_t size, const ImageHeader& header, ImageMetadata& metadata, size_t* requiredSize) noexcept
+	{
+		ClearImageMetadata(metadata);
+		metadata.width = header.width;
+		metadata.height = header.height;
+		metadata.orientation = header.orientation;
+		metadata.bitDepth = header.bitDepth;
+
+		size_t exifRequiredSize = 0;
+		if (header.exifSize > 0 && header.exifOffset <= size && header.exifSize <= size - header.exifOffset)
+		{
+			ReadExifMetadata(data + header.exifOffset, header.exifSize, metadata, &exifRequiredSize);
+		}
+
+		// JPEGなどのEXIFはセグメント内に収まっており、セグメントの外を指す値は不正なため、TIFFのみ読み足す範囲を返す
+		if (requiredSize)
+		{
+			*requiredSize = header.format == ImageFormat::Tiff ? header.exifOffset + exifRequiredSize : 0;
+		}
+	}
+}
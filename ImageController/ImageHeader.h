@@ -0,0 +1,93 @@
+/*!
+ * @file	ImageHeader.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include "DecodeStatisticsTypes.h"
+#include <cstddef>
+
+namespace Kchary::ImageController::Decode
+{
+	/*!
+	 * @brief	EXIFの向きを適用すると幅と高さが入れ替わるか
+	 * @param	orientation	EXIFの向き(1～8)
+	 * @return	入れ替わる: True
+	 */
+	constexpr bool IsTransposedOrientation(int orientation) noexcept
+	{
+		return orientation >= 5 && orientation <= 8;
+	}
+
+	/*!
+	 * @brief	読み込み設定の向きとファイルに記録された向きから、出力に適用する向きを求める
+	 * @param	requestedOrientation	読み込み設定の向き(0: ファイルの記録に従う、1～8: 指定した向き)
+	 * @param	recordedOrientation		ファイルに記録された向き
+	 * @return	適用する向き(1～8。範囲外の値は1とする)
+	 */
+	constexpr int ResolveOrientation(int requestedOrientation, int recordedOrientation) noexcept
+	{
+		const int orientation = requestedOrientation != 0 ? requestedOrientation : recordedOrientation;
+		return orientation >= 1 && orientation <= 8 ? orientation : 1;
+	}
+
+	/*!
+	 * @brief 画像ファイルのヘッダーから読み取った情報
+	 */
+	struct ImageHeader
+	{
+		Diagnostics::ImageFormat format = Diagnostics::ImageFormat::Other;	//!< 画像形式
+		int width = 0;					//!< 幅(ファイルに保存されている向き)
+		int height = 0;					//!< 高さ(ファイルに保存されている向き)
+		int orientation = 1;			//!< EXIFの向き(1～8。記録がない場合は1)
+		int bitDepth = 0;				//!< ビット深度(JPEG・PNG・TIFFは1チャンネルあたり、BMP・GIFは1画素あたり。0: 不明)
+		size_t exifOffset = 0;			//!< EXIF(TIFF構造)の先頭の位置(JPEGはAPP1内、TIFFはファイルの先頭)
+		size_t exifSize = 0;			//!< EXIFのバイト数(0: EXIFなし)
+		bool isDctScalable = false;		//!< DCTスケーリングで縮小デコードできるか(DCT方式のJPEGのみ)
+
+		/*!
+		 * @brief	EXIFの向きを適用すると幅と高さが入れ替わるか
+		 * @return	入れ替わる: True
+		 */
+		bool IsTransposed() const noexcept { return IsTransposedOrientation(orientation); }
+	};
+
+	/*!
+	 * @brief	ファイルの先頭のバイト列(シグネチャ)から画像形式を判定する
+	 * @param	data	ファイルの先頭
+	 * @param	size	バイト数
+	 * @return	画像形式(判定できない場合はOther)
+	 */
+	Diagnostics::ImageFormat DetectImageFormat(const unsigned char* data, size_t size) noexcept;
+
+	/*!
+	 * @brief	ファイルの先頭のバイト列から画像のヘッダーを読み取る(画素データはデコードしない)
+	 * @param	data	ファイルの先頭
+	 * @param	size	バイト数
+	 * @param	header	ヘッダー情報(out。失敗した場合も形式は設定する)
+	 * @return	成功: True, 失敗: False(未対応の形式・ヘッダーの破損)
+	 * @note	JPEG、PNG、TIFF、BMP、GIF、WebPに対応する。EXIFの向きはJPEG(APP1)とTIFF(IFD0)から読み取る
+	 */
+	bool ReadImageHeader(const unsigned char* data, size_t size, ImageHeader& header) noexcept;
+
+	/*!
+	 * @brief	メタデータを記録なしの状態に初期化する(向きは1、露出プログラムなどの列挙値は-1とする)
+	 * @param	metadata	メタデータ(out)
+	 */
+	void ClearImageMetadata(ImageMetadata& metadata) noexcept;
+
+	/*!
+	 * @brief	ヘッダーを読み取ったバイト列から、EXIFの撮影情報を含むメタデータを読み取る
+	 * @param	data		ファイルの先頭(ReadImageHeader()に渡したもの)
+	 * @param	size		バイト数
+	 * @param	header		ReadImageHeader()で読み取ったヘッダー情報
+	 * @param	metadata		メタデータ(out。記録のない項目はClearImageMetadata()の初期値とする)
+	 * @param	requiredSize	読み取る項目を全て読むために必要な、ファイルの先頭からのバイト数(out。nullptrの場合は求めない)
+	 * @note	EXIFはIFD0(メーカー・モデル・解像度・日時)と、そこから参照されるExif IFD(露出・ISO・焦点距離など)のみ読み、
+	 *			MakerNoteやサムネイルのIFDはたどらない。デコード時に開いたファイルをそのまま渡すことで、メタデータのためにファイルを開き直さずに済む。
+	 *			ファイルの先頭のみ渡した場合、requiredSizeがsizeを超えていれば、そこまで読み足して読み直すと範囲外にあった項目を読み取れる(TIFFのみ)
+	 */
+	void ReadImageMetadata(const unsigned char* data, size_t size, const ImageHeader& header, ImageMetadata& metadata, size_t* requiredSize = nullptr) noexcept;
+}
@@ -8,33 +8,447 @@
 #include "RawImageController.h"
 #include "NormalImageController.h"
 #include "ImageReader.h"
+#include "ThreadPool.h"
+#include "CancellationToken.h"
+#include "BufferPool.h"
+#include "RawProcessorPool.h"
+#include "ThumbnailStore.h"
+#include "TileLoader.h"
+#include "PyramidLoader.h"
+#include "MappedFile.h"
+#include "DecodeStatistics.h"
+#include "ImageDataWriter.h"
 #include <locale.h>
 #include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 namespace Kchary::ImageController::Library
 {
 	using namespace Kchary::ImageController::RawImageControl;
 	using namespace Kchary::ImageController::NormalImageControl;
+	using namespace Kchary::ImageController::Threading;
+	using namespace Kchary::ImageController::Memory;
+	using namespace Kchary::ImageController::Diagnostics;
+
+	namespace
+	{
+		constexpr size_t DefaultBufferPoolCapacity = 256 * 1024 * 1024;	//!< 画素バッファのプールの既定上限(256MB)
+		constexpr size_t DefaultTileCacheCapacity = 256 * 1024 * 1024;	//!< タイルキャッシュの既定上限(256MB)
+		constexpr size_t DefaultTileLevelCapacity = 192 * 1024 * 1024;	//!< タイルの分割元の縮小レベルを保持する既定上限(192MB。2400万画素の等倍2枚分)
+		constexpr size_t DefaultPyramidCacheCapacity = 256 * 1024 * 1024;	//!< ピラミッドキャッシュの既定上限(256MB)
+		constexpr int DefaultPyramidMinLongSideLength = 1024;			//!< ピラミッドを作る縮小要求の長辺の既定の最小値(ビューアーの表示用の読み込み(2200px)のみピラミッドを作る)
+	}
+
+	/*!
+	 * @brief 一括読み込みの状態
+	 */
+	struct ImageReader::BatchContext
+	{
+		std::mutex threadPoolMutex;						//!< スレッドプール生成用ミューテックス
+		std::shared_ptr<ThreadPool> threadPool;			//!< 一括読み込み用スレッドプール
+		bool isThreadPoolOutdated = false;				//!< 設定の変更後、ワーカースレッドからの変更のためスレッドプールを作り直していない
+		BatchReadSettings batchReadSettings{};			//!< 一括読み込み設定
+	};
 
 	ImageReader::ImageReader()
 	{
-		m_rawImageController = std::make_unique<RawImageController>();
-		m_normalImageController = std::make_unique<NormalImageController>();
+		m_bufferPool = std::make_shared<BufferPool>(DefaultBufferPoolCapacity);
+		m_rawProcessorPool = std::make_shared<RawProcessorPool>(0);
+		m_statistics = std::make_shared<DecodeStatistics>();
+		m_rawImageController = std::make_unique<RawImageController>(m_bufferPool, m_rawProcessorPool, m_statistics);
+		m_normalImageController = std::make_unique<NormalImageController>(m_bufferPool, m_statistics);
+		m_thumbnailStore = std::make_unique<Cache::ThumbnailStore>(m_bufferPool);
+		m_tileLoader = std::make_unique<Cache::TileLoader>(m_bufferPool, *m_rawImageController, *m_normalImageController, m_statistics, DefaultTileCacheCapacity, DefaultTileLevelCapacity);
+		m_pyramidLoader = std::make_unique<Cache::PyramidLoader>(m_bufferPool, *m_rawImageController, *m_normalImageController, m_statistics, PyramidCacheSettings{ DefaultPyramidCacheCapacity, DefaultPyramidMinLongSideLength });
+		m_batchContext = std::make_unique<BatchContext>();
 	}
 
+	ImageReader::~ImageReader() = default;
+
 	bool ImageReader::GetImageData(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& imageData)
 	{
+		return GetImageData(imagePath, imageReadSettings, imageData, nullptr);
+	}
+
+	DecodeHandle ImageReader::GetImageDataAsync(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, DecodeHandle::CompletionCallback callback)
+	{
+		auto handle = DecodeHandle::Create(std::move(callback));
+
+		GetThreadPool()->Submit([this, path = std::wstring(imagePath), imageReadSettings, handle]()
+			{
+				// 取り出した時点で中断済みの要求はデコードしない
+				if (!handle.Start())
+				{
+					return;
+				}
+
+				bool result = false;
+				try
+				{
+					// メタデータはデコードのために開いたファイルから読み取るため、常に取得しておく
+					result = GetImageData(path.c_str(), imageReadSettings, handle.GetImageData(), &handle.GetMetadata(), &handle.GetCancellationToken());
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << "ImageReader::GetImageDataAsync error: " << e.what() << std::endl;
+				}
+
+				// 例外の場合も完了を通知し、Wait()が返らなくなるのを防ぐ
+				handle.Complete(result);
+			});
+
+		return handle;
+	}
+
+	bool ImageReader::GetImageData(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& imageData, const Threading::CancellationToken* cancellationToken)
+	{
+		return GetImageData(imagePath, imageReadSettings, imageData, nullptr, cancellationToken);
+	}
+
+	bool ImageReader::GetImageData(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken)
+	{
+		ScopedStageTimer totalTimer(*m_statistics, DecodeStage::Total);
+
+		// 更新日時とサイズはデコード前に取得し、デコード中に更新された場合は次回デコードし直す
+		// (サムネイルストアはファイルに記録された向きを適用したBGR 8bitのサムネイルのみ保持する)
+		Cache::ThumbnailKey thumbnailKey;
+		const bool useThumbnailStore = CreateThumbnailKey(imagePath, imageReadSettings, thumbnailKey);
+		if (useThumbnailStore)
+		{
+			ScopedStageTimer storeTimer(*m_statistics, DecodeStage::ThumbnailStoreRead);
+			if (m_thumbnailStore->Find(thumbnailKey, imageData))
+			{
+				m_statistics->AddBytesCopied(imageData.size);
+
+				// サムネイルストアはメタデータを保持しないため、ヘッダーのみ読み取る
+				if (metadata)
+				{
+					GetImageMetadata(imagePath, imageReadSettings.isRawImage, *metadata);
+				}
+				return true;
+			}
+		}
+
 		bool result = false;
 
-		if (imageReadSettings.isRawImage)
+		if (!imageReadSettings.bypassPyramidCache && m_pyramidLoader->IsApplicable(imageReadSettings))
 		{
-			result = m_rawImageController->GetImageData(imagePath, imageReadSettings, imageData);
+			result = m_pyramidLoader->GetImageData(imagePath, imageReadSettings, imageData, metadata, cancellationToken);
+		}
+		else if (imageReadSettings.isRawImage)
+		{
+			result = m_rawImageController->GetImageData(imagePath, imageReadSettings, imageData, metadata, cancellationToken);
 		}
 		else
 		{
-			result = m_normalImageController->GetImageData(imagePath, imageReadSettings, imageData);
+			result = m_normalImageController->GetImageData(imagePath, imageReadSettings, imageData, metadata, cancellationToken);
+		}
+
+		if (result && useThumbnailStore)
+		{
+			m_thumbnailStore->Store(thumbnailKey, imageData);
 		}
 
 		return result;
 	}
-}
\ No newline at end of file
+
+	bool ImageReader::GetImageMetadata(const wchar_t* imagePath, bool isRawImage, ImageMetadata& metadata)
+	{
+		return isRawImage
+			? m_rawImageController->GetImageMetadata(imagePath, metadata)
+			: m_normalImageController->GetImageMetadata(imagePath, metadata);
+	}
+
+	bool ImageReader::GetImageSize(const wchar_t* imagePath, bool isRawImage, int& width, int& height)
+	{
+		return isRawImage
+			? m_rawImageController->GetImageSize(imagePath, width, height)
+			: m_normalImageController->GetImageSize(imagePath, width, height);
+	}
+
+	size_t ImageReader::GetImageDataBatch(const std::vector<std::wstring>& imagePaths, const ImageReadSettings& imageReadSettings, const BatchCallback& callback, const Threading::CancellationToken* cancellationToken)
+	{
+		if (imagePaths.empty())
+		{
+			return 0;
+		}
+
+		std::atomic<size_t> successCount{ 0 };
+
+		// 1枚読み込み、結果を通知する(中断後の画像はデコードせずにCancelledとして通知する)
+		const auto readImage = [this, &imagePaths, &imageReadSettings, &callback, cancellationToken, &successCount](size_t index)
+			{
+				ImageData imageData{};
+				DecodeStatus status = DecodeStatus::Cancelled;
+				if (!Threading::IsCancelled(cancellationToken))
+				{
+					bool result = false;
+					try
+					{
+						result = GetImageData(imagePaths[index].c_str(), imageReadSettings, imageData, cancellationToken);
+					}
+					catch (const std::exception& e)
+					{
+						std::cerr << "ImageReader::GetImageDataBatch error: " << e.what() << std::endl;
+					}
+
+					if (result)
+					{
+						status = DecodeStatus::Succeeded;
+						successCount.fetch_add(1, std::memory_order_relaxed);
+					}
+					else if (!Threading::IsCancelled(cancellationToken))
+					{
+						status = DecodeStatus::Failed;
+					}
+				}
+
+				if (callback)
+				{
+					callback(index, status, imageData);
+				}
+			};
+
+		auto threadPool = GetThreadPool();
+
+		// ワーカースレッドが自身のプールの完了を待つと、待っているワーカーの分だけタスクが進まずデッドロックし得るため、呼び出し元で順に読み込む
+		if (threadPool->IsWorkerThread())
+		{
+			// 読み込み中に設定の変更でプールが差し替えられた場合に、ワーカー自身が最後の参照を手放して自身の終了を待たないようにする
+			threadPool.reset();
+			for (size_t index = 0; index < imagePaths.size(); ++index)
+			{
+				readImage(index);
+			}
+			return successCount.load(std::memory_order_relaxed);
+		}
+
+		// 完了待ち合わせ用の状態(タスクから参照されるため、全タスク完了までこの関数内で保持する)
+		struct BatchState
+		{
+			std::mutex mutex;
+			std::condition_variable completed;
+			size_t remainingCount = 0;
+		} state;
+		state.remainingCount = imagePaths.size();
+
+		for (size_t index = 0; index < imagePaths.size(); ++index)
+		{
+			threadPool->Submit([&readImage, &state, index]()
+				{
+					try
+					{
+						readImage(index);
+					}
+					catch (...)
+					{
+						// コールバックの例外で完了の待ち合わせが終わらなくなるのを防ぐ
+					}
+
+					std::lock_guard<std::mutex> lock(state.mutex);
+					if (--state.remainingCount == 0)
+					{
+						state.completed.notify_all();
+					}
+				});
+		}
+
+		std::unique_lock<std::mutex> lock(state.mutex);
+		state.completed.wait(lock, [&state]() { return state.remainingCount == 0; });
+
+		return successCount.load(std::memory_order_relaxed);
+	}
+
+	bool ImageReader::GetImageDataProgressive(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& previewData, ImageDataCallback callback)
+	{
+		const bool hasPreview = imageReadSettings.isRawImage
+			&& m_rawImageController->GetPreviewImageData(imagePath, imageReadSettings, previewData);
+
+		// 最終的な画像はスレッドプールで読み込み、完了時に通知する
+		GetThreadPool()->Submit([this, path = std::wstring(imagePath), imageReadSettings, callback = std::move(callback)]()
+			{
+				ImageReadSettings fullImageReadSettings = imageReadSettings;
+				fullImageReadSettings.isThumbnailMode = false;
+
+				ImageData imageData{};
+				const bool result = GetImageData(path.c_str(), fullImageReadSettings, imageData);
+				if (callback)
+				{
+					callback(0, result, imageData);
+				}
+			});
+
+		return hasPreview;
+	}
+
+	bool ImageReader::ConvertToDisplayFormat(const ImageData& source, ImageData& displayData) const
+	{
+		const Common::ImageDataWriter imageDataWriter(m_bufferPool);
+		return imageDataWriter.WriteDisplayFormat(source, displayData);
+	}
+
+	void ImageReader::SetBatchReadSettings(const BatchReadSettings& batchReadSettings)
+	{
+		std::shared_ptr<ThreadPool> previousThreadPool;
+		{
+			std::lock_guard<std::mutex> lock(m_batchContext->threadPoolMutex);
+			m_batchContext->batchReadSettings = batchReadSettings;
+
+			// ワーカースレッドが自身のプールを破棄すると自身の終了を待ってデッドロックするため、次に他のスレッドから取得する際に作り直す
+			if (m_batchContext->threadPool && m_batchContext->threadPool->IsWorkerThread())
+			{
+				m_batchContext->isThreadPoolOutdated = true;
+				return;
+			}
+
+			previousThreadPool = std::move(m_batchContext->threadPool);
+			m_batchContext->isThreadPoolOutdated = false;
+		}
+
+		// 破棄は残りのタスクの完了を待つため、ロックの外で行う(待つ間も他のスレッドは新しいプールを取得できる)
+		previousThreadPool.reset();
+	}
+
+	void ImageReader::SetBufferPoolCapacity(size_t maxCachedBytes)
+	{
+		m_bufferPool->SetMaxCachedBytes(maxCachedBytes);
+	}
+
+	BufferPoolStatistics ImageReader::GetBufferPoolStatistics() const
+	{
+		return m_bufferPool->GetStatistics();
+	}
+
+	RawProcessorStatistics ImageReader::GetRawProcessorStatistics() const
+	{
+		return m_rawProcessorPool->GetStatistics();
+	}
+
+	bool ImageReader::OpenThumbnailStore(const wchar_t* directory)
+	{
+		return m_thumbnailStore->Open(directory);
+	}
+
+	void ImageReader::CloseThumbnailStore()
+	{
+		m_thumbnailStore->Close();
+	}
+
+	void ImageReader::SetThumbnailStoreCapacity(unsigned long long maxBytes)
+	{
+		m_thumbnailStore->SetCapacity(maxBytes);
+	}
+
+	bool ImageReader::FindStoredThumbnail(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& imageData)
+	{
+		Cache::ThumbnailKey thumbnailKey;
+		if (!CreateThumbnailKey(imagePath, imageReadSettings, thumbnailKey))
+		{
+			return false;
+		}
+
+		ScopedStageTimer storeTimer(*m_statistics, DecodeStage::ThumbnailStoreRead);
+		if (!m_thumbnailStore->Find(thumbnailKey, imageData))
+		{
+			return false;
+		}
+
+		m_statistics->AddBytesCopied(imageData.size);
+		return true;
+	}
+
+	bool ImageReader::CreateThumbnailKey(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, Cache::ThumbnailKey& thumbnailKey) const
+	{
+		// 表示・保存用の大きい画像と、1回だけ読む画像はストアに追加しない
+		if (!imageReadSettings.useThumbnailStore || imageReadSettings.bypassPyramidCache
+			|| !imageReadSettings.isThumbnailMode || imageReadSettings.orientation != 0 || imageReadSettings.isHighBitDepth || imageReadSettings.preserveAlpha || !m_thumbnailStore->IsOpen()
+			|| !IO::GetFileStatus(imagePath, thumbnailKey.fileStatus))
+		{
+			return false;
+		}
+
+		thumbnailKey.path = IO::ToUtf8Path(imagePath);
+		thumbnailKey.resizeLongSideLength = imageReadSettings.resizeLongSideLength;
+		return true;
+	}
+
+	bool ImageReader::CompactThumbnailStore()
+	{
+		return m_thumbnailStore->Compact();
+	}
+
+	ThumbnailStoreStatistics ImageReader::GetThumbnailStoreStatistics() const
+	{
+		return m_thumbnailStore->GetStatistics();
+	}
+
+	bool ImageReader::GetTiledImageInfo(const wchar_t* imagePath, bool isRawImage, TiledImageInfo& tiledImageInfo)
+	{
+		return m_tileLoader->GetTiledImageInfo(imagePath, isRawImage, tiledImageInfo);
+	}
+
+	bool ImageReader::GetImageTile(const wchar_t* imagePath, const TileReadSettings& tileReadSettings, ImageData& imageData)
+	{
+		return m_tileLoader->GetTile(imagePath, tileReadSettings, imageData);
+	}
+
+	void ImageReader::SetTileCacheCapacity(size_t capacity)
+	{
+		m_tileLoader->SetCapacity(capacity);
+	}
+
+	TileCacheStatistics ImageReader::GetTileCacheStatistics() const
+	{
+		return m_tileLoader->GetStatistics();
+	}
+
+	void ImageReader::SetPyramidCacheSettings(const PyramidCacheSettings& pyramidCacheSettings)
+	{
+		m_pyramidLoader->SetSettings(pyramidCacheSettings);
+	}
+
+	PyramidCacheStatistics ImageReader::GetPyramidCacheStatistics() const
+	{
+		return m_pyramidLoader->GetStatistics();
+	}
+
+	DecodeStatisticsSnapshot ImageReader::GetDecodeStatistics() const
+	{
+		return m_statistics->GetSnapshot();
+	}
+
+	std::string ImageReader::GetDecodeStatisticsJson() const
+	{
+		return m_statistics->GetSnapshot().ToJson();
+	}
+
+	void ImageReader::ResetDecodeStatistics()
+	{
+		m_statistics->Reset();
+	}
+
+	void ImageReader::SetDecodeStatisticsEnabled(bool isEnabled)
+	{
+		m_statistics->SetEnabled(isEnabled);
+	}
+
+	std::shared_ptr<ThreadPool> ImageReader::GetThreadPool()
+	{
+		std::shared_ptr<ThreadPool> previousThreadPool;	// ロックの解放後に破棄する
+		std::lock_guard<std::mutex> lock(m_batchContext->threadPoolMutex);
+		if (m_batchContext->isThreadPoolOutdated && !m_batchContext->threadPool->IsWorkerThread())
+		{
+			previousThreadPool = std::move(m_batchContext->threadPool);
+			m_batchContext->isThreadPoolOutdated = false;
+		}
+
+		if (!m_batchContext->threadPool)
+		{
+			m_batchContext->threadPool = std::make_shared<ThreadPool>(m_batchContext->batchReadSettings.threadCount, m_batchContext->batchReadSettings.queueDepth);
+		}
+
+		return m_batchContext->threadPool;
+	}
+}
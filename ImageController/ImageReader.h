@@ -7,13 +7,64 @@
 
 #include "ImageData.h"
 #include "IImageController.h"
+#include "DecodeStatisticsTypes.h"
+#include "DecodeHandle.h"
+#include <functional>
 #include <memory>
+#include <string>
+#include <vector>
+
+// C++/CLIからインクルードされるため、<mutex>・<thread>を必要とする型は前方宣言にとどめる
+namespace Kchary::ImageController::Threading
+{
+	class ThreadPool;
+	class CancellationToken;
+}
+
+namespace Kchary::ImageController::Memory
+{
+	class BufferPool;
+}
+
+namespace Kchary::ImageController::RawImageControl
+{
+	class RawProcessorPool;
+}
+
+namespace Kchary::ImageController::Cache
+{
+	class ThumbnailStore;
+	struct ThumbnailKey;
+	class TileLoader;
+	class PyramidLoader;
+}
+
+namespace Kchary::ImageController::Diagnostics
+{
+	class DecodeStatistics;
+}
 
 namespace Kchary::ImageController::Library
 {
-	class ImageReader final
+	class ImageReader final : public IImageController
 	{
 	public:
+		/*!
+		 * @brief	一括読み込みの結果通知コールバック
+		 * @param	index		画像パスのインデックス
+		 * @param	result		成功: True, 失敗: False
+		 * @param	imageData	画像データ(コールバック内でムーブして受け取ってよい)
+		 */
+		using ImageDataCallback = std::function<void(size_t index, bool result, ImageData& imageData)>;
+
+		/*!
+		 * @brief	一括読み込みの結果通知コールバック
+		 * @param	index		画像パスのインデックス
+		 * @param	status		結果(Succeeded, Failed, Cancelled)
+		 * @param	imageData	画像データ(コールバック内でムーブして受け取ってよい。Succeeded以外は空)
+		 */
+		using BatchCallback = std::function<void(size_t index, DecodeStatus status, ImageData& imageData)>;
+
 		/*!
 		* @brief コンストラクタ
 		*/
@@ -22,17 +73,265 @@ namespace Kchary::ImageController::Library
 		/*!
 		* @brief デストラクタ
 		*/
-		~ImageReader() = default;
+		~ImageReader();
 
 		/*!
 		 * @brief	画像データを取得する
 		 * @param	imageData: 画像データ
 		 * @return	成功: True, 失敗: False
+		 * @note	複数スレッドから同時に呼び出してよい。
+		 *			サムネイルストアを開いている場合、useThumbnailStoreを指定したサムネイルモードの画像はストアから取得し、なければデコードしてストアへ追加する
+		 *			(bypassPyramidCacheを指定した場合を除く)。
+		 *			デコード結果は1/2ずつ縮小したピラミッドとしてキャッシュし、同じ画像の異なるサイズの要求はピラミッドから縮小して出力する
+		 *			(bypassPyramidCacheを指定した場合と、ピラミッドを作る長辺の最小値より小さい要求でピラミッドがない場合を除く)
 		 */
 		bool GetImageData(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& imageData);
 
+		/*!
+		 * @brief	画像データを取得する(中断要求を受けたら工程の区切りで打ち切る)
+		 * @param	imagePath			画像パス
+		 * @param	imageReadSettings	画像設定
+		 * @param	imageData			画像データ(out)
+		 * @param	cancellationToken	中断要求(nullptrの場合は中断しない)
+		 * @return	成功: True, 失敗: False(中断した場合を含む)
+		 */
+		bool GetImageData(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& imageData, const Threading::CancellationToken* cancellationToken);
+
+		/*!
+		 * @brief	画像データと、同じファイルから読み取ったメタデータを取得する
+		 * @param	imagePath			画像パス
+		 * @param	imageReadSettings	画像設定
+		 * @param	imageData			画像データ(out)
+		 * @param	metadata			メタデータ(out。nullptrの場合は取得しない)
+		 * @param	cancellationToken	中断要求(nullptrの場合は中断しない)
+		 * @return	成功: True, 失敗: False(中断した場合を含む)
+		 * @note	メタデータはRAW画像はLibRawのopen_file結果から、それ以外はデコードのためにマップした領域のヘッダーとEXIFから読み取るため、
+		 *			メタデータのためにファイルを開き直さない。ピラミッドから提供する場合はピラミッドを作る際に読み取ったものを返し、
+		 *			サムネイルストアから提供する場合のみヘッダーを読むためにファイルを開く
+		 */
+		bool GetImageData(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken) override;
+
+		/*!
+		 * @brief	画素データをデコードせずに、メタデータを取得する
+		 * @param	imagePath	画像パス
+		 * @param	isRawImage	RAW画像か
+		 * @param	metadata	メタデータ(out)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool GetImageMetadata(const wchar_t* imagePath, bool isRawImage, ImageMetadata& metadata);
+
+		/*!
+		 * @brief	画素データをデコードせずに、等倍でデコードした場合の画像サイズを取得する
+		 * @param	imagePath	画像パス
+		 * @param	isRawImage	RAW画像か(埋め込みプレビューではなく、現像後の画像のサイズを返す)
+		 * @param	width		幅(out。EXIFの向き・RAWの回転を適用後)
+		 * @param	height		高さ(out。EXIFの向き・RAWの回転を適用後)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool GetImageSize(const wchar_t* imagePath, bool isRawImage, int& width, int& height);
+
+		/*!
+		 * @brief	画像データをスレッドプールで非同期に取得する
+		 * @param	imagePath			画像パス
+		 * @param	imageReadSettings	画像設定
+		 * @param	callback			完了通知コールバック(nullptrの場合は通知しない)
+		 * @return	完了待ち・状態確認・中断を行うハンドル
+		 * @note	表示する画像を切り替える際は、前の画像のハンドルをCancel()すること。
+		 *			開始前の要求はデコードせずに破棄し、デコード中の要求は工程の区切り(RAWはdcraw_processの途中を含む)で打ち切る。
+		 *			同じファイルから読み取ったメタデータをハンドルのGetMetadata()で取得できる
+		 */
+		DecodeHandle GetImageDataAsync(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, DecodeHandle::CompletionCallback callback);
+
+		/*!
+		 * @brief	複数の画像データをスレッドプールで並列に取得する
+		 * @param	imagePaths			画像パスのリスト
+		 * @param	imageReadSettings	画像設定(全画像共通)
+		 * @param	callback			1枚読み込むごとに完了順で呼ばれるコールバック(ワーカースレッドから呼ばれる)
+		 * @param	cancellationToken	この呼び出しの中断要求(nullptrの場合は中断しない。他の一括読み込みには影響しない)
+		 * @return	読み込みに成功した枚数
+		 * @note	全画像のコールバックが終わるまでブロックする。中断によりスキップ・打ち切った画像もCancelledとしてコールバックするため、
+		 *			コールバックの回数は常に画像数と一致する。
+		 *			スレッドプールのワーカースレッド(非同期読み込みのコールバック内など)から呼び出した場合は、プールの完了を待たずに呼び出し元のスレッドで順に読み込む
+		 */
+		size_t GetImageDataBatch(const std::vector<std::wstring>& imagePaths, const ImageReadSettings& imageReadSettings, const BatchCallback& callback, const Threading::CancellationToken* cancellationToken);
+
+		/*!
+		 * @brief	画像データを段階的に取得する
+		 * @param	imagePath			画像パス
+		 * @param	imageReadSettings	画像設定
+		 * @param	previewData			RAW画像に埋め込まれたプレビュー画像(out)
+		 * @param	callback			最終的な画像(RAWはデモザイク済みの画像)の通知先(スレッドプールから1回だけ呼ばれる。indexは常に0)
+		 * @return	プレビュー画像を取得できた: True, 取得できない(RAW画像以外を含む): False
+		 * @note	プレビュー画像を同期的に返した後、最終的な画像をスレッドプールで読み込む
+		 */
+		bool GetImageDataProgressive(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& previewData, ImageDataCallback callback);
+
+		/*!
+		 * @brief	画像データを表示用の8bit/ch(Bgr24・Bgra32)へ変換する
+		 * @param	source		画像データ(isHighBitDepthを指定して読み込んだ16bit/chの画像など)
+		 * @param	displayData	表示用の画像データ(out。書き込み先を設定した場合は書き込み先へ出力する)
+		 * @return	成功: True, 失敗: False
+		 * @note	編集・保存には元の画像データを使い、表示のみ変換した画像を使う。8bit/chの画像はそのまま複写する
+		 */
+		bool ConvertToDisplayFormat(const ImageData& source, ImageData& displayData) const;
+
+		/*!
+		 * @brief	一括読み込みの設定を変更する(次回の一括読み込みから反映される)
+		 * @param	batchReadSettings	一括読み込み設定
+		 * @note	現在のスレッドプールは残りのタスクの完了を待って破棄する。
+		 *			一括読み込みのワーカースレッド(コールバックなど)から呼び出した場合は、次に他のスレッドから読み込む際に作り直す
+		 */
+		void SetBatchReadSettings(const BatchReadSettings& batchReadSettings);
+
+		/*!
+		 * @brief	画素バッファのプールに保持する最大バイト数を設定する
+		 * @param	maxCachedBytes	最大バイト数
+		 */
+		void SetBufferPoolCapacity(size_t maxCachedBytes);
+
+		/*!
+		 * @brief	画素バッファのプールの統計情報を取得する
+		 * @return	統計情報
+		 */
+		Memory::BufferPoolStatistics GetBufferPoolStatistics() const;
+
+		/*!
+		 * @brief	RAW画像処理インスタンス(LibRaw)の生成・再利用回数を取得する
+		 * @return	統計情報
+		 */
+		RawProcessorStatistics GetRawProcessorStatistics() const;
+
+		/*!
+		 * @brief	ディスクに永続化するサムネイルストアを開く
+		 * @param	directory	ストアのファイルを置くディレクトリ(作成済みであること)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool OpenThumbnailStore(const wchar_t* directory);
+
+		/*!
+		 * @brief	サムネイルストアを閉じる(インデックスを保存する)
+		 */
+		void CloseThumbnailStore();
+
+		/*!
+		 * @brief	サムネイルストアのパックファイルに保持する最大バイト数を設定する(既定は500MB)
+		 * @param	maxBytes	最大バイト数(超えた場合は古いサムネイルから破棄する)
+		 */
+		void SetThumbnailStoreCapacity(unsigned long long maxBytes);
+
+		/*!
+		 * @brief	サムネイルストアに保存したサムネイルのみを取得する(デコードしない)
+		 * @param	imagePath			画像パス
+		 * @param	imageReadSettings	画像設定(GetImageData()でストアを使う設定であること)
+		 * @param	imageData			画像データ(out)
+		 * @return	取得できた: True, ストアを開いていない・ストアにない・ストアを使わない設定: False
+		 * @note	複数スレッドから同時に呼び出してよい
+		 */
+		bool FindStoredThumbnail(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, ImageData& imageData);
+
+		/*!
+		 * @brief	サムネイルストアから不要になったサムネイルの領域を解放する
+		 * @return	成功: True, 失敗: False
+		 */
+		bool CompactThumbnailStore();
+
+		/*!
+		 * @brief	サムネイルストアの統計情報を取得する
+		 * @return	統計情報
+		 */
+		ThumbnailStoreStatistics GetThumbnailStoreStatistics() const;
+
+		/*!
+		 * @brief	タイル読み込みする画像の等倍のサイズと縮小レベルの数を取得する
+		 * @param	imagePath		画像パス
+		 * @param	isRawImage		RAW画像か
+		 * @param	tiledImageInfo	画像の情報(out)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool GetTiledImageInfo(const wchar_t* imagePath, bool isRawImage, TiledImageInfo& tiledImageInfo);
+
+		/*!
+		 * @brief	縮小レベルの画像のうち、指定範囲を取得する
+		 * @param	imagePath			画像パス
+		 * @param	tileReadSettings	タイル読み込み設定
+		 * @param	imageData			画像データ(out。BGR 8bit。範囲は縮小レベルの画像内に切り詰める)
+		 * @return	成功: True, 失敗: False
+		 * @note	縮小レベルごとに512px四方のタイルへ分割してキャッシュする。キャッシュにないタイルは保持している縮小レベルの画像から切り出し、
+		 *			縮小レベルの画像も保持していない場合のみデコードする。タイル・縮小レベルの画像はそれぞれ合計バイト数の上限を超えると、
+		 *			最も長く使われていないものから破棄する。複数スレッドから同時に呼び出してよい
+		 */
+		bool GetImageTile(const wchar_t* imagePath, const TileReadSettings& tileReadSettings, ImageData& imageData);
+
+		/*!
+		 * @brief	タイルキャッシュに保持する最大バイト数を設定する
+		 * @param	capacity	最大バイト数
+		 */
+		void SetTileCacheCapacity(size_t capacity);
+
+		/*!
+		 * @brief	タイルキャッシュの統計情報を取得する
+		 * @return	統計情報
+		 */
+		TileCacheStatistics GetTileCacheStatistics() const;
+
+		/*!
+		 * @brief	ピラミッドキャッシュの設定を変更する
+		 * @param	pyramidCacheSettings	ピラミッドキャッシュ設定(上限を下げた場合は超過分を破棄する)
+		 */
+		void SetPyramidCacheSettings(const PyramidCacheSettings& pyramidCacheSettings);
+
+		/*!
+		 * @brief	ピラミッドキャッシュの統計情報を取得する
+		 * @return	統計情報
+		 */
+		PyramidCacheStatistics GetPyramidCacheStatistics() const;
+
+		/*!
+		 * @brief	デコードの統計情報(工程ごとの処理時間、読み込み・出力バイト数、形式・縮小モードごとのデコード回数)を取得する
+		 * @return	統計情報
+		 */
+		Diagnostics::DecodeStatisticsSnapshot GetDecodeStatistics() const;
+
+		/*!
+		 * @brief	デコードの統計情報をJSON形式で取得する
+		 * @return	JSON
+		 */
+		std::string GetDecodeStatisticsJson() const;
+
+		/*!
+		 * @brief	デコードの統計情報を初期化する
+		 */
+		void ResetDecodeStatistics();
+
+		/*!
+		 * @brief	デコードの統計情報の集計を有効・無効にする(既定では有効)
+		 * @param	isEnabled	有効: True
+		 */
+		void SetDecodeStatisticsEnabled(bool isEnabled);
+
 	private:
+		struct BatchContext;
+
+		/*!
+		 * @brief	一括読み込み用のスレッドプールを取得する(未作成または設定変更時は作り直す)
+		 * @return	スレッドプール(実行中の一括読み込みは設定変更後も旧プールを使い続ける)
+		 */
+		std::shared_ptr<Threading::ThreadPool> GetThreadPool();
+
+		/*!
+		 * @brief	サムネイルストアのキーを作る
+		 * @return	ストアを使う: True, ストアを開いていない・ストアを使わない設定・ファイルの状態を取得できない: False
+		 */
+		bool CreateThumbnailKey(const wchar_t* imagePath, const ImageReadSettings& imageReadSettings, Cache::ThumbnailKey& thumbnailKey) const;
+
+		std::shared_ptr<Memory::BufferPool> m_bufferPool;			//!< 画素バッファのプール
+		std::shared_ptr<RawImageControl::RawProcessorPool> m_rawProcessorPool;	//!< LibRawインスタンスのプール
+		std::shared_ptr<Diagnostics::DecodeStatistics> m_statistics;	//!< デコードの統計情報
 		std::unique_ptr<IImageController> m_rawImageController;		//!< RAW画像読み込み用インスタンス
 		std::unique_ptr<IImageController> m_normalImageController;	//!< 通常の画像読み込み用インスタンス
+		std::unique_ptr<Cache::ThumbnailStore> m_thumbnailStore;		//!< サムネイルストア
+		std::unique_ptr<Cache::TileLoader> m_tileLoader;				//!< タイル読み込み(各画像読み込みインスタンスより先に破棄する)
+		std::unique_ptr<Cache::PyramidLoader> m_pyramidLoader;		//!< ピラミッド読み込み(各画像読み込みインスタンスより先に破棄する)
+		std::unique_ptr<BatchContext> m_batchContext;				//!< 一括読み込みの状態
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,399 @@
+﻿/*!
+ * @file	MappedFile.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "MappedFile.h"
+#include <algorithm>	// std::min
+#include <limits>		// std::numeric_limits
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#endif
+
+namespace Kchary::ImageController::IO
+{
+	namespace
+	{
+		constexpr size_t MinMappedFileSize = 64 * 1024;		//!< これより小さいファイルはマップせずに読み込む
+		constexpr size_t ReadChunkSize = 4 * 1024 * 1024;	//!< フォールバック時の1回の読み込みサイズ
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const wchar_t* path, AccessPattern accessPattern)
+	{
+		return OpenFile(path, accessPattern, (std::numeric_limits<size_t>::max)());
+	}
+
+	bool MappedFile::OpenPrefix(const wchar_t* path, size_t prefixSize, AccessPattern accessPattern)
+	{
+		return OpenFile(path, accessPattern, prefixSize);
+	}
+
+	bool MappedFile::ExtendPrefix(size_t prefixSize)
+	{
+		if (m_isMapped || !m_data || prefixSize <= m_size || m_size >= m_fileSize)
+		{
+			return false;
+		}
+
+		return ReadTo((std::min)(prefixSize, m_fileSize));
+	}
+
+#ifdef _WIN32
+	bool MappedFile::OpenFile(const wchar_t* path, AccessPattern accessPattern, size_t readLimit)
+	{
+		Close();
+		m_accessPattern = accessPattern;
+
+		// 順次アクセスの場合はヒントを指定し、キャッシュマネージャーの先読みを有効にする
+		const bool isSequential = accessPattern == AccessPattern::Sequential;
+		const DWORD shareMode = isSequential ? FILE_SHARE_READ : FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+		const DWORD flags = isSequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+		const HANDLE file = ::CreateFileW(path, GENERIC_READ, shareMode, nullptr, OPEN_EXISTING, flags, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		m_fileHandle = file;
+
+		LARGE_INTEGER fileSize{};
+		if (!::GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+		{
+			Close();
+			return false;
+		}
+		m_fileSize = static_cast<size_t>(fileSize.QuadPart);
+
+		// ネットワーク上のファイルはマップ中に接続が切れると例外になるため、読み込む
+		if (m_fileSize >= MinMappedFileSize && !IsRemoteFile() && Map())
+		{
+			return true;
+		}
+
+		if (!ReadTo((std::min)(readLimit, m_fileSize)))
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void MappedFile::Close() noexcept
+	{
+		if (m_isMapped && m_data)
+		{
+			::UnmapViewOfFile(m_data);
+		}
+		if (m_mappingHandle)
+		{
+			::CloseHandle(m_mappingHandle);
+			m_mappingHandle = nullptr;
+		}
+		if (m_fileHandle)
+		{
+			::CloseHandle(m_fileHandle);
+			m_fileHandle = nullptr;
+		}
+
+		m_data = nullptr;
+		m_size = 0;
+		m_fileSize = 0;
+		m_isMapped = false;
+		m_readBuffer.clear();
+	}
+
+	bool MappedFile::Map()
+	{
+		const HANDLE mapping = ::CreateFileMappingW(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+		{
+			return false;
+		}
+
+		void* view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view)
+		{
+			::CloseHandle(mapping);
+			return false;
+		}
+
+		m_mappingHandle = mapping;
+		m_data = static_cast<const unsigned char*>(view);
+		m_size = m_fileSize;
+		m_isMapped = true;
+
+		// デコーダーが先頭から読み進める間にページを先読みさせる(失敗しても読み込みは継続できる)
+		if (m_accessPattern == AccessPattern::Sequential)
+		{
+			WIN32_MEMORY_RANGE_ENTRY range{ view, m_size };
+			::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+		}
+
+		return true;
+	}
+
+	bool MappedFile::ReadTo(size_t size)
+	{
+		// 読み込み済みの範囲は読み直さず、続きの位置から読む
+		m_readBuffer.resize(size);
+
+		size_t offset = m_size;
+		while (offset < size)
+		{
+			const DWORD chunkSize = static_cast<DWORD>((std::min)(ReadChunkSize, size - offset));
+			OVERLAPPED overlapped{};
+			overlapped.Offset = static_cast<DWORD>(static_cast<unsigned long long>(offset) & 0xFFFFFFFF);
+			overlapped.OffsetHigh = static_cast<DWORD>(static_cast<unsigned long long>(offset) >> 32);
+			DWORD readSize = 0;
+			if (!::ReadFile(m_fileHandle, m_readBuffer.data() + offset, chunkSize, &readSize, &overlapped) || readSize == 0)
+			{
+				m_readBuffer.resize(m_size);
+				m_data = m_size > 0 ? m_readBuffer.data() : nullptr;
+				return false;
+			}
+			offset += readSize;
+		}
+
+		m_data = m_readBuffer.data();
+		m_size = size;
+		m_isMapped = false;
+
+		return true;
+	}
+
+	bool MappedFile::IsRemoteFile() const
+	{
+		// FileRemoteProtocolInfoはリモートのファイルに対してのみ成功する
+		FILE_REMOTE_PROTOCOL_INFO protocolInfo{};
+		return ::GetFileInformationByHandleEx(m_fileHandle, FileRemoteProtocolInfo, &protocolInfo, sizeof(protocolInfo)) != FALSE;
+	}
+
+	std::string ToUtf8Path(const wchar_t* path)
+	{
+		const int length = ::WideCharToMultiByte(CP_UTF8, 0, path, -1, nullptr, 0, nullptr, nullptr);
+		if (length <= 1)
+		{
+			return {};
+		}
+
+		std::string result(static_cast<size_t>(length) - 1, '\0');
+		::WideCharToMultiByte(CP_UTF8, 0, path, -1, result.data(), length, nullptr, nullptr);
+		return result;
+	}
+
+	bool GetFileStatus(const wchar_t* path, FileStatus& status)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributeData{};
+		if (!::GetFileAttributesExW(path, GetFileExInfoStandard, &attributeData))
+		{
+			return false;
+		}
+
+		status.lastWriteTime = static_cast<long long>((static_cast<unsigned long long>(attributeData.ftLastWriteTime.dwHighDateTime) << 32) | attributeData.ftLastWriteTime.dwLowDateTime);
+		status.length = (static_cast<unsigned long long>(attributeData.nFileSizeHigh) << 32) | attributeData.nFileSizeLow;
+		return true;
+	}
+
+	bool GetFileStatus(const std::string& path, FileStatus& status)
+	{
+		const int length = ::MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, path.data(), static_cast<int>(path.size()), nullptr, 0);
+		if (length <= 0)
+		{
+			return false;
+		}
+
+		std::wstring widePath(static_cast<size_t>(length), L'\0');
+		::MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, path.data(), static_cast<int>(path.size()), widePath.data(), length);
+		return GetFileStatus(widePath.c_str(), status);
+	}
+#else
+	bool MappedFile::OpenFile(const wchar_t* path, AccessPattern accessPattern, size_t readLimit)
+	{
+		Close();
+		m_accessPattern = accessPattern;
+
+		const int fileDescriptor = ::open(ToUtf8Path(path).c_str(), O_RDONLY | O_CLOEXEC);
+		if (fileDescriptor < 0)
+		{
+			return false;
+		}
+		m_fileDescriptor = fileDescriptor;
+
+		struct stat fileStatus {};
+		if (::fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size <= 0)
+		{
+			Close();
+			return false;
+		}
+		m_fileSize = static_cast<size_t>(fileStatus.st_size);
+
+		// ネットワーク上のファイルはマップ中に切り詰められるとSIGBUSになるため、読み込む
+		if (m_fileSize >= MinMappedFileSize && !IsRemoteFile() && Map())
+		{
+			return true;
+		}
+
+		::posix_fadvise(m_fileDescriptor, 0, 0, m_accessPattern == AccessPattern::Sequential ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+		if (!ReadTo((std::min)(readLimit, m_fileSize)))
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void MappedFile::Close() noexcept
+	{
+		if (m_isMapped && m_data)
+		{
+			::munmap(const_cast<unsigned char*>(m_data), m_size);
+		}
+		if (m_fileDescriptor >= 0)
+		{
+			::close(m_fileDescriptor);
+			m_fileDescriptor = -1;
+		}
+
+		m_data = nullptr;
+		m_size = 0;
+		m_fileSize = 0;
+		m_isMapped = false;
+		m_readBuffer.clear();
+	}
+
+	bool MappedFile::Map()
+	{
+		void* view = ::mmap(nullptr, m_fileSize, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+		if (view == MAP_FAILED)
+		{
+			return false;
+		}
+
+		m_data = static_cast<const unsigned char*>(view);
+		m_size = m_fileSize;
+		m_isMapped = true;
+
+		// デコーダーが先頭から読み進める間にページを先読みさせる(失敗しても読み込みは継続できる)
+		if (m_accessPattern == AccessPattern::Sequential)
+		{
+			::madvise(view, m_size, MADV_SEQUENTIAL);
+			::madvise(view, m_size, MADV_WILLNEED);
+		}
+		else
+		{
+			::madvise(view, m_size, MADV_RANDOM);
+		}
+
+		return true;
+	}
+
+	bool MappedFile::ReadTo(size_t size)
+	{
+		// 読み込み済みの範囲は読み直さず、続きの位置から読む
+		m_readBuffer.resize(size);
+
+		size_t offset = m_size;
+		while (offset < size)
+		{
+			const ssize_t readSize = ::pread(m_fileDescriptor, m_readBuffer.data() + offset, (std::min)(ReadChunkSize, size - offset), static_cast<off_t>(offset));
+			if (readSize <= 0)
+			{
+				m_readBuffer.resize(m_size);
+				m_data = m_size > 0 ? m_readBuffer.data() : nullptr;
+				return false;
+			}
+			offset += static_cast<size_t>(readSize);
+		}
+
+		m_data = m_readBuffer.data();
+		m_size = size;
+		m_isMapped = false;
+
+		return true;
+	}
+
+	bool MappedFile::IsRemoteFile() const
+	{
+		constexpr long NfsSuperMagic = 0x6969;
+		constexpr long SmbSuperMagic = 0x517B;
+		constexpr long CifsSuperMagic = 0xFF534D42;
+		constexpr long Smb2SuperMagic = 0xFE534D42;
+		constexpr long FuseSuperMagic = 0x65735546;
+
+		struct statfs fileSystemStatus {};
+		if (::fstatfs(m_fileDescriptor, &fileSystemStatus) != 0)
+		{
+			return false;
+		}
+
+		const long type = static_cast<long>(fileSystemStatus.f_type);
+		return type == NfsSuperMagic || type == SmbSuperMagic || type == CifsSuperMagic || type == Smb2SuperMagic || type == FuseSuperMagic;
+	}
+
+	std::string ToUtf8Path(const wchar_t* path)
+	{
+		// Windows以外のwchar_tはUTF-32
+		std::string result;
+		for (const wchar_t* it = path; *it != L'\0'; ++it)
+		{
+			const auto codePoint = static_cast<char32_t>(*it);
+			if (codePoint < 0x80)
+			{
+				result += static_cast<char>(codePoint);
+			}
+			else if (codePoint < 0x800)
+			{
+				result += static_cast<char>(0xC0 | (codePoint >> 6));
+				result += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+			else if (codePoint < 0x10000)
+			{
+				result += static_cast<char>(0xE0 | (codePoint >> 12));
+				result += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				result += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+			else
+			{
+				result += static_cast<char>(0xF0 | (codePoint >> 18));
+				result += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+				result += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				result += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+		}
+
+		return result;
+	}
+
+	bool GetFileStatus(const wchar_t* path, FileStatus& status)
+	{
+		return GetFileStatus(ToUtf8Path(path), status);
+	}
+
+	bool GetFileStatus(const std::string& path, FileStatus& status)
+	{
+		struct stat fileStatus {};
+		if (::stat(path.c_str(), &fileStatus) != 0)
+		{
+			return false;
+		}
+
+		status.lastWriteTime = static_cast<long long>(fileStatus.st_mtim.tv_sec) * 1000000000LL + fileStatus.st_mtim.tv_nsec;
+		status.length = static_cast<unsigned long long>(fileStatus.st_size);
+		return true;
+	}
+#endif
+}
@@ -0,0 +1,159 @@
+﻿/*!
+ * @file	MappedFile.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Kchary::ImageController::IO
+{
+	/*!
+	 * @brief ファイルの読み方
+	 */
+	enum class AccessPattern
+	{
+		Sequential,		//!< 先頭から順に読む(OSへ先読みを指示する)
+		Random,			//!< 任意の位置を読む(先読みせず、他のハンドルからの追記・置き換えを許可する)
+	};
+
+	/*!
+	 * @brief ファイルの更新日時とサイズ
+	 */
+	struct FileStatus
+	{
+		long long lastWriteTime = 0;		//!< 最終更新日時(プラットフォーム固有の単位。比較にのみ使用する)
+		unsigned long long length = 0;		//!< ファイルサイズ
+	};
+
+	/*!
+	 * @brief 読み込み専用でメモリマップしたファイル
+	 * @note マップできないファイル(ネットワークドライブ上など)や小さいファイルは、一括読み込みにフォールバックする
+	 */
+	class MappedFile final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 */
+		MappedFile() = default;
+
+		/*!
+		 * @brief デストラクタ
+		 */
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/*!
+		 * @brief	ファイルを開く
+		 * @param	path			ファイルパス
+		 * @param	accessPattern	読み方(既定では先頭から順に読む前提でOSへ先読みを指示する)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Open(const wchar_t* path, AccessPattern accessPattern = AccessPattern::Sequential);
+
+		/*!
+		 * @brief	ファイルの先頭のみ読む前提でファイルを開く
+		 * @param	path			ファイルパス
+		 * @param	prefixSize		マップしない場合に先頭から読み込むバイト数
+		 * @param	accessPattern	読み方(既定ではヘッダーの読み取り用に任意の位置を読む前提で開く)
+		 * @return	成功: True, 失敗: False
+		 * @note	マップできるファイルはマップし、参照したページのみ読み込まれる。
+		 *			マップしないファイル(ネットワークドライブ上など)は先頭のみ読み込み、size()は読み込んだバイト数となる
+		 */
+		bool OpenPrefix(const wchar_t* path, size_t prefixSize, AccessPattern accessPattern = AccessPattern::Random);
+
+		/*!
+		 * @brief	先頭のみ読み込んでいる場合に、指定したバイト数まで読み足す(data()は変わる場合がある)
+		 * @param	prefixSize	先頭から読み込むバイト数(ファイルサイズを超える場合はファイル全体)
+		 * @return	読み足した: True, 読み足せない(マップ済み・全体を読み込み済み・読み込みの失敗): False
+		 */
+		bool ExtendPrefix(size_t prefixSize);
+
+		/*!
+		 * @brief	ファイルを閉じる
+		 */
+		void Close() noexcept;
+
+		const unsigned char* data() const noexcept { return m_data; }
+		size_t size() const noexcept { return m_size; }
+		size_t GetFileSize() const noexcept { return m_fileSize; }
+
+		/*!
+		 * @brief	メモリマップで開いているか
+		 * @return	メモリマップ: True, 一括読み込み: False
+		 */
+		bool IsMapped() const noexcept { return m_isMapped; }
+
+	private:
+		/*!
+		 * @brief	ファイルを開き、マップする(マップしない場合は先頭から指定バイト数を読み込む)
+		 * @param	path			ファイルパス
+		 * @param	accessPattern	読み方
+		 * @param	readLimit		マップしない場合に読み込むバイト数
+		 * @return	成功: True, 失敗: False
+		 */
+		bool OpenFile(const wchar_t* path, AccessPattern accessPattern, size_t readLimit);
+
+		/*!
+		 * @brief	開いたファイルをメモリマップする
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Map();
+
+		/*!
+		 * @brief	開いたファイルの続きをバッファへ順に読み込む
+		 * @param	size	読み込み後のバイト数(ファイルサイズ以下)
+		 * @return	成功: True, 失敗: False(読み込み済みの範囲は保たれる)
+		 */
+		bool ReadTo(size_t size);
+
+		/*!
+		 * @brief	開いたファイルがネットワーク上にあるか
+		 * @return	ネットワーク上: True, ローカル: False
+		 */
+		bool IsRemoteFile() const;
+
+		const unsigned char* m_data = nullptr;		//!< ファイル内容の先頭
+		size_t m_size = 0;							//!< 参照できるバイト数(マップした場合・全体を読み込んだ場合はファイルサイズ)
+		size_t m_fileSize = 0;						//!< ファイルサイズ
+		bool m_isMapped = false;					//!< メモリマップしているか
+		AccessPattern m_accessPattern = AccessPattern::Sequential;	//!< 読み方
+		std::vector<unsigned char> m_readBuffer;	//!< フォールバック時の読み込みバッファ
+
+#ifdef _WIN32
+		void* m_fileHandle = nullptr;				//!< ファイルハンドル(HANDLE)
+		void* m_mappingHandle = nullptr;			//!< ファイルマッピングハンドル(HANDLE)
+#else
+		int m_fileDescriptor = -1;					//!< ファイルディスクリプタ
+#endif
+	};
+
+	/*!
+	 * @brief	ワイド文字列のパスをUTF-8へ変換する(Windows以外でファイルを開く際に使用する)
+	 * @param	path	ファイルパス
+	 * @return	UTF-8のファイルパス
+	 */
+	std::string ToUtf8Path(const wchar_t* path);
+
+	/*!
+	 * @brief	ファイルの更新日時とサイズを取得する(ファイルは開かない)
+	 * @param	path	ファイルパス
+	 * @param	status	更新日時とサイズ(out)
+	 * @return	成功: True, 失敗: False
+	 */
+	bool GetFileStatus(const wchar_t* path, FileStatus& status);
+
+	/*!
+	 * @brief	UTF-8のパスのファイルの更新日時とサイズを取得する(ファイルは開かない)
+	 * @param	path	UTF-8のファイルパス(ToUtf8Path()で変換したもの)
+	 * @param	status	更新日時とサイズ(out)
+	 * @return	成功: True, 失敗: False
+	 */
+	bool GetFileStatus(const std::string& path, FileStatus& status);
+}
@@ -5,98 +5,270 @@
 
 #include "pch.h"
 #include "NormalImageController.h"
-#include <fstream>              // std::ifstream
-#include <vector>               // std::vector
-#include <string>               // std::wstring, std::string
-#include <cstring>              // std::memcpy
+#include "DecodePlanner.h"
+#include "ImageDataWriter.h"
+#include "MappedFile.h"
+#include "PixelConverter.h"
+#include "CancellationToken.h"
 #include <algorithm>            // std::max
+#include <limits>               // std::numeric_limits
 
 namespace Kchary::ImageController::NormalImageControl
 {
-    bool NormalImageController::GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData)
+    using Diagnostics::DecodeStage;
+    using Diagnostics::DecodeStatistics;
+    using Diagnostics::ScopedStageTimer;
+
+    namespace
     {
-#ifdef _WIN32
-        std::ifstream file(path, std::ios::binary);
-#else
-        std::ifstream file(std::wstring_convert<std::codecvt_utf8<wchar_t>>{}.to_bytes(path), std::ios::binary);
-#endif
-        if (!file.is_open())
+        constexpr size_t HeaderPrefixSize = 64 * 1024;  //!< ヘッダーの読み取りで最初に読み込むバイト数(マップしないファイルのみ)
+
+        /*!
+         * @brief ヘッダーを読み取れるまでファイルの先頭を読み足しながら、ヘッダーを読み取る
+         * @param path 画像パス
+         * @param file ファイル(out。ヘッダーを読み取った範囲を読み込んだ状態で返す)
+         * @param header ヘッダー情報(out)
+         * @return 成功: True, 失敗: False
+         * @note ネットワーク上のファイルでもファイル全体は読み込まない。
+         *       先頭のAPPセグメントが大きいJPEG・IFDが後方にあるTIFFなど、読み込んだ範囲でヘッダーを読み取れない場合は4倍ずつ読み足す
+         */
+        bool ReadHeaderPrefix(const wchar_t* path, IO::MappedFile& file, Decode::ImageHeader& header)
         {
-            return false;
+            if (!file.OpenPrefix(path, HeaderPrefixSize))
+            {
+                return false;
+            }
+
+            while (!Decode::ReadImageHeader(file.data(), file.size(), header))
+            {
+                // ヘッダーが先頭に固定長で置かれる形式・未対応の形式は、読み足しても読み取れない
+                const bool canExtend = header.format == Diagnostics::ImageFormat::Jpeg || header.format == Diagnostics::ImageFormat::Tiff;
+                if (!canExtend || !file.ExtendPrefix(file.size() * 4))
+                {
+                    return false;
+                }
+            }
+
+            return true;
         }
 
-        file.seekg(0, std::ios::end);
-        const std::streamsize fileSize = file.tellg();
-        if (fileSize <= 0)
+        /*!
+         * @brief デコード結果をImageDataの画素形式(BGR・BGRA、8ビット・16ビット)にそろえる
+         * @param preserveAlpha アルファチャンネルを残すか(falseの場合はBGRにする)
+         * @param isHighBitDepth 16ビットを残すか(falseの場合は8ビットにする)
+         * @return そろえられない形式(符号付き整数など)の場合はfalse
+         */
+        bool NormalizePixelFormat(cv::Mat& image, bool preserveAlpha, bool isHighBitDepth)
+        {
+            if (image.type() == CV_8UC3)
+            {
+                return true;
+            }
+
+            switch (image.channels())
+            {
+            case 1:
+                cv::cvtColor(image, image, cv::COLOR_GRAY2BGR);
+                break;
+            case 2:
+                // グレースケール+アルファ
+                if (preserveAlpha)
+                {
+                    cv::Mat bgra(image.size(), CV_MAKETYPE(image.depth(), 4));
+                    const int fromTo[] = { 0, 0, 0, 1, 0, 2, 1, 3 };
+                    cv::mixChannels(&image, 1, &bgra, 1, fromTo, 4);
+                    image = bgra;
+                }
+                else
+                {
+                    cv::Mat gray;
+                    cv::extractChannel(image, gray, 0);
+                    cv::cvtColor(gray, image, cv::COLOR_GRAY2BGR);
+                }
+                break;
+            case 3:
+                break;
+            case 4:
+                if (!preserveAlpha)
+                {
+                    cv::cvtColor(image, image, cv::COLOR_BGRA2BGR);
+                }
+                break;
+            default:
+                return false;
+            }
+
+            switch (image.depth())
+            {
+            case CV_8U:
+                return true;
+            case CV_16U:
+                if (!isHighBitDepth)
+                {
+                    cv::Mat narrowed(image.size(), CV_MAKETYPE(CV_8U, image.channels()));
+                    if (!Simd::ConvertToDisplayFormat(image, narrowed))
+                    {
+                        return false;
+                    }
+                    image = narrowed;
+                }
+                return true;
+            case CV_32F:
+            case CV_64F:
+                // 浮動小数点(HDR・浮動小数点TIFF)は0～1を整数の範囲へ対応させる
+                image.convertTo(image, CV_MAKETYPE(isHighBitDepth ? CV_16U : CV_8U, image.channels()), isHighBitDepth ? 65535.0 : 255.0);
+                return true;
+            default:
+                return false;
+            }
+        }
+    }
+
+    NormalImageController::NormalImageController(std::shared_ptr<Memory::BufferPool> bufferPool, std::shared_ptr<DecodeStatistics> statistics)
+        : m_imageDataWriter(std::move(bufferPool))
+        , m_statistics(std::move(statistics))
+    {
+    }
+
+    bool NormalImageController::GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken)
+    {
+        // ファイルをメモリマップし、マップした領域をそのままデコーダーへ渡す
+        IO::MappedFile file;
+        {
+            ScopedStageTimer timer(*m_statistics, DecodeStage::FileOpen);
+            if (!file.Open(path) || file.size() > static_cast<size_t>((std::numeric_limits<int>::max)()))
+            {
+                return false;
+            }
+        }
+        m_statistics->AddBytesRead(file.size());
+
+        // cv::imdecodeは途中で中断できないため、デコードの前後で中断要求を確認する
+        if (Threading::IsCancelled(cancellationToken))
         {
             return false;
         }
-        file.seekg(0, std::ios::beg);
 
-        std::vector<unsigned char> buffer(static_cast<size_t>(fileSize));
-        if (!file.read(reinterpret_cast<char*>(buffer.data()), fileSize))
+        const cv::Mat buffer(1, static_cast<int>(file.size()), CV_8UC1, const_cast<unsigned char*>(file.data()));
+
+        // ヘッダーから元画像のサイズを読み取り、要求サイズを満たす範囲で最も小さい縮小デコードを選ぶ
+        // (ヘッダーを読めない場合は等倍でデコードし、デコード後の画像から縮小率を求める)
+        Decode::ImageHeader header;
+        const bool hasHeader = Decode::ReadImageHeader(file.data(), file.size(), header);
+        const auto plan = Decode::PlanDecode(header, imageReadSettings.isThumbnailMode ? imageReadSettings.resizeLongSideLength : 0);
+        if (metadata)
+        {
+            Decode::ReadImageMetadata(file.data(), file.size(), header, *metadata);
+        }
+
+        // EXIFの向きをヘッダーから読み取れる形式(JPEG・TIFF)と向きを指定された場合は、デコーダーには保存されている向きのまま出力させ、
+        // 向きは書き込み先への出力と同時に適用する(それ以外はデコーダーが向きを適用する)
+        const bool hasOrientation = hasHeader && (header.format == Diagnostics::ImageFormat::Jpeg || header.format == Diagnostics::ImageFormat::Tiff);
+        const bool isOrientationApplied = hasOrientation || imageReadSettings.orientation != 0;
+        const int orientation = isOrientationApplied ? Decode::ResolveOrientation(imageReadSettings.orientation, header.orientation) : 1;
+
+        // アルファチャンネルを残す場合はそのままの形式でデコードする(JPEGはアルファを持たないため通常どおり)。
+        // 16ビットを残す場合は深度を保ったままBGRでデコードし、どちらもデコード後にImageDataの画素形式へそろえる
+        const bool isUnchanged = imageReadSettings.preserveAlpha && !(hasHeader && header.format == Diagnostics::ImageFormat::Jpeg);
+        int imreadFlags = cv::IMREAD_UNCHANGED;
+        if (!isUnchanged)
+        {
+            imreadFlags = imageReadSettings.isHighBitDepth ? plan.imreadMode | cv::IMREAD_ANYDEPTH : plan.imreadMode;
+            imreadFlags = isOrientationApplied ? imreadFlags | cv::IMREAD_IGNORE_ORIENTATION : imreadFlags;
+        }
+
+        // 等倍で向きの適用・形式の変換が不要な場合は、ヘッダーのサイズで書き込み先を確保してデコーダーに直接出力させ、画素ごとの書き込みを1回にする
+        // (デコーダーが向きを適用した場合など、書き込み先と異なるサイズ・型で出力された場合は、デコーダーが確保した領域から書き込み先へコピーする)
+        const bool isDirectDecode = hasHeader && !isUnchanged && !imageReadSettings.isHighBitDepth && orientation == 1 && plan.scaleDenominator == 1
+            && (!imageReadSettings.isThumbnailMode || std::max(header.width, header.height) <= imageReadSettings.resizeLongSideLength);
+        cv::Mat output;
+        if (isDirectDecode && !m_imageDataWriter.PrepareOutput(imageData, header.height, header.width, CV_8UC3, output))
         {
             return false;
         }
 
-        const int imreadMode = imageReadSettings.isThumbnailMode
-            ? GetImreadMode(imageReadSettings.resizeLongSideLength)
-            : cv::IMREAD_COLOR;
+        // サイズと型が一致する場合、cv::imdecodeは再確保せずに渡したcv::Matの領域へデコードする
+        cv::Mat image = output;
+        {
+            ScopedStageTimer timer(*m_statistics, DecodeStage::ImageDecode);
+            cv::imdecode(buffer, imreadFlags, &image);
+        }
+        if (image.empty() || !NormalizePixelFormat(image, imageReadSettings.preserveAlpha, imageReadSettings.isHighBitDepth))
+        {
+            return false;
+        }
+        m_statistics->RecordDecode(header.format, DecodeStatistics::GetDecodeMode(plan.imreadMode));
 
-        cv::Mat image = cv::imdecode(buffer, imreadMode);
-        if (image.empty())
+        if (Threading::IsCancelled(cancellationToken))
         {
             return false;
         }
 
+        if (isDirectDecode && image.data == output.data)
+        {
+            return true;
+        }
+
+        double ratio = 1.0;
         if (imageReadSettings.isThumbnailMode)
         {
             const int longSide = std::max(image.cols, image.rows);
-            const double ratio = static_cast<double>(imageReadSettings.resizeLongSideLength) / longSide;
+            ratio = static_cast<double>(imageReadSettings.resizeLongSideLength) / longSide;
+        }
 
-            if (ratio < 1.0)
-            {
-                cv::Mat resized;
-                cv::resize(image, resized, cv::Size(), ratio, ratio, cv::INTER_AREA);
-                std::swap(image, resized);
-            }
+        bool result = false;
+        {
+            // リサイズする場合は、リサイズ結果を書き込み先へ直接出力する
+            const bool isResized = ratio < 1.0;
+            ScopedStageTimer timer(*m_statistics, isResized ? DecodeStage::Resize : DecodeStage::Copy);
+            result = isResized ? m_imageDataWriter.WriteResized(image, ratio, orientation, imageData) : m_imageDataWriter.Write(image, orientation, imageData);
         }
 
-        const size_t dataSize = image.total() * image.elemSize();
-        imageData.buffer.resize(dataSize); // バッファ確保
-        m_image = cv::Mat(image.rows, image.cols, image.type(), imageData.buffer.data(), image.step);
-        // 元画像データをコピー（Mat間コピーだと内部最適化が効く）
-        image.copyTo(m_image);
+        if (result)
+        {
+            m_statistics->AddBytesCopied(imageData.size);
+        }
 
-        imageData.size = static_cast<unsigned int>(dataSize);
-        imageData.stride = static_cast<int>(m_image.step);
-        imageData.width = m_image.cols;
-        imageData.height = m_image.rows;
+        return result;
+    }
 
+    bool NormalImageController::GetImageSize(const wchar_t* path, int& width, int& height)
+    {
+        // ヘッダーのみ参照するため、先頭のみ読み込む
+        IO::MappedFile file;
+        Decode::ImageHeader header;
+        if (!ReadHeaderPrefix(path, file, header))
+        {
+            return false;
+        }
+
+        width = header.IsTransposed() ? header.height : header.width;
+        height = header.IsTransposed() ? header.width : header.height;
         return true;
     }
 
-	cv::ImreadModes NormalImageController::GetImreadMode(const int resizeLongSideLength)
-	{
-		cv::ImreadModes imreadMode;
-
-		if (resizeLongSideLength <= 800)
-		{
-			imreadMode = cv::ImreadModes::IMREAD_REDUCED_COLOR_8;
-		}
-		else if (800 < resizeLongSideLength && resizeLongSideLength <= 1600)
-		{
-			imreadMode = cv::ImreadModes::IMREAD_REDUCED_COLOR_4;
-		}
-		else if (1600 < resizeLongSideLength && resizeLongSideLength <= 3200)
-		{
-			imreadMode = cv::ImreadModes::IMREAD_REDUCED_COLOR_2;
-		}
-		else
-		{
-			imreadMode = cv::ImreadModes::IMREAD_COLOR;
-		}
-
-		return imreadMode;
-	}
+    bool NormalImageController::GetImageMetadata(const wchar_t* path, ImageMetadata& metadata)
+    {
+        // ヘッダーとEXIFのみ参照するため、先頭のみ読み込む
+        IO::MappedFile file;
+        Decode::ImageHeader header;
+        if (!ReadHeaderPrefix(path, file, header))
+        {
+            return false;
+        }
+
+        // IFD・値が読み込んだ範囲の外にある場合(TIFF)は、参照先まで読み足して読み直す
+        size_t requiredSize = 0;
+        Decode::ReadImageMetadata(file.data(), file.size(), header, metadata, &requiredSize);
+        while (requiredSize > file.size() && file.ExtendPrefix((std::max)(requiredSize, file.size() * 2)))
+        {
+            if (!Decode::ReadImageHeader(file.data(), file.size(), header))
+            {
+                return false;
+            }
+            Decode::ReadImageMetadata(file.data(), file.size(), header, metadata, &requiredSize);
+        }
+
+        return true;
+    }
 }
\ No newline at end of file
@@ -6,6 +6,9 @@
 #pragma once
 
 #include "IImageController.h"
+#include "ImageDataWriter.h"
+#include "DecodeStatistics.h"
+#include <memory>
 #include <opencv2/opencv.hpp>
 
 namespace Kchary::ImageController::NormalImageControl
@@ -15,8 +18,10 @@ namespace Kchary::ImageController::NormalImageControl
 	public:
 		/*!
 		 * @brief コンストラクタ
+		 * @param bufferPool	画素バッファの貸し出し元
+		 * @param statistics	統計情報の記録先
 		 */
-		NormalImageController() = default;
+		NormalImageController(std::shared_ptr<Memory::BufferPool> bufferPool, std::shared_ptr<Diagnostics::DecodeStatistics> statistics);
 
 		/*!
 		* @brief デストラクタ
@@ -28,18 +33,33 @@ namespace Kchary::ImageController::NormalImageControl
 		 * @param	path							画像パス
 		 * @param	imageReadSettings	画像設定
 		 * @param	imageData				画像データ(out)
-		 * @return	成功: True, 失敗: False
+		 * @param	metadata				メタデータ(out。nullptrの場合は取得しない)
+		 * @param	cancellationToken		中断要求(nullptrの場合は中断しない)
+		 * @return	成功: True, 失敗: False(中断した場合を含む)
+		 * @note	中断要求はファイルを開いた後とデコード後に確認する(cv::imdecodeの途中では中断できない)。
+		 *			メタデータはデコードのためにマップした領域のヘッダーとEXIFから読み取る
 		 */
-		bool GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData) override;
+		bool GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken) override;
 
-	private:
 		/*!
-		 * @brief    画像取得モード(OpenCV)を取得する
-		 * @param    resizeLongSideLength: リサイズする長辺の長さ
-		 * @return    ImreadModes
+		 * @brief	ヘッダーからデコード後の画像サイズを取得する
+		 * @param	path	画像パス
+		 * @param	width	幅(out。EXIFの向きを適用後)
+		 * @param	height	高さ(out。EXIFの向きを適用後)
+		 * @return	成功: True, 失敗: False(ヘッダーを読めない形式)
 		 */
-		static cv::ImreadModes GetImreadMode(const int resizeLongSideLength);
+		bool GetImageSize(const wchar_t* path, int& width, int& height) override;
 
-		cv::Mat m_image;	//!< 画像
+		/*!
+		 * @brief	ヘッダーとEXIFからメタデータを取得する
+		 * @param	path		画像パス
+		 * @param	metadata	メタデータ(out)
+		 * @return	成功: True, 失敗: False(ヘッダーを読めない形式)
+		 */
+		bool GetImageMetadata(const wchar_t* path, ImageMetadata& metadata) override;
+
+	private:
+		Common::ImageDataWriter m_imageDataWriter;	//!< 画像データの書き込み
+		std::shared_ptr<Diagnostics::DecodeStatistics> m_statistics;	//!< 統計情報の記録先
 	};
 }
\ No newline at end of file
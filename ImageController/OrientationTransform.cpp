@@ -0,0 +1,277 @@
+/*!
+ * @file	OrientationTransform.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "OrientationTransform.h"
+#include "SimdSupport.h"
+#include <algorithm>	// std::min
+#include <cstddef>		// std::ptrdiff_t
+#include <cstdint>		// std::uint8_t
+#include <cstring>		// std::memcpy
+
+namespace Kchary::ImageController::Simd
+{
+	namespace
+	{
+		constexpr int BlockSize = 32;	//!< 転置するブロックの一辺の画素数(8bit 3chで入出力合わせて6KB)
+
+		/*!
+		 * @brief 書き込み先の画素に対応する入力の画素の位置
+		 * @note 書き込み先の(x, y)の画素は、入力のorigin + x * columnStep + y * rowStepにある
+		 */
+		struct SourceWalk
+		{
+			const std::uint8_t* origin;		//!< 書き込み先の左上の画素に対応する入力の画素
+			std::ptrdiff_t columnStep;		//!< 書き込み先で右へ1画素進んだときの入力の移動量(Byte)
+			std::ptrdiff_t rowStep;			//!< 書き込み先で下へ1画素進んだときの入力の移動量(Byte)
+		};
+
+		SourceWalk GetSourceWalk(const cv::Mat& source, int orientation) noexcept
+		{
+			const auto pixelSize = static_cast<std::ptrdiff_t>(source.elemSize());
+			const auto lineStep = static_cast<std::ptrdiff_t>(source.step[0]);
+			const auto lastColumn = static_cast<std::ptrdiff_t>(source.cols - 1) * pixelSize;
+			const auto lastRow = static_cast<std::ptrdiff_t>(source.rows - 1) * lineStep;
+			const std::uint8_t* data = source.data;
+
+			switch (orientation)
+			{
+			case 2:		// 左右反転
+				return { data + lastColumn, -pixelSize, lineStep };
+			case 3:		// 180度回転
+				return { data + lastRow + lastColumn, -pixelSize, -lineStep };
+			case 4:		// 上下反転
+				return { data + lastRow, pixelSize, -lineStep };
+			case 5:		// 転置
+				return { data, lineStep, pixelSize };
+			case 6:		// 時計回りに90度回転
+				return { data + lastRow, -lineStep, pixelSize };
+			case 7:		// 反転置
+				return { data + lastRow + lastColumn, -lineStep, -pixelSize };
+			case 8:		// 反時計回りに90度回転
+				return { data + lastColumn, lineStep, -pixelSize };
+			default:
+				return { data, pixelSize, lineStep };
+			}
+		}
+
+		/*!
+		 * @brief	書き込み先の矩形を1画素ずつ入力から複写する
+		 * @param	pixelSize	1画素のバイト数(定数を渡すとmemcpyが展開される)
+		 */
+		inline void CopyBlockScalar(const SourceWalk& walk, cv::Mat& destination, int x, int y, int width, int height, size_t pixelSize) noexcept
+		{
+			for (int row = y; row < y + height; ++row)
+			{
+				const std::uint8_t* source = walk.origin + row * walk.rowStep + x * walk.columnStep;
+				std::uint8_t* output = destination.ptr<std::uint8_t>(row) + x * pixelSize;
+				for (int column = 0; column < width; ++column)
+				{
+					std::memcpy(output + column * pixelSize, source + column * walk.columnStep, pixelSize);
+				}
+			}
+		}
+
+#if defined(KCHARY_SIMD_X86)
+		/*!
+		 * @brief	1画素4Byteの4×4画素をレジスタ上で転置して書き込む
+		 * @note	入力の4行(書き込み先の4列)を読み込み、入力の行内で逆順に並ぶ向きは要素を反転してから転置する
+		 */
+		inline void TransposeBlock4x4(const SourceWalk& walk, cv::Mat& destination, int x, int y) noexcept
+		{
+			const bool isReversed = walk.rowStep < 0;
+			const std::uint8_t* source = walk.origin + x * walk.columnStep + (isReversed ? y + 3 : y) * walk.rowStep;
+
+			__m128i rows[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				rows[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * walk.columnStep));
+				if (isReversed)
+				{
+					rows[i] = _mm_shuffle_epi32(rows[i], _MM_SHUFFLE(0, 1, 2, 3));
+				}
+			}
+
+			const __m128i low01 = _mm_unpacklo_epi32(rows[0], rows[1]);
+			const __m128i low23 = _mm_unpacklo_epi32(rows[2], rows[3]);
+			const __m128i high01 = _mm_unpackhi_epi32(rows[0], rows[1]);
+			const __m128i high23 = _mm_unpackhi_epi32(rows[2], rows[3]);
+
+			const __m128i columns[4] = {
+				_mm_unpacklo_epi64(low01, low23),
+				_mm_unpackhi_epi64(low01, low23),
+				_mm_unpacklo_epi64(high01, high23),
+				_mm_unpackhi_epi64(high01, high23),
+			};
+			for (int j = 0; j < 4; ++j)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destination.ptr<std::uint8_t>(y + j) + x * 4), columns[j]);
+			}
+		}
+#elif defined(KCHARY_SIMD_NEON)
+		inline void TransposeBlock4x4(const SourceWalk& walk, cv::Mat& destination, int x, int y) noexcept
+		{
+			const bool isReversed = walk.rowStep < 0;
+			const std::uint8_t* source = walk.origin + x * walk.columnStep + (isReversed ? y + 3 : y) * walk.rowStep;
+
+			uint32x4_t rows[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				rows[i] = vld1q_u32(reinterpret_cast<const std::uint32_t*>(source + i * walk.columnStep));
+				if (isReversed)
+				{
+					const uint32x4_t swapped = vrev64q_u32(rows[i]);
+					rows[i] = vextq_u32(swapped, swapped, 2);
+				}
+			}
+
+			const uint32x4x2_t pair01 = vtrnq_u32(rows[0], rows[1]);
+			const uint32x4x2_t pair23 = vtrnq_u32(rows[2], rows[3]);
+
+			const uint32x4_t columns[4] = {
+				vcombine_u32(vget_low_u32(pair01.val[0]), vget_low_u32(pair23.val[0])),
+				vcombine_u32(vget_low_u32(pair01.val[1]), vget_low_u32(pair23.val[1])),
+				vcombine_u32(vget_high_u32(pair01.val[0]), vget_high_u32(pair23.val[0])),
+				vcombine_u32(vget_high_u32(pair01.val[1]), vget_high_u32(pair23.val[1])),
+			};
+			for (int j = 0; j < 4; ++j)
+			{
+				vst1q_u32(reinterpret_cast<std::uint32_t*>(destination.ptr<std::uint8_t>(y + j) + x * 4), columns[j]);
+			}
+		}
+#endif
+
+		/*!
+		 * @brief	書き込み先の矩形を入力から複写する
+		 * @note	1画素4Byteで幅と高さが入れ替わる向きは4×4画素単位でSIMD処理し、端数を1画素ずつ処理する
+		 */
+		template <size_t PixelSize, bool IsTransposed>
+		void CopyBlock(const SourceWalk& walk, cv::Mat& destination, int x, int y, int width, int height) noexcept
+		{
+#if defined(KCHARY_SIMD_X86) || defined(KCHARY_SIMD_NEON)
+			if constexpr (PixelSize == 4 && IsTransposed)
+			{
+				const int groupWidth = width & ~3;
+				const int groupHeight = height & ~3;
+				for (int row = y; row < y + groupHeight; row += 4)
+				{
+					for (int column = x; column < x + groupWidth; column += 4)
+					{
+						TransposeBlock4x4(walk, destination, column, row);
+					}
+				}
+
+				CopyBlockScalar(walk, destination, x + groupWidth, y, width - groupWidth, groupHeight, PixelSize);
+				CopyBlockScalar(walk, destination, x, y + groupHeight, width, height - groupHeight, PixelSize);
+			}
+			else
+#endif
+			{
+				CopyBlockScalar(walk, destination, x, y, width, height, PixelSize);
+			}
+		}
+
+		/*!
+		 * @brief	書き込み先をブロックに分割して入力から複写する
+		 * @param	blockWidth	ブロックの幅
+		 * @param	blockHeight	ブロックの高さ
+		 */
+		template <size_t PixelSize, bool IsTransposed>
+		void CopyBlocks(const SourceWalk& walk, cv::Mat& destination, int blockWidth, int blockHeight) noexcept
+		{
+			for (int y = 0; y < destination.rows; y += blockHeight)
+			{
+				const int height = (std::min)(blockHeight, destination.rows - y);
+				for (int x = 0; x < destination.cols; x += blockWidth)
+				{
+					CopyBlock<PixelSize, IsTransposed>(walk, destination, x, y, (std::min)(blockWidth, destination.cols - x), height);
+				}
+			}
+		}
+
+		/*!
+		 * @brief	幅と高さが入れ替わらない向き(1～4)を行単位で複写する
+		 */
+		template <size_t PixelSize>
+		void CopyRows(const SourceWalk& walk, cv::Mat& destination) noexcept
+		{
+			if (walk.columnStep > 0)
+			{
+				// 左右が反転しない場合は行をそのまま複写する
+				const size_t rowSize = static_cast<size_t>(destination.cols) * PixelSize;
+				for (int y = 0; y < destination.rows; ++y)
+				{
+					std::memcpy(destination.ptr<std::uint8_t>(y), walk.origin + y * walk.rowStep, rowSize);
+				}
+				return;
+			}
+
+			CopyBlocks<PixelSize, false>(walk, destination, destination.cols, 1);
+		}
+
+		template <size_t PixelSize>
+		void Transform(const SourceWalk& walk, bool isTransposed, cv::Mat& destination) noexcept
+		{
+			if (isTransposed)
+			{
+				CopyBlocks<PixelSize, true>(walk, destination, BlockSize, BlockSize);
+			}
+			else
+			{
+				CopyRows<PixelSize>(walk, destination);
+			}
+		}
+	}
+
+	bool TransformOrientation(const cv::Mat& source, int orientation, cv::Mat& destination)
+	{
+		if (orientation < 1 || orientation > 8 || source.dims != 2 || destination.dims != 2 || source.type() != destination.type())
+		{
+			return false;
+		}
+
+		const bool isTransposed = orientation >= 5;
+		const int rows = isTransposed ? source.cols : source.rows;
+		const int cols = isTransposed ? source.rows : source.cols;
+		if (destination.rows != rows || destination.cols != cols)
+		{
+			return false;
+		}
+
+		if (source.empty())
+		{
+			return true;
+		}
+
+		const SourceWalk walk = GetSourceWalk(source, orientation);
+		switch (source.elemSize())
+		{
+		case 1:
+			Transform<1>(walk, isTransposed, destination);
+			break;
+		case 2:
+			Transform<2>(walk, isTransposed, destination);
+			break;
+		case 3:
+			Transform<3>(walk, isTransposed, destination);
+			break;
+		case 4:
+			Transform<4>(walk, isTransposed, destination);
+			break;
+		case 6:
+			Transform<6>(walk, isTransposed, destination);
+			break;
+		case 8:
+			Transform<8>(walk, isTransposed, destination);
+			break;
+		default:
+			// 頻度の低い型は画素のバイト数を実行時に渡して処理する
+			CopyBlockScalar(walk, destination, 0, 0, destination.cols, destination.rows, source.elemSize());
+			break;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,23 @@
+/*!
+ * @file	OrientationTransform.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Simd
+{
+	/*!
+	 * @brief	EXIFの向きに従って回転・反転しながら書き込み先へ出力する
+	 * @param	source		入力(ファイルに保存されている向き)
+	 * @param	orientation	EXIFの向き(1～8)
+	 * @param	destination	書き込み先(sourceと同じ型で、向きを適用後のサイズで確保済みであること。sourceと重なってはならない)
+	 * @return	成功: True, 失敗: False(向きの値・型・サイズの不一致)
+	 * @note	幅と高さが入れ替わる向き(5～8)は、入出力の双方がL1キャッシュに収まるブロック単位で転置する。
+	 *			1画素4Byteの画像はブロック内を4×4画素ずつSSE2・NEONのレジスタ上で転置する。
+	 *			いずれの向きも中間バッファを介さず、入力の各画素を1回だけ読んで書き込み先へ1回だけ書き込む
+	 */
+	bool TransformOrientation(const cv::Mat& source, int orientation, cv::Mat& destination);
+}
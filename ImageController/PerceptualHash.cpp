@@ -0,0 +1,102 @@
+/*!
+ * @file	PerceptualHash.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "PerceptualHash.h"
+#include "ImageDataWriter.h"
+#include <algorithm>	// std::nth_element
+#include <iterator>	// std::size
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Hashing
+{
+	namespace
+	{
+		constexpr int DifferenceHashWidth = 9;		//!< dHashを求める画像の幅(隣り合う8組の差を取る)
+		constexpr int DifferenceHashHeight = 8;		//!< dHashを求める画像の高さ
+		constexpr int PerceptualHashSize = 32;		//!< pHashを求める画像の一辺(DCTする)
+		constexpr int PerceptualHashBands = 8;		//!< pHashに使う低周波成分の一辺
+
+		/*!
+		 * @brief	dHashを計算する(各行で左の画素が右の画素より暗い場合に1とする)
+		 * @param	luminance	輝度画像(CV_8UC1)
+		 */
+		std::uint64_t ComputeDifferenceHash(const cv::Mat& luminance)
+		{
+			cv::Mat reduced;
+			cv::resize(luminance, reduced, cv::Size(DifferenceHashWidth, DifferenceHashHeight), 0, 0, cv::INTER_AREA);
+
+			std::uint64_t hash = 0;
+			for (int y = 0; y < DifferenceHashHeight; ++y)
+			{
+				const auto* row = reduced.ptr<std::uint8_t>(y);
+				for (int x = 0; x < DifferenceHashWidth - 1; ++x)
+				{
+					hash = (hash << 1) | (row[x] < row[x + 1] ? 1u : 0u);
+				}
+			}
+
+			return hash;
+		}
+
+		/*!
+		 * @brief	pHashを計算する(DCTの低周波成分が、直流成分を除いた中央値より大きい場合に1とする)
+		 * @param	luminance	輝度画像(CV_8UC1)
+		 */
+		std::uint64_t ComputePerceptualHash(const cv::Mat& luminance)
+		{
+			cv::Mat reduced;
+			cv::resize(luminance, reduced, cv::Size(PerceptualHashSize, PerceptualHashSize), 0, 0, cv::INTER_AREA);
+			reduced.convertTo(reduced, CV_32F);
+
+			cv::Mat frequency;
+			cv::dct(reduced, frequency);
+
+			float coefficients[PerceptualHashBands * PerceptualHashBands];
+			for (int y = 0; y < PerceptualHashBands; ++y)
+			{
+				const auto* row = frequency.ptr<float>(y);
+				std::copy(row, row + PerceptualHashBands, coefficients + y * PerceptualHashBands);
+			}
+
+			// 直流成分は画像全体の明るさのため、中央値の計算から除く
+			float sorted[PerceptualHashBands * PerceptualHashBands - 1];
+			std::copy(std::begin(coefficients) + 1, std::end(coefficients), sorted);
+			auto* const middle = sorted + std::size(sorted) / 2;
+			std::nth_element(std::begin(sorted), middle, std::end(sorted));
+			const float median = *middle;
+
+			std::uint64_t hash = 0;
+			for (const float coefficient : coefficients)
+			{
+				hash = (hash << 1) | (coefficient > median ? 1u : 0u);
+			}
+
+			return hash;
+		}
+	}
+
+	bool ComputeImageHash(const ImageData& imageData, ImageHash& imageHash)
+	{
+		const std::byte* data = imageData.destination ? imageData.destination : imageData.buffer.data();
+		const int type = Common::ToMatType(imageData.pixelFormat);
+		if (data == nullptr || imageData.width <= 0 || imageData.height <= 0 || imageData.stride < imageData.width * CV_ELEM_SIZE(type))
+		{
+			return false;
+		}
+
+		const cv::Mat image(imageData.height, imageData.width, type, const_cast<std::byte*>(data), static_cast<size_t>(imageData.stride));
+		cv::Mat luminance;
+		cv::cvtColor(image, luminance, CV_MAT_CN(type) == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+		if (luminance.depth() == CV_16U)
+		{
+			luminance.convertTo(luminance, CV_8U, 1.0 / 257.0);
+		}
+
+		imageHash.differenceHash = ComputeDifferenceHash(luminance);
+		imageHash.perceptualHash = ComputePerceptualHash(luminance);
+		return true;
+	}
+}
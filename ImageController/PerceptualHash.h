@@ -0,0 +1,30 @@
+/*!
+ * @file	PerceptualHash.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <bitset>
+#include <cstdint>
+
+namespace Kchary::ImageController::Hashing
+{
+	/*!
+	 * @brief	画像から画像ハッシュ(dHash・pHash)を計算する
+	 * @param	imageData	画像(BGR・BGRA、8bit・16bit。サムネイルなど縮小済みの画像を渡すと、ハッシュ用の縮小が軽くなる)
+	 * @param	imageHash	画像ハッシュ(out)
+	 * @return	成功: True, 失敗: False(画像が空・形式が異なる)
+	 * @note	いずれも輝度画像から求めるため、色調の変更・再圧縮・拡大縮小の影響を受けにくい
+	 */
+	bool ComputeImageHash(const ImageData& imageData, ImageHash& imageHash);
+
+	/*!
+	 * @brief	2つのハッシュのハミング距離(異なるビット数)を取得する
+	 */
+	inline int GetHammingDistance(std::uint64_t left, std::uint64_t right) noexcept
+	{
+		return static_cast<int>(std::bitset<64>(left ^ right).count());
+	}
+}
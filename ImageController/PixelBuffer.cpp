@@ -0,0 +1,82 @@
+﻿/*!
+ * @file	PixelBuffer.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "PixelBuffer.h"
+#include "BufferPool.h"
+#include <utility>		// std::exchange
+
+namespace Kchary::ImageController::Memory
+{
+	PixelBuffer::~PixelBuffer()
+	{
+		Release();
+	}
+
+	PixelBuffer::PixelBuffer(PixelBuffer&& other) noexcept
+		: m_data(std::exchange(other.m_data, nullptr))
+		, m_size(std::exchange(other.m_size, 0))
+		, m_capacity(std::exchange(other.m_capacity, 0))
+		, m_pool(std::move(other.m_pool))
+	{
+	}
+
+	PixelBuffer& PixelBuffer::operator=(PixelBuffer&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Release();
+			m_data = std::exchange(other.m_data, nullptr);
+			m_size = std::exchange(other.m_size, 0);
+			m_capacity = std::exchange(other.m_capacity, 0);
+			m_pool = std::move(other.m_pool);
+		}
+
+		return *this;
+	}
+
+	void PixelBuffer::Allocate(size_t size, const std::shared_ptr<BufferPool>& pool)
+	{
+		if (m_data && size <= m_capacity)
+		{
+			m_size = size;
+			return;
+		}
+
+		Release();
+		if (size == 0)
+		{
+			return;
+		}
+
+		const size_t capacity = BufferPool::GetSizeClass(size);
+		m_data = pool ? pool->Acquire(capacity) : BufferPool::AllocateBlock(capacity);
+		m_size = size;
+		m_capacity = capacity;
+		m_pool = pool;
+	}
+
+	void PixelBuffer::Release() noexcept
+	{
+		if (!m_data)
+		{
+			return;
+		}
+
+		if (m_pool)
+		{
+			m_pool->Return(m_data, m_capacity);
+		}
+		else
+		{
+			BufferPool::FreeBlock(m_data);
+		}
+
+		m_data = nullptr;
+		m_size = 0;
+		m_capacity = 0;
+		m_pool.reset();
+	}
+}
@@ -0,0 +1,72 @@
+﻿/*!
+ * @file	PixelBuffer.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace Kchary::ImageController::Memory
+{
+	class BufferPool;
+
+	/*!
+	 * @brief バッファプールの統計情報
+	 */
+	struct BufferPoolStatistics
+	{
+		size_t allocationCount;		//!< ヒープから確保した回数
+		size_t reuseCount;			//!< プールから再利用した回数
+		size_t cachedBytes;			//!< プールに保持しているバイト数
+	};
+
+	/*!
+	 * @brief 画素バッファ(BufferPoolから貸し出され、解放時にプールへ返却される)
+	 * @note 確保時にゼロ初期化を行わない
+	 */
+	class PixelBuffer final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 */
+		PixelBuffer() = default;
+
+		/*!
+		 * @brief デストラクタ(バッファをプールへ返却する)
+		 */
+		~PixelBuffer();
+
+		PixelBuffer(const PixelBuffer&) = delete;
+		PixelBuffer& operator=(const PixelBuffer&) = delete;
+		PixelBuffer(PixelBuffer&& other) noexcept;
+		PixelBuffer& operator=(PixelBuffer&& other) noexcept;
+
+		/*!
+		 * @brief	バッファを確保する(既存の内容は保持しない)
+		 * @param	size	必要なサイズ(Byte)
+		 * @param	pool	貸し出し元のプール(nullptrの場合はヒープから確保する)
+		 * @note	現在のバッファの容量が足りる場合は再確保しない
+		 */
+		void Allocate(size_t size, const std::shared_ptr<BufferPool>& pool);
+
+		/*!
+		 * @brief	バッファを解放する(プールへ返却する)
+		 */
+		void Release() noexcept;
+
+		std::byte* data() noexcept { return m_data; }
+		const std::byte* data() const noexcept { return m_data; }
+		size_t size() const noexcept { return m_size; }
+		size_t capacity() const noexcept { return m_capacity; }
+		bool empty() const noexcept { return m_size == 0; }
+
+	private:
+		std::byte* m_data = nullptr;			//!< バッファの先頭
+		size_t m_size = 0;						//!< 使用サイズ
+		size_t m_capacity = 0;					//!< 確保済みサイズ(サイズクラス)
+		std::shared_ptr<BufferPool> m_pool;		//!< 貸し出し元のプール
+	};
+}
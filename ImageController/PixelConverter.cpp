@@ -0,0 +1,281 @@
+﻿/*!
+ * @file	PixelConverter.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "PixelConverter.h"
+#include "SimdSupport.h"
+#include <array>		// std::array
+
+namespace Kchary::ImageController::Simd
+{
+	namespace
+	{
+		constexpr size_t BlockSize = 48;	//!< SIMD処理の単位(16Byte×3。8bitは16画素、16bitは8画素)
+
+		/*!
+		 * @brief	48Byteのブロック内で、R・Bを入れ替えた後の各バイトの入力位置を求める
+		 * @param	outputIndex		出力バイトの位置
+		 * @param	channelBytes	1チャンネルのバイト数(1または2)
+		 * @return	入力バイトの位置
+		 */
+		constexpr size_t GetSwappedSourceIndex(size_t outputIndex, size_t channelBytes) noexcept
+		{
+			const size_t pixelBytes = channelBytes * 3;
+			const size_t pixelOffset = outputIndex / pixelBytes * pixelBytes;
+			const size_t channel = outputIndex % pixelBytes / channelBytes;
+			return pixelOffset + (2 - channel) * channelBytes + outputIndex % channelBytes;
+		}
+
+		/*!
+		 * @brief 48Byteのブロックを並べ替えるシャッフルマスク
+		 * @note masks[k][v]は出力ベクトルkのうち入力ベクトルvから取り出すバイトを示す(対象外は0x80でゼロ)
+		 */
+		struct ShuffleMasks
+		{
+			alignas(16) std::array<std::array<std::array<std::int8_t, 16>, 3>, 3> masks{};
+		};
+
+		ShuffleMasks BuildShuffleMasks(size_t channelBytes) noexcept
+		{
+			ShuffleMasks result;
+			for (size_t k = 0; k < 3; ++k)
+			{
+				for (size_t v = 0; v < 3; ++v)
+				{
+					for (size_t j = 0; j < 16; ++j)
+					{
+						const size_t sourceIndex = GetSwappedSourceIndex(k * 16 + j, channelBytes);
+						result.masks[k][v][j] = sourceIndex / 16 == v ? static_cast<std::int8_t>(sourceIndex % 16) : static_cast<std::int8_t>(0x80);
+					}
+				}
+			}
+
+			return result;
+		}
+
+		template <typename T>
+		void SwapRedBlueScalar(const T* source, T* destination, size_t pixelCount) noexcept
+		{
+			for (size_t i = 0; i < pixelCount; ++i)
+			{
+				destination[i * 3 + 0] = source[i * 3 + 2];
+				destination[i * 3 + 1] = source[i * 3 + 1];
+				destination[i * 3 + 2] = source[i * 3 + 0];
+			}
+		}
+
+#ifdef KCHARY_SIMD_X86
+		/*!
+		 * @brief	48Byte単位でシャッフルし、処理したバイト数を返す
+		 */
+		KCHARY_TARGET_SSSE3
+		size_t ShuffleBlocksSsse3(const std::uint8_t* source, std::uint8_t* destination, size_t byteCount, const ShuffleMasks& shuffleMasks) noexcept
+		{
+			__m128i masks[3][3];
+			for (int k = 0; k < 3; ++k)
+			{
+				for (int v = 0; v < 3; ++v)
+				{
+					masks[k][v] = _mm_load_si128(reinterpret_cast<const __m128i*>(shuffleMasks.masks[k][v].data()));
+				}
+			}
+
+			size_t offset = 0;
+			for (; offset + BlockSize <= byteCount; offset += BlockSize)
+			{
+				const __m128i input0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + offset));
+				const __m128i input1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + offset + 16));
+				const __m128i input2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + offset + 32));
+
+				// 各出力ベクトルは隣接する入力ベクトルからのみバイトを取り出す
+				const __m128i output0 = _mm_or_si128(_mm_shuffle_epi8(input0, masks[0][0]), _mm_shuffle_epi8(input1, masks[0][1]));
+				const __m128i output1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(input0, masks[1][0]), _mm_shuffle_epi8(input1, masks[1][1])), _mm_shuffle_epi8(input2, masks[1][2]));
+				const __m128i output2 = _mm_or_si128(_mm_shuffle_epi8(input1, masks[2][1]), _mm_shuffle_epi8(input2, masks[2][2]));
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + offset), output0);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + offset + 16), output1);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + offset + 32), output2);
+			}
+
+			return offset;
+		}
+
+		/*!
+		 * @brief	16bit/chの値を32個ずつ8bit/chに変換し、処理した値の数を返す
+		 */
+		KCHARY_TARGET_AVX2
+		size_t Narrow16To8Avx2(const std::uint16_t* source, std::uint8_t* destination, size_t valueCount) noexcept
+		{
+			const __m256i half = _mm256_set1_epi16(128);
+			size_t offset = 0;
+			for (; offset + 32 <= valueCount; offset += 32)
+			{
+				// (x + 128 - ((x + 128) >> 8)) >> 8 はround(x / 257)と一致する(65408以上で飽和しても結果は255のまま)
+				const __m256i low = _mm256_adds_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + offset)), half);
+				const __m256i high = _mm256_adds_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + offset + 16)), half);
+				const __m256i narrowedLow = _mm256_srli_epi16(_mm256_sub_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+				const __m256i narrowedHigh = _mm256_srli_epi16(_mm256_sub_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+
+				// packusは128bitのレーンごとに詰めるため、64bit単位で並べ直す
+				const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(narrowedLow, narrowedHigh), _MM_SHUFFLE(3, 1, 2, 0));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + offset), packed);
+			}
+
+			return offset;
+		}
+
+		/*!
+		 * @brief	16bit/chの値を16個ずつ8bit/chに変換し、処理した値の数を返す
+		 */
+		size_t Narrow16To8Sse2(const std::uint16_t* source, std::uint8_t* destination, size_t valueCount) noexcept
+		{
+			const __m128i half = _mm_set1_epi16(128);
+			size_t offset = 0;
+			for (; offset + 16 <= valueCount; offset += 16)
+			{
+				const __m128i low = _mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + offset)), half);
+				const __m128i high = _mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + offset + 8)), half);
+				const __m128i narrowedLow = _mm_srli_epi16(_mm_sub_epi16(low, _mm_srli_epi16(low, 8)), 8);
+				const __m128i narrowedHigh = _mm_srli_epi16(_mm_sub_epi16(high, _mm_srli_epi16(high, 8)), 8);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + offset), _mm_packus_epi16(narrowedLow, narrowedHigh));
+			}
+
+			return offset;
+		}
+#endif
+	}
+
+	bool ConvertRgbToBgr(const cv::Mat& source, cv::Mat& destination)
+	{
+		if (source.empty() || source.channels() != 3 || source.type() != destination.type() || source.size() != destination.size())
+		{
+			return false;
+		}
+
+		const bool is16Bit = source.depth() == CV_16U;
+		if (!is16Bit && source.depth() != CV_8U)
+		{
+			return false;
+		}
+
+		const auto width = static_cast<size_t>(source.cols);
+		for (int y = 0; y < source.rows; ++y)
+		{
+			if (is16Bit)
+			{
+				SwapRedBlue16(source.ptr<std::uint16_t>(y), destination.ptr<std::uint16_t>(y), width);
+			}
+			else
+			{
+				SwapRedBlue8(source.ptr<std::uint8_t>(y), destination.ptr<std::uint8_t>(y), width);
+			}
+		}
+
+		return true;
+	}
+
+	void SwapRedBlue8(const std::uint8_t* source, std::uint8_t* destination, size_t pixelCount) noexcept
+	{
+		size_t processedCount = 0;
+
+#if defined(KCHARY_SIMD_X86)
+		if (HasSsse3())
+		{
+			static const ShuffleMasks shuffleMasks = BuildShuffleMasks(1);
+			processedCount = ShuffleBlocksSsse3(source, destination, pixelCount * 3, shuffleMasks) / 3;
+		}
+#elif defined(KCHARY_SIMD_NEON)
+		for (; processedCount + 16 <= pixelCount; processedCount += 16)
+		{
+			uint8x16x3_t pixels = vld3q_u8(source + processedCount * 3);
+			const uint8x16_t red = pixels.val[0];
+			pixels.val[0] = pixels.val[2];
+			pixels.val[2] = red;
+			vst3q_u8(destination + processedCount * 3, pixels);
+		}
+#endif
+
+		SwapRedBlueScalar(source + processedCount * 3, destination + processedCount * 3, pixelCount - processedCount);
+	}
+
+	void SwapRedBlue16(const std::uint16_t* source, std::uint16_t* destination, size_t pixelCount) noexcept
+	{
+		size_t processedCount = 0;
+
+#if defined(KCHARY_SIMD_X86)
+		if (HasSsse3())
+		{
+			static const ShuffleMasks shuffleMasks = BuildShuffleMasks(2);
+			const size_t processedBytes = ShuffleBlocksSsse3(reinterpret_cast<const std::uint8_t*>(source), reinterpret_cast<std::uint8_t*>(destination), pixelCount * 6, shuffleMasks);
+			processedCount = processedBytes / 6;
+		}
+#elif defined(KCHARY_SIMD_NEON)
+		for (; processedCount + 8 <= pixelCount; processedCount += 8)
+		{
+			uint16x8x3_t pixels = vld3q_u16(source + processedCount * 3);
+			const uint16x8_t red = pixels.val[0];
+			pixels.val[0] = pixels.val[2];
+			pixels.val[2] = red;
+			vst3q_u16(destination + processedCount * 3, pixels);
+		}
+#endif
+
+		SwapRedBlueScalar(source + processedCount * 3, destination + processedCount * 3, pixelCount - processedCount);
+	}
+
+	bool ConvertToDisplayFormat(const cv::Mat& source, cv::Mat& destination)
+	{
+		const int channels = source.channels();
+		if (source.empty() || (channels != 3 && channels != 4) || destination.type() != CV_MAKETYPE(CV_8U, channels) || source.size() != destination.size())
+		{
+			return false;
+		}
+
+		if (source.depth() == CV_8U)
+		{
+			source.copyTo(destination);
+			return true;
+		}
+
+		if (source.depth() != CV_16U)
+		{
+			return false;
+		}
+
+		const size_t valueCount = static_cast<size_t>(source.cols) * channels;
+		for (int y = 0; y < source.rows; ++y)
+		{
+			Narrow16To8(source.ptr<std::uint16_t>(y), destination.ptr<std::uint8_t>(y), valueCount);
+		}
+
+		return true;
+	}
+
+	void Narrow16To8(const std::uint16_t* source, std::uint8_t* destination, size_t valueCount) noexcept
+	{
+		size_t processedCount = 0;
+
+#if defined(KCHARY_SIMD_X86)
+		processedCount = HasAvx2() ? Narrow16To8Avx2(source, destination, valueCount) : 0;
+		processedCount += Narrow16To8Sse2(source + processedCount, destination + processedCount, valueCount - processedCount);
+#elif defined(KCHARY_SIMD_NEON)
+		const uint16x8_t half = vdupq_n_u16(128);
+		for (; processedCount + 16 <= valueCount; processedCount += 16)
+		{
+			const uint16x8_t low = vqaddq_u16(vld1q_u16(source + processedCount), half);
+			const uint16x8_t high = vqaddq_u16(vld1q_u16(source + processedCount + 8), half);
+			const uint8x8_t narrowedLow = vshrn_n_u16(vsubq_u16(low, vshrq_n_u16(low, 8)), 8);
+			const uint8x8_t narrowedHigh = vshrn_n_u16(vsubq_u16(high, vshrq_n_u16(high, 8)), 8);
+			vst1q_u8(destination + processedCount, vcombine_u8(narrowedLow, narrowedHigh));
+		}
+#endif
+
+		for (size_t i = processedCount; i < valueCount; ++i)
+		{
+			const unsigned int value = source[i] + 128u;
+			destination[i] = static_cast<std::uint8_t>((value - (value >> 8)) >> 8);
+		}
+	}
+}
@@ -0,0 +1,55 @@
+﻿/*!
+ * @file	PixelConverter.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Simd
+{
+	/*!
+	 * @brief	RGB順の画像をBGR順に並べ替えながら書き込み先へ出力する
+	 * @param	source		RGB順の画像(CV_8UC3またはCV_16UC3)
+	 * @param	destination	書き込み先(sourceと同じサイズ・型で確保済みであること。sourceと重なってはならない)
+	 * @return	成功: True, 失敗: False(型・サイズの不一致)
+	 * @note	SSSE3/NEONが使用できる場合はSIMD命令で処理する
+	 */
+	bool ConvertRgbToBgr(const cv::Mat& source, cv::Mat& destination);
+
+	/*!
+	 * @brief	8bit 3chの画素列の1番目と3番目のチャンネルを入れ替える
+	 * @param	source		入力
+	 * @param	destination	出力(sourceと重なってはならない)
+	 * @param	pixelCount	画素数
+	 */
+	void SwapRedBlue8(const std::uint8_t* source, std::uint8_t* destination, size_t pixelCount) noexcept;
+
+	/*!
+	 * @brief	16bit 3chの画素列の1番目と3番目のチャンネルを入れ替える
+	 * @param	source		入力
+	 * @param	destination	出力(sourceと重なってはならない)
+	 * @param	pixelCount	画素数
+	 */
+	void SwapRedBlue16(const std::uint16_t* source, std::uint16_t* destination, size_t pixelCount) noexcept;
+
+	/*!
+	 * @brief	表示用の8bit/chへ変換しながら書き込み先へ出力する
+	 * @param	source		入力(CV_8UC3・CV_8UC4・CV_16UC3・CV_16UC4)
+	 * @param	destination	書き込み先(sourceと同じサイズ・チャンネル数の8bit/chで確保済みであること。sourceと重なってはならない)
+	 * @return	成功: True, 失敗: False(型・サイズの不一致)
+	 * @note	8bit/chの入力はそのまま複写する。16bit/chの入力はAVX2/SSE2/NEONで1命令あたり16～32個の値を変換する
+	 */
+	bool ConvertToDisplayFormat(const cv::Mat& source, cv::Mat& destination);
+
+	/*!
+	 * @brief	16bit/chの値の列を8bit/chに変換する(257で割って四捨五入する。0→0、65535→255)
+	 * @param	source		入力
+	 * @param	destination	出力
+	 * @param	valueCount	値の数(画素数×チャンネル数)
+	 */
+	void Narrow16To8(const std::uint16_t* source, std::uint8_t* destination, size_t valueCount) noexcept;
+}
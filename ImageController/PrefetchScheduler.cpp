@@ -0,0 +1,464 @@
+/*!
+ * @file	PrefetchScheduler.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "PrefetchScheduler.h"
+#include <algorithm>	// std::max
+#include <chrono>
+#include <iostream>		// std::cerr
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Library
+{
+	PrefetchScheduler::PrefetchScheduler(IImageController& imageController, const PrefetchSettings& prefetchSettings)
+		: m_imageController(imageController)
+		, m_imageDataWriter(nullptr)
+		, m_prefetchSettings(prefetchSettings)
+		, m_thumbnailCancellationToken(std::make_shared<Threading::CancellationToken>())
+	{
+		// 表示中の画像をデコードするワーカーが先読みで埋まらないよう、既定では論理コア数の半分とする
+		unsigned int threadCount = prefetchSettings.threadCount;
+		if (threadCount == 0)
+		{
+			threadCount = (std::max)(1u, std::thread::hardware_concurrency() / 2);
+		}
+
+		m_workers.reserve(threadCount);
+		for (unsigned int i = 0; i < threadCount; ++i)
+		{
+			m_workers.emplace_back(&PrefetchScheduler::WorkerLoop, this);
+		}
+	}
+
+	PrefetchScheduler::~PrefetchScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isStopping = true;
+			for (auto& [index, frame] : m_frames)
+			{
+				frame.cancellationToken->Cancel();
+			}
+			m_thumbnailCancellationToken->Cancel();
+		}
+		m_jobAvailable.notify_all();
+		m_frameUpdated.notify_all();
+
+		for (auto& worker : m_workers)
+		{
+			if (worker.joinable())
+			{
+				worker.join();
+			}
+		}
+	}
+
+	void PrefetchScheduler::SetItems(std::vector<std::wstring> imagePaths, const ImageReadSettings& displaySettings)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (auto& [index, frame] : m_frames)
+			{
+				frame.cancellationToken->Cancel();
+			}
+			m_frames.clear();
+			m_cachedBytes = 0;
+			m_estimatedFrameBytes = 0;
+
+			for (auto& lane : m_lanes)
+			{
+				lane.clear();
+			}
+			m_thumbnailCancellationToken->Cancel();
+			m_thumbnailCancellationToken = std::make_shared<Threading::CancellationToken>();
+
+			m_imagePaths = std::move(imagePaths);
+			m_displaySettings = displaySettings;
+			m_hasCurrentIndex = false;
+		}
+		m_frameUpdated.notify_all();
+	}
+
+	void PrefetchScheduler::SetCurrentIndex(size_t index)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (index >= m_imagePaths.size())
+			{
+				return;
+			}
+
+			m_currentIndex = index;
+			m_hasCurrentIndex = true;
+			DropStaleLocked();
+			ScheduleLocked();
+		}
+		m_jobAvailable.notify_all();
+		m_frameUpdated.notify_all();
+	}
+
+	bool PrefetchScheduler::GetFrame(size_t index, ImageData& imageData, unsigned int timeoutMilliseconds)
+	{
+		std::shared_ptr<const ImageData> frameData;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			auto found = m_frames.find(index);
+			if (found == m_frames.end())
+			{
+				return false;
+			}
+
+			if (found->second.state == FrameState::Ready)
+			{
+				++m_statistics.hitCount;
+			}
+			else
+			{
+				++m_statistics.missCount;
+			}
+
+			// 待っている間に現在位置が変わり、画像が破棄される場合がある
+			const bool isCompleted = m_frameUpdated.wait_for(lock, std::chrono::milliseconds(timeoutMilliseconds), [this, index]()
+				{
+					const auto frame = m_frames.find(index);
+					return frame == m_frames.end() || frame->second.state != FrameState::Decoding;
+				});
+
+			found = m_frames.find(index);
+			if (!isCompleted || found == m_frames.end() || found->second.state != FrameState::Ready)
+			{
+				return false;
+			}
+
+			frameData = found->second.imageData;
+		}
+
+		// 保持している画像は破棄されるまで変更しないため、ロックを解放してからコピーする
+		// (向きはデコード時に適用済みのため、そのままコピーする)
+		const cv::Mat image(frameData->height, frameData->width, Common::ToMatType(frameData->pixelFormat), const_cast<std::byte*>(frameData->buffer.data()), static_cast<size_t>(frameData->stride));
+		return m_imageDataWriter.Write(image, 1, imageData);
+	}
+
+	void PrefetchScheduler::RequestThumbnails(const std::vector<size_t>& indices, const ImageReadSettings& thumbnailSettings, ImageReader::ImageDataCallback callback)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			const auto sharedCallback = std::make_shared<ImageReader::ImageDataCallback>(std::move(callback));
+			auto& lane = m_lanes[static_cast<size_t>(Lane::Background)];
+			for (const size_t index : indices)
+			{
+				if (index >= m_imagePaths.size())
+				{
+					continue;
+				}
+
+				Job job;
+				job.lane = Lane::Background;
+				job.index = index;
+				job.path = m_imagePaths[index];
+				job.imageReadSettings = thumbnailSettings;
+				job.cancellationToken = m_thumbnailCancellationToken;
+				job.callback = sharedCallback;
+				lane.push_back(std::move(job));
+			}
+		}
+		m_jobAvailable.notify_all();
+	}
+
+	void PrefetchScheduler::CancelThumbnails()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_lanes[static_cast<size_t>(Lane::Background)].clear();
+		m_thumbnailCancellationToken->Cancel();
+		m_thumbnailCancellationToken = std::make_shared<Threading::CancellationToken>();
+	}
+
+	PrefetchStatistics PrefetchScheduler::GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		PrefetchStatistics statistics = m_statistics;
+		statistics.frameCount = 0;
+		for (const auto& [index, frame] : m_frames)
+		{
+			if (frame.state == FrameState::Ready)
+			{
+				++statistics.frameCount;
+			}
+		}
+		statistics.cachedBytes = m_cachedBytes;
+		return statistics;
+	}
+
+	void PrefetchScheduler::WorkerLoop()
+	{
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_jobAvailable.wait(lock, [this]()
+					{
+						return m_isStopping || std::any_of(m_lanes.begin(), m_lanes.end(), [](const auto& lane) { return !lane.empty(); });
+					});
+				if (m_isStopping)
+				{
+					return;
+				}
+
+				// 優先度の高いレーンから順に取り出す
+				for (auto& lane : m_lanes)
+				{
+					if (!lane.empty())
+					{
+						job = std::move(lane.front());
+						lane.pop_front();
+						break;
+					}
+				}
+			}
+
+			if (job.lane == Lane::Background)
+			{
+				RunThumbnailJob(job);
+			}
+			else
+			{
+				RunFrameJob(job);
+			}
+		}
+	}
+
+	void PrefetchScheduler::RunFrameJob(const Job& job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			const auto found = m_frames.find(job.index);
+			if (found == m_frames.end() || found->second.cancellationToken != job.cancellationToken)
+			{
+				return;
+			}
+			found->second.isRunning = true;
+		}
+
+		auto imageData = std::make_shared<ImageData>();
+		bool result = false;
+		try
+		{
+			result = m_imageController.GetImageData(job.path.c_str(), job.imageReadSettings, *imageData, nullptr, job.cancellationToken.get());
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "PrefetchScheduler::RunFrameJob error: " << e.what() << std::endl;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			// 現在位置の変更で破棄された要求の結果は捨てる
+			const auto found = m_frames.find(job.index);
+			if (found == m_frames.end() || found->second.cancellationToken != job.cancellationToken)
+			{
+				return;
+			}
+
+			auto& frame = found->second;
+			if (!result)
+			{
+				if (job.cancellationToken->IsCancelled())
+				{
+					m_frames.erase(found);
+				}
+				else
+				{
+					frame.state = FrameState::Failed;
+				}
+			}
+			else
+			{
+				frame.state = FrameState::Ready;
+				frame.bytes = imageData->buffer.size();
+				frame.imageData = std::move(imageData);
+				m_cachedBytes += frame.bytes;
+				m_estimatedFrameBytes = frame.bytes;
+				++m_statistics.decodeCount;
+
+				// 1枚目のデコードでサイズの見込みが分かるため、上限に余裕があれば先読みを追加する
+				EvictLocked();
+				ScheduleLocked();
+			}
+		}
+		m_frameUpdated.notify_all();
+		m_jobAvailable.notify_all();
+	}
+
+	void PrefetchScheduler::RunThumbnailJob(const Job& job)
+	{
+		if (job.cancellationToken->IsCancelled())
+		{
+			return;
+		}
+
+		ImageData imageData{};
+		bool result = false;
+		try
+		{
+			result = m_imageController.GetImageData(job.path.c_str(), job.imageReadSettings, imageData, nullptr, job.cancellationToken.get());
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "PrefetchScheduler::RunThumbnailJob error: " << e.what() << std::endl;
+		}
+
+		if (!job.cancellationToken->IsCancelled() && *job.callback)
+		{
+			(*job.callback)(job.index, result, imageData);
+		}
+	}
+
+	void PrefetchScheduler::ScheduleLocked()
+	{
+		if (!m_hasCurrentIndex || m_isStopping)
+		{
+			return;
+		}
+
+		// 表示中の画像、後ろ1枚、前1枚、後ろ2枚…の順に要求する
+		std::vector<std::pair<size_t, Lane>> candidates;
+		candidates.emplace_back(m_currentIndex, Lane::Visible);
+		const size_t maxDistance = (std::max)(m_prefetchSettings.aheadCount, m_prefetchSettings.behindCount);
+		for (size_t distance = 1; distance <= maxDistance; ++distance)
+		{
+			if (distance <= m_prefetchSettings.aheadCount && m_currentIndex + distance < m_imagePaths.size())
+			{
+				candidates.emplace_back(m_currentIndex + distance, Lane::Prefetch);
+			}
+			if (distance <= m_prefetchSettings.behindCount && m_currentIndex >= distance)
+			{
+				candidates.emplace_back(m_currentIndex - distance, Lane::Prefetch);
+			}
+		}
+
+		// デコード中の画像も見込みのサイズで上限に含める(見込みが分からない間は1枚ずつ要求する)
+		const int longSideLength = m_displaySettings.resizeLongSideLength;
+		const size_t estimatedFrameBytes = m_estimatedFrameBytes > 0 ? m_estimatedFrameBytes
+			: longSideLength > 0 ? static_cast<size_t>(longSideLength) * longSideLength * 3 : 0;
+		size_t projectedBytes = m_cachedBytes;
+		bool isDecoding = false;
+		for (const auto& [index, frame] : m_frames)
+		{
+			if (frame.state == FrameState::Decoding)
+			{
+				projectedBytes += estimatedFrameBytes;
+				isDecoding = true;
+			}
+		}
+
+		for (const auto& [index, lane] : candidates)
+		{
+			if (m_frames.find(index) != m_frames.end())
+			{
+				continue;
+			}
+
+			if (lane == Lane::Prefetch)
+			{
+				const bool isUnknownSize = estimatedFrameBytes == 0;
+				if ((isUnknownSize && isDecoding) || (!isUnknownSize && projectedBytes + estimatedFrameBytes > m_prefetchSettings.memoryBudget))
+				{
+					break;
+				}
+			}
+
+			Frame frame;
+			frame.cancellationToken = std::make_shared<Threading::CancellationToken>();
+
+			Job job;
+			job.lane = lane;
+			job.index = index;
+			job.path = m_imagePaths[index];
+			job.imageReadSettings = m_displaySettings;
+			job.cancellationToken = frame.cancellationToken;
+
+			m_frames.emplace(index, std::move(frame));
+			m_lanes[static_cast<size_t>(lane)].push_back(std::move(job));
+			projectedBytes += estimatedFrameBytes;
+			isDecoding = true;
+		}
+	}
+
+	void PrefetchScheduler::DropStaleLocked()
+	{
+		m_lanes[static_cast<size_t>(Lane::Visible)].clear();
+		m_lanes[static_cast<size_t>(Lane::Prefetch)].clear();
+
+		for (auto frame = m_frames.begin(); frame != m_frames.end();)
+		{
+			const bool isInWindow = IsInWindowLocked(frame->first);
+			const bool isQueued = frame->second.state == FrameState::Decoding && !frame->second.isRunning;
+			if (isInWindow && !isQueued)
+			{
+				++frame;
+				continue;
+			}
+
+			if (!isInWindow)
+			{
+				++m_statistics.droppedCount;
+			}
+
+			// デコード中の要求は中断し、結果はRunFrameJob()で捨てる
+			frame->second.cancellationToken->Cancel();
+			m_cachedBytes -= frame->second.bytes;
+			frame = m_frames.erase(frame);
+		}
+	}
+
+	void PrefetchScheduler::EvictLocked()
+	{
+		while (m_cachedBytes > m_prefetchSettings.memoryBudget)
+		{
+			auto farthest = m_frames.end();
+			for (auto frame = m_frames.begin(); frame != m_frames.end(); ++frame)
+			{
+				// 表示中の画像は上限を超えても破棄しない
+				if (frame->second.state != FrameState::Ready || (m_hasCurrentIndex && frame->first == m_currentIndex))
+				{
+					continue;
+				}
+
+				if (farthest == m_frames.end() || GetDistanceLocked(frame->first) > GetDistanceLocked(farthest->first))
+				{
+					farthest = frame;
+				}
+			}
+
+			if (farthest == m_frames.end())
+			{
+				break;
+			}
+
+			m_cachedBytes -= farthest->second.bytes;
+			m_frames.erase(farthest);
+		}
+	}
+
+	bool PrefetchScheduler::IsInWindowLocked(size_t index) const noexcept
+	{
+		if (!m_hasCurrentIndex)
+		{
+			return false;
+		}
+
+		return index >= m_currentIndex
+			? index - m_currentIndex <= m_prefetchSettings.aheadCount
+			: m_currentIndex - index <= m_prefetchSettings.behindCount;
+	}
+
+	size_t PrefetchScheduler::GetDistanceLocked(size_t index) const noexcept
+	{
+		return index >= m_currentIndex ? index - m_currentIndex : m_currentIndex - index;
+	}
+}
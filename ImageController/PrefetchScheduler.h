@@ -0,0 +1,199 @@
+/*!
+ * @file	PrefetchScheduler.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include "ImageReader.h"
+#include "CancellationToken.h"
+#include "ImageDataWriter.h"
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Kchary::ImageController::Library
+{
+	/*!
+	 * @brief フォルダ内の画像を順にめくる際に、前後の画像を表示サイズで先読みするクラス
+	 * @note 表示中の画像 → 先読み → バックグラウンドのサムネイルの順に優先してデコードする。
+	 *		 現在位置を変更すると、先読みの範囲から外れた未着手の要求を破棄し、デコード中の要求を中断する。
+	 *		 複数スレッドから同時に呼び出してよい
+	 */
+	class PrefetchScheduler final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param imageController	デコードに使う画像リーダー(通常はImageReader。このインスタンスより長く生存すること)
+		 * @param prefetchSettings	先読み設定
+		 */
+		PrefetchScheduler(IImageController& imageController, const PrefetchSettings& prefetchSettings);
+
+		/*!
+		 * @brief デストラクタ(デコード中の要求を中断し、ワーカースレッドを停止する)
+		 */
+		~PrefetchScheduler();
+
+		PrefetchScheduler(const PrefetchScheduler&) = delete;
+		PrefetchScheduler& operator=(const PrefetchScheduler&) = delete;
+
+		/*!
+		 * @brief	先読みする画像の一覧を設定する(保持している画像と未完了の要求は全て破棄する)
+		 * @param	imagePaths			画像パスの一覧(表示順)
+		 * @param	displaySettings		表示サイズの読み込み設定
+		 */
+		void SetItems(std::vector<std::wstring> imagePaths, const ImageReadSettings& displaySettings);
+
+		/*!
+		 * @brief	表示中の画像の位置を設定し、その画像と前後の画像のデコードを要求する
+		 * @param	index	位置(SetItems()の一覧のインデックス)
+		 */
+		void SetCurrentIndex(size_t index);
+
+		/*!
+		 * @brief	デコード済みの画像を取得する(デコード中の場合は完了まで待つ)
+		 * @param	index					位置(SetCurrentIndex()で要求した範囲内であること)
+		 * @param	imageData				画像データ(out。保持している画像をコピーする)
+		 * @param	timeoutMilliseconds		最大待ち時間(ミリ秒)
+		 * @return	取得できた: True, 失敗・時間切れ・要求されていない位置: False
+		 */
+		bool GetFrame(size_t index, ImageData& imageData, unsigned int timeoutMilliseconds);
+
+		/*!
+		 * @brief	サムネイルのデコードを最も低い優先度で要求する
+		 * @param	indices				位置の一覧(要求順にデコードする)
+		 * @param	thumbnailSettings	サムネイルの読み込み設定
+		 * @param	callback			1枚読み込むごとに呼ばれるコールバック(ワーカースレッドから呼ばれる。中断した画像は呼ばれない)
+		 * @note	現在位置の変更では破棄しない。CancelThumbnails()・SetItems()で破棄する
+		 */
+		void RequestThumbnails(const std::vector<size_t>& indices, const ImageReadSettings& thumbnailSettings, ImageReader::ImageDataCallback callback);
+
+		/*!
+		 * @brief	未完了のサムネイルの要求を破棄・中断する
+		 */
+		void CancelThumbnails();
+
+		/*!
+		 * @brief	統計情報を取得する
+		 * @return	統計情報
+		 */
+		PrefetchStatistics GetStatistics() const;
+
+	private:
+		/*!
+		 * @brief 要求の優先度(値の小さいものから処理する)
+		 */
+		enum class Lane
+		{
+			Visible,	//!< 表示中の画像
+			Prefetch,	//!< 前後の画像
+			Background,	//!< サムネイル
+			Count
+		};
+
+		/*!
+		 * @brief 先読みした画像の状態
+		 */
+		enum class FrameState
+		{
+			Decoding,	//!< デコード待ち・デコード中
+			Ready,		//!< デコード済み
+			Failed		//!< デコード失敗
+		};
+
+		/*!
+		 * @brief 先読みした画像
+		 */
+		struct Frame
+		{
+			FrameState state = FrameState::Decoding;								//!< 状態
+			bool isRunning = false;												//!< ワーカーがデコードを開始したか
+			std::shared_ptr<Threading::CancellationToken> cancellationToken;		//!< 中断要求(要求ごとに作り直す)
+			std::shared_ptr<const ImageData> imageData;							//!< デコード結果
+			size_t bytes = 0;													//!< デコード結果のバイト数
+		};
+
+		/*!
+		 * @brief デコードの要求
+		 */
+		struct Job
+		{
+			Lane lane = Lane::Visible;											//!< 優先度
+			size_t index = 0;													//!< 位置
+			std::wstring path;													//!< 画像パス
+			ImageReadSettings imageReadSettings{};								//!< 読み込み設定
+			std::shared_ptr<Threading::CancellationToken> cancellationToken;		//!< 中断要求
+			std::shared_ptr<ImageReader::ImageDataCallback> callback;			//!< サムネイルの通知先
+		};
+
+		/*!
+		 * @brief	ワーカースレッドの処理
+		 */
+		void WorkerLoop();
+
+		/*!
+		 * @brief	先読みした画像のデコード要求を処理する
+		 */
+		void RunFrameJob(const Job& job);
+
+		/*!
+		 * @brief	サムネイルのデコード要求を処理する
+		 */
+		void RunThumbnailJob(const Job& job);
+
+		/*!
+		 * @brief	現在位置と前後の画像のうち未要求のものを、上限に収まる範囲でデコード要求する(m_mutexを保持して呼び出すこと)
+		 */
+		void ScheduleLocked();
+
+		/*!
+		 * @brief	未着手の要求を全て取り下げ、先読みの範囲から外れた画像を破棄・中断する(m_mutexを保持して呼び出すこと)
+		 * @note	範囲内の未着手の要求は、ScheduleLocked()で新しい現在位置に応じた優先度で要求し直す
+		 */
+		void DropStaleLocked();
+
+		/*!
+		 * @brief	上限を超えている間、現在位置から最も遠いデコード済みの画像を破棄する(m_mutexを保持して呼び出すこと)
+		 */
+		void EvictLocked();
+
+		/*!
+		 * @brief	先読みの範囲内の位置か(m_mutexを保持して呼び出すこと)
+		 */
+		bool IsInWindowLocked(size_t index) const noexcept;
+
+		/*!
+		 * @brief	現在位置からの距離を求める(m_mutexを保持して呼び出すこと)
+		 */
+		size_t GetDistanceLocked(size_t index) const noexcept;
+
+		IImageController& m_imageController;									//!< デコードに使う画像リーダー
+		Common::ImageDataWriter m_imageDataWriter;								//!< 取得した画像の書き込み
+		const PrefetchSettings m_prefetchSettings;								//!< 先読み設定
+
+		mutable std::mutex m_mutex;												//!< 以下のメンバーを保護するミューテックス
+		std::condition_variable m_jobAvailable;									//!< 要求の登録通知
+		std::condition_variable m_frameUpdated;									//!< 画像の状態変更通知
+		std::array<std::deque<Job>, static_cast<size_t>(Lane::Count)> m_lanes;	//!< 優先度ごとの未着手の要求
+		std::vector<std::wstring> m_imagePaths;									//!< 画像パスの一覧
+		ImageReadSettings m_displaySettings{};									//!< 表示サイズの読み込み設定
+		size_t m_currentIndex = 0;												//!< 表示中の画像の位置
+		bool m_hasCurrentIndex = false;											//!< 現在位置が設定されているか
+		std::map<size_t, Frame> m_frames;										//!< 位置ごとの先読みした画像(デコード中を含む)
+		size_t m_cachedBytes = 0;												//!< デコード済みの画像の合計バイト数
+		size_t m_estimatedFrameBytes = 0;										//!< 1枚あたりのバイト数の見込み(直近のデコード結果)
+		std::shared_ptr<Threading::CancellationToken> m_thumbnailCancellationToken;	//!< サムネイルの要求の中断要求
+		PrefetchStatistics m_statistics{};										//!< 統計情報
+		bool m_isStopping = false;												//!< 停止要求フラグ
+
+		std::vector<std::thread> m_workers;										//!< ワーカースレッド
+	};
+}
@@ -0,0 +1,172 @@
+/*!
+ * @file	PyramidCache.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "PyramidCache.h"
+#include "AreaResizer.h"
+#include <algorithm>	// std::max
+#include <functional>	// std::hash
+
+namespace Kchary::ImageController::Cache
+{
+	namespace
+	{
+		size_t CombineHash(size_t seed, size_t value) noexcept
+		{
+			return seed ^ (value + 0x9E3779B9 + (seed << 6) + (seed >> 2));
+		}
+
+		int GetLongSideLength(const cv::Mat& image) noexcept
+		{
+			return (std::max)(image.cols, image.rows);
+		}
+	}
+
+	ImagePyramid::ImagePyramid(ImageData&& baseData, bool isFullResolution, const ImageMetadata& metadata)
+		: m_baseBuffer(std::move(baseData.buffer))
+		, m_isFullResolution(isFullResolution)
+		, m_metadata(metadata)
+	{
+		m_levels.emplace_back(baseData.height, baseData.width, CV_8UC3, m_baseBuffer.data(), static_cast<size_t>(baseData.stride));
+		m_bytes = m_baseBuffer.size();
+
+		while (GetLongSideLength(m_levels.back()) / 2 >= MinLevelLongSideLength)
+		{
+			const cv::Mat& source = m_levels.back();
+			cv::Mat level(cv::Size((source.cols + 1) / 2, (source.rows + 1) / 2), source.type());
+			if (!Simd::ResizeArea(source, level))
+			{
+				cv::resize(source, level, level.size(), 0, 0, cv::INTER_AREA);
+			}
+
+			m_bytes += level.total() * level.elemSize();
+			m_levels.push_back(std::move(level));
+		}
+	}
+
+	bool ImagePyramid::CanServe(int resizeLongSideLength) const noexcept
+	{
+		return m_isFullResolution || (resizeLongSideLength > 0 && resizeLongSideLength <= GetLongSideLength(m_levels.front()));
+	}
+
+	const cv::Mat& ImagePyramid::SelectLevel(int resizeLongSideLength) const noexcept
+	{
+		if (resizeLongSideLength > 0)
+		{
+			for (auto level = m_levels.rbegin(); level != m_levels.rend(); ++level)
+			{
+				if (GetLongSideLength(*level) >= resizeLongSideLength)
+				{
+					return *level;
+				}
+			}
+		}
+
+		return m_levels.front();
+	}
+
+	size_t PyramidKeyHash::operator()(const PyramidKey& key) const noexcept
+	{
+		size_t hash = std::hash<std::wstring>()(key.path);
+		hash = CombineHash(hash, std::hash<long long>()(key.lastWriteTime));
+		hash = CombineHash(hash, std::hash<bool>()(key.isRawImage));
+		return CombineHash(hash, std::hash<bool>()(key.isRawPreview));
+	}
+
+	PyramidCache::PyramidCache(size_t capacity)
+		: m_capacity(capacity)
+	{
+	}
+
+	void PyramidCache::SetCapacity(size_t capacity)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_capacity = capacity;
+		EvictLocked();
+	}
+
+	size_t PyramidCache::GetCapacity() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_capacity;
+	}
+
+	std::shared_ptr<const ImagePyramid> PyramidCache::Find(const PyramidKey& key, int resizeLongSideLength)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const auto found = m_index.find(key);
+		if (found == m_index.end() || !found->second->second->CanServe(resizeLongSideLength))
+		{
+			++m_missCount;
+			return nullptr;
+		}
+
+		// 最も新しく使われたピラミッドとして先頭へ移す
+		m_entries.splice(m_entries.begin(), m_entries, found->second);
+		++m_hitCount;
+		return found->second->second;
+	}
+
+	void PyramidCache::Insert(const PyramidKey& key, std::shared_ptr<const ImagePyramid> pyramid)
+	{
+		const size_t pyramidBytes = pyramid->GetBytes();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const auto found = m_index.find(key);
+		if (found != m_index.end())
+		{
+			// 提供できなかった要求のためにデコードし直したピラミッドで置き換える
+			m_cachedBytes -= found->second->second->GetBytes();
+			m_entries.erase(found->second);
+			m_index.erase(found);
+		}
+
+		if (pyramidBytes > m_capacity)
+		{
+			return;
+		}
+
+		m_entries.emplace_front(key, std::move(pyramid));
+		m_index.emplace(key, m_entries.begin());
+		m_cachedBytes += pyramidBytes;
+		EvictLocked();
+	}
+
+	std::mutex& PyramidCache::GetDecodeMutex(const PyramidKey& key) noexcept
+	{
+		return m_decodeMutexes[PyramidKeyHash()(key) % DecodeMutexCount];
+	}
+
+	void PyramidCache::AddDecodeCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_decodeCount;
+	}
+
+	PyramidCacheStatistics PyramidCache::GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		PyramidCacheStatistics statistics{};
+		statistics.hitCount = m_hitCount;
+		statistics.missCount = m_missCount;
+		statistics.decodeCount = m_decodeCount;
+		statistics.entryCount = m_entries.size();
+		statistics.cachedBytes = m_cachedBytes;
+		statistics.capacity = m_capacity;
+		return statistics;
+	}
+
+	void PyramidCache::EvictLocked()
+	{
+		while (m_cachedBytes > m_capacity && !m_entries.empty())
+		{
+			const auto& oldest = m_entries.back();
+			m_cachedBytes -= oldest.second->GetBytes();
+			m_index.erase(oldest.first);
+			m_entries.pop_back();
+		}
+	}
+}
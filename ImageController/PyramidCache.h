@@ -0,0 +1,183 @@
+/*!
+ * @file	PyramidCache.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include "PixelBuffer.h"
+#include <array>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Cache
+{
+	/*!
+	 * @brief デコードした画像と、それを1/2ずつ縮小した画像の組(ミップマップ)
+	 * @note 構築後は変更しないため、複数スレッドから同時に参照してよい
+	 */
+	class ImagePyramid final
+	{
+	public:
+		static constexpr int MinLevelLongSideLength = 64;	//!< 最も小さいレベルの長辺の下限
+
+		/*!
+		 * @brief コンストラクタ(デコード結果を最も大きいレベルとし、長辺が下限を下回るまで1/2ずつ縮小したレベルを作る)
+		 * @param baseData			デコード結果(BGR 8bit、ファイルに保存されている向き。画素バッファを引き継ぐ)
+		 * @param isFullResolution	縮小せずにデコードした画像か(Falseの場合、最も大きいレベルより大きい要求には提供できない)
+		 * @param metadata			デコード時に読み取ったメタデータ
+		 */
+		ImagePyramid(ImageData&& baseData, bool isFullResolution, const ImageMetadata& metadata);
+
+		ImagePyramid(const ImagePyramid&) = delete;
+		ImagePyramid& operator=(const ImagePyramid&) = delete;
+
+		/*!
+		 * @brief	要求された長辺の画像を提供できるか
+		 * @param	resizeLongSideLength	長辺の長さ(0: 等倍)
+		 * @return	提供できる: True
+		 */
+		bool CanServe(int resizeLongSideLength) const noexcept;
+
+		/*!
+		 * @brief	要求された長辺以上で最も小さいレベルを取得する
+		 * @param	resizeLongSideLength	長辺の長さ(0: 等倍)
+		 * @return	レベルの画像(要求より小さい画像しかない場合は最も大きいレベル)
+		 */
+		const cv::Mat& SelectLevel(int resizeLongSideLength) const noexcept;
+
+		/*!
+		 * @brief	全レベルの合計バイト数を取得する
+		 * @return	バイト数
+		 */
+		size_t GetBytes() const noexcept { return m_bytes; }
+
+		/*!
+		 * @brief	デコード時に読み取ったメタデータを取得する
+		 * @return	メタデータ
+		 */
+		const ImageMetadata& GetMetadata() const noexcept { return m_metadata; }
+
+	private:
+		Memory::PixelBuffer m_baseBuffer;	//!< 最も大きいレベルの画素バッファ
+		std::vector<cv::Mat> m_levels;		//!< レベルの画像(先頭が最も大きい)
+		bool m_isFullResolution;			//!< 等倍の画像か
+		ImageMetadata m_metadata;			//!< メタデータ
+		size_t m_bytes = 0;					//!< 全レベルの合計バイト数
+	};
+
+	/*!
+	 * @brief ピラミッドを識別するキー
+	 * @note 元画像の更新日時が異なるピラミッドは別のキーとなり、使われないままLRUで破棄される
+	 */
+	struct PyramidKey
+	{
+		std::wstring path;				//!< 画像パス
+		long long lastWriteTime = 0;	//!< 元画像の更新日時
+		bool isRawImage = false;		//!< RAW画像として読み込んだか
+		bool isRawPreview = false;		//!< RAW画像の埋め込みプレビューか(デモザイクした画像とは別に保持する)
+
+		bool operator==(const PyramidKey& other) const noexcept
+		{
+			return lastWriteTime == other.lastWriteTime && isRawImage == other.isRawImage && isRawPreview == other.isRawPreview && path == other.path;
+		}
+	};
+
+	/*!
+	 * @brief PyramidKeyのハッシュ
+	 */
+	struct PyramidKeyHash
+	{
+		size_t operator()(const PyramidKey& key) const noexcept;
+	};
+
+	/*!
+	 * @brief 画像ごとのピラミッドを、合計バイト数の上限まで保持するキャッシュ(LRU)
+	 * @note 複数スレッドから同時に呼び出してよい
+	 */
+	class PyramidCache final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param capacity	保持するピラミッドの合計バイト数の上限
+		 */
+		explicit PyramidCache(size_t capacity);
+
+		PyramidCache(const PyramidCache&) = delete;
+		PyramidCache& operator=(const PyramidCache&) = delete;
+
+		/*!
+		 * @brief	保持するピラミッドの合計バイト数の上限を変更する(超過分は古いピラミッドから破棄する)
+		 * @param	capacity	上限(Byte。0の場合は保持しない)
+		 */
+		void SetCapacity(size_t capacity);
+
+		/*!
+		 * @brief	保持するピラミッドの合計バイト数の上限を取得する
+		 * @return	上限(Byte)
+		 */
+		size_t GetCapacity() const;
+
+		/*!
+		 * @brief	要求された長辺の画像を提供できるピラミッドを取得する
+		 * @param	key						キー
+		 * @param	resizeLongSideLength	長辺の長さ(0: 等倍)
+		 * @return	ピラミッド(提供できない場合はnullptr。破棄後も参照できる)
+		 */
+		std::shared_ptr<const ImagePyramid> Find(const PyramidKey& key, int resizeLongSideLength);
+
+		/*!
+		 * @brief	ピラミッドを追加する(同じキーのピラミッドは置き換える)
+		 * @param	key		キー
+		 * @param	pyramid	ピラミッド(上限を超えるサイズの場合は追加しない)
+		 */
+		void Insert(const PyramidKey& key, std::shared_ptr<const ImagePyramid> pyramid);
+
+		/*!
+		 * @brief	画像単位のデコードを直列化するミューテックスを取得する
+		 * @param	key		キー
+		 * @return	ミューテックス(異なる画像が同じミューテックスを共有する場合がある)
+		 */
+		std::mutex& GetDecodeMutex(const PyramidKey& key) noexcept;
+
+		/*!
+		 * @brief	ピラミッドを作るためにデコードした回数を加算する
+		 */
+		void AddDecodeCount();
+
+		/*!
+		 * @brief	統計情報を取得する
+		 * @return	統計情報
+		 */
+		PyramidCacheStatistics GetStatistics() const;
+
+	private:
+		using Entry = std::pair<PyramidKey, std::shared_ptr<const ImagePyramid>>;
+
+		/*!
+		 * @brief	上限を超えている間、最も古いピラミッドを破棄する(m_mutexを保持して呼び出すこと)
+		 */
+		void EvictLocked();
+
+		static constexpr size_t DecodeMutexCount = 16;	//!< デコード用ミューテックスの数
+
+		mutable std::mutex m_mutex;									//!< 以下のメンバーを保護するミューテックス
+		std::list<Entry> m_entries;									//!< ピラミッド(先頭が最も新しく使われたもの)
+		std::unordered_map<PyramidKey, std::list<Entry>::iterator, PyramidKeyHash> m_index;	//!< キーからピラミッドへの索引
+		size_t m_capacity;											//!< 合計バイト数の上限
+		size_t m_cachedBytes = 0;									//!< 保持しているピラミッドの合計バイト数
+		size_t m_hitCount = 0;										//!< キャッシュから提供できた回数
+		size_t m_missCount = 0;										//!< キャッシュから提供できなかった回数
+		size_t m_decodeCount = 0;									//!< ピラミッドを作るためにデコードした回数
+		std::array<std::mutex, DecodeMutexCount> m_decodeMutexes;	//!< 画像単位のデコード用ミューテックス
+	};
+}
@@ -0,0 +1,157 @@
+/*!
+ * @file	PyramidLoader.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "PyramidLoader.h"
+#include "MappedFile.h"
+#include "CancellationToken.h"
+#include "ImageHeader.h"
+#include <algorithm>	// std::max
+#include <mutex>		// std::lock_guard
+
+namespace Kchary::ImageController::Cache
+{
+	using Diagnostics::DecodeStage;
+	using Diagnostics::ScopedStageTimer;
+
+	PyramidLoader::PyramidLoader(std::shared_ptr<Memory::BufferPool> bufferPool, IImageController& rawImageController, IImageController& normalImageController, std::shared_ptr<Diagnostics::DecodeStatistics> statistics, const PyramidCacheSettings& pyramidCacheSettings)
+		: m_imageDataWriter(std::move(bufferPool))
+		, m_rawImageController(rawImageController)
+		, m_normalImageController(normalImageController)
+		, m_statistics(std::move(statistics))
+		, m_pyramidCache(pyramidCacheSettings.capacity)
+		, m_minLongSideLength(pyramidCacheSettings.minLongSideLength)
+	{
+	}
+
+	bool PyramidLoader::IsApplicable(const ImageReadSettings& imageReadSettings) const
+	{
+		// ピラミッドはBGR 8bitで保持するため、16bit/ch・アルファを保持して出力する要求は対象外とする
+		return !imageReadSettings.isHighBitDepth && !imageReadSettings.preserveAlpha && m_pyramidCache.GetCapacity() > 0;
+	}
+
+	bool PyramidLoader::GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken)
+	{
+		IO::FileStatus fileStatus{};
+		if (!IO::GetFileStatus(path, fileStatus))
+		{
+			return false;
+		}
+
+		const int resizeLongSideLength = GetRequestedLongSideLength(imageReadSettings);
+		const PyramidKey key{ path, fileStatus.lastWriteTime, imageReadSettings.isRawImage, imageReadSettings.isRawImage && imageReadSettings.isThumbnailMode };
+
+		auto pyramid = m_pyramidCache.Find(key, resizeLongSideLength);
+		if (!pyramid && resizeLongSideLength > 0 && resizeLongSideLength < m_minLongSideLength.load(std::memory_order_relaxed))
+		{
+			// 小さい要求はピラミッドを作らず、要求された長辺で縮小デコードする(JPEGはDCTスケーリングで必要な分だけデコードする)
+			auto& imageController = imageReadSettings.isRawImage ? m_rawImageController : m_normalImageController;
+			return imageController.GetImageData(path, imageReadSettings, imageData, metadata, cancellationToken);
+		}
+
+		if (!pyramid)
+		{
+			// 同じ画像を複数スレッドで重複してデコードしないよう、ロックを取得してから再度探す
+			std::lock_guard<std::mutex> lock(m_pyramidCache.GetDecodeMutex(key));
+			pyramid = m_pyramidCache.Find(key, resizeLongSideLength);
+			if (!pyramid)
+			{
+				pyramid = BuildPyramid(path, imageReadSettings, resizeLongSideLength, cancellationToken);
+				if (!pyramid)
+				{
+					return false;
+				}
+				m_pyramidCache.Insert(key, pyramid);
+			}
+		}
+
+		if (metadata)
+		{
+			*metadata = pyramid->GetMetadata();
+		}
+
+		// 向きの指定が異なる要求でも同じピラミッドを使えるよう、向きは出力時に適用する
+		const int orientation = Decode::ResolveOrientation(imageReadSettings.orientation, pyramid->GetMetadata().orientation);
+		return WriteOutput(*pyramid, resizeLongSideLength, orientation, imageData);
+	}
+
+	void PyramidLoader::SetSettings(const PyramidCacheSettings& pyramidCacheSettings)
+	{
+		m_minLongSideLength.store(pyramidCacheSettings.minLongSideLength, std::memory_order_relaxed);
+		m_pyramidCache.SetCapacity(pyramidCacheSettings.capacity);
+	}
+
+	PyramidCacheStatistics PyramidLoader::GetStatistics() const
+	{
+		return m_pyramidCache.GetStatistics();
+	}
+
+	std::shared_ptr<const ImagePyramid> PyramidLoader::BuildPyramid(const wchar_t* path, const ImageReadSettings& imageReadSettings, int resizeLongSideLength, const Threading::CancellationToken* cancellationToken)
+	{
+		// 要求された長辺でデコードする(要求より大きくデコードすると、JPEGのDCTスケーリングで小さくデコードできなくなる)
+		ImageReadSettings decodeSettings = imageReadSettings;
+		decodeSettings.isHighBitDepth = false;
+		decodeSettings.preserveAlpha = false;
+		decodeSettings.orientation = 1;	// 向きは出力時に適用するため、保存されている向きのまま保持する
+		decodeSettings.resizeLongSideLength = resizeLongSideLength;
+		decodeSettings.isThumbnailMode = imageReadSettings.isRawImage ? imageReadSettings.isThumbnailMode : resizeLongSideLength > 0;
+
+		// メタデータはデコードと同じファイルから読み取り、ピラミッドと共に保持する
+		ImageData baseData{};
+		ImageMetadata metadata{};
+		auto& imageController = imageReadSettings.isRawImage ? m_rawImageController : m_normalImageController;
+		if (!imageController.GetImageData(path, decodeSettings, baseData, &metadata, cancellationToken) || baseData.width <= 0 || baseData.height <= 0)
+		{
+			return nullptr;
+		}
+		m_pyramidCache.AddDecodeCount();
+
+		if (Threading::IsCancelled(cancellationToken))
+		{
+			return nullptr;
+		}
+
+		// 指定した長辺より小さい画像は縮小されていないため、より大きい要求にも提供できる
+		const bool isFullResolution = decodeSettings.resizeLongSideLength <= 0 || (std::max)(baseData.width, baseData.height) < decodeSettings.resizeLongSideLength;
+
+		ScopedStageTimer timer(*m_statistics, DecodeStage::PyramidBuild);
+		return std::make_shared<const ImagePyramid>(std::move(baseData), isFullResolution, metadata);
+	}
+
+	bool PyramidLoader::WriteOutput(const ImagePyramid& pyramid, int resizeLongSideLength, int orientation, ImageData& imageData) const
+	{
+		const cv::Mat& level = pyramid.SelectLevel(resizeLongSideLength);
+		const int longSideLength = (std::max)(level.cols, level.rows);
+
+		bool result = false;
+		if (resizeLongSideLength > 0 && longSideLength > resizeLongSideLength)
+		{
+			ScopedStageTimer timer(*m_statistics, DecodeStage::Resize);
+			result = m_imageDataWriter.WriteResized(level, static_cast<double>(resizeLongSideLength) / longSideLength, orientation, imageData);
+		}
+		else
+		{
+			ScopedStageTimer timer(*m_statistics, DecodeStage::Copy);
+			result = m_imageDataWriter.Write(level, orientation, imageData);
+		}
+
+		if (result)
+		{
+			m_statistics->AddBytesCopied(imageData.size);
+		}
+
+		return result;
+	}
+
+	int PyramidLoader::GetRequestedLongSideLength(const ImageReadSettings& imageReadSettings) noexcept
+	{
+		if (!imageReadSettings.isRawImage && !imageReadSettings.isThumbnailMode)
+		{
+			return 0;
+		}
+
+		return (std::max)(imageReadSettings.resizeLongSideLength, 0);
+	}
+}
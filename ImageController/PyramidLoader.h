@@ -0,0 +1,107 @@
+/*!
+ * @file	PyramidLoader.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include "IImageController.h"
+#include "ImageDataWriter.h"
+#include "PyramidCache.h"
+#include "DecodeStatistics.h"
+#include <atomic>
+#include <memory>
+
+namespace Kchary::ImageController::Cache
+{
+	/*!
+	 * @brief デコード結果からピラミッドを作り、以降の異なるサイズの要求をピラミッドから提供するクラス
+	 * @note 要求された長辺以上で最も小さいレベルを縮小して出力する。
+	 *		 ピラミッドは要求された長辺でデコードして作り、ピラミッドより大きい要求(等倍の要求を含む)のみデコードし直す。
+	 *		 ピラミッドを作る長辺の最小値より小さい要求は、既存のピラミッドから提供できない場合、ピラミッドを作らずに縮小デコードする。
+	 *		 複数スレッドから同時に呼び出してよい
+	 */
+	class PyramidLoader final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param bufferPool				画素バッファの貸し出し元
+		 * @param rawImageController		RAW画像のデコードに使うインスタンス(このインスタンスより長く生存すること)
+		 * @param normalImageController		通常の画像のデコードに使うインスタンス(このインスタンスより長く生存すること)
+		 * @param statistics				統計情報の記録先
+		 * @param pyramidCacheSettings		ピラミッドキャッシュ設定
+		 */
+		PyramidLoader(std::shared_ptr<Memory::BufferPool> bufferPool, IImageController& rawImageController, IImageController& normalImageController, std::shared_ptr<Diagnostics::DecodeStatistics> statistics, const PyramidCacheSettings& pyramidCacheSettings);
+
+		PyramidLoader(const PyramidLoader&) = delete;
+		PyramidLoader& operator=(const PyramidLoader&) = delete;
+
+		/*!
+		 * @brief	ピラミッドから提供できる読み込み設定か
+		 * @param	imageReadSettings	画像設定
+		 * @return	提供できる: True(キャッシュが無効な場合・16bit出力の場合はFalse)
+		 */
+		bool IsApplicable(const ImageReadSettings& imageReadSettings) const;
+
+		/*!
+		 * @brief	画像データを取得する(ピラミッドになければデコードし、ピラミッドを作る長辺の最小値以上の要求の場合はピラミッドを作る)
+		 * @param	path				画像パス
+		 * @param	imageReadSettings	画像設定(IsApplicable()がTrueであること)
+		 * @param	imageData			画像データ(out)
+		 * @param	metadata			メタデータ(out。nullptrの場合は取得しない。ピラミッドを作る際に読み取ったものを返す)
+		 * @param	cancellationToken	中断要求(nullptrの場合は中断しない)
+		 * @return	成功: True, 失敗: False(中断した場合を含む)
+		 */
+		bool GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken);
+
+		/*!
+		 * @brief	ピラミッドキャッシュ設定を変更する(上限を下げた場合は超過分を破棄する)
+		 * @param	pyramidCacheSettings	ピラミッドキャッシュ設定
+		 */
+		void SetSettings(const PyramidCacheSettings& pyramidCacheSettings);
+
+		/*!
+		 * @brief	ピラミッドキャッシュの統計情報を取得する
+		 * @return	統計情報
+		 */
+		PyramidCacheStatistics GetStatistics() const;
+
+	private:
+		/*!
+		 * @brief	画像をデコードし、ピラミッドを作る
+		 * @param	path					画像パス
+		 * @param	imageReadSettings		画像設定
+		 * @param	resizeLongSideLength	要求された長辺の長さ(0: 等倍)
+		 * @param	cancellationToken		中断要求(nullptrの場合は中断しない)
+		 * @return	ピラミッド(失敗・中断した場合はnullptr)
+		 */
+		std::shared_ptr<const ImagePyramid> BuildPyramid(const wchar_t* path, const ImageReadSettings& imageReadSettings, int resizeLongSideLength, const Threading::CancellationToken* cancellationToken);
+
+		/*!
+		 * @brief	ピラミッドから要求された長辺の画像を書き込み先へ出力する
+		 * @param	pyramid					ピラミッド
+		 * @param	resizeLongSideLength	要求された長辺の長さ(0: 等倍)
+		 * @param	orientation				適用するEXIFの向き(1～8)
+		 * @param	imageData				画像データ(out)
+		 * @return	成功: True, 失敗: False
+		 * @note	ピラミッドはファイルに保存されている向きで保持し、向きは書き込み先への出力と同時に適用する
+		 */
+		bool WriteOutput(const ImagePyramid& pyramid, int resizeLongSideLength, int orientation, ImageData& imageData) const;
+
+		/*!
+		 * @brief	要求された長辺の長さを求める(RAW画像は常に、通常の画像はサムネイルモードのみ縮小する)
+		 * @param	imageReadSettings	画像設定
+		 * @return	長辺の長さ(0: 等倍)
+		 */
+		static int GetRequestedLongSideLength(const ImageReadSettings& imageReadSettings) noexcept;
+
+		Common::ImageDataWriter m_imageDataWriter;						//!< 画像データの書き込み
+		IImageController& m_rawImageController;							//!< RAW画像のデコード
+		IImageController& m_normalImageController;						//!< 通常の画像のデコード
+		std::shared_ptr<Diagnostics::DecodeStatistics> m_statistics;	//!< 統計情報の記録先
+		PyramidCache m_pyramidCache;									//!< ピラミッドキャッシュ
+		std::atomic<int> m_minLongSideLength;							//!< ピラミッドを作る縮小要求の長辺の最小値
+	};
+}
@@ -5,135 +5,509 @@
 
 #include "pch.h"
 #include "RawImageController.h"
-#include <memory>        // std::make_unique
-#include <vector>        // std::vector
-#include <cstdint>       // std::uint8_t
-#include <cstring>       // std::memcpy
+#include "ImageDataWriter.h"
+#include "MappedFile.h"
+#include "PixelConverter.h"
+#include "DecodeStatistics.h"
+#include "DecodePlanner.h"
+#include "CancellationToken.h"
+#include <memory>        // std::unique_ptr
 #include <stdexcept>     // std::runtime_error
 #include <algorithm>     // std::max
+#include <iostream>      // std::cerr
+#include <cmath>         // std::lround
+#include <cstring>       // std::memcpy
+#include <ctime>         // std::time_t, std::strftime
 #include <opencv2/opencv.hpp> // cv::Mat, cv::imdecode, cv::resize, etc.
 #include <libraw/libraw.h>    // LibRaw本体
 
 namespace Kchary::ImageController::RawImageControl
 {
-    bool RawImageController::GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData)
+    using Diagnostics::DecodeMode;
+    using Diagnostics::DecodeStage;
+    using Diagnostics::DecodeStatistics;
+    using Diagnostics::ImageFormat;
+    using Diagnostics::ScopedStageTimer;
+
+    namespace
     {
-        const auto rawProcessor = std::make_unique<LibRaw>();
+        /*!
+         * @brief LibRawの進捗コールバック(0以外を返すとLibRawが処理を打ち切る)
+         */
+        int OnProgress(void* data, enum LibRaw_progress /*stage*/, int /*iteration*/, int /*expected*/)
+        {
+            return static_cast<const Threading::CancellationToken*>(data)->IsCancelled() ? 1 : 0;
+        }
 
-        auto recycle = [&]()
+        /*!
+         * @brief 中断要求をLibRawの進捗コールバックへ登録し、スコープを抜ける際に解除するクラス
+         * @note プールのインスタンスはrecycle()でコールバックが解除されないため、破棄済みのトークンを参照しないよう必ず解除する
+         */
+        class ProgressHandlerScope final
+        {
+        public:
+            ProgressHandlerScope(LibRaw& rawProcessor, const Threading::CancellationToken* cancellationToken)
+                : m_rawProcessor(rawProcessor)
             {
-                if (rawProcessor) rawProcessor->recycle();
-            };
+                if (cancellationToken)
+                {
+                    m_rawProcessor.set_progress_handler(OnProgress, const_cast<Threading::CancellationToken*>(cancellationToken));
+                }
+            }
 
-        try
+            ~ProgressHandlerScope()
+            {
+                m_rawProcessor.set_progress_handler(nullptr, nullptr);
+            }
+
+            ProgressHandlerScope(const ProgressHandlerScope&) = delete;
+            ProgressHandlerScope& operator=(const ProgressHandlerScope&) = delete;
+
+        private:
+            LibRaw& m_rawProcessor;
+        };
+
+        /*!
+         * @brief NUL終端の文字列を、入りきらない部分を切り詰めて複写する
+         */
+        template<size_t Length>
+        void CopyText(char (&destination)[Length], const char* source)
         {
-            if (rawProcessor->open_file(path) != LIBRAW_SUCCESS)
+            size_t length = 0;
+            while (length < Length - 1 && source[length] != '\0')
             {
-                throw std::runtime_error("open_file failed");
+                ++length;
             }
 
-            if (imageReadSettings.isThumbnailMode)
+            std::memcpy(destination, source, length);
+            destination[length] = '\0';
+        }
+
+        /*!
+         * @brief LibRawのflip(bit0: 左右反転、bit1: 上下反転、bit2: 転置)とEXIFの向きの対応表(添字がflip)
+         */
+        constexpr int ExifOrientationFromFlip[8] = { 1, 2, 4, 3, 5, 8, 6, 7 };
+
+        /*!
+         * @brief LibRawのビットマップ(RGB順または1チャンネル)をBGR順の画像へ出力する
+         */
+        void ConvertToBgr(const cv::Mat& source, cv::Mat& destination)
+        {
+            if (source.channels() == 1)
             {
-                if (rawProcessor->unpack_thumb() != LIBRAW_SUCCESS)
-                {
-                    throw std::runtime_error("unpack_thumb failed");
-                }
+                cv::cvtColor(source, destination, cv::COLOR_GRAY2BGR);
+            }
+            else
+            {
+                Simd::ConvertRgbToBgr(source, destination);
+            }
+        }
 
-                auto* thumbnail = rawProcessor->dcraw_make_mem_thumb();
-                if (!thumbnail || thumbnail->type != LIBRAW_IMAGE_JPEG)
+        /*!
+         * @brief LibRawのflipをEXIFの向きへ変換する
+         */
+        int ToExifOrientation(int flip) noexcept
+        {
+            return flip >= 0 && flip < 8 ? ExifOrientationFromFlip[flip] : 1;
+        }
+
+        /*!
+         * @brief EXIFの向き(1～8)をLibRawのflipへ変換する
+         */
+        int ToLibRawFlip(int orientation) noexcept
+        {
+            for (int flip = 0; flip < 8; ++flip)
+            {
+                if (ExifOrientationFromFlip[flip] == orientation)
                 {
-                    throw std::runtime_error("invalid thumbnail");
+                    return flip;
                 }
+            }
+
+            return 0;
+        }
+    }
 
-                // スマートポインタで自動解放
-                std::unique_ptr<libraw_processed_image_t, decltype(&LibRaw::dcraw_clear_mem)> thumbPtr(thumbnail, LibRaw::dcraw_clear_mem);
+    RawImageController::RawImageController(std::shared_ptr<Memory::BufferPool> bufferPool, std::shared_ptr<RawProcessorPool> rawProcessorPool, std::shared_ptr<DecodeStatistics> statistics)
+        : m_imageDataWriter(std::move(bufferPool))
+        , m_rawProcessorPool(std::move(rawProcessorPool))
+        , m_statistics(std::move(statistics))
+    {
+    }
 
-                cv::Mat buf(1, thumbnail->data_size, CV_8UC1, thumbnail->data);
-                auto img = cv::imdecode(buf, GetImreadMode(rawProcessor->imgdata.thumbnail, imageReadSettings.resizeLongSideLength));
-                if (img.empty())
-                {
-                    throw std::runtime_error("thumbnail decode failed");
-                }
+    bool RawImageController::GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken)
+    {
+        // プールから借りたインスタンスは、スコープを抜ける際にrecycle()して返却される
+        const auto rawProcessor = m_rawProcessorPool->Acquire();
+        const ProgressHandlerScope progressHandlerScope(*rawProcessor, cancellationToken);
 
-                const int longSideLength = (std::max)(img.cols, img.rows);
-                if (longSideLength > imageReadSettings.resizeLongSideLength)
-                {
-                    const double ratio = static_cast<double>(imageReadSettings.resizeLongSideLength) / longSideLength;
-                    cv::resize(img, img, cv::Size(), ratio, ratio, cv::INTER_AREA);
-                }
+        try
+        {
+            OpenFile(*rawProcessor, path);
+            if (metadata)
+            {
+                // メタデータはopen_fileで解析済みのため、ファイルを開き直さずに取得できる
+                ReadMetadata(*rawProcessor, *metadata);
+            }
+            Threading::ThrowIfCancelled(cancellationToken);
+
+            if (imageReadSettings.isThumbnailMode)
+            {
+                UnpackThumbnail(*rawProcessor, -1);
+                Threading::ThrowIfCancelled(cancellationToken);
 
-                m_image = img;
+                // 埋め込みのサムネイルは回転されていないため、RAWに記録された向きを書き込み先への出力と同時に適用する
+                const auto img = DecodeThumbnail(*rawProcessor, imageReadSettings.resizeLongSideLength);
+                const int orientation = Decode::ResolveOrientation(imageReadSettings.orientation, ToExifOrientation(rawProcessor->imgdata.sizes.flip));
+                WriteOutput(img, imageReadSettings.resizeLongSideLength, orientation, imageData);
             }
             else
             {
-                if (rawProcessor->unpack() != LIBRAW_SUCCESS)
+                // 表示サイズがセンサーの半分以下であれば、2x2画素をまとめて1画素とするハーフサイズ処理でデモザイクを省く
+                // (プールのインスタンスはrecycle()でパラメータが初期化されないため、毎回設定する)
+                rawProcessor->imgdata.params.half_size = IsHalfSizeSufficient(rawProcessor->imgdata.sizes, imageReadSettings.resizeLongSideLength) ? 1 : 0;
+                rawProcessor->imgdata.params.output_bps = imageReadSettings.isHighBitDepth ? 16 : 8;
+
+                // 向きはLibRawがビットマップを作成する際の複写と同時に適用させる(-1: RAWに記録された向き)
+                rawProcessor->imgdata.params.user_flip = imageReadSettings.orientation != 0 ? ToLibRawFlip(imageReadSettings.orientation) : -1;
+
+                {
+                    ScopedStageTimer timer(*m_statistics, DecodeStage::RawUnpack);
+                    const int result = rawProcessor->unpack();
+                    Threading::ThrowIfCancelled(cancellationToken);
+                    if (result != LIBRAW_SUCCESS)
+                    {
+                        throw std::runtime_error("unpack failed");
+                    }
+                }
+
+                // LibRawはファイル全体を読み込むため、ファイルサイズを読み込んだバイト数とする
+                IO::FileStatus fileStatus;
+                if (m_statistics->IsEnabled() && IO::GetFileStatus(path, fileStatus))
                 {
-                    throw std::runtime_error("unpack failed");
+                    m_statistics->AddBytesRead(fileStatus.length);
                 }
 
-                if (rawProcessor->dcraw_process() != LIBRAW_SUCCESS)
                 {
-                    throw std::runtime_error("dcraw_process failed");
+                    ScopedStageTimer timer(*m_statistics, DecodeStage::RawProcess);
+                    const int result = rawProcessor->dcraw_process();
+                    // 進捗コールバックで打ち切った場合はLIBRAW_CANCELLED_BY_CALLBACKが返る
+                    Threading::ThrowIfCancelled(cancellationToken);
+                    if (result != LIBRAW_SUCCESS)
+                    {
+                        throw std::runtime_error("dcraw_process failed");
+                    }
                 }
 
-                auto* image = rawProcessor->dcraw_make_mem_image();
-                if (!image || image->type != LIBRAW_IMAGE_BITMAP || image->colors != 3)
+                libraw_processed_image_t* image = nullptr;
+                {
+                    ScopedStageTimer timer(*m_statistics, DecodeStage::RawMakeImage);
+                    image = rawProcessor->dcraw_make_mem_image();
+                }
+                if (!image || image->type != LIBRAW_IMAGE_BITMAP || (image->colors != 1 && image->colors != 3) || (image->bits != 8 && image->bits != 16))
                 {
                     throw std::runtime_error("invalid raw image");
                 }
 
                 std::unique_ptr<libraw_processed_image_t, decltype(&LibRaw::dcraw_clear_mem)> imagePtr(image, LibRaw::dcraw_clear_mem);
+                m_statistics->RecordDecode(ImageFormat::Raw, rawProcessor->imgdata.params.half_size ? DecodeMode::RawHalfSize : DecodeMode::Full);
 
-                cv::Mat buf(1, image->data_size, CV_8UC1, image->data);
-                m_image = cv::imdecode(buf, cv::ImreadModes::IMREAD_COLOR);
-                if (m_image.empty())
+                // LibRawのビットマップ(RGB順。モノクロセンサーは1チャンネル)はコピーせずに参照する
+                const int depth = image->bits == 16 ? CV_16U : CV_8U;
+                const int type = CV_MAKETYPE(depth, 3);
+                const cv::Mat rgbImage(image->height, image->width, CV_MAKETYPE(depth, image->colors), image->data);
+
+                const int resizeLongSideLength = imageReadSettings.resizeLongSideLength;
+                if (resizeLongSideLength > 0 && (std::max)(rgbImage.cols, rgbImage.rows) > resizeLongSideLength)
+                {
+                    // 縮小する場合はBGRへ並べ替えた画像をリサイズしながら書き込み先へ出力する
+                    cv::Mat bgrImage(rgbImage.rows, rgbImage.cols, type);
+                    {
+                        ScopedStageTimer timer(*m_statistics, DecodeStage::ColorConversion);
+                        ConvertToBgr(rgbImage, bgrImage);
+                    }
+                    WriteOutput(bgrImage, resizeLongSideLength, 1, imageData);
+                }
+                else
                 {
-                    throw std::runtime_error("raw decode failed");
+                    // 等倍の場合はBGR順へ並べ替えながら書き込み先へ直接出力する
+                    cv::Mat outputImage;
+                    if (!m_imageDataWriter.PrepareOutput(imageData, rgbImage.rows, rgbImage.cols, type, outputImage))
+                    {
+                        throw std::runtime_error("destination buffer too small");
+                    }
+
+                    {
+                        ScopedStageTimer timer(*m_statistics, DecodeStage::ColorConversion);
+                        ConvertToBgr(rgbImage, outputImage);
+                    }
+                    m_statistics->AddBytesCopied(imageData.size);
                 }
             }
+        }
+        catch (const Threading::OperationCancelled&)
+        {
+            return false;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "RawImageController::GetImageData error: " << e.what() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
 
-            const auto dataSize = m_image.total() * m_image.elemSize();
-            imageData.buffer.resize(dataSize);
-            memcpy(imageData.buffer.data(), m_image.data, dataSize);
+    bool RawImageController::GetPreviewImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData)
+    {
+        const auto rawProcessor = m_rawProcessorPool->Acquire();
 
-            imageData.size = static_cast<unsigned int>(dataSize);
-            imageData.stride = static_cast<int>(m_image.step);
-            imageData.width = m_image.cols;
-            imageData.height = m_image.rows;
+        try
+        {
+            OpenFile(*rawProcessor, path);
+
+            // 埋め込みプレビューのうち最大のものを使う(多くの機種でセンサーと同じ解像度のJPEGが入っている)
+            UnpackThumbnail(*rawProcessor, SelectLargestThumbnail(*rawProcessor));
+
+            const auto img = DecodeThumbnail(*rawProcessor, imageReadSettings.resizeLongSideLength);
+            const int orientation = Decode::ResolveOrientation(imageReadSettings.orientation, ToExifOrientation(rawProcessor->imgdata.sizes.flip));
+            WriteOutput(img, imageReadSettings.resizeLongSideLength, orientation, imageData);
         }
         catch (const std::exception& e)
         {
-            std::cerr << "RawImageController::GetImageData error: " << e.what() << std::endl;
-            recycle();
+            std::cerr << "RawImageController::GetPreviewImageData error: " << e.what() << std::endl;
             return false;
         }
 
-        recycle();
         return true;
     }
 
-	cv::ImreadModes RawImageController::GetImreadMode(const libraw_thumbnail_t& thumbnail, const int resizeLongSideLength)
-	{
-		const auto thumbLongSideLength = thumbnail.twidth > thumbnail.theight ? thumbnail.twidth : thumbnail.theight;
-		cv::ImreadModes imreadMode;
-
-		if (resizeLongSideLength <= thumbLongSideLength / 8)
-		{
-			imreadMode = cv::ImreadModes::IMREAD_REDUCED_COLOR_8;
-		}
-		else if (thumbLongSideLength / 8 < resizeLongSideLength && resizeLongSideLength <= thumbLongSideLength / 4)
-		{
-			imreadMode = cv::ImreadModes::IMREAD_REDUCED_COLOR_4;
-		}
-		else if (thumbLongSideLength / 4 < resizeLongSideLength && resizeLongSideLength <= thumbLongSideLength / 2)
-		{
-			imreadMode = cv::ImreadModes::IMREAD_REDUCED_COLOR_2;
-		}
-		else
-		{
-			imreadMode = cv::ImreadModes::IMREAD_COLOR;
-		}
-
-		return imreadMode;
-	}
+    bool RawImageController::GetImageSize(const wchar_t* path, int& width, int& height)
+    {
+        const auto rawProcessor = m_rawProcessorPool->Acquire();
+
+        try
+        {
+            OpenFile(*rawProcessor, path);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "RawImageController::GetImageSize error: " << e.what() << std::endl;
+            return false;
+        }
+
+        // flipのbit2が立っている場合、dcraw_processの出力は幅と高さが入れ替わる
+        const auto& sizes = rawProcessor->imgdata.sizes;
+        const bool isTransposed = (sizes.flip & 4) != 0;
+        width = isTransposed ? sizes.height : sizes.width;
+        height = isTransposed ? sizes.width : sizes.height;
+        return true;
+    }
+
+    bool RawImageController::GetImageMetadata(const wchar_t* path, ImageMetadata& metadata)
+    {
+        const auto rawProcessor = m_rawProcessorPool->Acquire();
+
+        try
+        {
+            OpenFile(*rawProcessor, path);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "RawImageController::GetImageMetadata error: " << e.what() << std::endl;
+            return false;
+        }
+
+        ReadMetadata(*rawProcessor, metadata);
+        return true;
+    }
+
+    void RawImageController::UnpackThumbnail(LibRaw& rawProcessor, const int thumbnailIndex) const
+    {
+        ScopedStageTimer timer(*m_statistics, DecodeStage::RawUnpackThumbnail);
+
+#if LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 21)
+        const int result = thumbnailIndex >= 0 ? rawProcessor.unpack_thumb_ex(thumbnailIndex) : rawProcessor.unpack_thumb();
+#else
+        (void)thumbnailIndex;
+        const int result = rawProcessor.unpack_thumb();
+#endif
+        if (result != LIBRAW_SUCCESS)
+        {
+            throw std::runtime_error("unpack_thumb failed");
+        }
+
+        m_statistics->AddBytesRead(rawProcessor.imgdata.thumbnail.tlength);
+    }
+
+    cv::Mat RawImageController::DecodeThumbnail(LibRaw& rawProcessor, const int resizeLongSideLength) const
+    {
+        auto* thumbnail = rawProcessor.dcraw_make_mem_thumb();
+        if (!thumbnail)
+        {
+            throw std::runtime_error("invalid thumbnail");
+        }
+
+        // スマートポインタで自動解放
+        std::unique_ptr<libraw_processed_image_t, decltype(&LibRaw::dcraw_clear_mem)> thumbPtr(thumbnail, LibRaw::dcraw_clear_mem);
+
+        cv::Mat img;
+        int imreadMode = cv::IMREAD_COLOR;
+        if (thumbnail->type == LIBRAW_IMAGE_JPEG)
+        {
+            imreadMode = GetImreadMode(*thumbnail, resizeLongSideLength);
+            // 埋め込みJPEGのEXIFの向きは使わず、RAWに記録された向きを書き込み時に適用する
+            ScopedStageTimer timer(*m_statistics, DecodeStage::ImageDecode);
+            cv::Mat buf(1, thumbnail->data_size, CV_8UC1, thumbnail->data);
+            img = cv::imdecode(buf, imreadMode | cv::IMREAD_IGNORE_ORIENTATION);
+        }
+        else if (thumbnail->type == LIBRAW_IMAGE_BITMAP && thumbnail->colors == 3 && thumbnail->bits == 8)
+        {
+            // 非圧縮のサムネイルはRGB順のため、BGRへ並べ替えつつLibRawのメモリからコピーする
+            const cv::Mat rgb(thumbnail->height, thumbnail->width, CV_8UC3, thumbnail->data);
+            ScopedStageTimer timer(*m_statistics, DecodeStage::ColorConversion);
+            img.create(rgb.rows, rgb.cols, CV_8UC3);
+            Simd::ConvertRgbToBgr(rgb, img);
+        }
+
+        if (img.empty())
+        {
+            throw std::runtime_error("thumbnail decode failed");
+        }
+
+        m_statistics->RecordDecode(ImageFormat::Raw, DecodeStatistics::GetDecodeMode(imreadMode));
+
+        return img;
+    }
+
+    void RawImageController::WriteOutput(const cv::Mat& image, const int resizeLongSideLength, const int orientation, ImageData& imageData) const
+    {
+        const int longSideLength = (std::max)(image.cols, image.rows);
+        if (resizeLongSideLength > 0 && longSideLength > resizeLongSideLength)
+        {
+            // リサイズ結果を書き込み先へ直接出力する
+            const double ratio = static_cast<double>(resizeLongSideLength) / longSideLength;
+            ScopedStageTimer timer(*m_statistics, DecodeStage::Resize);
+            if (!m_imageDataWriter.WriteResized(image, ratio, orientation, imageData))
+            {
+                throw std::runtime_error("destination buffer too small");
+            }
+        }
+        else
+        {
+            ScopedStageTimer timer(*m_statistics, DecodeStage::Copy);
+            if (!m_imageDataWriter.Write(image, orientation, imageData))
+            {
+                throw std::runtime_error("destination buffer too small");
+            }
+        }
+
+        m_statistics->AddBytesCopied(imageData.size);
+    }
+
+    bool RawImageController::IsHalfSizeSufficient(const libraw_image_sizes_t& sizes, const int resizeLongSideLength)
+    {
+        if (resizeLongSideLength <= 0)
+        {
+            // 書き出しなど、縮小しない場合はフル解像度でデモザイクする
+            return false;
+        }
+
+        const int sensorLongSideLength = (std::max)(static_cast<int>(sizes.width), static_cast<int>(sizes.height));
+        return resizeLongSideLength <= sensorLongSideLength / 2;
+    }
+
+    void RawImageController::OpenFile(LibRaw& rawProcessor, const wchar_t* path) const
+    {
+        ScopedStageTimer timer(*m_statistics, DecodeStage::RawOpen);
+
+        // プールのインスタンスは前回指定した向きが残るため、sizes.flipがRAWに記録された向きとなるよう戻してから開く
+        rawProcessor.imgdata.params.user_flip = -1;
+
+#ifdef _WIN32
+        const int result = rawProcessor.open_file(path);
+#else
+        // Windows以外のLibRawはワイド文字列のパスを受け付けない
+        const int result = rawProcessor.open_file(IO::ToUtf8Path(path).c_str());
+#endif
+        if (result != LIBRAW_SUCCESS)
+        {
+            throw std::runtime_error("open_file failed");
+        }
+    }
+
+    int RawImageController::SelectLargestThumbnail(const LibRaw& rawProcessor)
+    {
+        int selectedIndex = -1;
+
+#if LIBRAW_COMPILE_CHECK_VERSION_NOTLESS(0, 21)
+        const auto& thumbnailList = rawProcessor.imgdata.thumbs_list;
+        long long selectedArea = 0;
+        for (int i = 0; i < thumbnailList.thumbcount; ++i)
+        {
+            const auto& item = thumbnailList.thumblist[i];
+            if (item.tformat != LIBRAW_THUMBNAIL_JPEG && item.tformat != LIBRAW_THUMBNAIL_BITMAP)
+            {
+                continue;
+            }
+
+            const long long area = static_cast<long long>(item.twidth) * item.theight;
+            if (area > selectedArea)
+            {
+                selectedArea = area;
+                selectedIndex = i;
+            }
+        }
+#else
+        (void)rawProcessor;
+#endif
+
+        return selectedIndex;
+    }
+
+    void RawImageController::ReadMetadata(const LibRaw& rawProcessor, ImageMetadata& metadata)
+    {
+        const auto& imgdata = rawProcessor.imgdata;
+        Decode::ClearImageMetadata(metadata);
+
+        metadata.width = imgdata.sizes.width;
+        metadata.height = imgdata.sizes.height;
+        metadata.bitDepth = static_cast<int>(imgdata.color.raw_bps);
+
+        metadata.orientation = ToExifOrientation(imgdata.sizes.flip);
+
+        metadata.exposureTime = imgdata.other.shutter;
+        metadata.fNumber = imgdata.other.aperture;
+        metadata.isoSpeed = static_cast<int>(std::lround(imgdata.other.iso_speed));
+        metadata.focalLength = imgdata.other.focal_len;
+        metadata.focalLengthIn35mm = imgdata.lens.FocalLengthIn35mmFormat;
+
+        // 記録がない場合、LibRawは-1を設定する
+        metadata.exposureProgram = imgdata.shootinginfo.ExposureProgram;
+        metadata.meteringMode = imgdata.shootinginfo.MeteringMode;
+
+        CopyText(metadata.make, imgdata.idata.make);
+        CopyText(metadata.model, imgdata.idata.model);
+
+        // LibRawは撮影日時をローカル時刻として解釈したtime_tで保持する
+        const auto timestamp = static_cast<std::time_t>(imgdata.other.timestamp);
+        std::tm localTime{};
+#ifdef _WIN32
+        const bool hasLocalTime = timestamp > 0 && localtime_s(&localTime, &timestamp) == 0;
+#else
+        const bool hasLocalTime = timestamp > 0 && localtime_r(&timestamp, &localTime) != nullptr;
+#endif
+        if (hasLocalTime)
+        {
+            std::strftime(metadata.dateTime, sizeof(metadata.dateTime), "%Y:%m:%d %H:%M:%S", &localTime);
+        }
+    }
+
+    cv::ImreadModes RawImageController::GetImreadMode(const libraw_processed_image_t& thumbnail, const int resizeLongSideLength)
+    {
+        // LibRawが取得するサムネイルのサイズは機種によって実際のJPEGと異なるため、JPEGのヘッダーから読み取る
+        Decode::ImageHeader header;
+        Decode::ReadImageHeader(thumbnail.data, thumbnail.data_size, header);
+        return Decode::PlanDecode(header, resizeLongSideLength).imreadMode;
+    }
 }
\ No newline at end of file
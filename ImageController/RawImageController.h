@@ -6,9 +6,15 @@
 #pragma once
 
 #include "IImageController.h"
+#include "ImageDataWriter.h"
+#include "RawProcessorPool.h"
+#include "DecodeStatistics.h"
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include <libraw/libraw_types.h>
 
+class LibRaw;
+
 namespace Kchary::ImageController::RawImageControl
 {
 	class RawImageController final : public IImageController
@@ -16,8 +22,11 @@ namespace Kchary::ImageController::RawImageControl
 	public:
 		/*!
 		 * @brief コンストラクタ
+		 * @param bufferPool			画素バッファの貸し出し元
+		 * @param rawProcessorPool	LibRawインスタンスの貸し出し元
+		 * @param statistics			統計情報の記録先
 		 */
-		RawImageController() = default;
+		RawImageController(std::shared_ptr<Memory::BufferPool> bufferPool, std::shared_ptr<RawProcessorPool> rawProcessorPool, std::shared_ptr<Diagnostics::DecodeStatistics> statistics);
 
 		/*!
 		* @brief デストラクタ
@@ -29,19 +38,105 @@ namespace Kchary::ImageController::RawImageControl
 		 * @param	path							画像パス
 		 * @param	imageReadSettings	画像設定
 		 * @param	imageData				画像データ(out)
+		 * @param	metadata				メタデータ(out。nullptrの場合は取得しない。open_file後のimgdataから読み取る)
+		 * @param	cancellationToken		中断要求(nullptrの場合は中断しない)
+		 * @return	成功: True, 失敗: False(中断した場合を含む)
+		 * @note	サムネイルモード以外でresizeLongSideLengthがセンサーの長辺の半分以下の場合は、ハーフサイズでデモザイクしてから縮小する。
+		 *			フル解像度が必要な場合(書き出しなど)はresizeLongSideLengthを0にすること。
+		 *			中断要求は各工程の区切りに加えて、LibRawの進捗コールバックでも確認し、dcraw_processの途中で打ち切る
+		 */
+		bool GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata* metadata, const Threading::CancellationToken* cancellationToken) override;
+
+		/*!
+		 * @brief	RAWファイルに埋め込まれた最大のプレビュー画像を取得する(デモザイク処理を行わないため高速)
+		 * @param	path							画像パス
+		 * @param	imageReadSettings	画像設定(resizeLongSideLengthが0より大きい場合はその長さに縮小する)
+		 * @param	imageData				画像データ(out)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool GetPreviewImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData) override;
+
+		/*!
+		 * @brief	デモザイク後の画像サイズを取得する(open_fileのみ行う)
+		 * @param	path	画像パス
+		 * @param	width	幅(out。回転を適用後)
+		 * @param	height	高さ(out。回転を適用後)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool GetImageSize(const wchar_t* path, int& width, int& height) override;
+
+		/*!
+		 * @brief	メタデータを取得する(open_fileのみ行う)
+		 * @param	path		画像パス
+		 * @param	metadata	メタデータ(out)
 		 * @return	成功: True, 失敗: False
 		 */
-		bool GetImageData(const wchar_t* path, const ImageReadSettings& imageReadSettings, ImageData& imageData) override;
+		bool GetImageMetadata(const wchar_t* path, ImageMetadata& metadata) override;
 
 	private:
+		/*!
+		 * @brief	埋め込みプレビューを展開する
+		 * @param	rawProcessor	LibRawインスタンス(open_file済み)
+		 * @param	thumbnailIndex	プレビューのインデックス(負の場合は既定のプレビュー)
+		 */
+		void UnpackThumbnail(LibRaw& rawProcessor, const int thumbnailIndex) const;
+
+		/*!
+		 * @brief	展開済みのサムネイルをデコードする
+		 * @param	rawProcessor			LibRawインスタンス(unpack_thumb済み)
+		 * @param	resizeLongSideLength	リサイズする長辺の長さ(JPEGの場合、これを下回らない範囲で縮小デコードする。0以下の場合は等倍)
+		 * @return	BGRの画像
+		 */
+		cv::Mat DecodeThumbnail(LibRaw& rawProcessor, const int resizeLongSideLength) const;
+
+		/*!
+		 * @brief	画像を必要に応じて縮小し、指定した向きに回転・反転しながら書き込み先へ出力する
+		 * @param	image					画像
+		 * @param	resizeLongSideLength	リサイズする長辺の長さ(0以下の場合はリサイズしない)
+		 * @param	orientation				適用するEXIFの向き(1～8)
+		 * @param	imageData				画像データ(out)
+		 */
+		void WriteOutput(const cv::Mat& image, const int resizeLongSideLength, const int orientation, ImageData& imageData) const;
+
+		/*!
+		 * @brief	ハーフサイズのデモザイク結果で表示サイズを満たせるか判定する
+		 * @param	sizes					画像サイズ(open_file済みのLibRawから取得したもの)
+		 * @param	resizeLongSideLength	リサイズする長辺の長さ(0以下の場合はフル解像度)
+		 * @return	ハーフサイズで十分: True
+		 */
+		static bool IsHalfSizeSufficient(const libraw_image_sizes_t& sizes, const int resizeLongSideLength);
+
+		/*!
+		 * @brief	RAWファイルを開く(失敗した場合は例外を送出する)
+		 * @param	rawProcessor	LibRawインスタンス
+		 * @param	path			画像パス
+		 */
+		void OpenFile(LibRaw& rawProcessor, const wchar_t* path) const;
+
+		/*!
+		 * @brief	埋め込みプレビューのうち最大のもののインデックスを取得する
+		 * @param	rawProcessor	LibRawインスタンス(open_file済み)
+		 * @return	インデックス(一覧を取得できない場合は-1)
+		 */
+		static int SelectLargestThumbnail(const LibRaw& rawProcessor);
+
+		/*!
+		 * @brief	open_file済みのLibRawからメタデータを読み取る
+		 * @param	rawProcessor	LibRawインスタンス(open_file済み)
+		 * @param	metadata		メタデータ(out。ホワイトバランスはLibRawがEXIFの値を保持しないため記録なしとする)
+		 */
+		static void ReadMetadata(const LibRaw& rawProcessor, ImageMetadata& metadata);
+
 		/*!
 		 * @brief    画像取得モード(OpenCV)を取得する
-		 * @param   thumbnail: サムネイル画像データ
-		 * @param    resizeLongSideLength: リサイズする長辺の長さ
+		 * @param   thumbnail: JPEGのサムネイル画像データ
+		 * @param    resizeLongSideLength: リサイズする長辺の長さ(0以下の場合は等倍)
 		 * @return    ImreadModes
 		 */
-		static cv::ImreadModes GetImreadMode(const libraw_thumbnail_t& thumbnail, const int resizeLongSideLength);
+		static cv::ImreadModes GetImreadMode(const libraw_processed_image_t& thumbnail, const int resizeLongSideLength);
 
-		cv::Mat m_image;	//!< 画像
+		Common::ImageDataWriter m_imageDataWriter;				//!< 画像データの書き込み
+		std::shared_ptr<RawProcessorPool> m_rawProcessorPool;	//!< LibRawインスタンスのプール
+		std::shared_ptr<Diagnostics::DecodeStatistics> m_statistics;	//!< 統計情報の記録先
 	};
 }
\ No newline at end of file
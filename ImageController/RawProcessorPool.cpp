@@ -0,0 +1,73 @@
+﻿/*!
+ * @file	RawProcessorPool.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "RawProcessorPool.h"
+#include <algorithm>		// std::max
+#include <thread>			// std::thread::hardware_concurrency
+#include <libraw/libraw.h>	// LibRaw本体
+
+namespace Kchary::ImageController::RawImageControl
+{
+	RawProcessorPool::Lease::Lease(RawProcessorPool& pool, std::unique_ptr<LibRaw> processor) noexcept
+		: m_pool(pool)
+		, m_processor(std::move(processor))
+	{
+	}
+
+	RawProcessorPool::Lease::~Lease()
+	{
+		if (m_processor)
+		{
+			m_processor->recycle();
+			m_pool.Return(std::move(m_processor));
+		}
+	}
+
+	RawProcessorPool::RawProcessorPool(size_t maxIdleCount)
+		: m_maxIdleCount(maxIdleCount > 0 ? maxIdleCount : (std::max)(1u, std::thread::hardware_concurrency()))
+	{
+	}
+
+	RawProcessorPool::~RawProcessorPool() = default;
+
+	RawProcessorPool::Lease RawProcessorPool::Acquire()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_idleProcessors.empty())
+			{
+				auto processor = std::move(m_idleProcessors.back());
+				m_idleProcessors.pop_back();
+				m_reuseCount.fetch_add(1, std::memory_order_relaxed);
+				return Lease(*this, std::move(processor));
+			}
+		}
+
+		m_constructedCount.fetch_add(1, std::memory_order_relaxed);
+		return Lease(*this, std::make_unique<LibRaw>());
+	}
+
+	RawProcessorStatistics RawProcessorPool::GetStatistics() const noexcept
+	{
+		return { m_constructedCount.load(std::memory_order_relaxed), m_reuseCount.load(std::memory_order_relaxed) };
+	}
+
+	void RawProcessorPool::Return(std::unique_ptr<LibRaw> processor) noexcept
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_idleProcessors.size() < m_maxIdleCount)
+		{
+			try
+			{
+				m_idleProcessors.emplace_back(std::move(processor));
+			}
+			catch (...)
+			{
+				// 保持できない場合は破棄する
+			}
+		}
+	}
+}
@@ -0,0 +1,85 @@
+﻿/*!
+ * @file	RawProcessorPool.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class LibRaw;
+
+namespace Kchary::ImageController::RawImageControl
+{
+	/*!
+	 * @brief LibRawインスタンスのプール
+	 * @note LibRawは内部テーブルが大きく生成・破棄のコストが高いため、recycle()して使い回す。
+	 *       同時に使用するスレッド数分だけ生成されるため、実質ワーカースレッドごとに1つとなる
+	 */
+	class RawProcessorPool final
+	{
+	public:
+		/*!
+		 * @brief 貸し出し中のLibRawインスタンス(破棄時にrecycle()してプールへ返却する)
+		 */
+		class Lease final
+		{
+		public:
+			Lease(RawProcessorPool& pool, std::unique_ptr<LibRaw> processor) noexcept;
+			~Lease();
+
+			Lease(const Lease&) = delete;
+			Lease& operator=(const Lease&) = delete;
+
+			LibRaw* operator->() const noexcept { return m_processor.get(); }
+			LibRaw& operator*() const noexcept { return *m_processor; }
+
+		private:
+			RawProcessorPool& m_pool;				//!< 貸し出し元
+			std::unique_ptr<LibRaw> m_processor;	//!< LibRawインスタンス
+		};
+
+		/*!
+		 * @brief コンストラクタ
+		 * @param maxIdleCount	プールに保持する最大数(0: 論理コア数)
+		 */
+		explicit RawProcessorPool(size_t maxIdleCount);
+
+		/*!
+		 * @brief デストラクタ
+		 */
+		~RawProcessorPool();
+
+		RawProcessorPool(const RawProcessorPool&) = delete;
+		RawProcessorPool& operator=(const RawProcessorPool&) = delete;
+
+		/*!
+		 * @brief	LibRawインスタンスを借りる(空きがない場合は生成する)
+		 * @return	貸し出し中のLibRawインスタンス
+		 */
+		Lease Acquire();
+
+		/*!
+		 * @brief	統計情報を取得する
+		 * @return	統計情報
+		 */
+		RawProcessorStatistics GetStatistics() const noexcept;
+
+	private:
+		/*!
+		 * @brief	LibRawインスタンスを返却する
+		 * @param	processor	LibRawインスタンス(recycle済み)
+		 */
+		void Return(std::unique_ptr<LibRaw> processor) noexcept;
+
+		mutable std::mutex m_mutex;							//!< ミューテックス
+		std::vector<std::unique_ptr<LibRaw>> m_idleProcessors;	//!< 未使用のLibRawインスタンス
+		const size_t m_maxIdleCount;						//!< プールに保持する最大数
+		std::atomic<size_t> m_constructedCount{ 0 };		//!< 生成した回数
+		std::atomic<size_t> m_reuseCount{ 0 };				//!< 再利用した回数
+	};
+}
@@ -0,0 +1,172 @@
+/*!
+ * @file	SharedMemory.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "SharedMemory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Kchary::ImageController::IO
+{
+	SharedMemory::~SharedMemory()
+	{
+		Close();
+	}
+
+#ifdef _WIN32
+	bool SharedMemory::Create(size_t size)
+	{
+		Close();
+		if (size == 0)
+		{
+			return false;
+		}
+
+		// 子プロセスへ引き継ぐため継承可能にする(引き継ぐ子プロセスは起動時にハンドルの一覧で限定する)
+		SECURITY_ATTRIBUTES securityAttributes{ sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+		const auto size64 = static_cast<unsigned long long>(size);
+		m_mappingHandle = ::CreateFileMappingW(INVALID_HANDLE_VALUE, &securityAttributes, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), nullptr);
+		if (!m_mappingHandle)
+		{
+			return false;
+		}
+
+		return Map(size);
+	}
+
+	bool SharedMemory::Attach(std::intptr_t handle, size_t size)
+	{
+		Close();
+		if (handle == 0 || handle == -1 || size == 0)
+		{
+			return false;
+		}
+
+		m_mappingHandle = reinterpret_cast<HANDLE>(handle);
+		return Map(size);
+	}
+
+	bool SharedMemory::Map(size_t size)
+	{
+		void* view = ::MapViewOfFile(m_mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (!view)
+		{
+			Close();
+			return false;
+		}
+
+		m_data = static_cast<std::byte*>(view);
+		m_size = size;
+		return true;
+	}
+
+	void SharedMemory::Close() noexcept
+	{
+		if (m_data)
+		{
+			::UnmapViewOfFile(m_data);
+			m_data = nullptr;
+		}
+		if (m_mappingHandle)
+		{
+			::CloseHandle(m_mappingHandle);
+			m_mappingHandle = nullptr;
+		}
+		m_size = 0;
+	}
+
+	std::intptr_t SharedMemory::GetHandle() const noexcept
+	{
+		return m_mappingHandle ? reinterpret_cast<std::intptr_t>(m_mappingHandle) : -1;
+	}
+#else
+	bool SharedMemory::Create(size_t size)
+	{
+		Close();
+		if (size == 0)
+		{
+			return false;
+		}
+
+		// 一意な名前で作成し、直後に名前を削除する(プロセスが異常終了しても共有メモリが残らない)
+		static std::atomic<unsigned int> sequence{ 0 };
+		const std::string name = "/kchary-shm-" + std::to_string(::getpid()) + "-" + std::to_string(sequence.fetch_add(1));
+		m_fileDescriptor = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		if (m_fileDescriptor < 0)
+		{
+			return false;
+		}
+		::shm_unlink(name.c_str());
+
+		int result = 0;
+		do
+		{
+			result = ::ftruncate(m_fileDescriptor, static_cast<off_t>(size));
+		} while (result != 0 && errno == EINTR);
+		if (result != 0)
+		{
+			Close();
+			return false;
+		}
+
+		return Map(size);
+	}
+
+	bool SharedMemory::Attach(std::intptr_t handle, size_t size)
+	{
+		Close();
+		if (handle < 0 || size == 0)
+		{
+			return false;
+		}
+
+		m_fileDescriptor = static_cast<int>(handle);
+		return Map(size);
+	}
+
+	bool SharedMemory::Map(size_t size)
+	{
+		void* view = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fileDescriptor, 0);
+		if (view == MAP_FAILED)
+		{
+			Close();
+			return false;
+		}
+
+		m_data = static_cast<std::byte*>(view);
+		m_size = size;
+		return true;
+	}
+
+	void SharedMemory::Close() noexcept
+	{
+		if (m_data)
+		{
+			::munmap(m_data, m_size);
+			m_data = nullptr;
+		}
+		if (m_fileDescriptor >= 0)
+		{
+			::close(m_fileDescriptor);
+			m_fileDescriptor = -1;
+		}
+		m_size = 0;
+	}
+
+	std::intptr_t SharedMemory::GetHandle() const noexcept
+	{
+		return m_fileDescriptor;
+	}
+#endif
+}
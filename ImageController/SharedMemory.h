@@ -0,0 +1,78 @@
+/*!
+ * @file	SharedMemory.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Kchary::ImageController::IO
+{
+	/*!
+	 * @brief 子プロセスと共有する読み書き可能なメモリ
+	 * @note 名前を持たないため、作成したプロセスと、ハンドル(Windows以外はファイルディスクリプタ)を引き継いだ子プロセスからのみ参照できる
+	 */
+	class SharedMemory final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 */
+		SharedMemory() = default;
+
+		/*!
+		 * @brief デストラクタ
+		 */
+		~SharedMemory();
+
+		SharedMemory(const SharedMemory&) = delete;
+		SharedMemory& operator=(const SharedMemory&) = delete;
+
+		/*!
+		 * @brief	子プロセスへ引き継げる共有メモリを作成してマップする
+		 * @param	size	バイト数
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Create(size_t size);
+
+		/*!
+		 * @brief	親プロセスから引き継いだ共有メモリをマップする
+		 * @param	handle	引き継いだハンドル(GetHandle()の値。Windows以外は子プロセスでのファイルディスクリプタ)
+		 * @param	size	バイト数(作成時と同じ値)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Attach(std::intptr_t handle, size_t size);
+
+		/*!
+		 * @brief	マップを解除して閉じる
+		 */
+		void Close() noexcept;
+
+		/*!
+		 * @brief	子プロセスへ引き継ぐハンドルを取得する
+		 * @return	ハンドル(HANDLE。Windows以外はファイルディスクリプタ。開いていない場合は-1)
+		 */
+		std::intptr_t GetHandle() const noexcept;
+
+		std::byte* data() const noexcept { return m_data; }
+		size_t size() const noexcept { return m_size; }
+
+	private:
+		/*!
+		 * @brief	開いたハンドルをマップする
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Map(size_t size);
+
+		std::byte* m_data = nullptr;			//!< マップした領域の先頭
+		size_t m_size = 0;						//!< バイト数
+
+#ifdef _WIN32
+		void* m_mappingHandle = nullptr;		//!< ファイルマッピングハンドル(HANDLE)
+#else
+		int m_fileDescriptor = -1;				//!< 共有メモリのファイルディスクリプタ
+#endif
+	};
+}
@@ -0,0 +1,111 @@
+﻿/*!
+ * @file	SimdSupport.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "SimdSupport.h"
+
+#if defined(KCHARY_SIMD_X86) && !(defined(_MSC_VER) && !defined(__clang__))
+#include <cpuid.h>
+#endif
+
+namespace Kchary::ImageController::Simd
+{
+#ifdef KCHARY_SIMD_X86
+	namespace
+	{
+		/*!
+		 * @brief CPUの対応命令
+		 */
+		struct CpuFeatures
+		{
+			bool hasSsse3 = false;
+			bool hasAvx2 = false;
+		};
+
+		/*!
+		 * @brief	CPUID命令を実行する
+		 */
+		void QueryCpuId(int registers[4], int leaf, int subLeaf) noexcept
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			__cpuidex(registers, leaf, subLeaf);
+#else
+			unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+			__cpuid_count(leaf, subLeaf, eax, ebx, ecx, edx);
+			registers[0] = static_cast<int>(eax);
+			registers[1] = static_cast<int>(ebx);
+			registers[2] = static_cast<int>(ecx);
+			registers[3] = static_cast<int>(edx);
+#endif
+		}
+
+		/*!
+		 * @brief	XCR0レジスタを読み出す
+		 */
+		unsigned long long ReadXcr0() noexcept
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			return _xgetbv(0);
+#else
+			unsigned int eax = 0, edx = 0;
+			__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+		}
+
+		CpuFeatures DetectCpuFeatures() noexcept
+		{
+			CpuFeatures features;
+
+			int registers[4] = {};
+			QueryCpuId(registers, 0, 0);
+			const int maxLeaf = registers[0];
+			if (maxLeaf < 1)
+			{
+				return features;
+			}
+
+			QueryCpuId(registers, 1, 0);
+			features.hasSsse3 = (registers[2] & (1 << 9)) != 0;
+
+			const bool hasOsxsave = (registers[2] & (1 << 27)) != 0;
+			const bool hasAvx = (registers[2] & (1 << 28)) != 0;
+			if (maxLeaf >= 7 && hasOsxsave && hasAvx && (ReadXcr0() & 0x6) == 0x6)
+			{
+				QueryCpuId(registers, 7, 0);
+				features.hasAvx2 = (registers[1] & (1 << 5)) != 0;
+			}
+
+			return features;
+		}
+
+		const CpuFeatures& GetCpuFeatures() noexcept
+		{
+			static const CpuFeatures features = DetectCpuFeatures();
+			return features;
+		}
+	}
+
+	bool HasSsse3() noexcept
+	{
+		return GetCpuFeatures().hasSsse3;
+	}
+
+	bool HasAvx2() noexcept
+	{
+		return GetCpuFeatures().hasAvx2;
+	}
+#else
+	bool HasSsse3() noexcept
+	{
+		return false;
+	}
+
+	bool HasAvx2() noexcept
+	{
+		return false;
+	}
+#endif
+}
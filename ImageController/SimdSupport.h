@@ -0,0 +1,38 @@
+﻿/*!
+ * @file	SimdSupport.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+// SIMD命令セットの判定と、関数単位で命令セットを有効にするための定義
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define KCHARY_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define KCHARY_TARGET_SSSE3
+#define KCHARY_TARGET_AVX2
+#else
+#define KCHARY_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define KCHARY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define KCHARY_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace Kchary::ImageController::Simd
+{
+	/*!
+	 * @brief	SSSE3が使用できるか
+	 * @return	使用可能: True
+	 */
+	bool HasSsse3() noexcept;
+
+	/*!
+	 * @brief	AVX2が使用できるか(OSがYMMレジスタを保存するかも確認する)
+	 * @return	使用可能: True
+	 */
+	bool HasAvx2() noexcept;
+}
@@ -0,0 +1,119 @@
+/*!
+ * @file	SpscQueue.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace Kchary::ImageController::Threading
+{
+	/*!
+	 * @brief 送り手・受け手が1スレッドずつのロックフリーなリングバッファ
+	 * @note 受け手はロックを取らずに取り出せるため、UIスレッドから定期的に取り出しても送り手を止めない。
+	 *		 送り手・受け手がそれぞれ同時に1スレッドであれば、スレッドは入れ替わってよい(入れ替え時に同期すること)
+	 */
+	template <typename T>
+	class SpscQueue final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param capacity	最大要素数(2のべき乗に切り上げる)
+		 */
+		explicit SpscQueue(size_t capacity)
+			: m_slots(RoundUpToPowerOfTwo(capacity))
+			, m_mask(m_slots.size() - 1)
+		{
+		}
+
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+
+		/*!
+		 * @brief	要素を積む(送り手のスレッドから呼ぶ)
+		 * @param	item	要素(積めた場合のみムーブする)
+		 * @return	積んだ: True, 満杯: False
+		 */
+		bool TryPush(T& item)
+		{
+			const size_t tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_cachedHead == m_slots.size())
+			{
+				// 受け手の位置は満杯に見えたときのみ読み直し、キャッシュラインの行き来を減らす
+				m_cachedHead = m_head.load(std::memory_order_acquire);
+				if (tail - m_cachedHead == m_slots.size())
+				{
+					return false;
+				}
+			}
+
+			m_slots[tail & m_mask] = std::move(item);
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		/*!
+		 * @brief	要素を取り出す(受け手のスレッドから呼ぶ)
+		 * @param	item	要素(out)
+		 * @return	取り出した: True, 空: False
+		 */
+		bool TryPop(T& item)
+		{
+			const size_t head = m_head.load(std::memory_order_relaxed);
+			if (head == m_cachedTail)
+			{
+				m_cachedTail = m_tail.load(std::memory_order_acquire);
+				if (head == m_cachedTail)
+				{
+					return false;
+				}
+			}
+
+			item = std::move(m_slots[head & m_mask]);
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		/*!
+		 * @brief	空か(受け手のスレッドから呼ぶ)
+		 * @return	空: True
+		 */
+		bool IsEmpty() const noexcept
+		{
+			return m_head.load(std::memory_order_relaxed) == m_tail.load(std::memory_order_acquire);
+		}
+
+	private:
+		static constexpr size_t CacheLineSize = 64;	//!< 送り手・受け手の変数を分けるキャッシュラインのサイズ
+
+		/*!
+		 * @brief	2のべき乗に切り上げる
+		 * @param	value	値
+		 * @return	value以上で最小の2のべき乗(2以上)
+		 */
+		static size_t RoundUpToPowerOfTwo(size_t value) noexcept
+		{
+			size_t result = 2;
+			while (result < value)
+			{
+				result <<= 1;
+			}
+			return result;
+		}
+
+		std::vector<T> m_slots;								//!< 要素
+		const size_t m_mask;								//!< 位置からスロットを求めるマスク
+
+		std::byte m_headPadding[CacheLineSize]{};			//!< 送り手・受け手の変数が同じキャッシュラインに載らないようにする
+		std::atomic<size_t> m_head{ 0 };					//!< 次に取り出す位置(受け手が更新する)
+		size_t m_cachedTail = 0;							//!< 受け手が最後に読んだ送り手の位置
+
+		std::byte m_tailPadding[CacheLineSize]{};			//!< 送り手・受け手の変数が同じキャッシュラインに載らないようにする
+		std::atomic<size_t> m_tail{ 0 };					//!< 次に積む位置(送り手が更新する)
+		size_t m_cachedHead = 0;							//!< 送り手が最後に読んだ受け手の位置
+	};
+}
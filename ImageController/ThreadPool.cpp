@@ -0,0 +1,161 @@
+﻿/*!
+ * @file	ThreadPool.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "ThreadPool.h"
+#include <algorithm>	// std::max
+
+namespace Kchary::ImageController::Threading
+{
+	namespace
+	{
+		thread_local const ThreadPool* t_ownerPool = nullptr;	//!< 現在のスレッドが属するプール
+		thread_local size_t t_workerIndex = 0;					//!< 現在のスレッドのワーカー番号
+	}
+
+	ThreadPool::ThreadPool(unsigned int threadCount, size_t queueDepth)
+		: m_queueDepth(queueDepth)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+		}
+
+		m_queues.reserve(threadCount);
+		for (unsigned int i = 0; i < threadCount; ++i)
+		{
+			m_queues.emplace_back(std::make_unique<WorkQueue>());
+		}
+
+		m_workers.reserve(threadCount);
+		for (unsigned int i = 0; i < threadCount; ++i)
+		{
+			m_workers.emplace_back(&ThreadPool::WorkerLoop, this, static_cast<size_t>(i));
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_stateMutex);
+			m_isStopping = true;
+		}
+		m_workAvailable.notify_all();
+		m_spaceAvailable.notify_all();
+
+		for (auto& worker : m_workers)
+		{
+			if (worker.joinable())
+			{
+				worker.join();
+			}
+		}
+	}
+
+	void ThreadPool::Submit(Task task)
+	{
+		const bool isWorkerThread = (t_ownerPool == this);
+
+		{
+			std::unique_lock<std::mutex> lock(m_stateMutex);
+			if (m_queueDepth > 0 && !isWorkerThread)
+			{
+				m_spaceAvailable.wait(lock, [this]() { return m_isStopping || m_pendingCount < m_queueDepth; });
+			}
+			++m_pendingCount;
+		}
+
+		// ワーカーからの登録は自身のキューへ積み、キャッシュの局所性を保つ
+		const size_t queueIndex = isWorkerThread
+			? t_workerIndex
+			: m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+
+		{
+			auto& queue = *m_queues[queueIndex];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.emplace_back(std::move(task));
+		}
+
+		m_workAvailable.notify_one();
+	}
+
+	bool ThreadPool::IsWorkerThread() const noexcept
+	{
+		return t_ownerPool == this;
+	}
+
+	void ThreadPool::WorkerLoop(size_t index)
+	{
+		t_ownerPool = this;
+		t_workerIndex = index;
+
+		while (true)
+		{
+			Task task;
+			if (TryTakeTask(index, task))
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_stateMutex);
+					--m_pendingCount;
+				}
+				m_spaceAvailable.notify_one();
+
+				try
+				{
+					task();
+				}
+				catch (...)
+				{
+					// タスク内の例外でワーカーを停止させない
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_stateMutex);
+			if (m_isStopping && m_pendingCount == 0)
+			{
+				break;
+			}
+			m_workAvailable.wait(lock, [this]() { return m_isStopping || m_pendingCount > 0; });
+			if (m_isStopping && m_pendingCount == 0)
+			{
+				break;
+			}
+		}
+
+		t_ownerPool = nullptr;
+	}
+
+	bool ThreadPool::TryTakeTask(size_t index, Task& task)
+	{
+		// 自身のキューは末尾(LIFO)から取り出す
+		{
+			auto& queue = *m_queues[index];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty())
+			{
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+				return true;
+			}
+		}
+
+		// 他のワーカーのキューは先頭(FIFO)から盗む
+		const size_t queueCount = m_queues.size();
+		for (size_t offset = 1; offset < queueCount; ++offset)
+		{
+			auto& victim = *m_queues[(index + offset) % queueCount];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty())
+			{
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
@@ -0,0 +1,104 @@
+﻿/*!
+ * @file	ThreadPool.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Kchary::ImageController::Threading
+{
+	/*!
+	 * @brief ワークスティーリング方式のスレッドプール
+	 * @note 各ワーカーは自身のキューの末尾からタスクを取り出し、空になったら他のワーカーのキューの先頭から盗む
+	 */
+	class ThreadPool final
+	{
+	public:
+		using Task = std::function<void()>;
+
+		/*!
+		 * @brief コンストラクタ
+		 * @param threadCount	ワーカースレッド数(0: 論理コア数)
+		 * @param queueDepth	未処理タスクの上限数(0: 無制限)
+		 */
+		ThreadPool(unsigned int threadCount, size_t queueDepth);
+
+		/*!
+		 * @brief デストラクタ(キューに残ったタスクを処理してから停止する)
+		 */
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/*!
+		 * @brief	タスクを登録する
+		 * @param	task	タスク
+		 * @note	未処理タスクが上限に達している場合は空きができるまでブロックする(ワーカースレッドからの登録は除く)
+		 */
+		void Submit(Task task);
+
+		/*!
+		 * @brief	ワーカースレッド数を取得する
+		 * @return	ワーカースレッド数
+		 */
+		unsigned int GetThreadCount() const noexcept { return static_cast<unsigned int>(m_workers.size()); }
+
+		/*!
+		 * @brief	未処理タスクの上限数を取得する
+		 * @return	上限数(0: 無制限)
+		 */
+		size_t GetQueueDepth() const noexcept { return m_queueDepth; }
+
+		/*!
+		 * @brief	現在のスレッドがこのプールのワーカースレッドか
+		 * @return	ワーカースレッド: True
+		 * @note	ワーカースレッドから自身のプールのタスク完了を待つとデッドロックするため、待つ側で確認する
+		 */
+		bool IsWorkerThread() const noexcept;
+
+	private:
+		/*!
+		 * @brief ワーカーごとのタスクキュー
+		 */
+		struct WorkQueue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		/*!
+		 * @brief	ワーカースレッドの処理
+		 * @param	index	ワーカー番号
+		 */
+		void WorkerLoop(size_t index);
+
+		/*!
+		 * @brief	実行するタスクを取得する(自身のキュー → 他のワーカーのキューの順)
+		 * @param	index	ワーカー番号
+		 * @param	task	タスク(out)
+		 * @return	取得できた: True, キューが空: False
+		 */
+		bool TryTakeTask(size_t index, Task& task);
+
+		std::vector<std::unique_ptr<WorkQueue>> m_queues;	//!< ワーカーごとのタスクキュー
+		std::vector<std::thread> m_workers;					//!< ワーカースレッド
+		const size_t m_queueDepth;							//!< 未処理タスクの上限数
+
+		std::mutex m_stateMutex;							//!< 状態管理用ミューテックス
+		std::condition_variable m_workAvailable;			//!< タスク登録通知
+		std::condition_variable m_spaceAvailable;			//!< キュー空き通知
+		size_t m_pendingCount = 0;							//!< 未処理タスク数
+		bool m_isStopping = false;							//!< 停止要求フラグ
+		std::atomic<size_t> m_nextQueue{ 0 };				//!< 外部スレッドからの登録先(ラウンドロビン)
+	};
+}
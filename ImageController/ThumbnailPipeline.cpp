@@ -0,0 +1,523 @@
+/*!
+ * @file	ThumbnailPipeline.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "ThumbnailPipeline.h"
+#include "ImageReader.h"
+#include "BoundedQueue.h"
+#include "SpscQueue.h"
+#include "CancellationToken.h"
+#include "MappedFile.h"
+#include "PerceptualHash.h"
+#include <algorithm>	// std::min, std::max
+#include <atomic>
+#include <chrono>
+#include <cwctype>		// std::towlower
+#include <filesystem>
+#include <functional>
+#include <iostream>		// std::cerr
+#include <thread>
+
+namespace Kchary::ImageController::Library
+{
+	namespace
+	{
+		constexpr unsigned int DefaultReadThreadCount = 2;				//!< 既定の読み込みスレッド数(同時に多数読むとHDDではシークが増えるため少なくする)
+		constexpr size_t DefaultOutputCapacity = 256;					//!< 取り出されていない結果を保持する既定の最大数
+		constexpr size_t PageSize = 4096;								//!< ページキャッシュへ載せる単位
+		constexpr size_t MaxRawReadAheadBytes = 1024 * 1024;			//!< RAW画像を先読みする最大バイト数(サムネイルはヘッダーと埋め込みプレビューのみ読む)
+		constexpr std::chrono::milliseconds MaxPublishWait(16);		//!< 出力キューの空きを待つ間隔の最大値
+
+		/*!
+		 * @brief	小文字に変換する
+		 * @param	text	文字列
+		 * @return	小文字の文字列
+		 */
+		std::wstring ToLower(std::wstring text)
+		{
+			std::transform(text.begin(), text.end(), text.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+			return text;
+		}
+
+		/*!
+		 * @brief	拡張子が一覧に含まれるか
+		 * @param	extension	小文字の拡張子
+		 * @param	extensions	小文字の拡張子の一覧
+		 * @return	含まれる: True
+		 */
+		bool ContainsExtension(const std::wstring& extension, const std::vector<std::wstring>& extensions)
+		{
+			return std::find(extensions.begin(), extensions.end(), extension) != extensions.end();
+		}
+
+		/*!
+		 * @brief	ファイルを先頭から読み、ページキャッシュへ載せる
+		 * @param	path		画像パス
+		 * @param	isRawImage	RAW画像か(先頭のみ読む)
+		 * @param	readBytes	読み込んだバイト数(out)
+		 * @return	成功: True, 失敗: False
+		 * @note	デコード工程は同じファイルを開き直すが、ディスクを待たずにページキャッシュから読める。
+		 *			マップしないファイル(ネットワーク上・小さいファイル)は読み込んでも再利用されないため、RAW画像の先頭以外は読まない
+		 */
+		bool ReadAhead(const wchar_t* path, bool isRawImage, unsigned long long& readBytes)
+		{
+			IO::MappedFile file;
+			if (!file.OpenPrefix(path, isRawImage ? MaxRawReadAheadBytes : 0, IO::AccessPattern::Sequential))
+			{
+				return false;
+			}
+
+			if (!file.IsMapped())
+			{
+				readBytes = file.size();
+				return true;
+			}
+
+			// ページごとに1バイトずつ参照し、OSの先読みとあわせてファイルを読み込ませる
+			const size_t size = isRawImage ? (std::min)(file.size(), MaxRawReadAheadBytes) : file.size();
+			unsigned char checksum = 0;
+			for (size_t offset = 0; offset < size; offset += PageSize)
+			{
+				checksum ^= file.data()[offset];
+			}
+			volatile unsigned char sink = checksum;
+			(void)sink;
+
+			readBytes = size;
+			return true;
+		}
+	}
+
+	/*!
+	 * @brief 工程のスレッドとキュー
+	 */
+	struct ThumbnailPipeline::Impl
+	{
+		/*!
+		 * @brief 工程間で受け渡す画像
+		 */
+		struct Item
+		{
+			ThumbnailResult result;		//!< 読み込み結果
+			bool isRawImage = false;	//!< RAW画像か
+			bool isReadable = false;	//!< 読み込み工程で開けたか
+			bool isStored = false;		//!< サムネイルストアから取得したか(デコードしない)
+		};
+
+		/*!
+		 * @brief	列挙した画像を読み込み工程へ渡す関数(閉じられた場合はFalseを返す)
+		 */
+		using EmitFunction = std::function<bool(ThumbnailSource&& source)>;
+
+		Impl(ImageReader& reader, const ThumbnailPipelineSettings& settings)
+			: imageReader(reader)
+			, readThreadCount(settings.readThreadCount > 0 ? settings.readThreadCount : DefaultReadThreadCount)
+			, decodeThreadCount(settings.decodeThreadCount > 0 ? settings.decodeThreadCount : (std::max)(1u, std::thread::hardware_concurrency()))
+			, queueDepth(settings.queueDepth > 0 ? settings.queueDepth : static_cast<size_t>(decodeThreadCount) * 2)
+			, computeImageHash(settings.computeImageHash)
+			, output(settings.outputCapacity > 0 ? settings.outputCapacity : DefaultOutputCapacity)
+		{
+		}
+
+		/*!
+		 * @brief	各工程のスレッドを起動する
+		 * @param	enumerate			列挙工程の処理(列挙した画像をEmitFunctionへ渡す)
+		 * @param	imageReadSettings	サムネイルの読み込み設定
+		 */
+		void Launch(std::function<void(const EmitFunction& emit)> enumerate, const ImageReadSettings& imageReadSettings)
+		{
+			Stop();
+
+			thumbnailSettings = imageReadSettings;
+			thumbnailSettings.useThumbnailStore = true;
+			resultsAvailable = pendingResultsAvailable;
+			cancellationToken = std::make_unique<Threading::CancellationToken>();
+			readQueue = std::make_unique<Threading::BoundedQueue<Item>>(queueDepth);
+			decodeQueue = std::make_unique<Threading::BoundedQueue<Item>>(queueDepth);
+			publishQueue = std::make_unique<Threading::BoundedQueue<Item>>(queueDepth);
+			activeReaderCount.store(readThreadCount);
+			activeDecoderCount.store(decodeThreadCount);
+			isPublishing.store(true);
+
+			enumeratedCount.store(0);
+			readCount.store(0);
+			readBytes.store(0);
+			storedCount.store(0);
+			decodedCount.store(0);
+			failedCount.store(0);
+			publishedCount.store(0);
+			hashedCount.store(0);
+
+			threads.emplace_back(&Impl::EnumerateLoop, this, std::move(enumerate));
+			for (unsigned int i = 0; i < readThreadCount; ++i)
+			{
+				threads.emplace_back(&Impl::ReadLoop, this);
+			}
+			for (unsigned int i = 0; i < decodeThreadCount; ++i)
+			{
+				threads.emplace_back(&Impl::DecodeLoop, this);
+			}
+			threads.emplace_back(&Impl::PublishLoop, this);
+		}
+
+		/*!
+		 * @brief	実行中の処理を中断し、各工程のスレッドの終了を待つ
+		 */
+		void Stop()
+		{
+			if (cancellationToken)
+			{
+				cancellationToken->Cancel();
+			}
+			for (auto* queue : { readQueue.get(), decodeQueue.get(), publishQueue.get() })
+			{
+				if (queue)
+				{
+					queue->Abort();
+				}
+			}
+
+			for (auto& thread : threads)
+			{
+				if (thread.joinable())
+				{
+					thread.join();
+				}
+			}
+			threads.clear();
+			isPublishing.store(false);
+
+			ThumbnailResult discarded;
+			while (output.TryPop(discarded))
+			{
+			}
+		}
+
+		/*!
+		 * @brief	列挙工程
+		 */
+		void EnumerateLoop(const std::function<void(const EmitFunction& emit)>& enumerate)
+		{
+			size_t index = 0;
+			try
+			{
+				enumerate([this, &index](ThumbnailSource&& source)
+					{
+						if (cancellationToken->IsCancelled())
+						{
+							return false;
+						}
+
+						Item item;
+						item.result.index = index++;
+						item.result.path = std::move(source.path);
+						item.isRawImage = source.isRawImage;
+						enumeratedCount.store(index, std::memory_order_relaxed);
+						return readQueue->Push(std::move(item));
+					});
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "ThumbnailPipeline::EnumerateLoop error: " << e.what() << std::endl;
+			}
+
+			readQueue->Close();
+		}
+
+		/*!
+		 * @brief	読み込み工程
+		 */
+		void ReadLoop()
+		{
+			Item item;
+			while (readQueue->Pop(item))
+			{
+				// サムネイルストアにある画像はファイルを読まずに、ストアの結果を出力する
+				ImageReadSettings imageReadSettings = thumbnailSettings;
+				imageReadSettings.isRawImage = item.isRawImage;
+				try
+				{
+					item.isStored = imageReader.FindStoredThumbnail(item.result.path.c_str(), imageReadSettings, item.result.imageData);
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << "ThumbnailPipeline::ReadLoop error: " << e.what() << std::endl;
+				}
+
+				if (item.isStored)
+				{
+					item.result.result = true;
+					storedCount.fetch_add(1, std::memory_order_relaxed);
+					if (!decodeQueue->Push(std::move(item)))
+					{
+						break;
+					}
+					continue;
+				}
+
+				unsigned long long bytes = 0;
+				item.isReadable = ReadAhead(item.result.path.c_str(), item.isRawImage, bytes);
+				if (item.isReadable)
+				{
+					readCount.fetch_add(1, std::memory_order_relaxed);
+					readBytes.fetch_add(bytes, std::memory_order_relaxed);
+				}
+
+				if (!decodeQueue->Push(std::move(item)))
+				{
+					break;
+				}
+			}
+
+			// 最後に終わったスレッドが次の工程へ終端を伝える
+			if (activeReaderCount.fetch_sub(1) == 1)
+			{
+				decodeQueue->Close();
+			}
+		}
+
+		/*!
+		 * @brief	デコードと縮小の工程
+		 */
+		void DecodeLoop()
+		{
+			Item item;
+			while (decodeQueue->Pop(item))
+			{
+				if (item.isReadable && !item.isStored)
+				{
+					ImageReadSettings imageReadSettings = thumbnailSettings;
+					imageReadSettings.isRawImage = item.isRawImage;
+					try
+					{
+						item.result.result = imageReader.GetImageData(item.result.path.c_str(), imageReadSettings, item.result.imageData, cancellationToken.get());
+					}
+					catch (const std::exception& e)
+					{
+						std::cerr << "ThumbnailPipeline::DecodeLoop error: " << e.what() << std::endl;
+					}
+				}
+
+				// 縮小済みのサムネイルから求めるため、ハッシュのために画像を読み直さない
+				if (computeImageHash && item.result.result && !cancellationToken->IsCancelled())
+				{
+					try
+					{
+						item.result.hasImageHash = Hashing::ComputeImageHash(item.result.imageData, item.result.imageHash);
+					}
+					catch (const std::exception& e)
+					{
+						std::cerr << "ThumbnailPipeline::DecodeLoop error: " << e.what() << std::endl;
+					}
+
+					if (item.result.hasImageHash)
+					{
+						hashedCount.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+
+				if (cancellationToken->IsCancelled())
+				{
+					break;
+				}
+
+				if (!item.isStored)
+				{
+					(item.result.result ? decodedCount : failedCount).fetch_add(1, std::memory_order_relaxed);
+				}
+				if (!publishQueue->Push(std::move(item)))
+				{
+					break;
+				}
+			}
+
+			if (activeDecoderCount.fetch_sub(1) == 1)
+			{
+				publishQueue->Close();
+			}
+		}
+
+		/*!
+		 * @brief	出力工程(出力キューへ積むのはこのスレッドのみ)
+		 */
+		void PublishLoop()
+		{
+			Item item;
+			while (publishQueue->Pop(item))
+			{
+				// 呼び出し元が取り出すまで待つ(ロックフリーのキューは通知を持たないため、間隔を広げながら確認する)
+				auto wait = std::chrono::milliseconds(1);
+				while (!output.TryPush(item.result))
+				{
+					if (cancellationToken->IsCancelled())
+					{
+						isPublishing.store(false, std::memory_order_release);
+						return;
+					}
+
+					std::this_thread::sleep_for(wait);
+					wait = (std::min)(wait * 2, MaxPublishWait);
+				}
+				publishedCount.fetch_add(1, std::memory_order_relaxed);
+				NotifyResultsAvailable();
+			}
+
+			isPublishing.store(false, std::memory_order_release);
+
+			// 中断した場合は結果を破棄するため通知しない
+			if (!cancellationToken->IsCancelled())
+			{
+				NotifyResultsAvailable();
+			}
+		}
+
+		/*!
+		 * @brief	結果を積んだことを通知する
+		 */
+		void NotifyResultsAvailable() const
+		{
+			if (!resultsAvailable)
+			{
+				return;
+			}
+
+			try
+			{
+				resultsAvailable();
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "ThumbnailPipeline::PublishLoop error: " << e.what() << std::endl;
+			}
+		}
+
+		ImageReader& imageReader;											//!< デコードに使う画像リーダー
+		const unsigned int readThreadCount;									//!< 読み込みスレッド数
+		const unsigned int decodeThreadCount;								//!< デコードスレッド数
+		const size_t queueDepth;											//!< 工程間のキューの最大要素数
+		const bool computeImageHash;										//!< 画像ハッシュを計算するか
+		Threading::SpscQueue<ThumbnailResult> output;						//!< 出力キュー(出力工程 → 呼び出し元)
+
+		ResultsAvailableCallback pendingResultsAvailable;					//!< 次回の開始から使う結果の通知先
+		ResultsAvailableCallback resultsAvailable;							//!< 実行中の処理の結果の通知先
+		ImageReadSettings thumbnailSettings{};								//!< サムネイルの読み込み設定
+		std::unique_ptr<Threading::CancellationToken> cancellationToken;	//!< 実行中の処理の中断要求
+		std::unique_ptr<Threading::BoundedQueue<Item>> readQueue;			//!< 列挙 → 読み込み
+		std::unique_ptr<Threading::BoundedQueue<Item>> decodeQueue;		//!< 読み込み → デコード
+		std::unique_ptr<Threading::BoundedQueue<Item>> publishQueue;		//!< デコード → 出力
+		std::atomic<unsigned int> activeReaderCount{ 0 };					//!< 動作中の読み込みスレッド数
+		std::atomic<unsigned int> activeDecoderCount{ 0 };					//!< 動作中のデコードスレッド数
+		std::atomic<bool> isPublishing{ false };							//!< 出力工程が動作中か
+
+		std::atomic<size_t> enumeratedCount{ 0 };							//!< 列挙した画像数
+		std::atomic<size_t> readCount{ 0 };									//!< 読み込んだ画像数
+		std::atomic<unsigned long long> readBytes{ 0 };						//!< 読み込んだバイト数
+		std::atomic<size_t> storedCount{ 0 };								//!< サムネイルストアから取得した画像数
+		std::atomic<size_t> decodedCount{ 0 };								//!< デコードに成功した画像数
+		std::atomic<size_t> failedCount{ 0 };								//!< 失敗した画像数
+		std::atomic<size_t> publishedCount{ 0 };							//!< 出力キューへ積んだ画像数
+		std::atomic<size_t> hashedCount{ 0 };								//!< 画像ハッシュを計算した画像数
+
+		std::vector<std::thread> threads;									//!< 各工程のスレッド
+	};
+
+	ThumbnailPipeline::ThumbnailPipeline(ImageReader& imageReader, const ThumbnailPipelineSettings& settings)
+		: m_impl(std::make_unique<Impl>(imageReader, settings))
+	{
+	}
+
+	ThumbnailPipeline::~ThumbnailPipeline()
+	{
+		m_impl->Stop();
+	}
+
+	void ThumbnailPipeline::Start(const wchar_t* directory, const std::vector<std::wstring>& extensions, const std::vector<std::wstring>& rawExtensions, const ImageReadSettings& thumbnailSettings)
+	{
+		std::vector<std::wstring> lowerExtensions;
+		std::vector<std::wstring> lowerRawExtensions;
+		for (const auto& extension : extensions)
+		{
+			lowerExtensions.push_back(ToLower(extension));
+		}
+		for (const auto& extension : rawExtensions)
+		{
+			lowerRawExtensions.push_back(ToLower(extension));
+		}
+
+		m_impl->Launch([directoryPath = std::filesystem::path(directory), targetExtensions = std::move(lowerExtensions), targetRawExtensions = std::move(lowerRawExtensions)](const Impl::EmitFunction& emit)
+			{
+				// 一覧を作らずに、見つけた順に読み込み工程へ渡す
+				std::error_code errorCode;
+				for (std::filesystem::directory_iterator entry(directoryPath, errorCode), end; !errorCode && entry != end; entry.increment(errorCode))
+				{
+					std::error_code statusErrorCode;
+					if (!entry->is_regular_file(statusErrorCode))
+					{
+						continue;
+					}
+
+					const auto extension = ToLower(entry->path().extension().wstring());
+					if (!ContainsExtension(extension, targetExtensions))
+					{
+						continue;
+					}
+
+					if (!emit(ThumbnailSource{ entry->path().wstring(), ContainsExtension(extension, targetRawExtensions) }))
+					{
+						return;
+					}
+				}
+			}, thumbnailSettings);
+	}
+
+	void ThumbnailPipeline::Start(std::vector<ThumbnailSource> sources, const ImageReadSettings& thumbnailSettings)
+	{
+		m_impl->Launch([imageSources = std::move(sources)](const Impl::EmitFunction& emit) mutable
+			{
+				for (auto& source : imageSources)
+				{
+					if (!emit(std::move(source)))
+					{
+						return;
+					}
+				}
+			}, thumbnailSettings);
+	}
+
+	void ThumbnailPipeline::SetResultsAvailableCallback(ResultsAvailableCallback callback)
+	{
+		m_impl->pendingResultsAvailable = std::move(callback);
+	}
+
+	bool ThumbnailPipeline::TryDequeue(ThumbnailResult& result)
+	{
+		return m_impl->output.TryPop(result);
+	}
+
+	bool ThumbnailPipeline::IsCompleted() const
+	{
+		// 出力工程の終了を確認してから出力キューを確認し、最後に積まれた結果を取りこぼさない
+		return !m_impl->isPublishing.load(std::memory_order_acquire) && m_impl->output.IsEmpty();
+	}
+
+	void ThumbnailPipeline::Cancel()
+	{
+		m_impl->Stop();
+	}
+
+	ThumbnailPipelineStatistics ThumbnailPipeline::GetStatistics() const
+	{
+		ThumbnailPipelineStatistics statistics{};
+		statistics.enumeratedCount = m_impl->enumeratedCount.load(std::memory_order_relaxed);
+		statistics.readCount = m_impl->readCount.load(std::memory_order_relaxed);
+		statistics.readBytes = m_impl->readBytes.load(std::memory_order_relaxed);
+		statistics.storedCount = m_impl->storedCount.load(std::memory_order_relaxed);
+		statistics.decodedCount = m_impl->decodedCount.load(std::memory_order_relaxed);
+		statistics.failedCount = m_impl->failedCount.load(std::memory_order_relaxed);
+		statistics.publishedCount = m_impl->publishedCount.load(std::memory_order_relaxed);
+		statistics.hashedCount = m_impl->hashedCount.load(std::memory_order_relaxed);
+		return statistics;
+	}
+}
@@ -0,0 +1,126 @@
+/*!
+ * @file	ThumbnailPipeline.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// C++/CLIからインクルードされるため、<mutex>・<thread>・<atomic>を必要とする状態は実装ファイルで定義する
+namespace Kchary::ImageController::Library
+{
+	class ImageReader;
+
+	/*!
+	 * @brief サムネイルを作る画像
+	 */
+	struct ThumbnailSource
+	{
+		std::wstring path;			//!< 画像パス
+		bool isRawImage = false;	//!< RAW画像か
+	};
+
+	/*!
+	 * @brief サムネイルの読み込み結果
+	 */
+	struct ThumbnailResult
+	{
+		size_t index = 0;			//!< 列挙順のインデックス(Start()に渡した一覧のインデックス)
+		std::wstring path;			//!< 画像パス
+		bool result = false;		//!< 成功: True, 失敗: False
+		ImageData imageData{};		//!< 画像データ(成功した場合のみ有効)
+		bool hasImageHash = false;	//!< 画像ハッシュを計算したか(ThumbnailPipelineSettings::computeImageHashを指定した場合)
+		ImageHash imageHash{};		//!< 画像ハッシュ(hasImageHashがTrueの場合のみ有効)
+	};
+
+	/*!
+	 * @brief フォルダ内の画像のサムネイルを、列挙・読み込み・デコードと縮小・出力の工程に分けて並行に作るクラス
+	 * @note 工程ごとに専用のスレッドで動作し、読み込み(I/O)とデコード(CPU)のスレッド数を個別に設定できる。
+	 *		 工程間のキューは上限付きで、後段が詰まると前段も止まる。結果はロックフリーのキューに積み、
+	 *		 呼び出し元がTryDequeue()で取り出す。取り出しが追いつかない場合もキューの上限で止まる
+	 */
+	class ThumbnailPipeline final
+	{
+	public:
+		/*!
+		 * @brief	出力キューに結果を積んだ通知(出力工程のスレッドから呼ばれる。TryDequeue()・Cancel()を呼ばずに速やかに戻ること)
+		 * @note	全ての結果を積み終えたときも呼ばれるため、IsCompleted()で完了を判定できる
+		 */
+		using ResultsAvailableCallback = std::function<void()>;
+
+		/*!
+		 * @brief コンストラクタ
+		 * @param imageReader	デコードに使う画像リーダー(このインスタンスより長く生存すること)
+		 * @param settings		パイプライン設定
+		 * @note	画像リーダーがサムネイルストアを開いている場合、ストアにあるサムネイルは読み込み工程で取得してデコードしない。
+		 *			デコードしたサムネイルはストアへ追加する
+		 */
+		ThumbnailPipeline(ImageReader& imageReader, const ThumbnailPipelineSettings& settings);
+
+		/*!
+		 * @brief デストラクタ(実行中の処理を中断する)
+		 */
+		~ThumbnailPipeline();
+
+		ThumbnailPipeline(const ThumbnailPipeline&) = delete;
+		ThumbnailPipeline& operator=(const ThumbnailPipeline&) = delete;
+
+		/*!
+		 * @brief	フォルダ内の画像を列挙し、サムネイルを作り始める(実行中の場合は中断してから開始する)
+		 * @param	directory			フォルダパス(サブフォルダは列挙しない)
+		 * @param	extensions			対象とする拡張子(".jpg"など。大文字・小文字を区別しない)
+		 * @param	rawExtensions		RAW画像として読み込む拡張子
+		 * @param	thumbnailSettings	サムネイルの読み込み設定(isRawImageは拡張子から決める)
+		 * @note	列挙順はファイルシステムの順とする。表示順で作る場合は画像の一覧を渡すこと
+		 */
+		void Start(const wchar_t* directory, const std::vector<std::wstring>& extensions, const std::vector<std::wstring>& rawExtensions, const ImageReadSettings& thumbnailSettings);
+
+		/*!
+		 * @brief	画像の一覧の順にサムネイルを作り始める(実行中の場合は中断してから開始する)
+		 * @param	sources				画像の一覧
+		 * @param	thumbnailSettings	サムネイルの読み込み設定(isRawImageは画像ごとの指定に従う)
+		 */
+		void Start(std::vector<ThumbnailSource> sources, const ImageReadSettings& thumbnailSettings);
+
+		/*!
+		 * @brief	結果を積んだ通知先を設定する(次回のStart()から反映される。Start()と同時に呼び出さないこと)
+		 * @param	callback	通知先(nullptrの場合は通知しない。呼び出し元はTryDequeue()をポーリングする)
+		 */
+		void SetResultsAvailableCallback(ResultsAvailableCallback callback);
+
+		/*!
+		 * @brief	作り終えたサムネイルを1枚取り出す(ブロックしない)
+		 * @param	result	読み込み結果(out)
+		 * @return	取り出した: True, 作り終えたものがない: False
+		 * @note	Start()・Cancel()・TryDequeue()は同時に1スレッドから呼び出すこと
+		 */
+		bool TryDequeue(ThumbnailResult& result);
+
+		/*!
+		 * @brief	全ての画像を処理し、結果を全て取り出したか
+		 * @return	完了した: True(開始前・中断後を含む)
+		 */
+		bool IsCompleted() const;
+
+		/*!
+		 * @brief	実行中の処理を中断し、取り出されていない結果を破棄する(各工程のスレッドの終了を待つ)
+		 */
+		void Cancel();
+
+		/*!
+		 * @brief	直近に開始した処理の統計情報を取得する
+		 * @return	統計情報
+		 */
+		ThumbnailPipelineStatistics GetStatistics() const;
+
+	private:
+		struct Impl;
+
+		std::unique_ptr<Impl> m_impl;	//!< 工程のスレッドとキュー
+	};
+}
@@ -0,0 +1,739 @@
+/*!
+ * @file	ThumbnailStore.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "ThumbnailStore.h"
+#include <algorithm>		// std::sort, std::reverse
+#include <chrono>			// std::chrono::steady_clock
+#include <cstdint>			// std::uint32_t, std::uint64_t
+#include <cstring>			// std::memcpy
+#include <mutex>			// std::unique_lock
+#include <random>			// std::random_device
+#include <opencv2/opencv.hpp>	// cv::Mat
+
+namespace Kchary::ImageController::Cache
+{
+	namespace
+	{
+		constexpr std::uint32_t PackMagic = 0x4B50544B;		//!< パックファイルの識別子("KTPK")
+		constexpr std::uint32_t IndexMagic = 0x58495448;	//!< インデックスファイルの識別子("HTIX")
+		constexpr std::uint32_t RecordMagic = 0x43525448;	//!< レコードの識別子("HTRC")
+		constexpr std::uint32_t FormatVersion = 2;			//!< ファイル形式のバージョン(2: RAW画像のサムネイルに記録された向きを適用)
+
+		constexpr size_t RecordAlignment = 16;							//!< レコード・画素データの境界
+		constexpr size_t MaxPathLength = 32 * 1024;						//!< パスの最大バイト数(壊れたレコードの検出用)
+		constexpr unsigned long long IndexSaveInterval = 64ULL * 1024 * 1024;	//!< インデックスを保存する追記バイト数の間隔
+		constexpr unsigned long long MinCompactionBytes = 64ULL * 1024 * 1024;	//!< 開く際にコンパクションする不要バイト数の下限
+		constexpr unsigned long long DefaultMaxBytes = 500ULL * 1024 * 1024;	//!< パックファイルに保持する既定の最大バイト数
+
+#ifdef _WIN32
+		constexpr wchar_t PathSeparator = L'\\';
+#else
+		constexpr wchar_t PathSeparator = L'/';
+#endif
+
+		/*!
+		 * @brief パックファイルのヘッダー
+		 */
+		struct PackHeader
+		{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint64_t generation;
+		};
+
+		/*!
+		 * @brief パックファイル内のレコードのヘッダー(直後にパス、画素データが続く)
+		 */
+		struct RecordHeader
+		{
+			std::uint32_t magic;
+			std::uint32_t pathLength;
+			std::int32_t resizeLongSideLength;
+			std::int32_t width;
+			std::int32_t height;
+			std::int32_t type;
+			std::int64_t lastWriteTime;
+			std::uint64_t length;
+			std::uint64_t pixelSize;
+			std::uint64_t checksum;			//!< パスと画素データのチェックサム
+		};
+
+		/*!
+		 * @brief インデックスファイルのヘッダー(直後にエントリが続く)
+		 */
+		struct IndexHeader
+		{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint64_t generation;		//!< 対応するパックファイルの世代
+			std::uint64_t packSize;			//!< パックファイルの先頭から反映したバイト数
+			std::uint64_t entryCount;
+			std::uint64_t checksum;			//!< エントリ部分のチェックサム
+		};
+
+		/*!
+		 * @brief インデックスファイルのエントリ(直後にパスが続く)
+		 */
+		struct IndexRecord
+		{
+			std::uint32_t pathLength;
+			std::int32_t resizeLongSideLength;
+			std::int64_t lastWriteTime;
+			std::uint64_t length;
+			std::uint64_t offset;
+			std::uint64_t recordSize;
+		};
+
+		constexpr size_t AlignUp(size_t value) noexcept
+		{
+			return (value + RecordAlignment - 1) / RecordAlignment * RecordAlignment;
+		}
+
+		constexpr size_t PackHeaderSize = AlignUp(sizeof(PackHeader));
+
+		constexpr size_t GetPixelOffset(size_t pathLength) noexcept
+		{
+			return AlignUp(sizeof(RecordHeader) + pathLength);
+		}
+
+		constexpr size_t GetRecordSize(size_t pathLength, size_t pixelSize) noexcept
+		{
+			return GetPixelOffset(pathLength) + AlignUp(pixelSize);
+		}
+
+		/*!
+		 * @brief チェックサム(FNV-1a 64bit)
+		 */
+		class Checksum final
+		{
+		public:
+			void Update(const void* data, size_t size) noexcept
+			{
+				const auto* bytes = static_cast<const unsigned char*>(data);
+				for (size_t i = 0; i < size; ++i)
+				{
+					m_value = (m_value ^ bytes[i]) * 0x100000001B3ULL;
+				}
+			}
+
+			std::uint64_t value() const noexcept { return m_value; }
+
+		private:
+			std::uint64_t m_value = 0xCBF29CE484222325ULL;
+		};
+
+		bool IsSameFile(const IO::FileStatus& lhs, const IO::FileStatus& rhs) noexcept
+		{
+			return lhs.lastWriteTime == rhs.lastWriteTime && lhs.length == rhs.length;
+		}
+
+		std::wstring JoinPath(const wchar_t* directory, const wchar_t* fileName)
+		{
+			std::wstring path(directory);
+			if (!path.empty() && path.back() != L'/' && path.back() != L'\\')
+			{
+				path += PathSeparator;
+			}
+
+			return path + fileName;
+		}
+
+		std::uint64_t CreateGeneration()
+		{
+			std::random_device randomDevice;
+			const auto time = static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+			return ((static_cast<std::uint64_t>(randomDevice()) << 32) | randomDevice()) ^ time;
+		}
+
+		template <typename T>
+		T ReadStruct(const unsigned char* data) noexcept
+		{
+			T value{};
+			std::memcpy(&value, data, sizeof(T));
+			return value;
+		}
+
+		/*!
+		 * @brief	インデックスのエントリが指すレコードが、Store()で書き込んだ形式のままか
+		 * @param	record		レコードの先頭(recordSizeバイトを参照できること)
+		 * @param	recordSize	インデックスに記録したレコードのバイト数
+		 * @param	path		キーの画像パス
+		 * @note	インデックスに反映済みの範囲はチェックサムを検証しないため、画素を複写する前に範囲を検証する
+		 */
+		bool IsValidRecord(const unsigned char* record, unsigned long long recordSize, const std::string& path) noexcept
+		{
+			if (recordSize < sizeof(RecordHeader))
+			{
+				return false;
+			}
+
+			const auto header = ReadStruct<RecordHeader>(record);
+			return header.magic == RecordMagic && header.type == CV_8UC3 && header.pathLength == path.size() && header.width > 0 && header.height > 0
+				&& header.pixelSize == static_cast<std::uint64_t>(header.width) * static_cast<std::uint64_t>(header.height) * CV_ELEM_SIZE(CV_8UC3)
+				&& GetRecordSize(header.pathLength, static_cast<size_t>(header.pixelSize)) == recordSize
+				&& std::memcmp(record + sizeof(RecordHeader), path.data(), path.size()) == 0;
+		}
+	}
+
+	size_t ThumbnailStore::EntryKeyHash::operator()(const EntryKey& key) const noexcept
+	{
+		return std::hash<std::string>()(key.first) ^ (static_cast<size_t>(key.second) * 0x9E3779B97F4A7C15ULL);
+	}
+
+	ThumbnailStore::ThumbnailStore(std::shared_ptr<Memory::BufferPool> bufferPool)
+		: m_imageDataWriter(std::move(bufferPool))
+		, m_maxBytes(DefaultMaxBytes)
+	{
+	}
+
+	ThumbnailStore::~ThumbnailStore()
+	{
+		Close();
+	}
+
+	bool ThumbnailStore::Open(const wchar_t* directory)
+	{
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		CloseLocked();
+
+		m_packPath = JoinPath(directory, L"thumbnails.pack");
+		m_indexPath = JoinPath(directory, L"thumbnails.idx");
+		if (!m_packWriter.Open(m_packPath.c_str(), IO::WritableFile::OpenMode::Append))
+		{
+			return false;
+		}
+
+		bool isValidPack = false;
+		if (m_packWriter.size() >= PackHeaderSize && RemapLocked())
+		{
+			const auto header = ReadStruct<PackHeader>(m_packMapping.data());
+			isValidPack = header.magic == PackMagic && header.version == FormatVersion;
+			m_generation = header.generation;
+		}
+
+		if (!isValidPack && !ResetPackLocked())
+		{
+			CloseLocked();
+			return false;
+		}
+
+		// インデックスに反映済みの範囲はそのまま使い、それ以降のレコードのみ検証する
+		unsigned long long indexedSize = LoadIndexLocked();
+		if (indexedSize == 0)
+		{
+			m_entries.clear();
+			m_liveBytes = 0;
+			indexedSize = PackHeaderSize;
+		}
+
+		if (!RecoverRecordsLocked(indexedSize))
+		{
+			CloseLocked();
+			return false;
+		}
+
+		m_deadBytes = m_packWriter.size() - PackHeaderSize - m_liveBytes;
+		m_isOpen.store(true, std::memory_order_release);
+
+		if ((m_deadBytes > m_liveBytes && m_deadBytes >= MinCompactionBytes) || IsOverCapacityLocked())
+		{
+			CompactLocked();
+		}
+		else if (indexedSize != m_packWriter.size())
+		{
+			SaveIndexLocked();
+		}
+
+		return IsOpen();
+	}
+
+	void ThumbnailStore::Close()
+	{
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		CloseLocked();
+	}
+
+	void ThumbnailStore::SetCapacity(unsigned long long maxBytes)
+	{
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		m_maxBytes = maxBytes;
+		if (IsOpen() && IsOverCapacityLocked())
+		{
+			CompactLocked();
+		}
+	}
+
+	bool ThumbnailStore::Find(const ThumbnailKey& key, ImageData& imageData)
+	{
+		const EntryKey entryKey(key.path, key.resizeLongSideLength);
+		unsigned long long corruptedOffset = 0;
+		bool isCorrupted = false;
+
+		for (int attempt = 0; attempt < 2; ++attempt)
+		{
+			{
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+				if (!IsOpen())
+				{
+					break;
+				}
+
+				const auto it = m_entries.find(entryKey);
+				if (it == m_entries.end() || !IsSameFile(it->second.fileStatus, key.fileStatus))
+				{
+					break;
+				}
+
+				const auto& entry = it->second;
+				if (entry.offset + entry.recordSize <= m_packMapping.size())
+				{
+					const unsigned char* record = m_packMapping.data() + entry.offset;
+					if (!IsValidRecord(record, entry.recordSize, key.path))
+					{
+						corruptedOffset = entry.offset;
+						isCorrupted = true;
+						break;
+					}
+
+					const auto header = ReadStruct<RecordHeader>(record);
+					const cv::Mat image(header.height, header.width, header.type, const_cast<unsigned char*>(record + GetPixelOffset(header.pathLength)));
+
+					cv::Mat output;
+					if (!m_imageDataWriter.PrepareOutput(imageData, image.rows, image.cols, image.type(), output))
+					{
+						break;
+					}
+
+					image.copyTo(output);
+					m_hitCount.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+
+			// 前回マップした後に追記されたレコードは、マップし直してから読み出す
+			std::unique_lock<std::shared_mutex> lock(m_mutex);
+			if (!IsOpen() || !RemapLocked())
+			{
+				break;
+			}
+		}
+
+		// 壊れたレコード(パックファイルが書き換えられた場合)は取得できないものとし、次回はデコードして追加し直す
+		if (isCorrupted)
+		{
+			std::unique_lock<std::shared_mutex> lock(m_mutex);
+			RemoveEntryLocked(entryKey, corruptedOffset);
+		}
+
+		m_missCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	bool ThumbnailStore::Store(const ThumbnailKey& key, const ImageData& imageData)
+	{
+		const std::byte* pixels = imageData.destination ? imageData.destination : imageData.buffer.data();
+		if (!pixels || key.path.empty() || key.path.size() > MaxPathLength || imageData.width <= 0 || imageData.height <= 0
+			|| m_maxBytes == 0)
+		{
+			return false;
+		}
+
+		// ロックの外でレコード全体を組み立て、1回の書き込みで追記する
+		const int type = CV_8UC3;
+		const size_t rowSize = static_cast<size_t>(imageData.width) * CV_ELEM_SIZE(type);
+		const size_t pixelSize = rowSize * static_cast<size_t>(imageData.height);
+		const size_t pixelOffset = GetPixelOffset(key.path.size());
+		std::vector<unsigned char> record(GetRecordSize(key.path.size(), pixelSize));
+
+		std::memcpy(record.data() + sizeof(RecordHeader), key.path.data(), key.path.size());
+		for (int y = 0; y < imageData.height; ++y)
+		{
+			std::memcpy(record.data() + pixelOffset + rowSize * y, pixels + static_cast<size_t>(imageData.stride) * y, rowSize);
+		}
+
+		Checksum checksum;
+		checksum.Update(key.path.data(), key.path.size());
+		checksum.Update(record.data() + pixelOffset, pixelSize);
+
+		RecordHeader header{};
+		header.magic = RecordMagic;
+		header.pathLength = static_cast<std::uint32_t>(key.path.size());
+		header.resizeLongSideLength = key.resizeLongSideLength;
+		header.width = imageData.width;
+		header.height = imageData.height;
+		header.type = type;
+		header.lastWriteTime = key.fileStatus.lastWriteTime;
+		header.length = key.fileStatus.length;
+		header.pixelSize = pixelSize;
+		header.checksum = checksum.value();
+		std::memcpy(record.data(), &header, sizeof(header));
+
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		if (!IsOpen())
+		{
+			return false;
+		}
+
+		const auto offset = m_packWriter.size();
+		if (!m_packWriter.Write(record.data(), record.size()))
+		{
+			m_packWriter.Truncate(offset);
+			return false;
+		}
+
+		InsertEntryLocked(EntryKey(key.path, key.resizeLongSideLength), Entry{ key.fileStatus, offset, record.size() });
+
+		// 上限を超えた場合は古いサムネイルを破棄し、異常終了時に検証し直す範囲を抑えるため、一定量ごとにインデックスを保存する
+		m_unsavedBytes += record.size();
+		if (IsOverCapacityLocked())
+		{
+			CompactLocked();
+		}
+		else if (m_unsavedBytes >= IndexSaveInterval)
+		{
+			SaveIndexLocked();
+		}
+
+		return true;
+	}
+
+	bool ThumbnailStore::Flush()
+	{
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		return IsOpen() && SaveIndexLocked();
+	}
+
+	bool ThumbnailStore::Compact()
+	{
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		return IsOpen() && CompactLocked();
+	}
+
+	ThumbnailStoreStatistics ThumbnailStore::GetStatistics() const
+	{
+		std::shared_lock<std::shared_mutex> lock(m_mutex);
+		return { m_hitCount.load(std::memory_order_relaxed), m_missCount.load(std::memory_order_relaxed), m_entries.size(), m_liveBytes, m_deadBytes };
+	}
+
+	bool ThumbnailStore::ResetPackLocked()
+	{
+		m_packMapping.Close();
+		if (!m_packWriter.Truncate(0))
+		{
+			return false;
+		}
+
+		unsigned char headerBytes[PackHeaderSize] = {};
+		const PackHeader header{ PackMagic, FormatVersion, CreateGeneration() };
+		std::memcpy(headerBytes, &header, sizeof(header));
+		if (!m_packWriter.Write(headerBytes, sizeof(headerBytes)) || !m_packWriter.Flush())
+		{
+			return false;
+		}
+
+		m_generation = header.generation;
+		m_entries.clear();
+		m_liveBytes = 0;
+		m_deadBytes = 0;
+
+		// 古いインデックスは世代が一致しなくなるため、削除しなくても使われない
+		return RemapLocked();
+	}
+
+	unsigned long long ThumbnailStore::LoadIndexLocked()
+	{
+		IO::MappedFile indexFile;
+		if (!indexFile.Open(m_indexPath.c_str()) || indexFile.size() < sizeof(IndexHeader))
+		{
+			return 0;
+		}
+
+		const auto header = ReadStruct<IndexHeader>(indexFile.data());
+		if (header.magic != IndexMagic || header.version != FormatVersion || header.generation != m_generation
+			|| header.packSize < PackHeaderSize || header.packSize > m_packWriter.size())
+		{
+			return 0;
+		}
+
+		Checksum checksum;
+		checksum.Update(indexFile.data() + sizeof(IndexHeader), indexFile.size() - sizeof(IndexHeader));
+		if (checksum.value() != header.checksum)
+		{
+			return 0;
+		}
+
+		size_t position = sizeof(IndexHeader);
+		for (std::uint64_t i = 0; i < header.entryCount; ++i)
+		{
+			if (position + sizeof(IndexRecord) > indexFile.size())
+			{
+				return 0;
+			}
+
+			const auto record = ReadStruct<IndexRecord>(indexFile.data() + position);
+			position += sizeof(IndexRecord);
+			if (record.pathLength > indexFile.size() - position || record.offset < PackHeaderSize || record.offset + record.recordSize > header.packSize)
+			{
+				return 0;
+			}
+
+			std::string path(reinterpret_cast<const char*>(indexFile.data() + position), record.pathLength);
+			position += record.pathLength;
+
+			const IO::FileStatus fileStatus{ record.lastWriteTime, record.length };
+			InsertEntryLocked(EntryKey(std::move(path), record.resizeLongSideLength), Entry{ fileStatus, record.offset, record.recordSize });
+		}
+
+		return header.packSize;
+	}
+
+	bool ThumbnailStore::RecoverRecordsLocked(unsigned long long offset)
+	{
+		if (!RemapLocked())
+		{
+			return false;
+		}
+
+		const unsigned long long packSize = m_packMapping.size();
+		while (offset + sizeof(RecordHeader) <= packSize)
+		{
+			const unsigned char* record = m_packMapping.data() + offset;
+			const auto header = ReadStruct<RecordHeader>(record);
+			if (header.magic != RecordMagic || header.type != CV_8UC3 || header.pathLength == 0 || header.pathLength > MaxPathLength || header.width <= 0 || header.height <= 0
+				|| header.pixelSize != static_cast<std::uint64_t>(header.width) * header.height * CV_ELEM_SIZE(header.type))
+			{
+				break;
+			}
+
+			const auto recordSize = GetRecordSize(header.pathLength, header.pixelSize);
+			if (offset + recordSize > packSize)
+			{
+				break;
+			}
+
+			Checksum checksum;
+			checksum.Update(record + sizeof(RecordHeader), header.pathLength);
+			checksum.Update(record + GetPixelOffset(header.pathLength), header.pixelSize);
+			if (checksum.value() != header.checksum)
+			{
+				break;
+			}
+
+			std::string path(reinterpret_cast<const char*>(record + sizeof(RecordHeader)), header.pathLength);
+			const IO::FileStatus fileStatus{ header.lastWriteTime, header.length };
+			InsertEntryLocked(EntryKey(std::move(path), header.resizeLongSideLength), Entry{ fileStatus, offset, recordSize });
+			offset += recordSize;
+		}
+
+		if (offset == packSize)
+		{
+			return true;
+		}
+
+		// 書き込み途中で中断されたレコード以降を切り詰める(マップ中は切り詰められないため先に解除する)
+		m_packMapping.Close();
+		return m_packWriter.Truncate(offset) && m_packWriter.Flush() && RemapLocked();
+	}
+
+	bool ThumbnailStore::SaveIndexLocked()
+	{
+		// インデックスが参照するレコードを先にストレージへ書き出す
+		if (!m_packWriter.Flush())
+		{
+			return false;
+		}
+
+		std::vector<unsigned char> indexBytes(sizeof(IndexHeader));
+		for (const auto& [entryKey, entry] : m_entries)
+		{
+			IndexRecord record{};
+			record.pathLength = static_cast<std::uint32_t>(entryKey.first.size());
+			record.resizeLongSideLength = entryKey.second;
+			record.lastWriteTime = entry.fileStatus.lastWriteTime;
+			record.length = entry.fileStatus.length;
+			record.offset = entry.offset;
+			record.recordSize = entry.recordSize;
+
+			const auto* recordBytes = reinterpret_cast<const unsigned char*>(&record);
+			indexBytes.insert(indexBytes.end(), recordBytes, recordBytes + sizeof(record));
+			indexBytes.insert(indexBytes.end(), entryKey.first.begin(), entryKey.first.end());
+		}
+
+		Checksum checksum;
+		checksum.Update(indexBytes.data() + sizeof(IndexHeader), indexBytes.size() - sizeof(IndexHeader));
+		const IndexHeader header{ IndexMagic, FormatVersion, m_generation, m_packWriter.size(), m_entries.size(), checksum.value() };
+		std::memcpy(indexBytes.data(), &header, sizeof(header));
+
+		// 一時ファイルへ書き出してから置き換え、書き込み途中のインデックスが読まれないようにする
+		const std::wstring temporaryPath = m_indexPath + L".tmp";
+		IO::WritableFile indexWriter;
+		if (!indexWriter.Open(temporaryPath.c_str(), IO::WritableFile::OpenMode::Truncate)
+			|| !indexWriter.Write(indexBytes.data(), indexBytes.size())
+			|| !indexWriter.Flush())
+		{
+			indexWriter.Close();
+			IO::RemoveFile(temporaryPath.c_str());
+			return false;
+		}
+
+		indexWriter.Close();
+		if (!IO::ReplaceFile(temporaryPath.c_str(), m_indexPath.c_str()))
+		{
+			IO::RemoveFile(temporaryPath.c_str());
+			return false;
+		}
+
+		m_unsavedBytes = 0;
+		return true;
+	}
+
+	bool ThumbnailStore::RemapLocked()
+	{
+		return m_packMapping.Open(m_packPath.c_str(), IO::AccessPattern::Random);
+	}
+
+	void ThumbnailStore::InsertEntryLocked(EntryKey key, const Entry& entry)
+	{
+		auto [it, isInserted] = m_entries.try_emplace(std::move(key), entry);
+		if (!isInserted)
+		{
+			// 元画像が更新されたサムネイルは置き換え、古いレコードは不要な領域として扱う
+			m_liveBytes -= it->second.recordSize;
+			m_deadBytes += it->second.recordSize;
+			it->second = entry;
+		}
+
+		m_liveBytes += entry.recordSize;
+	}
+
+	void ThumbnailStore::RemoveEntryLocked(const EntryKey& key, unsigned long long offset)
+	{
+		// 確認してから排他ロックを取るまでに置き換えられたエントリは削除しない
+		const auto it = m_entries.find(key);
+		if (it == m_entries.end() || it->second.offset != offset)
+		{
+			return;
+		}
+
+		m_liveBytes -= it->second.recordSize;
+		m_deadBytes += it->second.recordSize;
+		m_entries.erase(it);
+	}
+
+	bool ThumbnailStore::IsOverCapacityLocked() const noexcept
+	{
+		return m_liveBytes + m_deadBytes > m_maxBytes;
+	}
+
+	bool ThumbnailStore::CompactLocked()
+	{
+		const std::wstring temporaryPath = m_packPath + L".tmp";
+		IO::WritableFile compactedWriter;
+		if (!RemapLocked() || !compactedWriter.Open(temporaryPath.c_str(), IO::WritableFile::OpenMode::Truncate))
+		{
+			return false;
+		}
+
+		unsigned char headerBytes[PackHeaderSize] = {};
+		const PackHeader header{ PackMagic, FormatVersion, CreateGeneration() };
+		std::memcpy(headerBytes, &header, sizeof(header));
+		bool isSucceeded = compactedWriter.Write(headerBytes, sizeof(headerBytes));
+
+		// 元画像が削除されたサムネイルは使われないため、書き出さない
+		std::vector<EntryMap::iterator> entries;
+		entries.reserve(m_entries.size());
+		for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+		{
+			IO::FileStatus fileStatus;
+			if (IO::GetFileStatus(it->first.first, fileStatus))
+			{
+				entries.push_back(it);
+			}
+		}
+
+		// 追記した順(パックファイル内の位置)が新しいものから、上限の3/4に収まるだけ残す
+		// (上限ちょうどまで残すと、以降の追記のたびにコンパクションすることになるため)
+		std::sort(entries.begin(), entries.end(), [](const auto& lhs, const auto& rhs) { return lhs->second.offset > rhs->second.offset; });
+		const unsigned long long keptBytesLimit = m_maxBytes / 4 * 3;
+		unsigned long long keptBytes = 0;
+		size_t keptCount = 0;
+		while (keptCount < entries.size() && keptBytes + entries[keptCount]->second.recordSize <= keptBytesLimit)
+		{
+			keptBytes += entries[keptCount]->second.recordSize;
+			++keptCount;
+		}
+		entries.resize(keptCount);
+
+		// 元のパックファイル内の順に書き出し、読み出しを先頭からの順次アクセスにする
+		std::reverse(entries.begin(), entries.end());
+
+		EntryMap compactedEntries;
+		compactedEntries.reserve(m_entries.size());
+		for (const auto& it : entries)
+		{
+			if (!isSucceeded)
+			{
+				break;
+			}
+
+			Entry entry = it->second;
+			entry.offset = compactedWriter.size();
+			isSucceeded = compactedWriter.Write(m_packMapping.data() + it->second.offset, it->second.recordSize);
+			compactedEntries.emplace(it->first, entry);
+		}
+
+		isSucceeded = isSucceeded && compactedWriter.Flush();
+		compactedWriter.Close();
+		if (!isSucceeded)
+		{
+			IO::RemoveFile(temporaryPath.c_str());
+			return false;
+		}
+
+		// マップ中のファイルは置き換えられないため、一度閉じてから置き換える
+		m_packMapping.Close();
+		m_packWriter.Close();
+		const bool isReplaced = IO::ReplaceFile(temporaryPath.c_str(), m_packPath.c_str());
+		if (!isReplaced)
+		{
+			IO::RemoveFile(temporaryPath.c_str());
+		}
+
+		if (!m_packWriter.Open(m_packPath.c_str(), IO::WritableFile::OpenMode::Append) || !RemapLocked())
+		{
+			CloseLocked();
+			return false;
+		}
+
+		if (!isReplaced)
+		{
+			return false;
+		}
+
+		m_generation = header.generation;
+		m_entries.swap(compactedEntries);
+		m_liveBytes = keptBytes;
+		m_deadBytes = 0;
+
+		return SaveIndexLocked();
+	}
+
+	void ThumbnailStore::CloseLocked()
+	{
+		if (IsOpen())
+		{
+			SaveIndexLocked();
+		}
+
+		m_isOpen.store(false, std::memory_order_release);
+		m_packMapping.Close();
+		m_packWriter.Close();
+		m_entries.clear();
+		m_liveBytes = 0;
+		m_deadBytes = 0;
+		m_unsavedBytes = 0;
+	}
+}
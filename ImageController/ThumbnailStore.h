@@ -0,0 +1,208 @@
+/*!
+ * @file	ThumbnailStore.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include "ImageDataWriter.h"
+#include "MappedFile.h"
+#include "WritableFile.h"
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Kchary::ImageController::Cache
+{
+	/*!
+	 * @brief サムネイルを識別するキー
+	 * @note 更新日時・ファイルサイズが一致しない場合は、元画像が変更されたものとみなして使用しない
+	 */
+	struct ThumbnailKey
+	{
+		std::string path;				//!< 画像パス(UTF-8)
+		int resizeLongSideLength = 0;	//!< リサイズする長辺の長さ
+		IO::FileStatus fileStatus;		//!< 元画像の更新日時とサイズ
+	};
+
+	/*!
+	 * @brief ディスクに永続化するサムネイルストア
+	 * @note サムネイルは追記専用のパックファイルへ書き込み、メモリマップして読み出す。
+	 *		 インデックスファイルはパックファイルの先頭からどこまでを反映したかを保持し、
+	 *		 異常終了した場合はそれ以降のレコードをチェックサムで検証しながら復元する。
+	 *		 パックファイルが上限を超えた場合はコンパクションし、古いサムネイルから破棄する
+	 */
+	class ThumbnailStore final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param bufferPool	画素バッファの貸し出し元
+		 */
+		explicit ThumbnailStore(std::shared_ptr<Memory::BufferPool> bufferPool);
+
+		/*!
+		 * @brief デストラクタ(開いている場合はインデックスを保存して閉じる)
+		 */
+		~ThumbnailStore();
+
+		ThumbnailStore(const ThumbnailStore&) = delete;
+		ThumbnailStore& operator=(const ThumbnailStore&) = delete;
+
+		/*!
+		 * @brief	ストアを開く(存在しない場合は作成する)
+		 * @param	directory	パックファイル・インデックスファイルを置くディレクトリ(作成済みであること)
+		 * @return	成功: True, 失敗: False
+		 * @note	不要な領域が有効な領域を上回る場合はコンパクションする
+		 */
+		bool Open(const wchar_t* directory);
+
+		/*!
+		 * @brief	インデックスを保存してストアを閉じる
+		 */
+		void Close();
+
+		/*!
+		 * @brief	ストアを開いているか
+		 * @return	開いている: True
+		 */
+		bool IsOpen() const noexcept { return m_isOpen.load(std::memory_order_acquire); }
+
+		/*!
+		 * @brief	パックファイルに保持する最大バイト数を設定する(超えている場合はコンパクションする)
+		 * @param	maxBytes	最大バイト数(0: サムネイルを追加しない)
+		 */
+		void SetCapacity(unsigned long long maxBytes);
+
+		/*!
+		 * @brief	サムネイルを取得する
+		 * @param	key			キー
+		 * @param	imageData	画像データ(out)
+		 * @return	取得できた: True, ストアにない(元画像が変更された場合を含む): False
+		 * @note	複数スレッドから同時に呼び出してよい
+		 */
+		bool Find(const ThumbnailKey& key, ImageData& imageData);
+
+		/*!
+		 * @brief	サムネイルを追加する(同じパス・長辺の長さのサムネイルは置き換える)
+		 * @param	key			キー(デコード前に取得した更新日時とサイズを指定すること)
+		 * @param	imageData	デコード済みの画像データ(8bit 3ch)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Store(const ThumbnailKey& key, const ImageData& imageData);
+
+		/*!
+		 * @brief	パックファイルをストレージへ書き出し、インデックスを保存する
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Flush();
+
+		/*!
+		 * @brief	有効なサムネイルのみを新しいパックファイルへ詰め直す
+		 * @return	成功: True, 失敗: False(元のパックファイルを使い続ける)
+		 * @note	元画像が削除されたサムネイルは破棄し、上限の3/4を超える分は古いサムネイルから破棄する
+		 */
+		bool Compact();
+
+		/*!
+		 * @brief	統計情報を取得する
+		 * @return	統計情報
+		 */
+		ThumbnailStoreStatistics GetStatistics() const;
+
+	private:
+		/*!
+		 * @brief インデックスのエントリ
+		 */
+		struct Entry
+		{
+			IO::FileStatus fileStatus;			//!< 元画像の更新日時とサイズ
+			unsigned long long offset = 0;		//!< パックファイル内のレコードの位置
+			unsigned long long recordSize = 0;	//!< レコードのバイト数
+		};
+
+		using EntryKey = std::pair<std::string, int>;
+
+		/*!
+		 * @brief エントリのキーのハッシュ
+		 */
+		struct EntryKeyHash
+		{
+			size_t operator()(const EntryKey& key) const noexcept;
+		};
+
+		using EntryMap = std::unordered_map<EntryKey, Entry, EntryKeyHash>;
+
+		/*!
+		 * @brief	パックファイルを作り直す(ヘッダーのみにする)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool ResetPackLocked();
+
+		/*!
+		 * @brief	インデックスファイルを読み込む
+		 * @return	インデックスが反映しているパックファイルのサイズ(読み込めない場合は0)
+		 */
+		unsigned long long LoadIndexLocked();
+
+		/*!
+		 * @brief	インデックスに反映されていないレコードを検証しながら読み込む(壊れたレコード以降は切り詰める)
+		 * @param	offset	読み込みを開始する位置
+		 * @return	成功: True, 失敗: False
+		 */
+		bool RecoverRecordsLocked(unsigned long long offset);
+
+		/*!
+		 * @brief	パックファイルをストレージへ書き出してからインデックスファイルを置き換える
+		 * @return	成功: True, 失敗: False
+		 */
+		bool SaveIndexLocked();
+
+		/*!
+		 * @brief	パックファイルをメモリマップし直す
+		 * @return	成功: True, 失敗: False
+		 */
+		bool RemapLocked();
+
+		/*!
+		 * @brief	エントリを追加・置き換え、有効・不要なバイト数を更新する
+		 */
+		void InsertEntryLocked(EntryKey key, const Entry& entry);
+
+		/*!
+		 * @brief	壊れたレコードを指すエントリを削除する(レコードは不要な領域として扱う)
+		 */
+		void RemoveEntryLocked(const EntryKey& key, unsigned long long offset);
+
+		/*!
+		 * @brief	パックファイルが上限を超えているか
+		 */
+		bool IsOverCapacityLocked() const noexcept;
+
+		bool CompactLocked();
+		void CloseLocked();
+
+		Common::ImageDataWriter m_imageDataWriter;	//!< 画像データの書き込み
+		mutable std::shared_mutex m_mutex;			//!< 読み出しは共有ロック、追記・コンパクションは排他ロック
+		std::atomic<bool> m_isOpen{ false };		//!< 開いているか
+		unsigned long long m_maxBytes;				//!< パックファイルに保持する最大バイト数
+
+		std::wstring m_packPath;					//!< パックファイルのパス
+		std::wstring m_indexPath;					//!< インデックスファイルのパス
+		IO::WritableFile m_packWriter;				//!< パックファイルの追記用
+		IO::MappedFile m_packMapping;				//!< パックファイルの読み出し用
+		unsigned long long m_generation = 0;		//!< パックファイルの世代(作り直すたびに変わる)
+		EntryMap m_entries;							//!< インデックス
+		unsigned long long m_liveBytes = 0;			//!< 有効なレコードのバイト数
+		unsigned long long m_deadBytes = 0;			//!< 不要になったレコードのバイト数
+		unsigned long long m_unsavedBytes = 0;		//!< インデックスに反映していない追記バイト数
+
+		std::atomic<size_t> m_hitCount{ 0 };		//!< 取得できた回数
+		std::atomic<size_t> m_missCount{ 0 };		//!< 取得できなかった回数
+	};
+}
@@ -0,0 +1,228 @@
+/*!
+ * @file	TileCache.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "TileCache.h"
+#include <functional>	// std::hash
+
+namespace Kchary::ImageController::Cache
+{
+	namespace
+	{
+		size_t CombineHash(size_t seed, size_t value) noexcept
+		{
+			return seed ^ (value + 0x9E3779B9 + (seed << 6) + (seed >> 2));
+		}
+
+		size_t GetTileBytes(const cv::Mat& tile) noexcept
+		{
+			return tile.total() * tile.elemSize();
+		}
+
+		size_t GetLevelBytes(const ImageData& levelData) noexcept
+		{
+			return levelData.buffer.size();
+		}
+	}
+
+	size_t TileKeyHash::operator()(const TileKey& key) const noexcept
+	{
+		size_t hash = std::hash<std::wstring>()(key.path);
+		hash = CombineHash(hash, std::hash<long long>()(key.lastWriteTime));
+		hash = CombineHash(hash, std::hash<int>()(key.level));
+		hash = CombineHash(hash, std::hash<int>()(key.column));
+		return CombineHash(hash, std::hash<int>()(key.row));
+	}
+
+	TileCache::TileCache(size_t capacity, size_t levelCapacity)
+		: m_capacity(capacity)
+		, m_levelCapacity(levelCapacity)
+	{
+	}
+
+	void TileCache::SetCapacity(size_t capacity)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_capacity = capacity;
+		EvictLocked();
+	}
+
+	size_t TileCache::GetCapacity() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_capacity;
+	}
+
+	bool TileCache::Find(const TileKey& key, cv::Mat& tile)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const auto found = m_index.find(key);
+		if (found == m_index.end())
+		{
+			++m_missCount;
+			return false;
+		}
+
+		// 最も新しく使われたタイルとして先頭へ移す
+		m_entries.splice(m_entries.begin(), m_entries, found->second);
+		tile = found->second->second;
+		++m_hitCount;
+		return true;
+	}
+
+	void TileCache::Insert(const TileKey& key, const cv::Mat& tile)
+	{
+		const size_t tileBytes = GetTileBytes(tile);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (tileBytes > m_capacity)
+		{
+			return;
+		}
+
+		const auto found = m_index.find(key);
+		if (found != m_index.end())
+		{
+			m_cachedBytes -= GetTileBytes(found->second->second);
+			found->second->second = tile;
+			m_entries.splice(m_entries.begin(), m_entries, found->second);
+		}
+		else
+		{
+			m_entries.emplace_front(key, tile);
+			m_index.emplace(key, m_entries.begin());
+		}
+
+		m_cachedBytes += tileBytes;
+		EvictLocked();
+	}
+
+	std::shared_ptr<const ImageData> TileCache::FindLevel(const TileKey& key)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const auto found = m_levelIndex.find(GetLevelKey(key));
+		if (found == m_levelIndex.end())
+		{
+			return nullptr;
+		}
+
+		m_levels.splice(m_levels.begin(), m_levels, found->second);
+		++m_levelHitCount;
+		return found->second->second;
+	}
+
+	bool TileCache::InsertLevel(const TileKey& key, std::shared_ptr<const ImageData> levelData)
+	{
+		const size_t levelBytes = GetLevelBytes(*levelData);
+		const TileKey levelKey = GetLevelKey(key);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (levelBytes > m_levelCapacity)
+		{
+			return false;
+		}
+
+		const auto found = m_levelIndex.find(levelKey);
+		if (found != m_levelIndex.end())
+		{
+			m_cachedLevelBytes -= GetLevelBytes(*found->second->second);
+			found->second->second = std::move(levelData);
+			m_levels.splice(m_levels.begin(), m_levels, found->second);
+		}
+		else
+		{
+			m_levels.emplace_front(levelKey, std::move(levelData));
+			m_levelIndex.emplace(levelKey, m_levels.begin());
+		}
+
+		m_cachedLevelBytes += levelBytes;
+		EvictLevelsLocked();
+		return true;
+	}
+
+	std::mutex& TileCache::GetDecodeMutex(const TileKey& key) noexcept
+	{
+		size_t hash = std::hash<std::wstring>()(key.path);
+		hash = CombineHash(hash, std::hash<long long>()(key.lastWriteTime));
+		hash = CombineHash(hash, std::hash<int>()(key.level));
+		return m_decodeMutexes[hash % DecodeMutexCount];
+	}
+
+	bool TileCache::FindImageSize(const std::wstring& path, long long lastWriteTime, cv::Size& size) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const auto found = m_imageSizes.find(path);
+		if (found == m_imageSizes.end() || found->second.first != lastWriteTime)
+		{
+			return false;
+		}
+
+		size = found->second.second;
+		return true;
+	}
+
+	void TileCache::InsertImageSize(const std::wstring& path, long long lastWriteTime, cv::Size size)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_imageSizes.size() >= MaxImageSizeCount && m_imageSizes.find(path) == m_imageSizes.end())
+		{
+			// 1件あたり数十Byteのため、上限に達した場合はまとめて破棄する
+			m_imageSizes.clear();
+		}
+
+		m_imageSizes[path] = { lastWriteTime, size };
+	}
+
+	void TileCache::AddDecodeCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_decodeCount;
+	}
+
+	TileCacheStatistics TileCache::GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		TileCacheStatistics statistics{};
+		statistics.hitCount = m_hitCount;
+		statistics.missCount = m_missCount;
+		statistics.decodeCount = m_decodeCount;
+		statistics.tileCount = m_entries.size();
+		statistics.cachedBytes = m_cachedBytes;
+		statistics.capacity = m_capacity;
+		statistics.levelHitCount = m_levelHitCount;
+		statistics.levelCount = m_levels.size();
+		statistics.cachedLevelBytes = m_cachedLevelBytes;
+		statistics.levelCapacity = m_levelCapacity;
+		return statistics;
+	}
+
+	void TileCache::EvictLocked()
+	{
+		while (m_cachedBytes > m_capacity && !m_entries.empty())
+		{
+			const auto& oldest = m_entries.back();
+			m_cachedBytes -= GetTileBytes(oldest.second);
+			m_index.erase(oldest.first);
+			m_entries.pop_back();
+		}
+	}
+
+	void TileCache::EvictLevelsLocked()
+	{
+		while (m_cachedLevelBytes > m_levelCapacity && !m_levels.empty())
+		{
+			const auto& oldest = m_levels.back();
+			m_cachedLevelBytes -= GetLevelBytes(*oldest.second);
+			m_levelIndex.erase(oldest.first);
+			m_levels.pop_back();
+		}
+	}
+
+	TileKey TileCache::GetLevelKey(const TileKey& key)
+	{
+		return TileKey{ key.path, key.lastWriteTime, key.level, 0, 0 };
+	}
+}
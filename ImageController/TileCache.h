@@ -0,0 +1,178 @@
+/*!
+ * @file	TileCache.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include <array>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Cache
+{
+	/*!
+	 * @brief タイルを識別するキー
+	 * @note 元画像の更新日時が異なるタイルは別のキーとなり、使われないままLRUで破棄される
+	 */
+	struct TileKey
+	{
+		std::wstring path;				//!< 画像パス
+		long long lastWriteTime = 0;	//!< 元画像の更新日時
+		int level = 0;					//!< 縮小レベル
+		int column = 0;					//!< タイルの列
+		int row = 0;					//!< タイルの行
+
+		bool operator==(const TileKey& other) const noexcept
+		{
+			return lastWriteTime == other.lastWriteTime && level == other.level && column == other.column && row == other.row && path == other.path;
+		}
+	};
+
+	/*!
+	 * @brief TileKeyのハッシュ
+	 */
+	struct TileKeyHash
+	{
+		size_t operator()(const TileKey& key) const noexcept;
+	};
+
+	/*!
+	 * @brief タイルに分割した画像を、合計バイト数の上限まで保持するキャッシュ(LRU)
+	 * @note 分割元の縮小レベルの画像も、タイルとは別の上限で保持する(LRU)。
+	 *		 キャッシュにないタイルは保持している縮小レベルから切り出し、縮小レベルを再度デコードせずに済むようにする。
+	 *		 複数スレッドから同時に呼び出してよい
+	 */
+	class TileCache final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 * @param capacity		保持するタイルの合計バイト数の上限
+		 * @param levelCapacity	保持する縮小レベルの画像の合計バイト数の上限
+		 */
+		TileCache(size_t capacity, size_t levelCapacity);
+
+		TileCache(const TileCache&) = delete;
+		TileCache& operator=(const TileCache&) = delete;
+
+		/*!
+		 * @brief	保持するタイルの合計バイト数の上限を変更する(超過分は古いタイルから破棄する)
+		 * @param	capacity	上限(Byte)
+		 */
+		void SetCapacity(size_t capacity);
+
+		/*!
+		 * @brief	保持するタイルの合計バイト数の上限を取得する
+		 * @return	上限(Byte)
+		 */
+		size_t GetCapacity() const;
+
+		/*!
+		 * @brief	タイルを取得する
+		 * @param	key		キー
+		 * @param	tile	タイル(out。キャッシュと画素を共有するため書き換えてはならない)
+		 * @return	取得できた: True
+		 */
+		bool Find(const TileKey& key, cv::Mat& tile);
+
+		/*!
+		 * @brief	タイルを追加する(最も新しく使われたものとして扱う)
+		 * @param	key		キー
+		 * @param	tile	タイル(上限を超えるサイズの場合は追加しない)
+		 */
+		void Insert(const TileKey& key, const cv::Mat& tile);
+
+		/*!
+		 * @brief	縮小レベルの画像を取得する
+		 * @param	key		キー(画像パス・更新日時・縮小レベルのみ参照する)
+		 * @return	縮小レベルの画像(ない場合はnullptr。キャッシュから破棄された後も、返したポインタが解放されるまで有効)
+		 */
+		std::shared_ptr<const ImageData> FindLevel(const TileKey& key);
+
+		/*!
+		 * @brief	縮小レベルの画像を追加する(最も新しく使われたものとして扱う)
+		 * @param	key			キー(画像パス・更新日時・縮小レベルのみ参照する)
+		 * @param	levelData	縮小レベルの画像(上限を超えるサイズの場合は追加しない)
+		 * @return	追加した: True, 上限を超えるため追加しない: False
+		 */
+		bool InsertLevel(const TileKey& key, std::shared_ptr<const ImageData> levelData);
+
+		/*!
+		 * @brief	縮小レベル単位のデコードを直列化するミューテックスを取得する
+		 * @param	key		キー(画像パス・更新日時・縮小レベルのみ参照する)
+		 * @return	ミューテックス(異なるレベルが同じミューテックスを共有する場合がある)
+		 */
+		std::mutex& GetDecodeMutex(const TileKey& key) noexcept;
+
+		/*!
+		 * @brief	画像の等倍のサイズを取得する
+		 * @param	path			画像パス
+		 * @param	lastWriteTime	元画像の更新日時
+		 * @param	size			サイズ(out)
+		 * @return	記録されている: True
+		 */
+		bool FindImageSize(const std::wstring& path, long long lastWriteTime, cv::Size& size) const;
+
+		/*!
+		 * @brief	画像の等倍のサイズを記録する
+		 */
+		void InsertImageSize(const std::wstring& path, long long lastWriteTime, cv::Size size);
+
+		/*!
+		 * @brief	縮小レベルをデコードした回数を加算する
+		 */
+		void AddDecodeCount();
+
+		/*!
+		 * @brief	統計情報を取得する
+		 * @return	統計情報
+		 */
+		TileCacheStatistics GetStatistics() const;
+
+	private:
+		using Entry = std::pair<TileKey, cv::Mat>;
+		using LevelEntry = std::pair<TileKey, std::shared_ptr<const ImageData>>;
+
+		/*!
+		 * @brief	上限を超えている間、最も古いタイルを破棄する(m_mutexを保持して呼び出すこと)
+		 */
+		void EvictLocked();
+
+		/*!
+		 * @brief	上限を超えている間、最も古い縮小レベルの画像を破棄する(m_mutexを保持して呼び出すこと)
+		 */
+		void EvictLevelsLocked();
+
+		/*!
+		 * @brief	縮小レベルの画像のキーを求める(列・行を0とする)
+		 */
+		static TileKey GetLevelKey(const TileKey& key);
+
+		static constexpr size_t DecodeMutexCount = 16;	//!< デコード用ミューテックスの数
+		static constexpr size_t MaxImageSizeCount = 4096;	//!< 記録する画像サイズの最大数
+
+		mutable std::mutex m_mutex;									//!< 以下のメンバーを保護するミューテックス
+		std::list<Entry> m_entries;									//!< タイル(先頭が最も新しく使われたもの)
+		std::unordered_map<TileKey, std::list<Entry>::iterator, TileKeyHash> m_index;	//!< キーからタイルへの索引
+		std::unordered_map<std::wstring, std::pair<long long, cv::Size>> m_imageSizes;	//!< 画像パスごとの更新日時と等倍のサイズ
+		std::list<LevelEntry> m_levels;								//!< 縮小レベルの画像(先頭が最も新しく使われたもの)
+		std::unordered_map<TileKey, std::list<LevelEntry>::iterator, TileKeyHash> m_levelIndex;	//!< キーから縮小レベルの画像への索引
+		size_t m_capacity;											//!< 合計バイト数の上限
+		size_t m_cachedBytes = 0;									//!< 保持しているタイルの合計バイト数
+		size_t m_levelCapacity;										//!< 縮小レベルの画像の合計バイト数の上限
+		size_t m_cachedLevelBytes = 0;								//!< 保持している縮小レベルの画像の合計バイト数
+		size_t m_hitCount = 0;										//!< キャッシュから取得できた回数
+		size_t m_missCount = 0;										//!< キャッシュになかった回数
+		size_t m_levelHitCount = 0;									//!< 保持している縮小レベルの画像から切り出した回数
+		size_t m_decodeCount = 0;									//!< 縮小レベルをデコードした回数
+		std::array<std::mutex, DecodeMutexCount> m_decodeMutexes;	//!< 縮小レベル単位のデコード用ミューテックス
+	};
+}
@@ -0,0 +1,275 @@
+/*!
+ * @file	TileLoader.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "TileLoader.h"
+#include "MappedFile.h"
+#include <algorithm>	// std::max, std::min, std::stable_sort
+#include <mutex>		// std::lock_guard
+#include <utility>		// std::pair
+
+namespace Kchary::ImageController::Cache
+{
+	using Diagnostics::DecodeStage;
+	using Diagnostics::ScopedStageTimer;
+
+	TileLoader::TileLoader(std::shared_ptr<Memory::BufferPool> bufferPool, IImageController& rawImageController, IImageController& normalImageController, std::shared_ptr<Diagnostics::DecodeStatistics> statistics, size_t capacity, size_t levelCapacity)
+		: m_imageDataWriter(std::move(bufferPool))
+		, m_rawImageController(rawImageController)
+		, m_normalImageController(normalImageController)
+		, m_statistics(std::move(statistics))
+		, m_tileCache(capacity, levelCapacity)
+	{
+	}
+
+	bool TileLoader::GetTiledImageInfo(const wchar_t* path, bool isRawImage, TiledImageInfo& info)
+	{
+		IO::FileStatus fileStatus{};
+		cv::Size imageSize;
+		if (!IO::GetFileStatus(path, fileStatus) || !GetImageSize(path, isRawImage, fileStatus.lastWriteTime, imageSize))
+		{
+			return false;
+		}
+
+		// 最も小さいレベルが1タイルに収まるまでレベルを重ねる
+		int levelCount = 1;
+		for (cv::Size levelSize = imageSize; levelCount <= MaxLevel && (std::max)(levelSize.width, levelSize.height) > TileSize; ++levelCount)
+		{
+			levelSize = GetLevelSize(imageSize, levelCount);
+		}
+
+		info.width = imageSize.width;
+		info.height = imageSize.height;
+		info.tileSize = TileSize;
+		info.levelCount = levelCount;
+		return true;
+	}
+
+	bool TileLoader::GetTile(const wchar_t* path, const TileReadSettings& tileReadSettings, ImageData& imageData)
+	{
+		ScopedStageTimer timer(*m_statistics, DecodeStage::TileRead);
+
+		IO::FileStatus fileStatus{};
+		cv::Size imageSize;
+		if (tileReadSettings.level < 0 || tileReadSettings.level > MaxLevel || !IO::GetFileStatus(path, fileStatus)
+			|| !GetImageSize(path, tileReadSettings.isRawImage, fileStatus.lastWriteTime, imageSize))
+		{
+			return false;
+		}
+
+		// 要求範囲を縮小レベルの画像内に切り詰め、範囲にかかるタイルを求める
+		const cv::Size levelSize = GetLevelSize(imageSize, tileReadSettings.level);
+		const cv::Rect region = cv::Rect(tileReadSettings.x, tileReadSettings.y, tileReadSettings.width, tileReadSettings.height) & cv::Rect(0, 0, levelSize.width, levelSize.height);
+		if (region.empty())
+		{
+			return false;
+		}
+
+		const int firstColumn = region.x / TileSize;
+		const int firstRow = region.y / TileSize;
+		const cv::Rect tileRange(firstColumn, firstRow, (region.x + region.width - 1) / TileSize - firstColumn + 1, (region.y + region.height - 1) / TileSize - firstRow + 1);
+
+		TileKey key{ path, fileStatus.lastWriteTime, tileReadSettings.level, 0, 0 };
+		std::vector<cv::Mat> tiles(static_cast<size_t>(tileRange.area()));
+		if (!FindTiles(key, tileRange, tiles))
+		{
+			// 同じ縮小レベルを複数スレッドで重複してデコードしないよう、ロックを取得してから再度探す
+			std::lock_guard<std::mutex> lock(m_tileCache.GetDecodeMutex(key));
+			if (!FindTiles(key, tileRange, tiles))
+			{
+				std::shared_ptr<const ImageData> levelData = m_tileCache.FindLevel(key);
+				bool isLevelCached = true;
+				if (!levelData)
+				{
+					levelData = DecodeLevel(path, tileReadSettings.isRawImage, tileReadSettings.level, levelSize);
+					if (!levelData)
+					{
+						return false;
+					}
+					isLevelCached = m_tileCache.InsertLevel(key, levelData);
+				}
+
+				// 保持できない大きさの縮小レベル(1億画素の等倍など)は、次のタイルのたびにデコードし直さないよう全体を切り出しておく
+				CutTiles(*levelData, key, levelSize, tileRange, tiles, !isLevelCached);
+			}
+		}
+
+		cv::Mat output;
+		if (!m_imageDataWriter.PrepareOutput(imageData, region.height, region.width, CV_8UC3, output))
+		{
+			return false;
+		}
+
+		// 各タイルの要求範囲と重なる部分を書き込み先へコピーする
+		for (int row = 0; row < tileRange.height; ++row)
+		{
+			for (int column = 0; column < tileRange.width; ++column)
+			{
+				const cv::Rect tileRect((tileRange.x + column) * TileSize, (tileRange.y + row) * TileSize, TileSize, TileSize);
+				const cv::Rect overlap = tileRect & region;
+				tiles[static_cast<size_t>(row) * tileRange.width + column](overlap - tileRect.tl()).copyTo(output(overlap - region.tl()));
+			}
+		}
+
+		m_statistics->AddBytesCopied(imageData.size);
+		return true;
+	}
+
+	void TileLoader::SetCapacity(size_t capacity)
+	{
+		m_tileCache.SetCapacity(capacity);
+	}
+
+	TileCacheStatistics TileLoader::GetStatistics() const
+	{
+		return m_tileCache.GetStatistics();
+	}
+
+	cv::Size TileLoader::GetLevelSize(cv::Size imageSize, int level) noexcept
+	{
+		return cv::Size(((imageSize.width - 1) >> level) + 1, ((imageSize.height - 1) >> level) + 1);
+	}
+
+	bool TileLoader::GetImageSize(const wchar_t* path, bool isRawImage, long long lastWriteTime, cv::Size& size)
+	{
+		if (m_tileCache.FindImageSize(path, lastWriteTime, size))
+		{
+			return true;
+		}
+
+		int width = 0;
+		int height = 0;
+		auto& imageController = isRawImage ? m_rawImageController : m_normalImageController;
+		if (!imageController.GetImageSize(path, width, height) || width <= 0 || height <= 0)
+		{
+			return false;
+		}
+
+		size = cv::Size(width, height);
+		m_tileCache.InsertImageSize(path, lastWriteTime, size);
+		return true;
+	}
+
+	bool TileLoader::FindTiles(TileKey& key, const cv::Rect& tileRange, std::vector<cv::Mat>& tiles)
+	{
+		bool hasAllTiles = true;
+		for (int row = 0; row < tileRange.height; ++row)
+		{
+			for (int column = 0; column < tileRange.width; ++column)
+			{
+				auto& tile = tiles[static_cast<size_t>(row) * tileRange.width + column];
+				if (!tile.empty())
+				{
+					continue;
+				}
+
+				key.column = tileRange.x + column;
+				key.row = tileRange.y + row;
+				hasAllTiles &= m_tileCache.Find(key, tile);
+			}
+		}
+
+		return hasAllTiles;
+	}
+
+	std::shared_ptr<ImageData> TileLoader::DecodeLevel(const wchar_t* path, bool isRawImage, int level, cv::Size levelSize)
+	{
+		// 縮小レベルの長辺を指定してデコードする(JPEGはDCTスケーリング、RAWはハーフサイズ処理で必要な分だけ処理する)
+		ImageReadSettings imageReadSettings{};
+		imageReadSettings.isRawImage = isRawImage;
+		if (level > 0)
+		{
+			imageReadSettings.isThumbnailMode = !isRawImage;
+			imageReadSettings.resizeLongSideLength = (std::max)(levelSize.width, levelSize.height);
+		}
+
+		auto levelData = std::make_shared<ImageData>();
+		auto& imageController = isRawImage ? m_rawImageController : m_normalImageController;
+		if (!imageController.GetImageData(path, imageReadSettings, *levelData, nullptr, nullptr) || levelData->width <= 0 || levelData->height <= 0)
+		{
+			return nullptr;
+		}
+
+		m_tileCache.AddDecodeCount();
+		return levelData;
+	}
+
+	void TileLoader::CutTiles(const ImageData& levelData, TileKey& key, cv::Size levelSize, const cv::Rect& tileRange, std::vector<cv::Mat>& tiles, bool isWholeLevel)
+	{
+		// 縮小レベルの画像はキャッシュと共有するため、書き換えずに参照する
+		const cv::Mat levelImage(levelData.height, levelData.width, CV_8UC3, const_cast<std::byte*>(levelData.buffer.data()), static_cast<size_t>(levelData.stride));
+
+		// 要求範囲と、その周囲1タイル分(縮小レベル全体を対象とする場合は全てのタイル)を対象とする
+		const int columnCount = (levelSize.width + TileSize - 1) / TileSize;
+		const int rowCount = (levelSize.height + TileSize - 1) / TileSize;
+		const cv::Rect levelRange(0, 0, columnCount, rowCount);
+		const cv::Rect neighborRange = isWholeLevel ? levelRange : cv::Rect(tileRange.x - 1, tileRange.y - 1, tileRange.width + 2, tileRange.height + 2) & levelRange;
+		const double centerColumn = tileRange.x + (tileRange.width - 1) * 0.5;
+		const double centerRow = tileRange.y + (tileRange.height - 1) * 0.5;
+
+		std::vector<std::pair<double, cv::Point>> positions;
+		positions.reserve(static_cast<size_t>(neighborRange.area()));
+		for (int row = neighborRange.y; row < neighborRange.y + neighborRange.height; ++row)
+		{
+			for (int column = neighborRange.x; column < neighborRange.x + neighborRange.width; ++column)
+			{
+				const double distance = (column - centerColumn) * (column - centerColumn) + (row - centerRow) * (row - centerRow);
+				positions.emplace_back(distance, cv::Point(column, row));
+			}
+		}
+		std::stable_sort(positions.begin(), positions.end(), [](const auto& left, const auto& right) { return left.first < right.first; });
+
+		// 要求範囲に近いタイルから順に、キャッシュの上限に収まる分だけ切り出す(要求範囲のタイルは必ず切り出す)
+		const size_t capacity = m_tileCache.GetCapacity();
+		size_t totalBytes = 0;
+		std::vector<std::pair<cv::Point, cv::Mat>> cutTiles;
+		for (const auto& positionEntry : positions)
+		{
+			const cv::Point& position = positionEntry.second;
+			const bool isRequested = tileRange.contains(position);
+			const cv::Rect tileRect = cv::Rect(position.x * TileSize, position.y * TileSize, TileSize, TileSize) & cv::Rect(0, 0, levelSize.width, levelSize.height);
+			const size_t tileBytes = static_cast<size_t>(tileRect.area()) * 3;
+			if (!isRequested && totalBytes + tileBytes > capacity)
+			{
+				continue;
+			}
+
+			cv::Mat* requestedTile = isRequested ? &tiles[static_cast<size_t>(position.y - tileRange.y) * tileRange.width + (position.x - tileRange.x)] : nullptr;
+			if (requestedTile && !requestedTile->empty())
+			{
+				// キャッシュから取得済みのタイル
+				continue;
+			}
+
+			cv::Mat tile = CutTile(levelImage, tileRect);
+			totalBytes += tileBytes;
+			if (requestedTile)
+			{
+				*requestedTile = tile;
+			}
+			cutTiles.emplace_back(position, std::move(tile));
+		}
+
+		// 遠いタイルから追加し、要求範囲に近いタイルほど後まで残るようにする
+		for (auto cutTile = cutTiles.rbegin(); cutTile != cutTiles.rend(); ++cutTile)
+		{
+			key.column = cutTile->first.x;
+			key.row = cutTile->first.y;
+			m_tileCache.Insert(key, cutTile->second);
+		}
+	}
+
+	cv::Mat TileLoader::CutTile(const cv::Mat& levelImage, const cv::Rect& tileRect)
+	{
+		// タイルの左上がデコード結果の外側にある場合も、最も近い端の画素から埋める
+		const int left = (std::min)(tileRect.x, levelImage.cols - 1);
+		const int top = (std::min)(tileRect.y, levelImage.rows - 1);
+		const cv::Rect source(left, top, (std::min)(tileRect.x + tileRect.width, levelImage.cols) - left, (std::min)(tileRect.y + tileRect.height, levelImage.rows) - top);
+
+		cv::Mat tile;
+		cv::copyMakeBorder(levelImage(source), tile, 0, tileRect.height - source.height, 0, tileRect.width - source.width, cv::BORDER_REPLICATE);
+		return tile;
+	}
+}
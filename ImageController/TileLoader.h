@@ -0,0 +1,135 @@
+/*!
+ * @file	TileLoader.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+#include "IImageController.h"
+#include "ImageDataWriter.h"
+#include "TileCache.h"
+#include "DecodeStatistics.h"
+#include <memory>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace Kchary::ImageController::Cache
+{
+	/*!
+	 * @brief 画像を縮小レベル(1/2^n)ごとのタイルに分割して読み込むクラス
+	 * @note 要求範囲のタイルがキャッシュにない場合、保持している縮小レベルの画像から切り出し、
+	 *		 縮小レベルの画像もない場合のみデコードする。縮小レベルの画像はタイルとは別の上限まで保持し、
+	 *		 切り出すのは要求範囲と隣接するタイルのみとする(パンで隣のタイルが必要になっても縮小レベルをデコードし直さない)。
+	 *		 複数スレッドから同時に呼び出してよい
+	 */
+	class TileLoader final
+	{
+	public:
+		static constexpr int TileSize = 512;	//!< タイルの一辺の長さ
+		static constexpr int MaxLevel = 16;		//!< 縮小レベルの最大値
+
+		/*!
+		 * @brief コンストラクタ
+		 * @param bufferPool				画素バッファの貸し出し元
+		 * @param rawImageController		RAW画像のデコードに使うインスタンス(このインスタンスより長く生存すること)
+		 * @param normalImageController		通常の画像のデコードに使うインスタンス(このインスタンスより長く生存すること)
+		 * @param statistics				統計情報の記録先
+		 * @param capacity					タイルキャッシュの上限(Byte)
+		 * @param levelCapacity				縮小レベルの画像を保持する上限(Byte)
+		 */
+		TileLoader(std::shared_ptr<Memory::BufferPool> bufferPool, IImageController& rawImageController, IImageController& normalImageController, std::shared_ptr<Diagnostics::DecodeStatistics> statistics, size_t capacity, size_t levelCapacity);
+
+		TileLoader(const TileLoader&) = delete;
+		TileLoader& operator=(const TileLoader&) = delete;
+
+		/*!
+		 * @brief	画像の等倍のサイズと縮小レベルの数を取得する
+		 * @param	path		画像パス
+		 * @param	isRawImage	RAW画像か
+		 * @param	info		画像の情報(out)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool GetTiledImageInfo(const wchar_t* path, bool isRawImage, TiledImageInfo& info);
+
+		/*!
+		 * @brief	縮小レベルの画像のうち、指定範囲を取得する
+		 * @param	path				画像パス
+		 * @param	tileReadSettings	タイル読み込み設定
+		 * @param	imageData			画像データ(out。BGR 8bit。範囲は縮小レベルの画像内に切り詰める)
+		 * @return	成功: True, 失敗: False(範囲が画像の外側にある場合を含む)
+		 */
+		bool GetTile(const wchar_t* path, const TileReadSettings& tileReadSettings, ImageData& imageData);
+
+		/*!
+		 * @brief	タイルキャッシュの上限を変更する
+		 * @param	capacity	上限(Byte)
+		 */
+		void SetCapacity(size_t capacity);
+
+		/*!
+		 * @brief	タイルキャッシュの統計情報を取得する
+		 * @return	統計情報
+		 */
+		TileCacheStatistics GetStatistics() const;
+
+		/*!
+		 * @brief	縮小レベルの画像サイズを求める(各辺を2^levelで割って切り上げる)
+		 * @param	imageSize	等倍のサイズ
+		 * @param	level		縮小レベル
+		 * @return	サイズ
+		 */
+		static cv::Size GetLevelSize(cv::Size imageSize, int level) noexcept;
+
+	private:
+		/*!
+		 * @brief	画像の等倍のサイズを取得する(キャッシュにない場合はヘッダーから読み取る)
+		 */
+		bool GetImageSize(const wchar_t* path, bool isRawImage, long long lastWriteTime, cv::Size& size);
+
+		/*!
+		 * @brief	キャッシュから範囲内のタイルを取得する
+		 * @param	key			キー(列・行は上書きする)
+		 * @param	tileRange	タイルの範囲(列・行)
+		 * @param	tiles		タイル(行優先。取得済みの要素は探さない)
+		 * @return	全て揃った: True
+		 */
+		bool FindTiles(TileKey& key, const cv::Rect& tileRange, std::vector<cv::Mat>& tiles);
+
+		/*!
+		 * @brief	縮小レベルをデコードする
+		 * @param	path		画像パス
+		 * @param	isRawImage	RAW画像か
+		 * @param	level		縮小レベル
+		 * @param	levelSize	縮小レベルの画像サイズ
+		 * @return	縮小レベルの画像(失敗した場合はnullptr)
+		 */
+		std::shared_ptr<ImageData> DecodeLevel(const wchar_t* path, bool isRawImage, int level, cv::Size levelSize);
+
+		/*!
+		 * @brief	縮小レベルの画像から要求範囲と隣接するタイルを切り出し、キャッシュへ追加する
+		 * @param	levelData		縮小レベルの画像
+		 * @param	key				キー(列・行は上書きする)
+		 * @param	levelSize		縮小レベルの画像サイズ
+		 * @param	tileRange		要求されたタイルの範囲(列・行)
+		 * @param	tiles			要求されたタイル(out。行優先。取得済みの要素は切り出さない)
+		 * @param	isWholeLevel	縮小レベル全体を対象とするか(縮小レベルの画像を保持できない場合。falseの場合は周囲1タイル分まで)
+		 */
+		void CutTiles(const ImageData& levelData, TileKey& key, cv::Size levelSize, const cv::Rect& tileRange, std::vector<cv::Mat>& tiles, bool isWholeLevel);
+
+		/*!
+		 * @brief	デコードした画像からタイルを切り出す
+		 * @param	levelImage	デコードした縮小レベルの画像
+		 * @param	tileRect	タイルの範囲(縮小レベルの座標系)
+		 * @return	タイル
+		 * @note	デコード結果は縮小時の丸めにより縮小レベルのサイズと1画素程度異なる場合があるため、不足分は端の画素で埋める
+		 */
+		static cv::Mat CutTile(const cv::Mat& levelImage, const cv::Rect& tileRect);
+
+		Common::ImageDataWriter m_imageDataWriter;						//!< 画像データの書き込み
+		IImageController& m_rawImageController;							//!< RAW画像のデコード
+		IImageController& m_normalImageController;						//!< 通常の画像のデコード
+		std::shared_ptr<Diagnostics::DecodeStatistics> m_statistics;	//!< 統計情報の記録先
+		TileCache m_tileCache;											//!< タイルキャッシュ
+	};
+}
@@ -0,0 +1,502 @@
+/*!
+ * @file	WorkerProcess.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "WorkerProcess.h"
+#include "MappedFile.h"
+#include <algorithm>	// std::min
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <cstdio>		// _fileno
+#include <io.h>			// _dup2
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace Kchary::ImageController::Service
+{
+	namespace
+	{
+		constexpr std::chrono::milliseconds ExitTimeout(1000);		//!< 通信路を閉じてからワーカーの終了を待つ時間
+	}
+
+	WorkerProcess::~WorkerProcess()
+	{
+		Close();
+	}
+
+	ParentChannel::~ParentChannel()
+	{
+#ifdef _WIN32
+		if (m_outputHandle)
+		{
+			::CloseHandle(m_outputHandle);
+		}
+#else
+		if (m_outputDescriptor >= 0)
+		{
+			::close(m_outputDescriptor);
+		}
+#endif
+	}
+
+#ifdef _WIN32
+	namespace
+	{
+		/*!
+		 * @brief	コマンドラインの1つの引数として解釈されるよう引用符で囲む(CommandLineToArgvWの規則)
+		 */
+		std::wstring QuoteArgument(const std::wstring& argument)
+		{
+			if (!argument.empty() && argument.find_first_of(L" \t\n\v\"") == std::wstring::npos)
+			{
+				return argument;
+			}
+
+			std::wstring quoted = L"\"";
+			size_t backslashCount = 0;
+			for (const wchar_t c : argument)
+			{
+				if (c == L'\\')
+				{
+					++backslashCount;
+					continue;
+				}
+
+				// 引用符の直前の\は2倍にし、引用符自体も\でエスケープする
+				quoted.append(c == L'"' ? backslashCount * 2 + 1 : backslashCount, L'\\');
+				quoted += c;
+				backslashCount = 0;
+			}
+			quoted.append(backslashCount * 2, L'\\');
+			quoted += L'"';
+
+			return quoted;
+		}
+
+		void CloseHandleIfOpen(void*& handle) noexcept
+		{
+			if (handle)
+			{
+				::CloseHandle(handle);
+				handle = nullptr;
+			}
+		}
+	}
+
+	bool WorkerProcess::Start(const std::wstring& executablePath, const std::vector<std::wstring>& arguments, std::intptr_t inheritedHandle)
+	{
+		Close();
+
+		// ワーカー側の端のみ継承させる
+		SECURITY_ATTRIBUTES securityAttributes{ sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+		HANDLE inputRead = nullptr;
+		HANDLE inputWrite = nullptr;
+		HANDLE outputRead = nullptr;
+		HANDLE outputWrite = nullptr;
+		if (!::CreatePipe(&inputRead, &inputWrite, &securityAttributes, 0))
+		{
+			return false;
+		}
+		if (!::CreatePipe(&outputRead, &outputWrite, &securityAttributes, 0))
+		{
+			::CloseHandle(inputRead);
+			::CloseHandle(inputWrite);
+			return false;
+		}
+		::SetHandleInformation(inputWrite, HANDLE_FLAG_INHERIT, 0);
+		::SetHandleInformation(outputRead, HANDLE_FLAG_INHERIT, 0);
+
+		// GUIアプリケーションは標準エラー出力を持たない場合があるため、ある場合のみ継承可能な複製を渡す
+		HANDLE errorHandle = nullptr;
+		const HANDLE standardError = ::GetStdHandle(STD_ERROR_HANDLE);
+		if (standardError && standardError != INVALID_HANDLE_VALUE)
+		{
+			::DuplicateHandle(::GetCurrentProcess(), standardError, ::GetCurrentProcess(), &errorHandle, 0, TRUE, DUPLICATE_SAME_ACCESS);
+		}
+
+		// 同時に起動される他の子プロセスへ継承されないよう、継承するハンドルを限定する
+		std::vector<HANDLE> handles{ inputRead, outputWrite, reinterpret_cast<HANDLE>(inheritedHandle) };
+		if (errorHandle)
+		{
+			handles.push_back(errorHandle);
+		}
+
+		SIZE_T attributeListSize = 0;
+		::InitializeProcThreadAttributeList(nullptr, 1, 0, &attributeListSize);
+		std::vector<unsigned char> attributeListBuffer(attributeListSize);
+		auto* const attributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributeListBuffer.data());
+		const bool isAttributeListInitialized = ::InitializeProcThreadAttributeList(attributeList, 1, 0, &attributeListSize) != FALSE;
+
+		STARTUPINFOEXW startupInfo{};
+		startupInfo.StartupInfo.cb = sizeof(startupInfo);
+		startupInfo.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+		startupInfo.StartupInfo.hStdInput = inputRead;
+		startupInfo.StartupInfo.hStdOutput = outputWrite;
+		startupInfo.StartupInfo.hStdError = errorHandle;
+		startupInfo.lpAttributeList = attributeList;
+
+		std::wstring commandLine = QuoteArgument(executablePath);
+		for (const auto& argument : arguments)
+		{
+			commandLine += L' ' + QuoteArgument(argument);
+		}
+		commandLine += L' ' + std::to_wstring(inheritedHandle);
+
+		PROCESS_INFORMATION processInformation{};
+		const bool result = isAttributeListInitialized
+			&& ::UpdateProcThreadAttribute(attributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, handles.data(), handles.size() * sizeof(HANDLE), nullptr, nullptr)
+			&& ::CreateProcessW(executablePath.c_str(), commandLine.data(), nullptr, nullptr, TRUE, CREATE_NO_WINDOW | EXTENDED_STARTUPINFO_PRESENT, nullptr, nullptr, &startupInfo.StartupInfo, &processInformation);
+
+		if (isAttributeListInitialized)
+		{
+			::DeleteProcThreadAttributeList(attributeList);
+		}
+		::CloseHandle(inputRead);
+		::CloseHandle(outputWrite);
+		if (errorHandle)
+		{
+			::CloseHandle(errorHandle);
+		}
+
+		if (!result)
+		{
+			::CloseHandle(inputWrite);
+			::CloseHandle(outputRead);
+			return false;
+		}
+
+		::CloseHandle(processInformation.hThread);
+		m_processHandle = processInformation.hProcess;
+		m_inputHandle = inputWrite;
+		m_outputHandle = outputRead;
+		return true;
+	}
+
+	void WorkerProcess::Close() noexcept
+	{
+		// 通信路を閉じるとワーカーは入力の終端を受け取って終了する
+		CloseHandleIfOpen(m_inputHandle);
+		CloseHandleIfOpen(m_outputHandle);
+		if (m_processHandle)
+		{
+			if (::WaitForSingleObject(m_processHandle, static_cast<DWORD>(ExitTimeout.count())) != WAIT_OBJECT_0)
+			{
+				::TerminateProcess(m_processHandle, 1);
+				::WaitForSingleObject(m_processHandle, INFINITE);
+			}
+			CloseHandleIfOpen(m_processHandle);
+		}
+	}
+
+	void WorkerProcess::Terminate() noexcept
+	{
+		if (m_processHandle)
+		{
+			::TerminateProcess(m_processHandle, 1);
+		}
+	}
+
+	bool WorkerProcess::Write(const void* data, size_t size)
+	{
+		const auto* bytes = static_cast<const unsigned char*>(data);
+		while (size > 0)
+		{
+			DWORD writtenSize = 0;
+			if (!::WriteFile(m_inputHandle, bytes, static_cast<DWORD>((std::min)(size, size_t{ MAXDWORD })), &writtenSize, nullptr) || writtenSize == 0)
+			{
+				return false;
+			}
+			bytes += writtenSize;
+			size -= writtenSize;
+		}
+
+		return true;
+	}
+
+	bool WorkerProcess::Read(void* data, size_t size)
+	{
+		auto* bytes = static_cast<unsigned char*>(data);
+		while (size > 0)
+		{
+			DWORD readSize = 0;
+			if (!::ReadFile(m_outputHandle, bytes, static_cast<DWORD>((std::min)(size, size_t{ MAXDWORD })), &readSize, nullptr) || readSize == 0)
+			{
+				return false;
+			}
+			bytes += readSize;
+			size -= readSize;
+		}
+
+		return true;
+	}
+
+	bool WorkerProcess::IsStarted() const noexcept
+	{
+		return m_processHandle != nullptr;
+	}
+
+	bool ParentChannel::Open()
+	{
+		m_inputHandle = ::GetStdHandle(STD_INPUT_HANDLE);
+		const HANDLE standardOutput = ::GetStdHandle(STD_OUTPUT_HANDLE);
+		if (!m_inputHandle || m_inputHandle == INVALID_HANDLE_VALUE || !standardOutput || standardOutput == INVALID_HANDLE_VALUE
+			|| !::DuplicateHandle(::GetCurrentProcess(), standardOutput, ::GetCurrentProcess(), &m_outputHandle, 0, FALSE, DUPLICATE_SAME_ACCESS))
+		{
+			return false;
+		}
+
+		// 以降の標準出力(printf・std::cout)は標準エラー出力へ出す
+		::SetStdHandle(STD_OUTPUT_HANDLE, ::GetStdHandle(STD_ERROR_HANDLE));
+		_dup2(_fileno(stderr), _fileno(stdout));
+		return true;
+	}
+
+	bool ParentChannel::Write(const void* data, size_t size)
+	{
+		const auto* bytes = static_cast<const unsigned char*>(data);
+		while (size > 0)
+		{
+			DWORD writtenSize = 0;
+			if (!::WriteFile(m_outputHandle, bytes, static_cast<DWORD>((std::min)(size, size_t{ MAXDWORD })), &writtenSize, nullptr) || writtenSize == 0)
+			{
+				return false;
+			}
+			bytes += writtenSize;
+			size -= writtenSize;
+		}
+
+		return true;
+	}
+
+	bool ParentChannel::Read(void* data, size_t size)
+	{
+		auto* bytes = static_cast<unsigned char*>(data);
+		while (size > 0)
+		{
+			DWORD readSize = 0;
+			if (!::ReadFile(m_inputHandle, bytes, static_cast<DWORD>((std::min)(size, size_t{ MAXDWORD })), &readSize, nullptr) || readSize == 0)
+			{
+				return false;
+			}
+			bytes += readSize;
+			size -= readSize;
+		}
+
+		return true;
+	}
+#else
+	namespace
+	{
+		constexpr int InheritedDescriptor = 3;		//!< ワーカーへ引き継ぐファイルディスクリプタのワーカーでの値
+
+		void CloseIfOpen(int& descriptor) noexcept
+		{
+			if (descriptor >= 0)
+			{
+				::close(descriptor);
+				descriptor = -1;
+			}
+		}
+	}
+
+	bool WorkerProcess::Start(const std::wstring& executablePath, const std::vector<std::wstring>& arguments, std::intptr_t inheritedHandle)
+	{
+		Close();
+
+		// 双方向の通信路として1組のソケットを使い、ワーカーの標準入力と標準出力の両方につなぐ
+		int sockets[2] = { -1, -1 };
+		if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+		{
+			return false;
+		}
+
+		std::vector<std::string> argumentStrings{ IO::ToUtf8Path(executablePath.c_str()) };
+		for (const auto& argument : arguments)
+		{
+			argumentStrings.push_back(IO::ToUtf8Path(argument.c_str()));
+		}
+		argumentStrings.push_back(std::to_string(InheritedDescriptor));
+
+		std::vector<char*> argv;
+		for (auto& argument : argumentStrings)
+		{
+			argv.push_back(argument.data());
+		}
+		argv.push_back(nullptr);
+
+		// 親プロセスのファイルディスクリプタはCLOEXECのため、複製した3つのみ引き継がれる
+		posix_spawn_file_actions_t fileActions;
+		::posix_spawn_file_actions_init(&fileActions);
+		::posix_spawn_file_actions_adddup2(&fileActions, sockets[1], STDIN_FILENO);
+		::posix_spawn_file_actions_adddup2(&fileActions, sockets[1], STDOUT_FILENO);
+		::posix_spawn_file_actions_adddup2(&fileActions, static_cast<int>(inheritedHandle), InheritedDescriptor);
+
+		pid_t processId = -1;
+		const int result = ::posix_spawn(&processId, argumentStrings.front().c_str(), &fileActions, nullptr, argv.data(), environ);
+		::posix_spawn_file_actions_destroy(&fileActions);
+		::close(sockets[1]);
+
+		if (result != 0)
+		{
+			::close(sockets[0]);
+			return false;
+		}
+
+		m_processId = processId;
+		m_socket = sockets[0];
+		return true;
+	}
+
+	void WorkerProcess::Close() noexcept
+	{
+		// 通信路を閉じるとワーカーは入力の終端を受け取って終了する
+		CloseIfOpen(m_socket);
+		if (m_processId > 0)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + ExitTimeout;
+			int status = 0;
+			pid_t result = 0;
+			while ((result = ::waitpid(m_processId, &status, WNOHANG)) == 0 && std::chrono::steady_clock::now() < deadline)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			if (result == 0)
+			{
+				::kill(m_processId, SIGKILL);
+				while (::waitpid(m_processId, &status, 0) < 0 && errno == EINTR)
+				{
+				}
+			}
+			m_processId = -1;
+		}
+	}
+
+	void WorkerProcess::Terminate() noexcept
+	{
+		// 終了したワーカーはClose()で回収するまでプロセスIDが再利用されない
+		if (m_processId > 0)
+		{
+			::kill(m_processId, SIGKILL);
+		}
+	}
+
+	bool WorkerProcess::Write(const void* data, size_t size)
+	{
+		const auto* bytes = static_cast<const unsigned char*>(data);
+		while (size > 0)
+		{
+			// 終了したワーカーへの書き込みでSIGPIPEを発生させない
+			const ssize_t writtenSize = ::send(m_socket, bytes, size, MSG_NOSIGNAL);
+			if (writtenSize < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (writtenSize <= 0)
+			{
+				return false;
+			}
+			bytes += writtenSize;
+			size -= static_cast<size_t>(writtenSize);
+		}
+
+		return true;
+	}
+
+	bool WorkerProcess::Read(void* data, size_t size)
+	{
+		auto* bytes = static_cast<unsigned char*>(data);
+		while (size > 0)
+		{
+			const ssize_t readSize = ::recv(m_socket, bytes, size, 0);
+			if (readSize < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (readSize <= 0)
+			{
+				return false;
+			}
+			bytes += readSize;
+			size -= static_cast<size_t>(readSize);
+		}
+
+		return true;
+	}
+
+	bool WorkerProcess::IsStarted() const noexcept
+	{
+		return m_processId > 0;
+	}
+
+	bool ParentChannel::Open()
+	{
+		m_inputDescriptor = STDIN_FILENO;
+		m_outputDescriptor = ::fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+		if (m_outputDescriptor < 0)
+		{
+			return false;
+		}
+
+		// 以降の標準出力(printf・std::cout)は標準エラー出力へ出す。親プロセスの終了はWrite()の失敗で検出する
+		::dup2(STDERR_FILENO, STDOUT_FILENO);
+		std::signal(SIGPIPE, SIG_IGN);
+		return true;
+	}
+
+	bool ParentChannel::Write(const void* data, size_t size)
+	{
+		const auto* bytes = static_cast<const unsigned char*>(data);
+		while (size > 0)
+		{
+			const ssize_t writtenSize = ::write(m_outputDescriptor, bytes, size);
+			if (writtenSize < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (writtenSize <= 0)
+			{
+				return false;
+			}
+			bytes += writtenSize;
+			size -= static_cast<size_t>(writtenSize);
+		}
+
+		return true;
+	}
+
+	bool ParentChannel::Read(void* data, size_t size)
+	{
+		auto* bytes = static_cast<unsigned char*>(data);
+		while (size > 0)
+		{
+			const ssize_t readSize = ::read(m_inputDescriptor, bytes, size);
+			if (readSize < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (readSize <= 0)
+			{
+				return false;
+			}
+			bytes += readSize;
+			size -= static_cast<size_t>(readSize);
+		}
+
+		return true;
+	}
+#endif
+}
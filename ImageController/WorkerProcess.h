@@ -0,0 +1,127 @@
+/*!
+ * @file	WorkerProcess.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Kchary::ImageController::Service
+{
+	/*!
+	 * @brief 子プロセスとして起動したワーカーと、その標準入出力につないだ通信路
+	 * @note ワーカーが異常終了した場合、Read()・Write()は例外やシグナルを発生させずにFalseを返す。
+	 *		 Terminate()は別のスレッドから呼び出してよく、Read()で待っているスレッドを解放する
+	 */
+	class WorkerProcess final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 */
+		WorkerProcess() = default;
+
+		/*!
+		 * @brief デストラクタ(起動中の場合は終了させる)
+		 */
+		~WorkerProcess();
+
+		WorkerProcess(const WorkerProcess&) = delete;
+		WorkerProcess& operator=(const WorkerProcess&) = delete;
+
+		/*!
+		 * @brief	ワーカーを起動する
+		 * @param	executablePath	実行ファイルのパス
+		 * @param	arguments		引数(実行ファイルのパスを除く)
+		 * @param	inheritedHandle	ワーカーへ引き継ぐハンドル(IO::SharedMemory::GetHandle()の値。ワーカーでの値を最後の引数として追加する)
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Start(const std::wstring& executablePath, const std::vector<std::wstring>& arguments, std::intptr_t inheritedHandle);
+
+		/*!
+		 * @brief	通信路を閉じ、ワーカーの終了を待つ(一定時間内に終了しない場合は強制終了する)
+		 */
+		void Close() noexcept;
+
+		/*!
+		 * @brief	ワーカーを強制終了する(終了の待機・後片付けはClose()で行う)
+		 */
+		void Terminate() noexcept;
+
+		/*!
+		 * @brief	ワーカーの標準入力へ書き込む
+		 * @return	成功: True, 失敗: False(ワーカーが終了した)
+		 */
+		bool Write(const void* data, size_t size);
+
+		/*!
+		 * @brief	ワーカーの標準出力から指定バイト数を読み込む(揃うまで待つ)
+		 * @return	成功: True, 失敗: False(ワーカーが終了した)
+		 */
+		bool Read(void* data, size_t size);
+
+		bool IsStarted() const noexcept;
+
+	private:
+#ifdef _WIN32
+		void* m_processHandle = nullptr;		//!< プロセスハンドル(HANDLE)
+		void* m_inputHandle = nullptr;			//!< ワーカーの標準入力へ書き込むパイプ(HANDLE)
+		void* m_outputHandle = nullptr;			//!< ワーカーの標準出力を読み込むパイプ(HANDLE)
+#else
+		int m_processId = -1;					//!< プロセスID
+		int m_socket = -1;						//!< ワーカーの標準入出力につないだソケット
+#endif
+	};
+
+	/*!
+	 * @brief ワーカー側から見た、親プロセスとの通信路(標準入出力)
+	 * @note 開いた後の標準出力は標準エラー出力へ付け替え、ライブラリの出力が通信路に混ざらないようにする
+	 */
+	class ParentChannel final
+	{
+	public:
+		/*!
+		 * @brief コンストラクタ
+		 */
+		ParentChannel() = default;
+
+		/*!
+		 * @brief デストラクタ
+		 */
+		~ParentChannel();
+
+		ParentChannel(const ParentChannel&) = delete;
+		ParentChannel& operator=(const ParentChannel&) = delete;
+
+		/*!
+		 * @brief	標準入出力を通信路として開く
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Open();
+
+		/*!
+		 * @brief	親プロセスへ書き込む
+		 * @return	成功: True, 失敗: False(親プロセスが終了した)
+		 */
+		bool Write(const void* data, size_t size);
+
+		/*!
+		 * @brief	親プロセスから指定バイト数を読み込む(揃うまで待つ)
+		 * @return	成功: True, 失敗: False(親プロセスが通信路を閉じた)
+		 */
+		bool Read(void* data, size_t size);
+
+	private:
+#ifdef _WIN32
+		void* m_inputHandle = nullptr;			//!< 標準入力(HANDLE)
+		void* m_outputHandle = nullptr;			//!< 付け替える前の標準出力を複製したハンドル(HANDLE)
+#else
+		int m_inputDescriptor = -1;				//!< 標準入力
+		int m_outputDescriptor = -1;			//!< 付け替える前の標準出力を複製したファイルディスクリプタ
+#endif
+	};
+}
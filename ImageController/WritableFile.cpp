@@ -0,0 +1,209 @@
+/*!
+ * @file	WritableFile.cpp
+ * @author	kleon6436
+ */
+
+#include "pch.h"
+#include "WritableFile.h"
+#include "MappedFile.h"
+#include <algorithm>	// std::min
+#include <cerrno>		// errno
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Kchary::ImageController::IO
+{
+	namespace
+	{
+		constexpr size_t WriteChunkSize = 4 * 1024 * 1024;	//!< 1回の書き込みサイズ
+	}
+
+	WritableFile::~WritableFile()
+	{
+		Close();
+	}
+
+#ifdef _WIN32
+	bool WritableFile::Open(const wchar_t* path, OpenMode openMode)
+	{
+		Close();
+
+		const DWORD creationDisposition = openMode == OpenMode::Truncate ? CREATE_ALWAYS : OPEN_ALWAYS;
+		const HANDLE file = ::CreateFileW(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, creationDisposition, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		m_fileHandle = file;
+
+		LARGE_INTEGER fileSize{};
+		if (!::GetFileSizeEx(file, &fileSize) || !::SetFilePointerEx(file, fileSize, nullptr, FILE_BEGIN))
+		{
+			Close();
+			return false;
+		}
+		m_size = static_cast<size_t>(fileSize.QuadPart);
+
+		return true;
+	}
+
+	void WritableFile::Close() noexcept
+	{
+		if (m_fileHandle)
+		{
+			::CloseHandle(m_fileHandle);
+			m_fileHandle = nullptr;
+		}
+
+		m_size = 0;
+	}
+
+	bool WritableFile::Write(const void* data, size_t size)
+	{
+		const auto* bytes = static_cast<const unsigned char*>(data);
+		size_t offset = 0;
+		while (offset < size)
+		{
+			const DWORD chunkSize = static_cast<DWORD>((std::min)(WriteChunkSize, size - offset));
+			DWORD writtenSize = 0;
+			if (!::WriteFile(m_fileHandle, bytes + offset, chunkSize, &writtenSize, nullptr) || writtenSize == 0)
+			{
+				m_size += offset;
+				return false;
+			}
+			offset += writtenSize;
+		}
+
+		m_size += size;
+		return true;
+	}
+
+	bool WritableFile::Flush()
+	{
+		return ::FlushFileBuffers(m_fileHandle) != FALSE;
+	}
+
+	bool WritableFile::Truncate(size_t size)
+	{
+		LARGE_INTEGER position{};
+		position.QuadPart = static_cast<LONGLONG>(size);
+		if (!::SetFilePointerEx(m_fileHandle, position, nullptr, FILE_BEGIN) || !::SetEndOfFile(m_fileHandle))
+		{
+			return false;
+		}
+
+		m_size = size;
+		return true;
+	}
+
+	bool WritableFile::IsOpen() const noexcept
+	{
+		return m_fileHandle != nullptr;
+	}
+
+	bool ReplaceFile(const wchar_t* source, const wchar_t* destination)
+	{
+		return ::MoveFileExW(source, destination, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+	}
+
+	bool RemoveFile(const wchar_t* path)
+	{
+		return ::DeleteFileW(path) != FALSE || ::GetLastError() == ERROR_FILE_NOT_FOUND;
+	}
+#else
+	bool WritableFile::Open(const wchar_t* path, OpenMode openMode)
+	{
+		Close();
+
+		const int flags = O_RDWR | O_CREAT | O_CLOEXEC | (openMode == OpenMode::Truncate ? O_TRUNC : 0);
+		const int fileDescriptor = ::open(ToUtf8Path(path).c_str(), flags, 0644);
+		if (fileDescriptor < 0)
+		{
+			return false;
+		}
+		m_fileDescriptor = fileDescriptor;
+
+		const off_t fileSize = ::lseek(fileDescriptor, 0, SEEK_END);
+		if (fileSize < 0)
+		{
+			Close();
+			return false;
+		}
+		m_size = static_cast<size_t>(fileSize);
+
+		return true;
+	}
+
+	void WritableFile::Close() noexcept
+	{
+		if (m_fileDescriptor >= 0)
+		{
+			::close(m_fileDescriptor);
+			m_fileDescriptor = -1;
+		}
+
+		m_size = 0;
+	}
+
+	bool WritableFile::Write(const void* data, size_t size)
+	{
+		const auto* bytes = static_cast<const unsigned char*>(data);
+		size_t offset = 0;
+		while (offset < size)
+		{
+			const ssize_t writtenSize = ::write(m_fileDescriptor, bytes + offset, (std::min)(WriteChunkSize, size - offset));
+			if (writtenSize < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (writtenSize <= 0)
+			{
+				m_size += offset;
+				return false;
+			}
+			offset += static_cast<size_t>(writtenSize);
+		}
+
+		m_size += size;
+		return true;
+	}
+
+	bool WritableFile::Flush()
+	{
+		return ::fsync(m_fileDescriptor) == 0;
+	}
+
+	bool WritableFile::Truncate(size_t size)
+	{
+		if (::ftruncate(m_fileDescriptor, static_cast<off_t>(size)) != 0 || ::lseek(m_fileDescriptor, static_cast<off_t>(size), SEEK_SET) < 0)
+		{
+			return false;
+		}
+
+		m_size = size;
+		return true;
+	}
+
+	bool WritableFile::IsOpen() const noexcept
+	{
+		return m_fileDescriptor >= 0;
+	}
+
+	bool ReplaceFile(const wchar_t* source, const wchar_t* destination)
+	{
+		return std::rename(ToUtf8Path(source).c_str(), ToUtf8Path(destination).c_str()) == 0;
+	}
+
+	bool RemoveFile(const wchar_t* path)
+	{
+		return ::unlink(ToUtf8Path(path).c_str()) == 0 || errno == ENOENT;
+	}
+#endif
+}
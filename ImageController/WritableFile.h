@@ -0,0 +1,103 @@
+/*!
+ * @file	WritableFile.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace Kchary::ImageController::IO
+{
+	/*!
+	 * @brief 書き込み用に開いたファイル(末尾への追記のみを行う)
+	 * @note 他のハンドルからの読み込み・メモリマップを許可する
+	 */
+	class WritableFile final
+	{
+	public:
+		/*!
+		 * @brief ファイルの開き方
+		 */
+		enum class OpenMode
+		{
+			Append,		//!< 既存の内容の末尾へ追記する(存在しない場合は作成する)
+			Truncate,	//!< 空にしてから書き込む(存在しない場合は作成する)
+		};
+
+		/*!
+		 * @brief コンストラクタ
+		 */
+		WritableFile() = default;
+
+		/*!
+		 * @brief デストラクタ
+		 */
+		~WritableFile();
+
+		WritableFile(const WritableFile&) = delete;
+		WritableFile& operator=(const WritableFile&) = delete;
+
+		/*!
+		 * @brief	ファイルを開く
+		 * @param	path		ファイルパス
+		 * @param	openMode	開き方
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Open(const wchar_t* path, OpenMode openMode);
+
+		/*!
+		 * @brief	ファイルを閉じる
+		 */
+		void Close() noexcept;
+
+		/*!
+		 * @brief	末尾へ書き込む
+		 * @param	data	書き込むデータ
+		 * @param	size	バイト数
+		 * @return	成功: True, 失敗: False(途中まで書き込まれている場合がある)
+		 */
+		bool Write(const void* data, size_t size);
+
+		/*!
+		 * @brief	書き込んだ内容をストレージへ書き出し、電源断後も残るようにする
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Flush();
+
+		/*!
+		 * @brief	指定サイズに切り詰める(書き込み途中で中断された末尾を取り除く)
+		 * @param	size	切り詰め後のサイズ
+		 * @return	成功: True, 失敗: False
+		 */
+		bool Truncate(size_t size);
+
+		size_t size() const noexcept { return m_size; }
+		bool IsOpen() const noexcept;
+
+	private:
+		size_t m_size = 0;							//!< ファイルサイズ(次に書き込む位置)
+
+#ifdef _WIN32
+		void* m_fileHandle = nullptr;				//!< ファイルハンドル(HANDLE)
+#else
+		int m_fileDescriptor = -1;					//!< ファイルディスクリプタ
+#endif
+	};
+
+	/*!
+	 * @brief	ファイルを置き換える(置き換え先が存在する場合も1回の操作で入れ替える)
+	 * @param	source		置き換え元のファイルパス(置き換え後は存在しない)
+	 * @param	destination	置き換え先のファイルパス
+	 * @return	成功: True, 失敗: False
+	 * @note	置き換え先をメモリマップしている場合、Windowsでは失敗する
+	 */
+	bool ReplaceFile(const wchar_t* source, const wchar_t* destination);
+
+	/*!
+	 * @brief	ファイルを削除する
+	 * @param	path	ファイルパス
+	 * @return	成功(存在しない場合を含む): True, 失敗: False
+	 */
+	bool RemoveFile(const wchar_t* path);
+}
@@ -0,0 +1,224 @@
+/*!
+ * @file	BatchExport.cpp
+ * @author	kleon6436
+ * @brief	BatchExporterで画像を一括で縮小・変換して書き出すコマンドラインツール
+ * @note	使い方: BatchExport [--long-side 長辺の長さ] [--format jpeg|png|bmp|tiff] [--quality JPEGの品質]
+ *			[--decode-threads スレッド数] [--encode-threads スレッド数] [--max-pending-mb MB] 出力ディレクトリ 画像パス...
+ *			画像ごとの結果と全体のスループットを出力し、失敗した画像がある場合は終了コード1を返す
+ *			Ctrl+C(SIGINT)を受けると処理中の画像を中断し、未処理の画像は書き出さずに終了コード130を返す
+ */
+
+#include "BatchExporter.h"
+#include "ImageData.h"
+#include "ImageReader.h"
+#include <algorithm>	// std::max
+#include <atomic>		// std::atomic
+#include <cctype>		// std::tolower
+#include <chrono>		// std::chrono::milliseconds
+#include <csignal>		// std::signal
+#include <cstdio>		// std::printf
+#include <cstdlib>		// std::atoi
+#include <filesystem>	// std::filesystem
+#include <string>		// std::string
+#include <thread>		// std::thread
+#include <vector>		// std::vector
+
+namespace
+{
+	namespace fs = std::filesystem;
+	using namespace Kchary::ImageController::Library;
+
+	std::atomic<bool> g_isInterrupted{ false };	//!< SIGINTを受けたか(シグナルハンドラーから書き込むためロックフリーであること)
+
+	/*!
+	 * @brief	SIGINTのハンドラー(フラグのみ立て、中断はシグナルハンドラーの外で行う)
+	 */
+	extern "C" void OnInterrupt(int)
+	{
+		g_isInterrupted.store(true);
+	}
+
+	/*!
+	 * @brief	拡張子からRAW画像か判定する
+	 */
+	bool IsRawImage(const fs::path& path)
+	{
+		static const char* const RawExtensions[] = { ".arw", ".cr2", ".cr3", ".dng", ".nef", ".nrw", ".orf", ".pef", ".raf", ".rw2", ".srw" };
+
+		std::string extension = path.extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return std::any_of(std::begin(RawExtensions), std::end(RawExtensions), [&extension](const char* raw) { return extension == raw; });
+	}
+
+	bool ParseFormat(const std::string& name, ExportFormat& format, const char*& extension)
+	{
+		if (name == "jpeg" || name == "jpg")
+		{
+			format = ExportFormat::Jpeg;
+			extension = ".jpg";
+		}
+		else if (name == "png")
+		{
+			format = ExportFormat::Png;
+			extension = ".png";
+		}
+		else if (name == "bmp")
+		{
+			format = ExportFormat::Bmp;
+			extension = ".bmp";
+		}
+		else if (name == "tiff" || name == "tif")
+		{
+			format = ExportFormat::Tiff;
+			extension = ".tif";
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	const char* ToString(ExportStatus status)
+	{
+		switch (status)
+		{
+		case ExportStatus::Succeeded:
+			return "ok";
+		case ExportStatus::DecodeFailed:
+			return "decode failed";
+		case ExportStatus::EncodeFailed:
+			return "encode failed";
+		case ExportStatus::WriteFailed:
+			return "write failed";
+		default:
+			return "cancelled";
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	BatchExportSettings settings{};
+	int longSideLength = 0;
+	int quality = 0;
+	ExportFormat format = ExportFormat::Jpeg;
+	const char* extension = ".jpg";
+
+	int i = 1;
+	for (; i + 1 < argc && std::string(argv[i]).rfind("--", 0) == 0; i += 2)
+	{
+		const std::string option = argv[i];
+		if (option == "--long-side")
+		{
+			longSideLength = (std::max)(0, std::atoi(argv[i + 1]));
+		}
+		else if (option == "--format")
+		{
+			if (!ParseFormat(argv[i + 1], format, extension))
+			{
+				std::fprintf(stderr, "Unknown format: %s\n", argv[i + 1]);
+				return 1;
+			}
+		}
+		else if (option == "--quality")
+		{
+			quality = (std::max)(0, std::atoi(argv[i + 1]));
+		}
+		else if (option == "--decode-threads")
+		{
+			settings.decodeThreadCount = static_cast<unsigned int>((std::max)(0, std::atoi(argv[i + 1])));
+		}
+		else if (option == "--encode-threads")
+		{
+			settings.encodeThreadCount = static_cast<unsigned int>((std::max)(0, std::atoi(argv[i + 1])));
+		}
+		else if (option == "--max-pending-mb")
+		{
+			settings.maxPendingBytes = static_cast<size_t>((std::max)(0, std::atoi(argv[i + 1]))) * 1024 * 1024;
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option: %s\n", option.c_str());
+			return 1;
+		}
+	}
+
+	if (argc - i < 2)
+	{
+		std::fprintf(stderr, "Usage: BatchExport [options] OUTPUT_DIRECTORY IMAGE...\n");
+		return 1;
+	}
+
+	const fs::path outputDirectory = argv[i++];
+	std::error_code errorCode;
+	fs::create_directories(outputDirectory, errorCode);
+
+	std::vector<ExportJob> jobs;
+	for (; i < argc; ++i)
+	{
+		const fs::path sourcePath = argv[i];
+		fs::path destinationPath = outputDirectory / sourcePath.filename();
+		destinationPath.replace_extension(extension);
+
+		ExportJob job;
+		job.sourcePath = sourcePath.wstring();
+		job.destinationPath = destinationPath.wstring();
+		job.isRawImage = IsRawImage(sourcePath);
+		job.longSideLength = longSideLength;
+		job.format = format;
+		job.quality = quality;
+		jobs.push_back(std::move(job));
+	}
+
+	ImageReader imageReader;
+	BatchExporter exporter(imageReader, settings);
+
+	// BatchExporter::Cancel()はロックを取得するためシグナルハンドラーから呼べない。フラグを監視するスレッドから中断する
+	static_assert(std::atomic<bool>::is_always_lock_free, "the interrupt flag must be lock-free");
+	std::atomic<bool> isFinished{ false };
+	std::signal(SIGINT, OnInterrupt);
+	std::thread interruptWatcher([&exporter, &isFinished]()
+		{
+			while (!isFinished.load())
+			{
+				if (g_isInterrupted.load())
+				{
+					// Run()の開始前に受けた場合も中断は保持される
+					exporter.Cancel();
+					break;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+		});
+
+	const auto statistics = exporter.Run(jobs, [](const ExportJob& job, const ExportResult& result)
+	{
+		std::printf("%-14s %5dx%-5d %10llu B %9.1f ms %9.1f ms  %s\n",
+			ToString(result.status), result.width, result.height, result.outputBytes,
+			result.decodeMilliseconds, result.encodeMilliseconds, fs::path(job.sourcePath).string().c_str());
+	});
+
+	isFinished.store(true);
+	interruptWatcher.join();
+	std::signal(SIGINT, SIG_DFL);
+
+	const double elapsedSeconds = (std::max)(statistics.elapsedSeconds, 1e-9);
+	std::printf("\n%zu images, %zu succeeded, %zu failed in %.2f s\n", statistics.jobCount, statistics.succeededCount, statistics.failedCount, statistics.elapsedSeconds);
+	std::printf("throughput: %.1f images/sec, %.1f MPixel/sec, %.1f MB/sec read, %.1f MB/sec written\n",
+		static_cast<double>(statistics.succeededCount) / elapsedSeconds,
+		static_cast<double>(statistics.outputPixels) / 1e6 / elapsedSeconds,
+		static_cast<double>(statistics.inputBytes) / (1024.0 * 1024.0) / elapsedSeconds,
+		static_cast<double>(statistics.outputBytes) / (1024.0 * 1024.0) / elapsedSeconds);
+	std::printf("stage time: decode %.2f s, encode %.2f s, peak pending %.1f MB\n",
+		statistics.decodeSeconds, statistics.encodeSeconds, static_cast<double>(statistics.peakPendingBytes) / (1024.0 * 1024.0));
+
+	if (g_isInterrupted.load())
+	{
+		std::fprintf(stderr, "interrupted\n");
+		return 130;
+	}
+
+	return statistics.failedCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+/*!
+ * @file	DecodeServerBenchmark.cpp
+ * @author	kleon6436
+ * @brief	プロセス内でのデコードとデコードサーバー(DecodeServer)でのデコードのスループットを比較するベンチマーク
+ * @note	使い方: DecodeServerBenchmark [--workers ワーカー数] [--threads スレッド数] [--long-side 長辺の長さ] [--slot-mb スロットのMB] [--repeat 繰り返し回数] 画像パス...
+ *			ワーカーには同じディレクトリのDecodeWorkerを使う。
+ *			デコードサーバーの結果別の枚数と、ワーカーの異常終了・再起動の回数もあわせて出力する
+ */
+
+#include "DecodeServer.h"
+#include "ImageData.h"
+#include "ImageReader.h"
+#include <algorithm>			// std::transform
+#include <atomic>				// std::atomic
+#include <cctype>				// std::tolower
+#include <chrono>				// std::chrono::steady_clock
+#include <cstdio>				// std::printf
+#include <cstdlib>				// std::atoi
+#include <filesystem>			// std::filesystem
+#include <functional>			// std::function
+#include <string>				// std::string
+#include <thread>				// std::thread
+#include <vector>				// std::vector
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	namespace fs = std::filesystem;
+	using namespace Kchary::ImageController::Library;
+
+	constexpr size_t StatusCount = static_cast<size_t>(DecodeServerStatus::Unavailable) + 1;	//!< DecodeServerStatusの数
+
+	/*!
+	 * @brief	拡張子からRAW画像か判定する
+	 */
+	bool IsRawImage(const fs::path& path)
+	{
+		static const char* const RawExtensions[] = { ".arw", ".cr2", ".cr3", ".dng", ".nef", ".nrw", ".orf", ".pef", ".raf", ".rw2", ".srw" };
+
+		std::string extension = path.extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return std::any_of(std::begin(RawExtensions), std::end(RawExtensions), [&extension](const char* raw) { return extension == raw; });
+	}
+
+	const char* ToString(DecodeServerStatus status)
+	{
+		switch (status)
+		{
+		case DecodeServerStatus::Succeeded:
+			return "succeeded";
+		case DecodeServerStatus::DecodeFailed:
+			return "decode failed";
+		case DecodeServerStatus::SlotTooSmall:
+			return "slot too small";
+		case DecodeServerStatus::WorkerCrashed:
+			return "worker crashed";
+		case DecodeServerStatus::TimedOut:
+			return "timed out";
+		case DecodeServerStatus::Cancelled:
+			return "cancelled";
+		default:
+			return "unavailable";
+		}
+	}
+
+	/*!
+	 * @brief	画像をスレッド数で分担してデコードし、経過時間(秒)を返す
+	 * @param	decode	1枚をデコードする関数(引数は画像のインデックス)
+	 */
+	double Run(size_t imageCount, unsigned int threadCount, const std::function<void(size_t)>& decode)
+	{
+		std::atomic<size_t> nextIndex{ 0 };
+		const auto start = Clock::now();
+
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([&]()
+				{
+					for (size_t index = nextIndex.fetch_add(1); index < imageCount; index = nextIndex.fetch_add(1))
+					{
+						decode(index);
+					}
+				});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	DecodeServerSettings serverSettings{};
+	unsigned int threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+	int longSideLength = 0;
+	int repeatCount = 1;
+
+	int i = 1;
+	for (; i + 1 < argc && std::string(argv[i]).rfind("--", 0) == 0; i += 2)
+	{
+		const std::string option = argv[i];
+		if (option == "--workers")
+		{
+			serverSettings.workerCount = static_cast<unsigned int>((std::max)(0, std::atoi(argv[i + 1])));
+		}
+		else if (option == "--threads")
+		{
+			threadCount = static_cast<unsigned int>((std::max)(1, std::atoi(argv[i + 1])));
+		}
+		else if (option == "--long-side")
+		{
+			longSideLength = (std::max)(0, std::atoi(argv[i + 1]));
+		}
+		else if (option == "--slot-mb")
+		{
+			serverSettings.slotBytes = static_cast<size_t>((std::max)(0, std::atoi(argv[i + 1]))) * 1024 * 1024;
+		}
+		else if (option == "--repeat")
+		{
+			repeatCount = (std::max)(1, std::atoi(argv[i + 1]));
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option: %s\n", option.c_str());
+			return 1;
+		}
+	}
+
+	if (i >= argc)
+	{
+		std::fprintf(stderr, "Usage: DecodeServerBenchmark [options] IMAGE...\n");
+		return 1;
+	}
+
+	std::vector<std::wstring> paths;
+	std::vector<ImageReadSettings> readSettings;
+	for (int r = 0; r < repeatCount; ++r)
+	{
+		for (int j = i; j < argc; ++j)
+		{
+			ImageReadSettings imageReadSettings{};
+			imageReadSettings.isRawImage = IsRawImage(argv[j]);
+			imageReadSettings.resizeLongSideLength = longSideLength;
+			imageReadSettings.bypassPyramidCache = true;
+			paths.push_back(fs::path(argv[j]).wstring());
+			readSettings.push_back(imageReadSettings);
+		}
+	}
+
+#ifdef _WIN32
+	serverSettings.workerPath = (fs::path(argv[0]).parent_path() / "DecodeWorker.exe").wstring();
+#else
+	serverSettings.workerPath = (fs::path(argv[0]).parent_path() / "DecodeWorker").wstring();
+#endif
+
+	// プロセス内でのデコード
+	ImageReader imageReader;
+	std::atomic<size_t> inProcessFailureCount{ 0 };
+	const double inProcessSeconds = Run(paths.size(), threadCount, [&](size_t index)
+		{
+			ImageData imageData{};
+			if (!imageReader.GetImageData(paths[index].c_str(), readSettings[index], imageData))
+			{
+				inProcessFailureCount.fetch_add(1);
+			}
+		});
+
+	// デコードサーバーでのデコード(起動時間は含めない)
+	DecodeServer server(serverSettings);
+	if (!server.Start())
+	{
+		std::fprintf(stderr, "Failed to start the decode server.\n");
+		return 1;
+	}
+
+	std::atomic<size_t> statusCounts[StatusCount] = {};
+	const double serverSeconds = Run(paths.size(), threadCount, [&](size_t index)
+		{
+			DecodedImage image;
+			const auto status = server.Decode(paths[index].c_str(), readSettings[index], image, nullptr, nullptr);
+			statusCounts[static_cast<size_t>(status)].fetch_add(1);
+		});
+
+	const auto statistics = server.GetStatistics();
+	server.Stop();
+
+	std::printf("%12s %10s %10s %12s %10s\n", "mode", "images", "threads", "images/s", "failed");
+	std::printf("%12s %10zu %10u %12.1f %10zu\n", "in-process", paths.size(), threadCount, paths.size() / inProcessSeconds, inProcessFailureCount.load());
+	std::printf("%12s %10zu %10u %12.1f %10zu\n\n", "server", paths.size(), threadCount, paths.size() / serverSeconds, paths.size() - statusCounts[0].load());
+
+	for (size_t status = 0; status < StatusCount; ++status)
+	{
+		std::printf("%-16s %zu\n", ToString(static_cast<DecodeServerStatus>(status)), statusCounts[status].load());
+	}
+	std::printf("workers: %zu running, %zu crashed, %zu timed out, %zu restarted\n",
+		statistics.runningWorkerCount, statistics.crashedCount, statistics.timedOutCount, statistics.restartCount);
+
+	return inProcessFailureCount.load() > 0 || statusCounts[0].load() != paths.size() ? 1 : 0;
+}
@@ -0,0 +1,13 @@
+/*!
+ * @file	DecodeWorker.cpp
+ * @author	kleon6436
+ * @brief	デコードサーバー(DecodeServer)が子プロセスとして起動するワーカー
+ * @note	DecodeServerSettings::workerPathにこの実行ファイルを指定する(直接起動するものではない)
+ */
+
+#include "DecodeWorker.h"
+
+int main(int argc, char* argv[])
+{
+	return Kchary::ImageController::Service::RunDecodeWorker(argc, argv);
+}
@@ -0,0 +1,132 @@
+/*!
+ * @file	FolderIndexBenchmark.cpp
+ * @author	kleon6436
+ * @brief	フォルダの列挙とFolderIndexerの走査(初回・2回目・保存したインデックスの読み込み後)の処理時間を計測するベンチマーク
+ * @note	使い方: FolderIndexBenchmark [--repeat 繰り返し回数] フォルダパス
+ *			拡張子ごとにフォルダを列挙する従来の方法と、1回の走査で拡張子を選り分けてヘッダーを読むFolderIndexerを比較する
+ */
+
+#include "FolderIndexer.h"
+#include "ImageData.h"
+#include "ImageReader.h"
+#include <algorithm>			// std::sort, std::count_if
+#include <chrono>				// std::chrono::steady_clock
+#include <cstdio>				// std::printf
+#include <cstdlib>				// std::atoi
+#include <cwctype>				// std::towlower
+#include <filesystem>			// std::filesystem
+#include <functional>			// std::function
+#include <string>				// std::string
+#include <vector>				// std::vector
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	namespace fs = std::filesystem;
+	using namespace Kchary::ImageController::Library;
+
+	const std::vector<std::wstring> Extensions = { L".jpg", L".bmp", L".png", L".tiff", L".tif", L".gif", L".dng", L".nef" };	//!< 対象の拡張子(ビューアーと同じ)
+	const std::vector<std::wstring> RawExtensions = { L".dng", L".nef" };															//!< RAW画像の拡張子
+
+	/*!
+	 * @brief	処理を繰り返し、処理時間の中央値(ms)を返す
+	 */
+	double MeasureMilliseconds(int repeatCount, const std::function<void()>& function)
+	{
+		std::vector<double> milliseconds;
+		for (int i = 0; i < repeatCount; ++i)
+		{
+			const auto startTime = Clock::now();
+			function();
+			milliseconds.push_back(std::chrono::duration<double, std::milli>(Clock::now() - startTime).count());
+		}
+
+		std::sort(milliseconds.begin(), milliseconds.end());
+		return milliseconds[milliseconds.size() / 2];
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int repeatCount = 5;
+
+	int i = 1;
+	for (; i + 1 < argc && std::string(argv[i]).rfind("--", 0) == 0; i += 2)
+	{
+		const std::string option = argv[i];
+		if (option == "--repeat")
+		{
+			repeatCount = (std::max)(1, std::atoi(argv[i + 1]));
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option: %s\n", option.c_str());
+			return 1;
+		}
+	}
+
+	if (i >= argc)
+	{
+		std::fprintf(stderr, "Usage: FolderIndexBenchmark [options] DIRECTORY\n");
+		return 1;
+	}
+
+	const std::wstring directory = fs::path(argv[i]).wstring();
+	const std::wstring indexPath = (fs::temp_directory_path() / "FolderIndexBenchmark.bin").wstring();
+
+	// 従来の方法: 拡張子ごとにフォルダを列挙する(大文字・小文字を区別しないため、拡張子を小文字にして比較する)
+	size_t enumeratedCount = 0;
+	const double perExtensionMilliseconds = MeasureMilliseconds(repeatCount, [&]()
+		{
+			enumeratedCount = 0;
+			for (const auto& extension : Extensions)
+			{
+				std::error_code errorCode;
+				for (fs::directory_iterator entry(directory, errorCode), end; !errorCode && entry != end; entry.increment(errorCode))
+				{
+					auto entryExtension = entry->path().extension().wstring();
+					std::transform(entryExtension.begin(), entryExtension.end(), entryExtension.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+					if (entryExtension == extension && entry->is_regular_file(errorCode))
+					{
+						++enumeratedCount;
+					}
+				}
+			}
+		});
+
+	ImageReader imageReader;
+	std::vector<FolderIndexEntry> entries;
+
+	// 初回の走査(全ての画像のヘッダーを読む)。2回目以降はインデックスを使うため、1回のみ計測する
+	FolderIndexer coldIndexer(imageReader, FolderIndexSettings{});
+	const double coldMilliseconds = MeasureMilliseconds(1, [&]() { coldIndexer.Scan(directory.c_str(), Extensions, RawExtensions, entries); });
+
+	// 2回目以降の走査(更新日時・サイズが一致する画像はヘッダーを読まない)
+	const double warmMilliseconds = MeasureMilliseconds(repeatCount, [&]() { coldIndexer.Scan(directory.c_str(), Extensions, RawExtensions, entries); });
+
+	// 保存したインデックスを読み込んでから走査する(次回の起動を想定)
+	const double saveMilliseconds = MeasureMilliseconds(1, [&]() { coldIndexer.Save(indexPath.c_str()); });
+	const double loadMilliseconds = MeasureMilliseconds(repeatCount, [&]()
+		{
+			FolderIndexer indexer(imageReader, FolderIndexSettings{});
+			indexer.Load(indexPath.c_str());
+			indexer.Scan(directory.c_str(), Extensions, RawExtensions, entries);
+		});
+
+	std::error_code errorCode;
+	fs::remove(indexPath, errorCode);
+
+	const size_t headerCount = static_cast<size_t>(std::count_if(entries.begin(), entries.end(), [](const FolderIndexEntry& entry) { return entry.hasHeader; }));
+	std::printf("images: %zu (per-extension enumeration: %zu), headers read: %zu\n\n", entries.size(), enumeratedCount, headerCount);
+	std::printf("%-36s %12s\n", "scenario", "time[ms]");
+	std::printf("%-36s %12.2f\n", "per-extension enumeration", perExtensionMilliseconds);
+	std::printf("%-36s %12.2f\n", "index scan (cold, reads headers)", coldMilliseconds);
+	std::printf("%-36s %12.2f\n", "index scan (warm)", warmMilliseconds);
+	std::printf("%-36s %12.2f\n", "index save", saveMilliseconds);
+	std::printf("%-36s %12.2f\n", "index load + scan", loadMilliseconds);
+
+	const auto statistics = coldIndexer.GetStatistics();
+	std::printf("\nreused: %zu, read: %zu, failed: %zu\n", statistics.reusedCount, statistics.readCount, statistics.failedCount);
+
+	return 0;
+}
@@ -0,0 +1,230 @@
+/*!
+ * @file	ImageHashBenchmark.cpp
+ * @author	kleon6436
+ * @brief	画像ハッシュの計算時間と、ImageHashIndexの構築・クラスタ検出の処理時間を計測するベンチマーク
+ * @note	使い方: ImageHashBenchmark [--count 画像数] [--repeat 繰り返し回数]
+ *			連写・再圧縮を想定して少しずつビットを変えたハッシュの群を生成し、ハミング距離の閾値ごとに計測する。
+ *			総当たりの結果とクラスタが一致しない場合は終了コード1を返す(総当たりは先頭の3000件で比較する)
+ */
+
+#include "ImageData.h"
+#include "ImageHashIndex.h"
+#include "PerceptualHash.h"
+#include <algorithm>			// std::sort
+#include <chrono>				// std::chrono::steady_clock
+#include <cstdio>				// std::printf
+#include <cstdlib>				// std::atoi
+#include <numeric>				// std::iota
+#include <random>				// std::mt19937_64
+#include <string>				// std::string
+#include <vector>				// std::vector
+#include <opencv2/opencv.hpp>	// cv::imencode
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	using namespace Kchary::ImageController;
+
+	constexpr size_t VerifyCount = 3000;	//!< 総当たりと比較する画像数
+
+	double ToMilliseconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	/*!
+	 * @brief	ハッシュの群を生成する(4件に1件は、元のハッシュから数ビット変えた1～6件の類似画像を続ける)
+	 */
+	std::vector<ImageHash> CreateHashes(size_t count)
+	{
+		std::mt19937_64 random(1);
+		auto flipBits = [&random](std::uint64_t hash, int bitCount)
+		{
+			for (int i = 0; i < bitCount; ++i)
+			{
+				hash ^= std::uint64_t{ 1 } << (random() % 64);
+			}
+			return hash;
+		};
+
+		std::vector<ImageHash> hashes;
+		hashes.reserve(count);
+		while (hashes.size() < count)
+		{
+			const ImageHash original{ random(), random() };
+			hashes.push_back(original);
+			if (random() % 4 == 0)
+			{
+				const int similarCount = 1 + static_cast<int>(random() % 6);
+				for (int i = 0; i < similarCount && hashes.size() < count; ++i)
+				{
+					hashes.push_back({ flipBits(original.differenceHash, static_cast<int>(random() % 6)), flipBits(original.perceptualHash, static_cast<int>(random() % 12)) });
+				}
+			}
+		}
+
+		return hashes;
+	}
+
+	/*!
+	 * @brief	総当たりでクラスタを求める
+	 */
+	std::vector<std::vector<size_t>> FindClustersByBruteForce(const std::vector<ImageHash>& hashes, int maxDistance)
+	{
+		std::vector<size_t> parents(hashes.size());
+		std::iota(parents.begin(), parents.end(), size_t{ 0 });
+		auto findRoot = [&parents](size_t index)
+		{
+			while (parents[index] != index)
+			{
+				index = parents[index];
+			}
+			return index;
+		};
+
+		for (size_t i = 0; i < hashes.size(); ++i)
+		{
+			for (size_t j = i + 1; j < hashes.size(); ++j)
+			{
+				if (Hashing::GetHammingDistance(hashes[i].perceptualHash, hashes[j].perceptualHash) <= maxDistance
+					&& Hashing::GetHammingDistance(hashes[i].differenceHash, hashes[j].differenceHash) <= maxDistance)
+				{
+					const size_t left = findRoot(i);
+					const size_t right = findRoot(j);
+					parents[(std::max)(left, right)] = (std::min)(left, right);
+				}
+			}
+		}
+
+		std::vector<std::vector<size_t>> groups(hashes.size());
+		for (size_t i = 0; i < hashes.size(); ++i)
+		{
+			groups[findRoot(i)].push_back(i);
+		}
+
+		std::vector<std::vector<size_t>> clusters;
+		for (auto& group : groups)
+		{
+			if (group.size() > 1)
+			{
+				clusters.push_back(std::move(group));
+			}
+		}
+
+		return clusters;
+	}
+
+	/*!
+	 * @brief	サムネイルを想定した画像のハッシュの計算時間と、再圧縮・縮小した画像とのハミング距離を出力する
+	 */
+	void MeasureImageHash(int repeatCount)
+	{
+		cv::Mat image(240, 320, CV_8UC3);
+		for (int y = 0; y < image.rows; ++y)
+		{
+			auto* row = image.ptr<uchar>(y);
+			for (int x = 0; x < image.cols; ++x)
+			{
+				const int texture = ((x / 9) ^ (y / 7)) & 0x1F;
+				row[x * 3 + 0] = static_cast<uchar>(x * 255 / image.cols);
+				row[x * 3 + 1] = static_cast<uchar>(y * 255 / image.rows);
+				row[x * 3 + 2] = static_cast<uchar>(texture * 6);
+			}
+		}
+
+		auto toImageData = [](const cv::Mat& mat, ImageData& imageData)
+		{
+			imageData = ImageData{};
+			imageData.destination = reinterpret_cast<std::byte*>(mat.data);
+			imageData.width = mat.cols;
+			imageData.height = mat.rows;
+			imageData.stride = static_cast<int>(mat.step[0]);
+			imageData.size = static_cast<unsigned int>(mat.step[0] * mat.rows);
+			imageData.pixelFormat = ImagePixelFormat::Bgr24;
+		};
+
+		ImageData imageData;
+		toImageData(image, imageData);
+		ImageHash original{};
+		const auto startTime = Clock::now();
+		for (int i = 0; i < repeatCount * 100; ++i)
+		{
+			Hashing::ComputeImageHash(imageData, original);
+		}
+		const double microseconds = ToMilliseconds(Clock::now() - startTime) * 1000.0 / (repeatCount * 100);
+
+		// JPEG(品質70)で再圧縮し、さらに縮小した画像
+		std::vector<uchar> encoded;
+		cv::imencode(".jpg", image, encoded, { cv::IMWRITE_JPEG_QUALITY, 70 });
+		cv::Mat recompressed = cv::imdecode(encoded, cv::IMREAD_COLOR);
+		cv::resize(recompressed, recompressed, cv::Size(160, 120), 0, 0, cv::INTER_AREA);
+		toImageData(recompressed, imageData);
+		ImageHash modified{};
+		Hashing::ComputeImageHash(imageData, modified);
+
+		std::printf("hash 320x240: %.1f us/image, distance to JPEG q70 + 1/2 resize: dHash %d, pHash %d\n\n",
+			microseconds, Hashing::GetHammingDistance(original.differenceHash, modified.differenceHash), Hashing::GetHammingDistance(original.perceptualHash, modified.perceptualHash));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 50000;
+	int repeatCount = 5;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string option = argv[i];
+		if (option == "--count")
+		{
+			count = static_cast<size_t>((std::max)(1, std::atoi(argv[i + 1])));
+		}
+		else if (option == "--repeat")
+		{
+			repeatCount = (std::max)(1, std::atoi(argv[i + 1]));
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option: %s\n", option.c_str());
+			return 1;
+		}
+	}
+
+	MeasureImageHash(repeatCount);
+
+	const auto hashes = CreateHashes(count);
+	const std::vector<ImageHash> verifyHashes(hashes.begin(), hashes.begin() + (std::min)(count, VerifyCount));
+
+	std::printf("%8s %10s %12s %16s %10s %10s\n", "images", "distance", "build[ms]", "clusters[ms]", "clusters", "verified");
+
+	bool hasMismatch = false;
+	for (const int maxDistance : { 0, 4, 6, 8, 10 })
+	{
+		Hashing::ImageHashIndex index;
+		std::vector<double> buildMilliseconds;
+		std::vector<double> clusterMilliseconds;
+		std::vector<std::vector<size_t>> clusters;
+		for (int i = 0; i < repeatCount; ++i)
+		{
+			const auto buildStartTime = Clock::now();
+			index.Build(hashes);
+			const auto clusterStartTime = Clock::now();
+			clusters = index.FindClusters(maxDistance);
+			const auto endTime = Clock::now();
+			buildMilliseconds.push_back(ToMilliseconds(clusterStartTime - buildStartTime));
+			clusterMilliseconds.push_back(ToMilliseconds(endTime - clusterStartTime));
+		}
+		std::sort(buildMilliseconds.begin(), buildMilliseconds.end());
+		std::sort(clusterMilliseconds.begin(), clusterMilliseconds.end());
+
+		Hashing::ImageHashIndex verifyIndex;
+		verifyIndex.Build(verifyHashes);
+		const bool isVerified = verifyIndex.FindClusters(maxDistance) == FindClustersByBruteForce(verifyHashes, maxDistance);
+		hasMismatch = hasMismatch || !isVerified;
+
+		std::printf("%8zu %10d %12.2f %16.2f %10zu %10s\n", count, maxDistance,
+			buildMilliseconds[buildMilliseconds.size() / 2], clusterMilliseconds[clusterMilliseconds.size() / 2], clusters.size(), isVerified ? "ok" : "MISMATCH");
+	}
+
+	return hasMismatch ? 1 : 0;
+}
@@ -0,0 +1,333 @@
+/*!
+ * @file	ImageReaderBenchmark.cpp
+ * @author	kleon6436
+ * @brief	ImageReader::GetImageDataのスループット・レイテンシ・ピークメモリを計測するベンチマーク
+ * @note	使い方: ImageReaderBenchmark [--raw RAW画像パス]... [--repeat 繰り返し回数] [--threads スレッド数] [--corpus 生成先ディレクトリ]
+ *			起動時にJPEG/PNG/TIFF/BMPの画像を複数の解像度で生成し、--rawで指定したRAW画像とあわせて、
+ *			サムネイルモード(長辺800/1600/3200px)・フルモードを、1スレッドとNスレッドで計測する
+ */
+
+#include "ImageData.h"
+#include "ImageReader.h"
+#include <algorithm>			// std::sort
+#include <atomic>				// std::atomic
+#include <chrono>				// std::chrono::steady_clock
+#include <cstdio>				// std::printf
+#include <cstdlib>				// std::atoi
+#include <filesystem>			// std::filesystem
+#include <fstream>				// std::ofstream
+#include <string>				// std::string
+#include <thread>				// std::thread
+#include <vector>				// std::vector
+#include <opencv2/opencv.hpp>	// cv::imwrite
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	namespace fs = std::filesystem;
+
+	/*!
+	 * @brief 計測対象の画像群
+	 */
+	struct ImageGroup
+	{
+		std::string name;				//!< 形式名
+		bool isRawImage = false;		//!< RAW画像か
+		std::vector<fs::path> paths;	//!< 画像パス
+	};
+
+	/*!
+	 * @brief 読み込み条件
+	 */
+	struct Scenario
+	{
+		std::string name;				//!< 条件名
+		bool isThumbnailMode = false;	//!< サムネイルモード
+		int resizeLongSideLength = 0;	//!< リサイズする長辺の長さ
+	};
+
+	/*!
+	 * @brief 1回の計測結果
+	 */
+	struct RunResult
+	{
+		size_t imageCount = 0;			//!< 読み込んだ枚数
+		size_t failureCount = 0;		//!< 失敗した枚数
+		double elapsedSeconds = 0.0;	//!< 経過時間
+		double p50Milliseconds = 0.0;	//!< レイテンシの中央値
+		double p99Milliseconds = 0.0;	//!< レイテンシの99パーセンタイル
+		double peakRssMegabytes = 0.0;	//!< ピークRSS
+	};
+
+	/*!
+	 * @brief	ピークRSSの計測を開始する(Linuxではプロセスのピーク値を現在値に戻す)
+	 */
+	void ResetPeakRss()
+	{
+#if defined(__linux__)
+		// /proc/self/clear_refsへ5を書き込むとVmHWMが現在のRSSに戻る
+		std::ofstream clearRefs("/proc/self/clear_refs");
+		clearRefs << "5";
+#endif
+	}
+
+	/*!
+	 * @brief	ピークRSSを取得する
+	 * @return	ピークRSS(MB)
+	 */
+	double GetPeakRssMegabytes()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters{};
+		::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters));
+		return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+#elif defined(__linux__)
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.rfind("VmHWM:", 0) == 0)
+			{
+				return std::atof(line.c_str() + 6) / 1024.0;
+			}
+		}
+		return 0.0;
+#else
+		rusage usage{};
+		::getrusage(RUSAGE_SELF, &usage);
+		return static_cast<double>(usage.ru_maxrss) / (1024.0 * 1024.0);
+#endif
+	}
+
+	/*!
+	 * @brief	写真に近い(なだらかな変化と細かな模様を含む)BGR画像を生成する
+	 * @param	width	幅
+	 * @param	height	高さ
+	 * @return	画像
+	 */
+	cv::Mat CreateSyntheticImage(int width, int height)
+	{
+		cv::Mat image(height, width, CV_8UC3);
+		for (int y = 0; y < height; ++y)
+		{
+			auto* row = image.ptr<cv::Vec3b>(y);
+			for (int x = 0; x < width; ++x)
+			{
+				const int texture = ((x / 7) ^ (y / 5)) & 0x1F;
+				row[x] = cv::Vec3b(static_cast<uchar>(x * 255 / width), static_cast<uchar>(y * 255 / height), static_cast<uchar>((x + y) * 127 / (width + height) + texture * 4));
+			}
+		}
+
+		cv::Mat noise(height, width, CV_8UC3);
+		cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(6));
+		image += noise;
+
+		return image;
+	}
+
+	/*!
+	 * @brief	計測用の画像を生成する
+	 * @param	directory	生成先ディレクトリ
+	 * @return	形式ごとの画像群
+	 */
+	std::vector<ImageGroup> CreateCorpus(const fs::path& directory)
+	{
+		constexpr struct
+		{
+			int width;
+			int height;
+		} Resolutions[] = { { 1600, 1200 }, { 3200, 2400 }, { 6000, 4000 } };
+
+		const struct
+		{
+			const char* name;
+			const char* extension;
+			std::vector<int> parameters;
+		} Formats[] = {
+			{ "JPEG", ".jpg", { cv::IMWRITE_JPEG_QUALITY, 90 } },
+			{ "PNG", ".png", { cv::IMWRITE_PNG_COMPRESSION, 3 } },
+			{ "TIFF", ".tif", {} },
+			{ "BMP", ".bmp", {} },
+		};
+
+		fs::create_directories(directory);
+
+		std::vector<ImageGroup> groups;
+		for (const auto& format : Formats)
+		{
+			ImageGroup group{ format.name, false, {} };
+			for (const auto& resolution : Resolutions)
+			{
+				const auto path = directory / (std::to_string(resolution.width) + "x" + std::to_string(resolution.height) + format.extension);
+				if (!fs::exists(path) && !cv::imwrite(path.string(), CreateSyntheticImage(resolution.width, resolution.height), format.parameters))
+				{
+					std::fprintf(stderr, "Failed to create %s\n", path.string().c_str());
+					continue;
+				}
+				group.paths.push_back(path);
+			}
+			groups.push_back(std::move(group));
+		}
+
+		return groups;
+	}
+
+	/*!
+	 * @brief	画像群を指定スレッド数で読み込み、レイテンシとスループットを計測する
+	 * @param	imageReader			画像リーダー
+	 * @param	group				画像群
+	 * @param	scenario			読み込み条件
+	 * @param	threadCount			スレッド数
+	 * @param	repeatCount			画像群を読み込む回数
+	 * @return	計測結果
+	 */
+	RunResult Run(Kchary::ImageController::Library::ImageReader& imageReader, const ImageGroup& group, const Scenario& scenario, unsigned int threadCount, int repeatCount)
+	{
+		ImageReadSettings imageReadSettings{};
+		imageReadSettings.isRawImage = group.isRawImage;
+		imageReadSettings.isThumbnailMode = scenario.isThumbnailMode;
+		imageReadSettings.resizeLongSideLength = scenario.resizeLongSideLength;
+
+		std::vector<std::wstring> paths;
+		for (int i = 0; i < repeatCount; ++i)
+		{
+			for (const auto& path : group.paths)
+			{
+				paths.push_back(path.wstring());
+			}
+		}
+
+		// 各スレッドが共有のインデックスから次の画像を取り出して読み込む
+		std::vector<double> latencies(paths.size());
+		std::atomic<size_t> nextIndex{ 0 };
+		std::atomic<size_t> failureCount{ 0 };
+
+		ResetPeakRss();
+		const auto start = Clock::now();
+
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([&]()
+				{
+					for (size_t index = nextIndex.fetch_add(1); index < paths.size(); index = nextIndex.fetch_add(1))
+					{
+						ImageData imageData{};
+						const auto imageStart = Clock::now();
+						if (!imageReader.GetImageData(paths[index].c_str(), imageReadSettings, imageData))
+						{
+							failureCount.fetch_add(1);
+						}
+						latencies[index] = std::chrono::duration<double, std::milli>(Clock::now() - imageStart).count();
+					}
+				});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		RunResult result;
+		result.elapsedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+		result.peakRssMegabytes = GetPeakRssMegabytes();
+		result.imageCount = paths.size();
+		result.failureCount = failureCount.load();
+
+		std::sort(latencies.begin(), latencies.end());
+		if (!latencies.empty())
+		{
+			result.p50Milliseconds = latencies[latencies.size() / 2];
+			result.p99Milliseconds = latencies[(std::min)(latencies.size() - 1, latencies.size() * 99 / 100)];
+		}
+
+		return result;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<fs::path> rawPaths;
+	int repeatCount = 3;
+	unsigned int threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+	fs::path corpusDirectory = fs::temp_directory_path() / "ImageControllerBenchmarkCorpus";
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string option = argv[i];
+		if (option == "--raw")
+		{
+			rawPaths.emplace_back(argv[i + 1]);
+		}
+		else if (option == "--repeat")
+		{
+			repeatCount = (std::max)(1, std::atoi(argv[i + 1]));
+		}
+		else if (option == "--threads")
+		{
+			threadCount = static_cast<unsigned int>((std::max)(1, std::atoi(argv[i + 1])));
+		}
+		else if (option == "--corpus")
+		{
+			corpusDirectory = argv[i + 1];
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option: %s\n", option.c_str());
+			return 1;
+		}
+	}
+
+	std::printf("Generating corpus in %s\n", corpusDirectory.string().c_str());
+	auto groups = CreateCorpus(corpusDirectory);
+	if (!rawPaths.empty())
+	{
+		groups.push_back({ "RAW", true, rawPaths });
+	}
+
+	const Scenario scenarios[] = {
+		{ "thumbnail 800", true, 800 },
+		{ "thumbnail 1600", true, 1600 },
+		{ "thumbnail 3200", true, 3200 },
+		{ "full", false, 0 },
+	};
+
+	std::printf("%-6s %-16s %8s %8s %12s %10s %10s %14s\n", "format", "scenario", "threads", "images", "images/sec", "p50[ms]", "p99[ms]", "peak RSS[MB]");
+
+	bool hasFailure = false;
+	for (const auto& group : groups)
+	{
+		for (const auto& scenario : scenarios)
+		{
+			for (const unsigned int threads : { 1u, threadCount })
+			{
+				// スレッド数ごとに新しいリーダーを使い、プールの状態を揃える
+				Kchary::ImageController::Library::ImageReader imageReader;
+				const auto result = Run(imageReader, group, scenario, threads, repeatCount);
+				std::printf("%-6s %-16s %8u %8zu %12.1f %10.2f %10.2f %14.1f\n",
+					group.name.c_str(), scenario.name.c_str(), threads, result.imageCount,
+					static_cast<double>(result.imageCount) / result.elapsedSeconds,
+					result.p50Milliseconds, result.p99Milliseconds, result.peakRssMegabytes);
+
+				if (result.failureCount > 0)
+				{
+					std::fprintf(stderr, "%zu images failed (%s, %s)\n", result.failureCount, group.name.c_str(), scenario.name.c_str());
+					hasFailure = true;
+				}
+
+				if (threadCount == 1)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	return hasFailure ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+/*!
+ * @file	RawDecodeBenchmark.cpp
+ * @author	kleon6436
+ * @brief	RAW画像のフルデコードを工程ごとに計測するベンチマーク
+ * @note	使い方: RawDecodeBenchmark [RAW画像パス] [繰り返し回数]
+ *			既定ではPhotoViewerUnitTest/TestData/Penguins.NEFを5回デコードし、各工程の中央値(ms)を出力する
+ */
+
+#include "ImageData.h"
+#include "ImageReader.h"
+#include "PixelConverter.h"
+#include <algorithm>			// std::sort
+#include <chrono>				// std::chrono::steady_clock
+#include <cstdio>				// std::printf
+#include <cstdlib>				// std::atoi
+#include <filesystem>			// std::filesystem::path
+#include <functional>			// std::function
+#include <map>					// std::map
+#include <memory>				// std::unique_ptr
+#include <string>				// std::string
+#include <utility>				// std::pair
+#include <vector>				// std::vector
+#include <opencv2/opencv.hpp>	// cv::Mat, cv::cvtColor
+#include <libraw/libraw.h>		// LibRaw本体
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	/*!
+	 * @brief 工程ごとの計測結果
+	 */
+	class StageTimer final
+	{
+	public:
+		/*!
+		 * @brief	処理を実行して経過時間を記録する
+		 * @param	stageName	工程名
+		 * @param	function	計測する処理(失敗時はfalseを返す)
+		 * @return	処理の戻り値
+		 */
+		bool Measure(const std::string& stageName, const std::function<bool()>& function)
+		{
+			if (std::find(m_stageNames.begin(), m_stageNames.end(), stageName) == m_stageNames.end())
+			{
+				m_stageNames.push_back(stageName);
+			}
+
+			const auto start = Clock::now();
+			const bool result = function();
+			m_elapsedMilliseconds[stageName].push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			return result;
+		}
+
+		/*!
+		 * @brief	工程ごとの中央値・最小値・最大値を出力する
+		 */
+		void Print() const
+		{
+			std::printf("%-40s %10s %10s %10s\n", "stage", "median[ms]", "min[ms]", "max[ms]");
+			for (const auto& stageName : m_stageNames)
+			{
+				auto samples = m_elapsedMilliseconds.at(stageName);
+				std::sort(samples.begin(), samples.end());
+				std::printf("%-40s %10.2f %10.2f %10.2f\n", stageName.c_str(), samples[samples.size() / 2], samples.front(), samples.back());
+			}
+		}
+
+	private:
+		std::vector<std::string> m_stageNames;
+		std::map<std::string, std::vector<double>> m_elapsedMilliseconds;
+	};
+
+	/*!
+	 * @brief	LibRawを直接呼び出し、フルデコードの各工程を計測する
+	 * @param	path		RAW画像パス
+	 * @param	outputBps	出力ビット数(8または16)
+	 * @param	timer		計測結果
+	 * @return	成功: True, 失敗: False(SIMD変換の結果がOpenCVと一致しない場合も失敗)
+	 */
+	bool MeasureLibRawStages(const std::filesystem::path& path, int outputBps, StageTimer& timer)
+	{
+		const auto prefix = std::to_string(outputBps) + "bit ";
+		auto rawProcessor = std::make_unique<LibRaw>();
+		rawProcessor->imgdata.params.output_bps = outputBps;
+
+		if (!timer.Measure(prefix + "open_file", [&] { return rawProcessor->open_file(path.string().c_str()) == LIBRAW_SUCCESS; })
+			|| !timer.Measure(prefix + "unpack", [&] { return rawProcessor->unpack() == LIBRAW_SUCCESS; })
+			|| !timer.Measure(prefix + "dcraw_process", [&] { return rawProcessor->dcraw_process() == LIBRAW_SUCCESS; }))
+		{
+			return false;
+		}
+
+		libraw_processed_image_t* image = nullptr;
+		if (!timer.Measure(prefix + "dcraw_make_mem_image", [&] { image = rawProcessor->dcraw_make_mem_image(); return image != nullptr; }))
+		{
+			return false;
+		}
+
+		std::unique_ptr<libraw_processed_image_t, decltype(&LibRaw::dcraw_clear_mem)> imagePtr(image, LibRaw::dcraw_clear_mem);
+		const int type = image->bits == 16 ? CV_16UC3 : CV_8UC3;
+		const cv::Mat rgbImage(image->height, image->width, type, image->data);
+
+		cv::Mat simdOutput(rgbImage.size(), type);
+		cv::Mat openCvOutput(rgbImage.size(), type);
+		timer.Measure(prefix + "RGB->BGR (Simd)", [&] { return Kchary::ImageController::Simd::ConvertRgbToBgr(rgbImage, simdOutput); });
+		timer.Measure(prefix + "RGB->BGR (cv::cvtColor)", [&] { cv::cvtColor(rgbImage, openCvOutput, cv::COLOR_RGB2BGR); return true; });
+
+		if (cv::norm(simdOutput, openCvOutput, cv::NORM_INF) != 0)
+		{
+			std::fprintf(stderr, "RGB->BGR mismatch (%dbit)\n", outputBps);
+			return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const std::filesystem::path path = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::path("../PhotoViewerUnitTest/TestData/Penguins.NEF");
+	const int iterationCount = argc > 2 ? (std::max)(1, std::atoi(argv[2])) : 5;
+
+	StageTimer timer;
+	Kchary::ImageController::Library::ImageReader imageReader;
+
+	for (int i = 0; i < iterationCount; ++i)
+	{
+		if (!MeasureLibRawStages(path, 8, timer) || !MeasureLibRawStages(path, 16, timer))
+		{
+			std::fprintf(stderr, "LibRaw decode failed: %s\n", path.string().c_str());
+			return 1;
+		}
+
+		// ImageReader経由のフルデコード(書き込み先のバッファはプールから再利用される)
+		// 長辺2000pxの表示サイズを指定した場合は、ハーフサイズでデモザイクされる
+		for (const auto& [isHighBitDepth, resizeLongSideLength] : { std::pair{ false, 0 }, std::pair{ true, 0 }, std::pair{ false, 2000 } })
+		{
+			ImageReadSettings imageReadSettings{};
+			imageReadSettings.isRawImage = true;
+			imageReadSettings.isHighBitDepth = isHighBitDepth;
+			imageReadSettings.resizeLongSideLength = resizeLongSideLength;
+
+			ImageData imageData{};
+			auto stageName = std::string(isHighBitDepth ? "16bit" : "8bit") + " ImageReader::GetImageData";
+			if (resizeLongSideLength > 0)
+			{
+				stageName += " (" + std::to_string(resizeLongSideLength) + "px)";
+			}
+
+			if (!timer.Measure(stageName, [&] { return imageReader.GetImageData(path.wstring().c_str(), imageReadSettings, imageData); }))
+			{
+				std::fprintf(stderr, "ImageReader::GetImageData failed: %s\n", path.string().c_str());
+				return 1;
+			}
+		}
+	}
+
+	std::printf("%s (%d iterations)\n", path.string().c_str(), iterationCount);
+	timer.Print();
+
+	// ImageReaderが集計した工程ごとの統計情報
+	std::printf("%s\n", imageReader.GetDecodeStatisticsJson().c_str());
+	return 0;
+}
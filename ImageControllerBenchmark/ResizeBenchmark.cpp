@@ -0,0 +1,176 @@
+/*!
+ * @file	ResizeBenchmark.cpp
+ * @author	kleon6436
+ * @brief	縮小処理(Simd::ResizeArea)とcv::resize(INTER_AREA)の処理時間・画素値の差を比較するベンチマーク
+ * @note	使い方: ResizeBenchmark [--repeat 繰り返し回数] [--threads スレッド数]
+ *			縮小デコード後の画像を想定したサイズの8bit 3ch/4ch画像を生成し、1スレッドとNスレッドで計測する。
+ *			画素値の差が1を超えた場合と、SIMD処理とスカラー処理(Simd::ResizeAreaScalar)の出力が一致しない場合は終了コード1を返す
+ */
+
+#include "AreaResizer.h"
+#include <algorithm>			// std::sort
+#include <chrono>				// std::chrono::steady_clock
+#include <cstdio>				// std::printf
+#include <cstdlib>				// std::atoi
+#include <functional>			// std::function
+#include <string>				// std::string
+#include <vector>				// std::vector
+#include <opencv2/opencv.hpp>	// cv::resize
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	/*!
+	 * @brief 縮小条件
+	 */
+	struct ResizeCase
+	{
+		const char* name;		//!< 条件名
+		int sourceWidth;		//!< 入力の幅
+		int sourceHeight;		//!< 入力の高さ
+		int longSideLength;		//!< 出力の長辺の長さ
+	};
+
+	/*!
+	 * @brief	写真に近い(なだらかな変化と細かな模様を含む)画像を生成する
+	 * @param	width		幅
+	 * @param	height		高さ
+	 * @param	channels	チャンネル数(3または4)
+	 * @return	画像
+	 */
+	cv::Mat CreateSyntheticImage(int width, int height, int channels)
+	{
+		cv::Mat image(height, width, CV_8UC(channels));
+		for (int y = 0; y < height; ++y)
+		{
+			auto* row = image.ptr<uchar>(y);
+			for (int x = 0; x < width; ++x)
+			{
+				const int texture = ((x / 7) ^ (y / 5)) & 0x1F;
+				row[x * channels + 0] = static_cast<uchar>(x * 255 / width);
+				row[x * channels + 1] = static_cast<uchar>(y * 255 / height);
+				row[x * channels + 2] = static_cast<uchar>((x + y) * 127 / (width + height) + texture * 4);
+				if (channels == 4)
+				{
+					row[x * channels + 3] = static_cast<uchar>(texture * 8);
+				}
+			}
+		}
+
+		cv::Mat noise(height, width, CV_8UC(channels));
+		cv::randn(noise, cv::Scalar::all(0), cv::Scalar::all(6));
+		image += noise;
+
+		return image;
+	}
+
+	/*!
+	 * @brief	処理を繰り返し実行し、処理時間の中央値を求める
+	 * @param	repeatCount	繰り返し回数
+	 * @param	function	計測する処理
+	 * @return	中央値(ms)
+	 */
+	double MeasureMedianMilliseconds(int repeatCount, const std::function<void()>& function)
+	{
+		// 1回目はスレッドプールの起動などを含むため計測しない
+		function();
+
+		std::vector<double> samples;
+		for (int i = 0; i < repeatCount; ++i)
+		{
+			const auto start = Clock::now();
+			function();
+			samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		}
+
+		std::sort(samples.begin(), samples.end());
+		return samples[samples.size() / 2];
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int repeatCount = 20;
+	int threadCount = cv::getNumThreads();
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string option = argv[i];
+		if (option == "--repeat")
+		{
+			repeatCount = (std::max)(1, std::atoi(argv[i + 1]));
+		}
+		else if (option == "--threads")
+		{
+			threadCount = (std::max)(1, std::atoi(argv[i + 1]));
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option: %s\n", option.c_str());
+			return 1;
+		}
+	}
+
+	// 縮小デコード(1/2・1/4・1/8)の結果を表示サイズへ縮小する場合と、RAWのハーフサイズ画像を縮小する場合
+	const ResizeCase resizeCases[] = {
+		{ "6000x4000/2 -> 1600", 3000, 2000, 1600 },
+		{ "6000x4000/4 -> 800", 1500, 1000, 800 },
+		{ "6000x4000/8 -> 400", 750, 500, 400 },
+		{ "4000x3000/2 -> 1600", 2000, 1500, 1600 },
+		{ "12000x4000/8 -> 800", 1500, 500, 800 },
+		{ "RAW half 3000x2000 -> 2000", 3000, 2000, 2000 },
+	};
+
+	std::printf("%-28s %4s %8s %14s %14s %8s %8s %10s\n", "case", "ch", "threads", "cv::resize[ms]", "ResizeArea[ms]", "speedup", "maxdiff", "scalardiff");
+
+	bool hasMismatch = false;
+	bool hasScalarMismatch = false;
+	for (const auto& resizeCase : resizeCases)
+	{
+		for (const int channels : { 3, 4 })
+		{
+			const cv::Mat source = CreateSyntheticImage(resizeCase.sourceWidth, resizeCase.sourceHeight, channels);
+			const double ratio = static_cast<double>(resizeCase.longSideLength) / (std::max)(source.cols, source.rows);
+			const cv::Size size(static_cast<int>(source.cols * ratio + 0.5), static_cast<int>(source.rows * ratio + 0.5));
+
+			// SIMD処理の出力は、命令セット・スレッド数によらずスカラー処理と一致すること
+			cv::Mat scalarResult(size, source.type());
+			Kchary::ImageController::Simd::ResizeAreaScalar(source, scalarResult);
+
+			for (const int threads : { 1, threadCount })
+			{
+				cv::setNumThreads(threads);
+
+				cv::Mat expected(size, source.type());
+				cv::Mat actual(size, source.type());
+				const double openCvMilliseconds = MeasureMedianMilliseconds(repeatCount, [&]() { cv::resize(source, expected, size, 0, 0, cv::INTER_AREA); });
+				const double simdMilliseconds = MeasureMedianMilliseconds(repeatCount, [&]() { Kchary::ImageController::Simd::ResizeArea(source, actual); });
+
+				const double maxDifference = cv::norm(expected, actual, cv::NORM_INF);
+				const double scalarDifference = cv::norm(scalarResult, actual, cv::NORM_INF);
+				hasMismatch |= maxDifference > 1.0;
+				hasScalarMismatch |= scalarDifference != 0.0;
+
+				std::printf("%-28s %4d %8d %14.3f %14.3f %7.2fx %8.0f %10.0f\n", resizeCase.name, channels, threads,
+					openCvMilliseconds, simdMilliseconds, openCvMilliseconds / simdMilliseconds, maxDifference, scalarDifference);
+
+				if (threadCount == 1)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	if (hasMismatch)
+	{
+		std::fprintf(stderr, "ResizeArea differs from cv::resize(INTER_AREA) by more than 1\n");
+	}
+	if (hasScalarMismatch)
+	{
+		std::fprintf(stderr, "ResizeArea (SIMD) differs from ResizeAreaScalar\n");
+	}
+
+	return hasMismatch || hasScalarMismatch ? 1 : 0;
+}
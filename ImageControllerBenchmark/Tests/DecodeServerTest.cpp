@@ -0,0 +1,106 @@
+/*!
+ * @file	DecodeServerTest.cpp
+ * @author	kleon6436
+ * @brief	デコードサーバーのワーカーが停止した後に起動し直し、以降の要求を処理できることのテスト
+ * @note	ワーカーの実行ファイルを --worker で指定した場合のみ実行する(CMakeのテストは指定して実行する)
+ */
+
+#include "TestFramework.h"
+#include "DecodeServer.h"
+#include <cstdio>				// std::printf
+#include <opencv2/opencv.hpp>
+
+#ifndef _WIN32
+#include <sys/stat.h>			// mkfifo
+#endif
+
+namespace
+{
+	using namespace Kchary::ImageController;
+
+	constexpr int ImageWidth = 40;		//!< テスト画像の幅
+	constexpr int ImageHeight = 30;		//!< テスト画像の高さ
+
+	/*!
+	 * @brief	ワーカー1つ・上限時間1秒のデコードサーバーの設定
+	 */
+	Library::DecodeServerSettings CreateServerSettings(const std::string& workerPath)
+	{
+		Library::DecodeServerSettings settings;
+		settings.workerPath = std::filesystem::path(workerPath).wstring();
+		settings.workerCount = 1;
+		settings.slotCount = 2;
+		settings.slotBytes = 1024 * 1024;
+		settings.timeoutMilliseconds = 1000;
+		return settings;
+	}
+
+	ImageReadSettings CreateReadSettings()
+	{
+		ImageReadSettings imageReadSettings{};
+		imageReadSettings.bypassPyramidCache = true;
+		return imageReadSettings;
+	}
+
+	/*!
+	 * @brief	画像をデコードし、サイズが一致するか確認する
+	 */
+	bool DecodeImage(Library::DecodeServer& server, const std::wstring& imagePath)
+	{
+		Library::DecodedImage image;
+		const auto status = server.Decode(imagePath.c_str(), CreateReadSettings(), image, nullptr, nullptr);
+		return status == Library::DecodeServerStatus::Succeeded && image.IsValid()
+			&& image.GetImageData().width == ImageWidth && image.GetImageData().height == ImageHeight
+			&& image.GetImageData().pixelFormat == ImagePixelFormat::Bgr24;
+	}
+}
+
+TEST_CASE(DecodeServerRestartTest)
+{
+	const std::string workerPath = Test::GetOption("--worker");
+	if (workerPath.empty())
+	{
+		std::printf("  skipped: --worker is not specified\n");
+		return;
+	}
+
+	Test::TemporaryDirectory directory("ImageControllerTest_DecodeServer");
+	const auto imagePath = directory.path() / "image.png";
+	EXPECT_TRUE(cv::imwrite(imagePath.string(), cv::Mat(ImageHeight, ImageWidth, CV_8UC3, cv::Scalar(10, 20, 30))));
+
+	Library::DecodeServer server(CreateServerSettings(workerPath));
+	EXPECT_TRUE(server.Start());
+	EXPECT_TRUE(DecodeImage(server, imagePath.wstring()));
+
+	// 存在しない画像はワーカーを止めずに失敗を返す
+	Library::DecodedImage missingImage;
+	const auto missingPath = (directory.path() / "missing.png").wstring();
+	EXPECT_TRUE(server.Decode(missingPath.c_str(), CreateReadSettings(), missingImage, nullptr, nullptr) == Library::DecodeServerStatus::DecodeFailed);
+	EXPECT_FALSE(missingImage.IsValid());
+
+#ifndef _WIN32
+	// 書き込む側が開かないFIFOを読ませてワーカーを止め、上限時間を超えたワーカーを強制終了させる
+	const auto fifoPath = directory.path() / "blocked.png";
+	EXPECT_EQ(0, ::mkfifo(fifoPath.c_str(), 0600));
+
+	Library::DecodedImage blockedImage;
+	EXPECT_TRUE(server.Decode(fifoPath.wstring().c_str(), CreateReadSettings(), blockedImage, nullptr, nullptr) == Library::DecodeServerStatus::TimedOut);
+	EXPECT_FALSE(blockedImage.IsValid());
+
+	// 強制終了したワーカーを起動し直し、以降の要求を処理する
+	EXPECT_TRUE(DecodeImage(server, imagePath.wstring()));
+
+	const auto statistics = server.GetStatistics();
+	EXPECT_EQ(size_t{ 1 }, statistics.timedOutCount);
+	EXPECT_EQ(size_t{ 1 }, statistics.restartCount);
+	EXPECT_EQ(size_t{ 2 }, statistics.succeededCount);
+	EXPECT_EQ(size_t{ 1 }, statistics.runningWorkerCount);
+#endif
+
+	server.Stop();
+	EXPECT_EQ(size_t{ 0 }, server.GetStatistics().runningWorkerCount);
+
+	// 停止後は要求を受け付けない
+	Library::DecodedImage stoppedImage;
+	EXPECT_TRUE(server.Decode(imagePath.wstring().c_str(), CreateReadSettings(), stoppedImage, nullptr, nullptr) == Library::DecodeServerStatus::Unavailable);
+}
@@ -0,0 +1,293 @@
+/*!
+ * @file	ImageHashIndexTest.cpp
+ * @author	kleon6436
+ * @brief	画像ハッシュの索引の検索・クラスタ検出が総当たりと一致すること、画像ハッシュが画素の形式によらないことのテスト
+ */
+
+#include "TestFramework.h"
+#include "ImageHashIndex.h"
+#include "PerceptualHash.h"
+#include <algorithm>			// std::fill, std::min, std::max, std::shuffle
+#include <cstddef>				// std::byte
+#include <cstdint>				// std::uint8_t, std::uint16_t, std::uint64_t
+#include <cstring>				// std::memcpy
+#include <numeric>				// std::iota
+#include <random>				// std::mt19937_64
+#include <vector>				// std::vector
+
+namespace
+{
+	using namespace Kchary::ImageController;
+
+	constexpr int HashImageWidth = 64;	//!< ハッシュを求める画像の幅
+	constexpr int HashImageHeight = 48;	//!< ハッシュを求める画像の高さ
+
+	/*!
+	 * @brief	ランダムなビットを反転したハッシュを作る
+	 * @param	bitCount	反転するビット数の上限(同じビットを選んだ場合は少なくなる)
+	 */
+	std::uint64_t FlipBits(std::uint64_t hash, int bitCount, std::mt19937_64& random)
+	{
+		for (int i = 0; i < bitCount; ++i)
+		{
+			hash ^= 1ULL << (random() % 64);
+		}
+		return hash;
+	}
+
+	/*!
+	 * @brief	一部の画像が少しずつ異なる(再圧縮・連写を想定)ハッシュの一覧を作る
+	 * @note	索引の走査が総当たりより少なくなる閾値(8未満)で部分ごとの走査を通るよう、3000件とする
+	 */
+	std::vector<ImageHash> CreateHashes()
+	{
+		std::mt19937_64 random(20240601);
+		std::vector<ImageHash> hashes;
+		while (hashes.size() < 3000)
+		{
+			const ImageHash base{ random(), random() };
+			hashes.push_back(base);
+
+			// 同一・数ビット違いの画像を0～4枚加え、クラスタ内の順序が連続しないよう後で混ぜる
+			const int variantCount = static_cast<int>(random() % 5);
+			for (int i = 0; i < variantCount; ++i)
+			{
+				const int bitCount = static_cast<int>(random() % 9);
+				hashes.push_back(ImageHash{ FlipBits(base.differenceHash, bitCount, random), FlipBits(base.perceptualHash, bitCount, random) });
+			}
+		}
+
+		std::shuffle(hashes.begin(), hashes.end(), random);
+		return hashes;
+	}
+
+	bool IsMatchByBruteForce(const ImageHash& left, const ImageHash& right, int maxDistance)
+	{
+		return Hashing::GetHammingDistance(left.perceptualHash, right.perceptualHash) <= maxDistance
+			&& Hashing::GetHammingDistance(left.differenceHash, right.differenceHash) <= maxDistance;
+	}
+
+	std::vector<size_t> FindByBruteForce(const std::vector<ImageHash>& hashes, const ImageHash& hash, int maxDistance)
+	{
+		std::vector<size_t> matches;
+		for (size_t i = 0; i < hashes.size(); ++i)
+		{
+			if (IsMatchByBruteForce(hashes[i], hash, maxDistance))
+			{
+				matches.push_back(i);
+			}
+		}
+		return matches;
+	}
+
+	/*!
+	 * @brief	全ての組を照合してクラスタを求める(各クラスタのインデックスは昇順、クラスタは先頭のインデックスの昇順)
+	 */
+	std::vector<std::vector<size_t>> FindClustersByBruteForce(const std::vector<ImageHash>& hashes, int maxDistance)
+	{
+		std::vector<size_t> parents(hashes.size());
+		std::iota(parents.begin(), parents.end(), size_t{ 0 });
+		auto findRoot = [&parents](size_t index)
+		{
+			while (parents[index] != index)
+			{
+				index = parents[index];
+			}
+			return index;
+		};
+
+		for (size_t i = 0; i < hashes.size(); ++i)
+		{
+			for (size_t j = i + 1; j < hashes.size(); ++j)
+			{
+				if (IsMatchByBruteForce(hashes[i], hashes[j], maxDistance))
+				{
+					const size_t left = findRoot(i);
+					const size_t right = findRoot(j);
+					parents[(std::max)(left, right)] = (std::min)(left, right);
+				}
+			}
+		}
+
+		std::vector<std::vector<size_t>> groups(hashes.size());
+		for (size_t i = 0; i < hashes.size(); ++i)
+		{
+			groups[findRoot(i)].push_back(i);
+		}
+
+		std::vector<std::vector<size_t>> clusters;
+		for (auto& group : groups)
+		{
+			if (group.size() > 1)
+			{
+				clusters.push_back(std::move(group));
+			}
+		}
+		return clusters;
+	}
+
+	/*!
+	 * @brief	位置により輝度が不規則に変わるBGR 8bitの画素を作る(縮小後の隣り合う画素が同じ値になりにくい画像)
+	 * @note	無彩色とし、8bit・16bitのどちらでも輝度が丸めの差なく同じ値になるようにする
+	 */
+	std::vector<std::uint8_t> CreateBgrPixels()
+	{
+		std::vector<std::uint8_t> pixels(static_cast<size_t>(HashImageWidth) * HashImageHeight * 3);
+		for (int y = 0; y < HashImageHeight; ++y)
+		{
+			for (int x = 0; x < HashImageWidth; ++x)
+			{
+				auto* pixel = &pixels[(static_cast<size_t>(y) * HashImageWidth + x) * 3];
+				const auto value = static_cast<std::uint8_t>((x * 37 + y * 11 + (x * y) % 23 * 5 + (x ^ y) * 3) & 0xFF);
+				std::fill(pixel, pixel + 3, value);
+			}
+		}
+		return pixels;
+	}
+
+	/*!
+	 * @brief	画素を指定した形式・1行のバイト数で並べ直し、参照する画像データを作る
+	 * @param	pixels		BGR 8bitの画素
+	 * @param	format		画素の形式(Bgr24, Bgra32, Bgr48)
+	 * @param	padding		1行の末尾に加えるバイト数
+	 * @param	buffer		並べ直した画素の格納先(out)
+	 */
+	ImageData CreateImageData(const std::vector<std::uint8_t>& pixels, ImagePixelFormat format, int padding, std::vector<std::byte>& buffer)
+	{
+		const int channelCount = format == ImagePixelFormat::Bgra32 ? 4 : 3;
+		const int channelBytes = format == ImagePixelFormat::Bgr48 ? 2 : 1;
+		const int stride = HashImageWidth * channelCount * channelBytes + padding;
+		buffer.assign(static_cast<size_t>(stride) * HashImageHeight, std::byte{ 0xCD });
+
+		for (int y = 0; y < HashImageHeight; ++y)
+		{
+			for (int x = 0; x < HashImageWidth; ++x)
+			{
+				const auto* source = &pixels[(static_cast<size_t>(y) * HashImageWidth + x) * 3];
+				auto* destination = buffer.data() + static_cast<size_t>(stride) * y + static_cast<size_t>(x) * channelCount * channelBytes;
+				for (int channel = 0; channel < channelCount; ++channel)
+				{
+					const std::uint8_t value = channel < 3 ? source[channel] : static_cast<std::uint8_t>(x * 4);	// アルファは輝度に影響しない
+					if (channelBytes == 2)
+					{
+						const auto wideValue = static_cast<std::uint16_t>(value * 257);
+						std::memcpy(destination + channel * 2, &wideValue, sizeof(wideValue));
+					}
+					else
+					{
+						destination[channel] = static_cast<std::byte>(value);
+					}
+				}
+			}
+		}
+
+		ImageData imageData{};
+		imageData.destination = buffer.data();
+		imageData.destinationCapacity = buffer.size();
+		imageData.size = static_cast<unsigned int>(buffer.size());
+		imageData.stride = stride;
+		imageData.width = HashImageWidth;
+		imageData.height = HashImageHeight;
+		imageData.pixelFormat = format;
+		return imageData;
+	}
+}
+
+TEST_CASE(ImageHashIndexFindTest)
+{
+	const auto hashes = CreateHashes();
+	Hashing::ImageHashIndex index;
+	index.Build(hashes);
+	EXPECT_EQ(hashes.size(), index.GetCount());
+
+	// 4の倍数でない閾値・全てのビットが異なってもよい閾値(64以上)を含め、総当たりと一致する
+	std::vector<size_t> matches;
+	for (const int maxDistance : { 0, 1, 3, 5, 7, 10, 13, 64, 70 })
+	{
+		for (size_t i = 0; i < 100; ++i)
+		{
+			index.Find(hashes[i], maxDistance, matches);
+			EXPECT_TRUE(matches == FindByBruteForce(hashes, hashes[i], maxDistance));
+		}
+	}
+
+	// 登録されていないハッシュ
+	const ImageHash unknownHash{ ~hashes[0].differenceHash, ~hashes[0].perceptualHash };
+	index.Find(unknownHash, 5, matches);
+	EXPECT_TRUE(matches == FindByBruteForce(hashes, unknownHash, 5));
+
+	// 負の閾値は一致なしとする
+	index.Find(hashes[0], -1, matches);
+	EXPECT_TRUE(matches.empty());
+}
+
+TEST_CASE(ImageHashIndexFindClustersTest)
+{
+	const auto hashes = CreateHashes();
+	Hashing::ImageHashIndex index;
+	index.Build(hashes);
+
+	for (const int maxDistance : { 0, 1, 3, 5, 7, 10, 13, 64, 70 })
+	{
+		const auto clusters = index.FindClusters(maxDistance);
+		EXPECT_TRUE(clusters == FindClustersByBruteForce(hashes, maxDistance));
+	}
+
+	// 同一の画像を含むため閾値0でもクラスタがあり、64以上では全ての画像が1つのクラスタになる
+	EXPECT_FALSE(index.FindClusters(0).empty());
+	const auto allClusters = index.FindClusters(64);
+	EXPECT_EQ(size_t{ 1 }, allClusters.size());
+	EXPECT_EQ(hashes.size(), allClusters.front().size());
+	EXPECT_TRUE(index.FindClusters(-1).empty());
+}
+
+TEST_CASE(ImageHashIndexEmptyTest)
+{
+	Hashing::ImageHashIndex index;
+	std::vector<size_t> matches{ 1, 2 };
+	index.Find(ImageHash{ 0, 0 }, 10, matches);
+	EXPECT_TRUE(matches.empty());
+	EXPECT_TRUE(index.FindClusters(10).empty());
+
+	// 構築し直すと前の画像は残らない
+	index.Build({ ImageHash{ 1, 1 }, ImageHash{ 1, 1 } });
+	EXPECT_EQ(size_t{ 1 }, index.FindClusters(0).size());
+	index.Build({});
+	EXPECT_EQ(size_t{ 0 }, index.GetCount());
+	index.Find(ImageHash{ 1, 1 }, 64, matches);
+	EXPECT_TRUE(matches.empty());
+	EXPECT_TRUE(index.FindClusters(64).empty());
+}
+
+TEST_CASE(ComputeImageHashPixelFormatTest)
+{
+	const auto pixels = CreateBgrPixels();
+	std::vector<std::byte> buffer;
+	ImageHash expected{};
+	EXPECT_TRUE(Hashing::ComputeImageHash(CreateImageData(pixels, ImagePixelFormat::Bgr24, 0, buffer), expected));
+
+	// 1行の末尾の余白は読まない
+	ImageHash actual{};
+	EXPECT_TRUE(Hashing::ComputeImageHash(CreateImageData(pixels, ImagePixelFormat::Bgr24, 13, buffer), actual));
+	EXPECT_EQ(expected.differenceHash, actual.differenceHash);
+	EXPECT_EQ(expected.perceptualHash, actual.perceptualHash);
+
+	// アルファは輝度に影響しない
+	EXPECT_TRUE(Hashing::ComputeImageHash(CreateImageData(pixels, ImagePixelFormat::Bgra32, 8, buffer), actual));
+	EXPECT_EQ(expected.differenceHash, actual.differenceHash);
+	EXPECT_EQ(expected.perceptualHash, actual.perceptualHash);
+
+	// 16bitの画像は輝度を8bitへ縮めてから求める
+	EXPECT_TRUE(Hashing::ComputeImageHash(CreateImageData(pixels, ImagePixelFormat::Bgr48, 6, buffer), actual));
+	EXPECT_EQ(expected.differenceHash, actual.differenceHash);
+	EXPECT_EQ(expected.perceptualHash, actual.perceptualHash);
+
+	// 1行のバイト数が幅に足りない画像・空の画像は計算しない
+	ImageData imageData = CreateImageData(pixels, ImagePixelFormat::Bgr24, 0, buffer);
+	imageData.stride -= 1;
+	EXPECT_FALSE(Hashing::ComputeImageHash(imageData, actual));
+	imageData = CreateImageData(pixels, ImagePixelFormat::Bgr24, 0, buffer);
+	imageData.width = 0;
+	EXPECT_FALSE(Hashing::ComputeImageHash(imageData, actual));
+	EXPECT_FALSE(Hashing::ComputeImageHash(ImageData{}, actual));
+}
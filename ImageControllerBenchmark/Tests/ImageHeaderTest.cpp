@@ -0,0 +1,516 @@
+/*!
+ * @file	ImageHeaderTest.cpp
+ * @author	kleon6436
+ * @brief	ヘッダー・EXIFの読み取り(破損したIFDの範囲外参照を含む)と、DCTスケーリングの縮小率の選択のテスト
+ */
+
+#include "TestFramework.h"
+#include "DecodePlanner.h"
+#include "ImageHeader.h"
+#include <cstdint>				// std::uint16_t, std::uint32_t
+#include <algorithm>			// std::copy
+#include <cstring>				// std::strlen
+#include <memory>				// std::unique_ptr
+#include <string>				// std::string
+#include <utility>				// std::pair
+#include <vector>				// std::vector
+
+namespace
+{
+	using namespace Kchary::ImageController;
+	using Diagnostics::ImageFormat;
+
+	using Bytes = std::vector<unsigned char>;
+
+	void AppendUint16(Bytes& bytes, std::uint32_t value, bool isBigEndian)
+	{
+		if (isBigEndian)
+		{
+			bytes.insert(bytes.end(), { static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value) });
+		}
+		else
+		{
+			bytes.insert(bytes.end(), { static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8) });
+		}
+	}
+
+	void AppendUint32(Bytes& bytes, std::uint32_t value, bool isBigEndian)
+	{
+		AppendUint16(bytes, isBigEndian ? value >> 16 : value & 0xFFFF, isBigEndian);
+		AppendUint16(bytes, isBigEndian ? value & 0xFFFF : value >> 16, isBigEndian);
+	}
+
+	/*!
+	 * @brief	SHORTのエントリのみを持つIFD0からなるTIFF構造を作る
+	 * @param	entries	タグと値の組
+	 */
+	Bytes CreateTiff(const std::vector<std::pair<std::uint16_t, std::uint16_t>>& entries, bool isBigEndian)
+	{
+		Bytes bytes = isBigEndian ? Bytes{ 'M', 'M' } : Bytes{ 'I', 'I' };
+		AppendUint16(bytes, 42, isBigEndian);
+		AppendUint32(bytes, 8, isBigEndian);
+
+		AppendUint16(bytes, static_cast<std::uint32_t>(entries.size()), isBigEndian);
+		for (const auto& [tag, value] : entries)
+		{
+			AppendUint16(bytes, tag, isBigEndian);
+			AppendUint16(bytes, 3, isBigEndian);
+			AppendUint32(bytes, 1, isBigEndian);
+			AppendUint16(bytes, value, isBigEndian);
+			AppendUint16(bytes, 0, isBigEndian);
+		}
+		AppendUint32(bytes, 0, isBigEndian);
+
+		return bytes;
+	}
+
+	/*!
+	 * @brief	APP1(EXIF、任意)とSOFのみを持つJPEGを作る
+	 * @param	sofMarker	SOFのマーカー(0xC0: ベースライン、0xC3: ロスレスなど)
+	 * @param	exif		EXIFのTIFF構造(空の場合はAPP1を付けない)
+	 */
+	Bytes CreateJpeg(int width, int height, unsigned char sofMarker, const Bytes& exif)
+	{
+		Bytes bytes = { 0xFF, 0xD8 };
+		if (!exif.empty())
+		{
+			bytes.insert(bytes.end(), { 0xFF, 0xE1 });
+			AppendUint16(bytes, static_cast<std::uint32_t>(2 + 6 + exif.size()), true);
+			bytes.insert(bytes.end(), { 'E', 'x', 'i', 'f', 0, 0 });
+			bytes.insert(bytes.end(), exif.begin(), exif.end());
+		}
+
+		bytes.insert(bytes.end(), { 0xFF, sofMarker });
+		AppendUint16(bytes, 2 + 6 + 3 * 3, true);
+		bytes.push_back(8);
+		AppendUint16(bytes, static_cast<std::uint32_t>(height), true);
+		AppendUint16(bytes, static_cast<std::uint32_t>(width), true);
+		bytes.push_back(3);
+		for (unsigned char component = 1; component <= 3; ++component)
+		{
+			bytes.insert(bytes.end(), { component, 0x11, 0 });
+		}
+
+		bytes.insert(bytes.end(), { 0xFF, 0xDA });
+		return bytes;
+	}
+
+	Bytes CreatePng(std::uint32_t width, std::uint32_t height, unsigned char bitDepth)
+	{
+		Bytes bytes = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		AppendUint32(bytes, 13, true);
+		bytes.insert(bytes.end(), { 'I', 'H', 'D', 'R' });
+		AppendUint32(bytes, width, true);
+		AppendUint32(bytes, height, true);
+		bytes.insert(bytes.end(), { bitDepth, 2, 0, 0, 0 });
+		AppendUint32(bytes, 0, true);
+		return bytes;
+	}
+
+	/*!
+	 * @brief IFDのエントリ(値フィールドは検証せずにそのまま書き込む)
+	 */
+	struct RawIfdEntry
+	{
+		std::uint16_t tag = 0;		//!< タグ
+		std::uint16_t type = 0;		//!< 型
+		std::uint32_t count = 0;	//!< 値の個数
+		std::uint32_t value = 0;	//!< 4Byte以内の値、または値の位置
+	};
+
+	/*!
+	 * @brief	IFD0の直後に置いた値の領域の先頭の位置を求める
+	 */
+	constexpr std::uint32_t GetValueOffset(size_t entryCount)
+	{
+		return static_cast<std::uint32_t>(8 + 2 + entryCount * 12 + 4);
+	}
+
+	/*!
+	 * @brief	4Byte以内のASCIIを値フィールドに直接格納する値へ変換する(リトルエンディアン)
+	 */
+	std::uint32_t ToInlineAscii(const char* text)
+	{
+		std::uint32_t value = 0;
+		for (size_t i = 0; i < 4 && text[i] != '\0'; ++i)
+		{
+			value |= static_cast<std::uint32_t>(static_cast<unsigned char>(text[i])) << (i * 8);
+		}
+		return value;
+	}
+
+	/*!
+	 * @brief	リトルエンディアンのTIFF構造を作る(ヘッダー、IFD0、値の領域の順に並べる)
+	 * @param	ifdOffset	ヘッダーに書き込むIFD0の位置
+	 * @param	entries		IFD0のエントリ
+	 * @param	values		値の領域(先頭の位置はGetValueOffset()で求める)
+	 */
+	Bytes CreateRawTiff(std::uint32_t ifdOffset, const std::vector<RawIfdEntry>& entries, const Bytes& values)
+	{
+		Bytes bytes = { 'I', 'I' };
+		AppendUint16(bytes, 42, false);
+		AppendUint32(bytes, ifdOffset, false);
+
+		AppendUint16(bytes, static_cast<std::uint32_t>(entries.size()), false);
+		for (const auto& entry : entries)
+		{
+			AppendUint16(bytes, entry.tag, false);
+			AppendUint16(bytes, entry.type, false);
+			AppendUint32(bytes, entry.count, false);
+			AppendUint32(bytes, entry.value, false);
+		}
+		AppendUint32(bytes, 0, false);
+
+		bytes.insert(bytes.end(), values.begin(), values.end());
+		return bytes;
+	}
+
+	/*!
+	 * @brief	TIFFファイルとしてメタデータを読み取る
+	 * @note	範囲外の読み取りを検出できるよう、ちょうどのバイト数の領域へ複写してから読み取る
+	 */
+	ImageMetadata ReadTiffMetadata(const Bytes& tiff)
+	{
+		Decode::ImageHeader header;
+		header.format = ImageFormat::Tiff;
+		header.exifSize = tiff.size();
+
+		const std::unique_ptr<unsigned char[]> data(new unsigned char[tiff.size()]);
+		std::copy(tiff.begin(), tiff.end(), data.get());
+
+		ImageMetadata metadata;
+		Decode::ReadImageMetadata(data.get(), tiff.size(), header, metadata);
+		return metadata;
+	}
+
+	Decode::ImageHeader CreateJpegHeader(int width, int height)
+	{
+		Decode::ImageHeader header;
+		header.format = ImageFormat::Jpeg;
+		header.width = width;
+		header.height = height;
+		header.isDctScalable = true;
+		return header;
+	}
+}
+
+TEST_CASE(ReadJpegHeaderTest)
+{
+	const Bytes jpeg = CreateJpeg(6000, 4000, 0xC0, CreateTiff({ { 0x0112, 6 } }, false));
+
+	Decode::ImageHeader header;
+	EXPECT_TRUE(Decode::ReadImageHeader(jpeg.data(), jpeg.size(), header));
+	EXPECT_TRUE(header.format == ImageFormat::Jpeg);
+	EXPECT_EQ(6000, header.width);
+	EXPECT_EQ(4000, header.height);
+	EXPECT_EQ(8, header.bitDepth);
+	EXPECT_EQ(6, header.orientation);
+	EXPECT_TRUE(header.IsTransposed());
+	EXPECT_TRUE(header.isDctScalable);
+
+	// EXIFの位置はAPP1の"Exif\0\0"の直後(SOI・マーカー・長さ・識別子の後ろ)
+	EXPECT_EQ(size_t{ 2 + 4 + 6 }, header.exifOffset);
+	EXPECT_TRUE(header.exifSize > 0);
+}
+
+TEST_CASE(ReadLosslessJpegHeaderTest)
+{
+	// ロスレス(SOF3)はIDCTを使わないため縮小デコードできない
+	const Bytes jpeg = CreateJpeg(640, 480, 0xC3, Bytes{});
+
+	Decode::ImageHeader header;
+	EXPECT_TRUE(Decode::ReadImageHeader(jpeg.data(), jpeg.size(), header));
+	EXPECT_EQ(640, header.width);
+	EXPECT_EQ(480, header.height);
+	EXPECT_EQ(1, header.orientation);
+	EXPECT_FALSE(header.isDctScalable);
+}
+
+TEST_CASE(ReadPngAndTiffHeaderTest)
+{
+	const Bytes png = CreatePng(1234, 567, 16);
+	Decode::ImageHeader header;
+	EXPECT_TRUE(Decode::ReadImageHeader(png.data(), png.size(), header));
+	EXPECT_TRUE(header.format == ImageFormat::Png);
+	EXPECT_EQ(1234, header.width);
+	EXPECT_EQ(567, header.height);
+	EXPECT_EQ(16, header.bitDepth);
+	EXPECT_FALSE(header.isDctScalable);
+
+	// ビッグエンディアン・リトルエンディアンのどちらも読める
+	for (const bool isBigEndian : { false, true })
+	{
+		const Bytes tiff = CreateTiff({ { 0x0100, 300 }, { 0x0101, 200 }, { 0x0102, 16 }, { 0x0112, 8 } }, isBigEndian);
+		EXPECT_TRUE(Decode::ReadImageHeader(tiff.data(), tiff.size(), header));
+		EXPECT_TRUE(header.format == ImageFormat::Tiff);
+		EXPECT_EQ(300, header.width);
+		EXPECT_EQ(200, header.height);
+		EXPECT_EQ(16, header.bitDepth);
+		EXPECT_EQ(8, header.orientation);
+		EXPECT_EQ(size_t{ 0 }, header.exifOffset);
+		EXPECT_EQ(tiff.size(), header.exifSize);
+	}
+}
+
+TEST_CASE(ReadImageHeaderRejectsInvalidInputTest)
+{
+	Decode::ImageHeader header;
+	EXPECT_FALSE(Decode::ReadImageHeader(nullptr, 0, header));
+
+	// SOFの途中で途切れている
+	Bytes jpeg = CreateJpeg(640, 480, 0xC0, Bytes{});
+	jpeg.resize(jpeg.size() - 12);
+	EXPECT_FALSE(Decode::ReadImageHeader(jpeg.data(), jpeg.size(), header));
+	EXPECT_TRUE(header.format == ImageFormat::Jpeg);
+
+	// 幅・高さが0
+	const Bytes zeroWidthJpeg = CreateJpeg(0, 480, 0xC0, Bytes{});
+	EXPECT_FALSE(Decode::ReadImageHeader(zeroWidthJpeg.data(), zeroWidthJpeg.size(), header));
+	const Bytes zeroHeightPng = CreatePng(100, 0, 8);
+	EXPECT_FALSE(Decode::ReadImageHeader(zeroHeightPng.data(), zeroHeightPng.size(), header));
+
+	// intの範囲を超える幅
+	const Bytes hugePng = CreatePng(0x80000000u, 100, 8);
+	EXPECT_FALSE(Decode::ReadImageHeader(hugePng.data(), hugePng.size(), header));
+
+	// IHDRの途中で途切れている
+	const Bytes png = CreatePng(100, 100, 8);
+	EXPECT_FALSE(Decode::ReadImageHeader(png.data(), 24, header));
+
+	// 幅・高さを持たないTIFF
+	const Bytes tiff = CreateTiff({ { 0x0112, 3 } }, false);
+	EXPECT_FALSE(Decode::ReadImageHeader(tiff.data(), tiff.size(), header));
+
+	// ヘッダーの読み取りに失敗しても形式は設定する
+	const Bytes unknown = { 'n', 'o', 't', ' ', 'a', 'n', ' ', 'i', 'm', 'a', 'g', 'e' };
+	EXPECT_FALSE(Decode::ReadImageHeader(unknown.data(), unknown.size(), header));
+	EXPECT_TRUE(header.format == ImageFormat::Other);
+}
+
+TEST_CASE(ReadImageMetadataOutOfRangeValueTest)
+{
+	// 値の領域: RATIONAL(300/0)、"Canon"
+	constexpr std::uint32_t valueOffset = GetValueOffset(6);
+	Bytes values;
+	AppendUint32(values, 300, false);
+	AppendUint32(values, 0, false);
+	values.insert(values.end(), { 'C', 'a', 'n', 'o', 'n', '\0' });
+	const std::uint32_t size = valueOffset + static_cast<std::uint32_t>(values.size());
+
+	std::vector<RawIfdEntry> entries = {
+		{ 0x010F, 2, 6, valueOffset + 8 },		// Make(有効)
+		{ 0x0110, 2, 10, 0x7FFFFFF0 },			// Model(値の位置が範囲外)
+		{ 0x011A, 5, 1, valueOffset },			// XResolution(分母が0)
+		{ 0x011B, 5, 1, size - 4 },				// YResolution(値の途中で終端に達する)
+		{ 0x0132, 2, 0xFFFFFFFF, 0xFFFFFFFF },	// DateTime(位置+バイト数が32bitを超える)
+		{ 0x8769, 4, 1, 0xFFFFFFF0 },			// ExifIFDPointer(範囲外)
+	};
+
+	// 範囲外を指すエントリは読み飛ばし、後続のエントリは読み続ける
+	auto metadata = ReadTiffMetadata(CreateRawTiff(8, entries, values));
+	EXPECT_EQ(std::string("Canon"), std::string(metadata.make));
+	EXPECT_EQ(size_t{ 0 }, std::strlen(metadata.model));
+	EXPECT_EQ(size_t{ 0 }, std::strlen(metadata.dateTime));
+	EXPECT_TRUE(metadata.xResolution == 0.0);
+	EXPECT_TRUE(metadata.yResolution == 0.0);
+	EXPECT_TRUE(metadata.exposureTime == 0.0);
+	EXPECT_EQ(-1, metadata.exposureProgram);
+
+	// Exif IFDの位置が終端の直前(エントリ数の途中・エントリの途中)
+	for (const std::uint32_t exifIfdOffset : { size - 1, size - 2, size - 6 })
+	{
+		entries.back().value = exifIfdOffset;
+		metadata = ReadTiffMetadata(CreateRawTiff(8, entries, values));
+		EXPECT_EQ(std::string("Canon"), std::string(metadata.make));
+		EXPECT_EQ(0, metadata.isoSpeed);
+		EXPECT_EQ(-1, metadata.meteringMode);
+	}
+
+	// IFD0の位置が範囲外
+	for (const std::uint32_t ifdOffset : { size - 1, 0xFFFFFFFFu })
+	{
+		metadata = ReadTiffMetadata(CreateRawTiff(ifdOffset, entries, values));
+		EXPECT_EQ(size_t{ 0 }, std::strlen(metadata.make));
+		EXPECT_EQ(1, metadata.orientation);
+	}
+}
+
+TEST_CASE(ReadImageMetadataTruncatedIfdTest)
+{
+	// "Camera"(NUL終端なし)の後ろにIFD0を置き、エントリ数は3とするが2エントリ目で終端に達する
+	Bytes tiff = { 'I', 'I' };
+	AppendUint16(tiff, 42, false);
+	AppendUint32(tiff, 14, false);
+	tiff.insert(tiff.end(), { 'C', 'a', 'm', 'e', 'r', 'a' });
+	AppendUint16(tiff, 3, false);
+	for (const auto& entry : { RawIfdEntry{ 0x010F, 2, 4, ToInlineAscii("ABCD") }, RawIfdEntry{ 0x0110, 2, 6, 8 } })
+	{
+		AppendUint16(tiff, entry.tag, false);
+		AppendUint16(tiff, entry.type, false);
+		AppendUint32(tiff, entry.count, false);
+		AppendUint32(tiff, entry.value, false);
+	}
+
+	// NUL終端のないASCIIは個数の分だけ読む
+	auto metadata = ReadTiffMetadata(tiff);
+	EXPECT_EQ(std::string("ABCD"), std::string(metadata.make));
+	EXPECT_EQ(std::string("Camera"), std::string(metadata.model));
+
+	// 2エントリ目の途中で途切れている場合は、1エントリ目のみ読む
+	tiff.resize(tiff.size() - 1);
+	metadata = ReadTiffMetadata(tiff);
+	EXPECT_EQ(std::string("ABCD"), std::string(metadata.make));
+	EXPECT_EQ(size_t{ 0 }, std::strlen(metadata.model));
+
+	// TIFFヘッダーの途中で途切れている
+	tiff.resize(7);
+	metadata = ReadTiffMetadata(tiff);
+	EXPECT_EQ(size_t{ 0 }, std::strlen(metadata.make));
+}
+
+TEST_CASE(ReadImageMetadataAsciiLengthTest)
+{
+	// 格納先に入りきらないASCII(NUL終端なし)と、末尾の空白を含むASCII(ファイルの終端まで)
+	constexpr std::uint32_t valueOffset = GetValueOffset(3);
+	Bytes values(100, 'A');
+	values.insert(values.end(), { 'E', 'O', 'S', ' ', ' ' });
+
+	const std::vector<RawIfdEntry> entries = {
+		{ 0x010F, 2, 100, valueOffset },
+		{ 0x0110, 2, 5, valueOffset + 100 },
+		{ 0x0132, 2, 6, valueOffset + 100 },	// DateTime(終端を1Byte超える)
+	};
+
+	const auto metadata = ReadTiffMetadata(CreateRawTiff(8, entries, values));
+	EXPECT_EQ(sizeof(metadata.make) - 1, std::strlen(metadata.make));
+	EXPECT_EQ(std::string("EOS"), std::string(metadata.model));
+	EXPECT_EQ(size_t{ 0 }, std::strlen(metadata.dateTime));
+}
+
+TEST_CASE(ReadImageMetadataExifRangeTest)
+{
+	const Bytes tiff = CreateRawTiff(8, { { 0x010F, 2, 4, ToInlineAscii("ABC") } }, Bytes{});
+
+	// ヘッダーのEXIFの範囲がデータを超える場合は読まない
+	Decode::ImageHeader header;
+	header.format = ImageFormat::Jpeg;
+	header.exifOffset = 4;
+	header.exifSize = tiff.size();
+	ImageMetadata metadata;
+	Decode::ReadImageMetadata(tiff.data(), tiff.size(), header, metadata);
+	EXPECT_EQ(size_t{ 0 }, std::strlen(metadata.make));
+
+	header.exifOffset = 0;
+	Decode::ReadImageMetadata(tiff.data(), tiff.size(), header, metadata);
+	EXPECT_EQ(std::string("ABC"), std::string(metadata.make));
+
+	// APP1の長さがファイルの終端を超えるJPEGはヘッダーの破損とする
+	Bytes jpeg = CreateJpeg(640, 480, 0xC0, tiff);
+	jpeg[4] = 0xFF;
+	jpeg[5] = 0xFF;
+	EXPECT_FALSE(Decode::ReadImageHeader(jpeg.data(), jpeg.size(), header));
+}
+
+TEST_CASE(ReadImageMetadataRequiredSizeTest)
+{
+	// 値の領域: "Canon"、Exif IFD(ISO感度のみ)
+	constexpr std::uint32_t valueOffset = GetValueOffset(2);
+	constexpr std::uint32_t exifIfdOffset = valueOffset + 6;
+	Bytes values = { 'C', 'a', 'n', 'o', 'n', '\0' };
+	AppendUint16(values, 1, false);
+	AppendUint16(values, 0x8827, false);
+	AppendUint16(values, 3, false);
+	AppendUint32(values, 1, false);
+	AppendUint32(values, 400, false);
+	AppendUint32(values, 0, false);
+
+	const Bytes tiff = CreateRawTiff(8, { { 0x010F, 2, 6, valueOffset }, { 0x8769, 4, 1, exifIfdOffset } }, values);
+
+	// ファイルの先頭のみ読んだ場合と同様に、渡したバイト数をTIFFのEXIFの範囲とする
+	ImageMetadata metadata;
+	size_t requiredSize = 0;
+	const auto readPrefix = [&tiff, &metadata, &requiredSize](size_t size)
+		{
+			Decode::ImageHeader header;
+			header.format = ImageFormat::Tiff;
+			header.exifSize = size;
+			Decode::ReadImageMetadata(tiff.data(), size, header, metadata, &requiredSize);
+		};
+
+	// IFD0のみ渡すと値とExif IFDは読めず、必要なバイト数を返す
+	readPrefix(valueOffset);
+	EXPECT_EQ(size_t{ 0 }, std::strlen(metadata.make));
+	EXPECT_EQ(0, metadata.isoSpeed);
+	EXPECT_EQ(size_t{ exifIfdOffset + 2 }, requiredSize);
+
+	// 必要なバイト数まで読み足すと、Exif IFDのエントリが必要になる
+	readPrefix(requiredSize);
+	EXPECT_EQ(std::string("Canon"), std::string(metadata.make));
+	EXPECT_EQ(size_t{ exifIfdOffset + 2 + 12 }, requiredSize);
+
+	readPrefix(requiredSize);
+	EXPECT_EQ(std::string("Canon"), std::string(metadata.make));
+	EXPECT_EQ(400, metadata.isoSpeed);
+	EXPECT_TRUE(requiredSize <= tiff.size());
+}
+
+TEST_CASE(PlanDecodeScaleSelectionTest)
+{
+	const auto header = CreateJpegHeader(6000, 4000);
+
+	// 要求サイズを下回らない範囲で最も大きい縮小率を選ぶ
+	EXPECT_EQ(8, Decode::PlanDecode(header, 700).scaleDenominator);
+	EXPECT_EQ(8, Decode::PlanDecode(header, 750).scaleDenominator);
+	EXPECT_EQ(4, Decode::PlanDecode(header, 751).scaleDenominator);
+	EXPECT_EQ(4, Decode::PlanDecode(header, 1500).scaleDenominator);
+	EXPECT_EQ(2, Decode::PlanDecode(header, 1501).scaleDenominator);
+	EXPECT_EQ(2, Decode::PlanDecode(header, 3000).scaleDenominator);
+	EXPECT_EQ(1, Decode::PlanDecode(header, 3001).scaleDenominator);
+	EXPECT_EQ(1, Decode::PlanDecode(header, 0).scaleDenominator);
+	EXPECT_EQ(1, Decode::PlanDecode(header, -1).scaleDenominator);
+
+	EXPECT_TRUE(Decode::PlanDecode(header, 700).imreadMode == cv::IMREAD_REDUCED_COLOR_8);
+	EXPECT_TRUE(Decode::PlanDecode(header, 1000).imreadMode == cv::IMREAD_REDUCED_COLOR_4);
+	EXPECT_TRUE(Decode::PlanDecode(header, 2000).imreadMode == cv::IMREAD_REDUCED_COLOR_2);
+	EXPECT_TRUE(Decode::PlanDecode(header, 0).imreadMode == cv::IMREAD_COLOR);
+
+	// 縦長の画像は高さを長辺とする
+	const auto portraitHeader = CreateJpegHeader(4000, 6000);
+	EXPECT_EQ(8, Decode::PlanDecode(portraitHeader, 700).scaleDenominator);
+	EXPECT_EQ(4, Decode::PlanDecode(portraitHeader, 1000).scaleDenominator);
+}
+
+TEST_CASE(PlanDecodeScaledSizeTest)
+{
+	// libjpegと同じく切り上げる(端数の画素を持つ画像で要求サイズを下回らない)
+	const auto header = CreateJpegHeader(4001, 2999);
+	const auto plan = Decode::PlanDecode(header, 500);
+	EXPECT_EQ(8, plan.scaleDenominator);
+	EXPECT_EQ(501, plan.decodedWidth);
+	EXPECT_EQ(375, plan.decodedHeight);
+
+	const auto halfPlan = Decode::PlanDecode(header, 1500);
+	EXPECT_EQ(2, halfPlan.scaleDenominator);
+	EXPECT_EQ(2001, halfPlan.decodedWidth);
+	EXPECT_EQ(1500, halfPlan.decodedHeight);
+
+	// 縮小しない場合はヘッダーの幅・高さのまま
+	const auto fullPlan = Decode::PlanDecode(header, 0);
+	EXPECT_EQ(4001, fullPlan.decodedWidth);
+	EXPECT_EQ(2999, fullPlan.decodedHeight);
+}
+
+TEST_CASE(PlanDecodeNonScalableTest)
+{
+	// DCTスケーリングできない形式は要求サイズによらず等倍でデコードする
+	auto header = CreateJpegHeader(6000, 4000);
+	header.isDctScalable = false;
+	const auto plan = Decode::PlanDecode(header, 100);
+	EXPECT_EQ(1, plan.scaleDenominator);
+	EXPECT_TRUE(plan.imreadMode == cv::IMREAD_COLOR);
+	EXPECT_EQ(6000, plan.decodedWidth);
+	EXPECT_EQ(4000, plan.decodedHeight);
+
+	header.format = ImageFormat::Png;
+	EXPECT_EQ(1, Decode::PlanDecode(header, 100).scaleDenominator);
+}
@@ -0,0 +1,140 @@
+/*!
+ * @file	OrientationTransformTest.cpp
+ * @author	kleon6436
+ * @brief	EXIFの向き(2～8)の回転・反転がOpenCVの回転・反転と一致することのテスト
+ */
+
+#include "TestFramework.h"
+#include "OrientationTransform.h"
+#include <cstdint>				// std::uint8_t
+#include <cstring>				// std::memcmp
+
+namespace
+{
+	using namespace Kchary::ImageController;
+
+	/*!
+	 * @brief	画素の位置とチャンネルごとに異なる値で埋めた画像を作る
+	 */
+	cv::Mat CreatePatternImage(int width, int height, int type)
+	{
+		cv::Mat image(height, width, type);
+		const size_t rowBytes = static_cast<size_t>(width) * image.elemSize();
+		for (int y = 0; y < height; ++y)
+		{
+			auto* row = image.ptr<std::uint8_t>(y);
+			for (size_t i = 0; i < rowBytes; ++i)
+			{
+				row[i] = static_cast<std::uint8_t>((y * 131 + i * 7 + i / 3) & 0xFF);
+			}
+		}
+		return image;
+	}
+
+	/*!
+	 * @brief	OpenCVの回転・反転でEXIFの向きを適用した画像を作る(期待値)
+	 */
+	cv::Mat CreateExpectedImage(const cv::Mat& source, int orientation)
+	{
+		cv::Mat expected;
+		switch (orientation)
+		{
+		case 2:
+			cv::flip(source, expected, 1);
+			break;
+		case 3:
+			cv::rotate(source, expected, cv::ROTATE_180);
+			break;
+		case 4:
+			cv::flip(source, expected, 0);
+			break;
+		case 5:
+			cv::transpose(source, expected);
+			break;
+		case 6:
+			cv::rotate(source, expected, cv::ROTATE_90_CLOCKWISE);
+			break;
+		case 7:
+		{
+			cv::Mat transposed;
+			cv::transpose(source, transposed);
+			cv::flip(transposed, expected, -1);
+			break;
+		}
+		case 8:
+			cv::rotate(source, expected, cv::ROTATE_90_COUNTERCLOCKWISE);
+			break;
+		default:
+			source.copyTo(expected);
+			break;
+		}
+		return expected;
+	}
+
+	bool IsSameImage(const cv::Mat& expected, const cv::Mat& actual)
+	{
+		if (expected.size() != actual.size() || expected.type() != actual.type())
+		{
+			return false;
+		}
+
+		const size_t rowBytes = static_cast<size_t>(expected.cols) * expected.elemSize();
+		for (int y = 0; y < expected.rows; ++y)
+		{
+			if (std::memcmp(expected.ptr(y), actual.ptr(y), rowBytes) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+TEST_CASE(TransformOrientationTest)
+{
+	// 奇数の幅・高さと、転置のブロック(32画素)・SIMDの単位(4画素)で割り切れないサイズを含める
+	const cv::Size sizes[] = { { 1, 1 }, { 7, 5 }, { 33, 17 }, { 65, 31 }, { 3, 70 } };
+	const int types[] = { CV_8UC1, CV_8UC3, CV_8UC4, CV_16UC3 };
+
+	for (const auto& size : sizes)
+	{
+		for (const int type : types)
+		{
+			const cv::Mat source = CreatePatternImage(size.width, size.height, type);
+			for (int orientation = 2; orientation <= 8; ++orientation)
+			{
+				const cv::Mat expected = CreateExpectedImage(source, orientation);
+				cv::Mat destination(expected.size(), type);
+				EXPECT_TRUE(Simd::TransformOrientation(source, orientation, destination));
+				EXPECT_TRUE(IsSameImage(expected, destination));
+			}
+		}
+	}
+}
+
+TEST_CASE(TransformOrientationRoiTest)
+{
+	// 行の末尾に余白がある(連続していない)入力も、余白を読まずに変換する
+	const cv::Mat image = CreatePatternImage(41, 23, CV_8UC4);
+	const cv::Mat source = image(cv::Rect(3, 2, 35, 19));
+
+	for (int orientation = 2; orientation <= 8; ++orientation)
+	{
+		const cv::Mat expected = CreateExpectedImage(source, orientation);
+		cv::Mat destination(expected.size(), CV_8UC4);
+		EXPECT_TRUE(Simd::TransformOrientation(source, orientation, destination));
+		EXPECT_TRUE(IsSameImage(expected, destination));
+	}
+}
+
+TEST_CASE(TransformOrientationMismatchTest)
+{
+	// 向きの値・書き込み先のサイズ・型が合わない場合は失敗する
+	const cv::Mat source = CreatePatternImage(7, 5, CV_8UC3);
+	cv::Mat destination(cv::Size(7, 5), CV_8UC3);
+	EXPECT_FALSE(Simd::TransformOrientation(source, 9, destination));
+	EXPECT_FALSE(Simd::TransformOrientation(source, 6, destination));
+
+	cv::Mat wrongType(cv::Size(5, 7), CV_8UC4);
+	EXPECT_FALSE(Simd::TransformOrientation(source, 6, wrongType));
+}
@@ -0,0 +1,200 @@
+/*!
+ * @file	PrefetchSchedulerTest.cpp
+ * @author	kleon6436
+ * @brief	先読みの優先度(表示中 → 前後 → サムネイル)と、現在位置の変更・サムネイルの中断で破棄する要求のテスト
+ */
+
+#include "TestFramework.h"
+#include "PrefetchScheduler.h"
+#include <chrono>				// std::chrono::milliseconds
+#include <condition_variable>	// std::condition_variable
+#include <mutex>				// std::mutex
+#include <string>				// std::to_wstring
+#include <vector>				// std::vector
+
+namespace
+{
+	using namespace Kchary::ImageController;
+
+	constexpr unsigned int WaitMilliseconds = 5000;	//!< ワーカーを待つ最大時間(ミリ秒)
+
+	/*!
+	 * @brief 開くまでデコードを止め、デコードを開始した順序を記録するデコーダー
+	 */
+	class GatedImageController final : public IImageController
+	{
+	public:
+		bool GetImageData(const wchar_t* path, const ImageReadSettings&, ImageData& imageData, ImageMetadata*, const Threading::CancellationToken* cancellationToken) override
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_startedPaths.push_back(path);
+			m_stateChanged.notify_all();
+
+			// 中断要求はフラグのため、短い間隔で確認する
+			while (!m_isOpen && !Threading::IsCancelled(cancellationToken))
+			{
+				m_stateChanged.wait_for(lock, std::chrono::milliseconds(1));
+			}
+			if (Threading::IsCancelled(cancellationToken))
+			{
+				m_cancelledPaths.push_back(path);
+				return false;
+			}
+
+			imageData.stride = 4 * 3;
+			imageData.width = 4;
+			imageData.height = 4;
+			imageData.size = static_cast<unsigned int>(imageData.stride) * imageData.height;
+			imageData.pixelFormat = ImagePixelFormat::Bgr24;
+			imageData.buffer.Allocate(imageData.size, nullptr);
+			return true;
+		}
+
+		/*!
+		 * @brief	デコードを止めずに進める
+		 */
+		void Open()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_isOpen = true;
+			}
+			m_stateChanged.notify_all();
+		}
+
+		/*!
+		 * @brief	指定した数のデコードが開始されるまで待つ
+		 */
+		bool WaitForStarted(size_t count)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			return m_stateChanged.wait_for(lock, std::chrono::milliseconds(WaitMilliseconds), [this, count]() { return m_startedPaths.size() >= count; });
+		}
+
+		/*!
+		 * @brief	デコードを開始した順序を取得する
+		 */
+		std::vector<std::wstring> GetStartedPaths()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_startedPaths;
+		}
+
+		/*!
+		 * @brief	中断したデコードを取得する
+		 */
+		std::vector<std::wstring> GetCancelledPaths()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_cancelledPaths;
+		}
+
+	private:
+		std::mutex m_mutex;							//!< 以下のメンバーを保護するミューテックス
+		std::condition_variable m_stateChanged;		//!< デコードの開始・Open()の通知
+		bool m_isOpen = false;						//!< デコードを進めるか
+		std::vector<std::wstring> m_startedPaths;	//!< デコードを開始した画像パス(開始順)
+		std::vector<std::wstring> m_cancelledPaths;	//!< 中断した画像パス
+	};
+
+	std::vector<std::wstring> CreatePaths(size_t count)
+	{
+		std::vector<std::wstring> paths;
+		for (size_t i = 0; i < count; ++i)
+		{
+			paths.push_back(std::to_wstring(i) + L".jpg");
+		}
+		return paths;
+	}
+
+	ImageReadSettings CreateDisplaySettings()
+	{
+		ImageReadSettings displaySettings{};
+		displaySettings.isThumbnailMode = true;
+		displaySettings.resizeLongSideLength = 100;
+		return displaySettings;
+	}
+
+	/*!
+	 * @brief	ワーカー1つ・後ろ2枚と前1枚を先読みする設定
+	 */
+	PrefetchSettings CreatePrefetchSettings()
+	{
+		return PrefetchSettings{ 1, 2, 1, 16 * 1024 * 1024 };
+	}
+}
+
+TEST_CASE(PrefetchSchedulerPriorityTest)
+{
+	GatedImageController imageController;
+	Library::PrefetchScheduler scheduler(imageController, CreatePrefetchSettings());
+	scheduler.SetItems(CreatePaths(10), CreateDisplaySettings());
+
+	// サムネイルのデコード中にワーカーを止めておき、後から要求した表示中・前後の画像が残りのサムネイルより先に処理されることを確認する
+	scheduler.RequestThumbnails({ 7, 8 }, CreateDisplaySettings(), nullptr);
+	EXPECT_TRUE(imageController.WaitForStarted(1));
+
+	scheduler.SetCurrentIndex(3);
+	imageController.Open();
+
+	// 表示中の画像、後ろ1枚、前1枚、後ろ2枚の順に処理する
+	ImageData imageData{};
+	EXPECT_TRUE(scheduler.GetFrame(3, imageData, WaitMilliseconds));
+	EXPECT_EQ(4, imageData.width);
+	EXPECT_TRUE(scheduler.GetFrame(4, imageData, WaitMilliseconds));
+	EXPECT_TRUE(scheduler.GetFrame(2, imageData, WaitMilliseconds));
+	EXPECT_TRUE(scheduler.GetFrame(5, imageData, WaitMilliseconds));
+	EXPECT_TRUE(imageController.WaitForStarted(6));
+
+	const std::vector<std::wstring> expected = { L"7.jpg", L"3.jpg", L"4.jpg", L"2.jpg", L"5.jpg", L"8.jpg" };
+	EXPECT_TRUE(imageController.GetStartedPaths() == expected);
+
+	// 先読みの範囲外の位置は要求されていない
+	EXPECT_FALSE(scheduler.GetFrame(6, imageData, 0));
+
+	const auto statistics = scheduler.GetStatistics();
+	EXPECT_EQ(size_t{ 4 }, statistics.decodeCount);
+	EXPECT_EQ(size_t{ 4 }, statistics.frameCount);
+	EXPECT_EQ(size_t{ 0 }, statistics.droppedCount);
+}
+
+TEST_CASE(PrefetchSchedulerCancelOrderTest)
+{
+	GatedImageController imageController;
+	Library::PrefetchScheduler scheduler(imageController, CreatePrefetchSettings());
+	scheduler.SetItems(CreatePaths(10), CreateDisplaySettings());
+
+	// 表示中の画像のデコード中に、前後の画像の要求とサムネイルの要求を積んでおく
+	scheduler.SetCurrentIndex(3);
+	EXPECT_TRUE(imageController.WaitForStarted(1));
+
+	bool isThumbnailCalled = false;
+	scheduler.RequestThumbnails({ 0, 1 }, CreateDisplaySettings(), [&isThumbnailCalled](size_t, bool, ImageData&)
+		{
+			isThumbnailCalled = true;
+		});
+	scheduler.CancelThumbnails();
+
+	// 現在位置を移すと、範囲外になったデコード中の要求は中断し、未着手の要求は破棄して新しい位置から要求し直す
+	scheduler.SetCurrentIndex(8);
+	EXPECT_TRUE(imageController.WaitForStarted(2));
+	ImageData imageData{};
+	EXPECT_FALSE(scheduler.GetFrame(3, imageData, 0));
+
+	imageController.Open();
+	EXPECT_TRUE(scheduler.GetFrame(8, imageData, WaitMilliseconds));
+	EXPECT_TRUE(scheduler.GetFrame(9, imageData, WaitMilliseconds));
+	EXPECT_TRUE(scheduler.GetFrame(7, imageData, WaitMilliseconds));
+
+	// 破棄した要求(4, 2, 5)と中断したサムネイルはデコードしない
+	const std::vector<std::wstring> expected = { L"3.jpg", L"8.jpg", L"9.jpg", L"7.jpg" };
+	EXPECT_TRUE(imageController.GetStartedPaths() == expected);
+	const std::vector<std::wstring> expectedCancelled = { L"3.jpg" };
+	EXPECT_TRUE(imageController.GetCancelledPaths() == expectedCancelled);
+	EXPECT_FALSE(isThumbnailCalled);
+
+	const auto statistics = scheduler.GetStatistics();
+	EXPECT_EQ(size_t{ 4 }, statistics.droppedCount);
+	EXPECT_EQ(size_t{ 3 }, statistics.decodeCount);
+	EXPECT_EQ(size_t{ 3 }, statistics.frameCount);
+}
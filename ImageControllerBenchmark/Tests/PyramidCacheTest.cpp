@@ -0,0 +1,180 @@
+/*!
+ * @file	PyramidCacheTest.cpp
+ * @author	kleon6436
+ * @brief	ピラミッドのレベル選択・キャッシュの破棄順序と、ピラミッドを作る要求の選別のテスト
+ */
+
+#include "TestFramework.h"
+#include "BufferPool.h"
+#include "PyramidLoader.h"
+#include <algorithm>			// std::fill_n
+#include <cmath>				// std::lround
+#include <fstream>				// std::ofstream
+#include <memory>				// std::make_shared
+#include <vector>				// std::vector
+
+namespace
+{
+	using namespace Kchary::ImageController;
+
+	/*!
+	 * @brief	BGR 8bitの画像データを作る
+	 */
+	ImageData CreateImageData(int width, int height)
+	{
+		ImageData imageData{};
+		imageData.stride = width * 3;
+		imageData.width = width;
+		imageData.height = height;
+		imageData.size = static_cast<unsigned int>(imageData.stride) * height;
+		imageData.pixelFormat = ImagePixelFormat::Bgr24;
+		imageData.buffer.Allocate(imageData.size, nullptr);
+		std::fill_n(imageData.buffer.data(), imageData.size, std::byte{ 0x80 });
+		return imageData;
+	}
+
+	std::shared_ptr<const Cache::ImagePyramid> CreatePyramid(int width, int height, bool isFullResolution = false)
+	{
+		return std::make_shared<const Cache::ImagePyramid>(CreateImageData(width, height), isFullResolution, ImageMetadata{});
+	}
+
+	Cache::PyramidKey CreateKey(const wchar_t* path)
+	{
+		return Cache::PyramidKey{ path, 1, false, false };
+	}
+
+	/*!
+	 * @brief 要求された長辺に縮小した画像を出力し、要求を記録するデコーダー
+	 */
+	class RecordingImageController final : public IImageController
+	{
+	public:
+		static constexpr int ImageWidth = 4000;		//!< 画像の幅
+		static constexpr int ImageHeight = 3000;	//!< 画像の高さ
+
+		bool GetImageData(const wchar_t*, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata*, const Threading::CancellationToken*) override
+		{
+			const int resizeLongSideLength = imageReadSettings.isThumbnailMode ? imageReadSettings.resizeLongSideLength : 0;
+			requestedLongSideLengths.push_back(resizeLongSideLength);
+
+			const double ratio = resizeLongSideLength > 0 ? static_cast<double>(resizeLongSideLength) / ImageWidth : 1.0;
+			imageData = CreateImageData(static_cast<int>(std::lround(ImageWidth * ratio)), static_cast<int>(std::lround(ImageHeight * ratio)));
+			return true;
+		}
+
+		std::vector<int> requestedLongSideLengths;	//!< デコードを要求された長辺の長さ(0: 等倍)
+	};
+}
+
+TEST_CASE(ImagePyramidLevelTest)
+{
+	// 長辺が64pxを下回るまで1/2ずつ縮小する(1000, 500, 250, 125)
+	const auto pyramid = CreatePyramid(1000, 600);
+	EXPECT_EQ(1000, pyramid->SelectLevel(0).cols);
+	EXPECT_EQ(1000, pyramid->SelectLevel(1000).cols);
+	EXPECT_EQ(1000, pyramid->SelectLevel(501).cols);
+	EXPECT_EQ(500, pyramid->SelectLevel(500).cols);
+	EXPECT_EQ(300, pyramid->SelectLevel(500).rows);
+	EXPECT_EQ(250, pyramid->SelectLevel(200).cols);
+	EXPECT_EQ(125, pyramid->SelectLevel(50).cols);
+	EXPECT_EQ(1000, pyramid->SelectLevel(2000).cols);
+	EXPECT_EQ(size_t{ (1000 * 600 + 500 * 300 + 250 * 150 + 125 * 75) * 3 }, pyramid->GetBytes());
+
+	// 縮小してデコードしたピラミッドは、最も大きいレベルより大きい要求には提供できない
+	EXPECT_TRUE(pyramid->CanServe(1000));
+	EXPECT_TRUE(pyramid->CanServe(64));
+	EXPECT_FALSE(pyramid->CanServe(1001));
+	EXPECT_FALSE(pyramid->CanServe(0));
+
+	const auto fullPyramid = CreatePyramid(1000, 600, true);
+	EXPECT_TRUE(fullPyramid->CanServe(0));
+	EXPECT_TRUE(fullPyramid->CanServe(4000));
+}
+
+TEST_CASE(PyramidCacheEvictionTest)
+{
+	const size_t pyramidBytes = CreatePyramid(400, 300)->GetBytes();
+	Cache::PyramidCache cache(pyramidBytes * 2);
+
+	cache.Insert(CreateKey(L"a.jpg"), CreatePyramid(400, 300));
+	cache.Insert(CreateKey(L"b.jpg"), CreatePyramid(400, 300));
+
+	// aを使った後にcを追加すると、最も長く使われていないbを破棄する
+	EXPECT_TRUE(cache.Find(CreateKey(L"a.jpg"), 200) != nullptr);
+	cache.Insert(CreateKey(L"c.jpg"), CreatePyramid(400, 300));
+	EXPECT_TRUE(cache.Find(CreateKey(L"a.jpg"), 200) != nullptr);
+	EXPECT_TRUE(cache.Find(CreateKey(L"b.jpg"), 200) == nullptr);
+	EXPECT_TRUE(cache.Find(CreateKey(L"c.jpg"), 200) != nullptr);
+
+	auto statistics = cache.GetStatistics();
+	EXPECT_EQ(size_t{ 2 }, statistics.entryCount);
+	EXPECT_EQ(pyramidBytes * 2, statistics.cachedBytes);
+	EXPECT_EQ(size_t{ 3 }, statistics.hitCount);
+	EXPECT_EQ(size_t{ 1 }, statistics.missCount);
+
+	// 提供できない要求(ピラミッドより大きい要求)はミスとし、破棄しない
+	EXPECT_TRUE(cache.Find(CreateKey(L"a.jpg"), 800) == nullptr);
+	EXPECT_EQ(size_t{ 2 }, cache.GetStatistics().entryCount);
+
+	// 上限を超えるピラミッドは追加せず、同じキーの古いピラミッドも破棄する
+	cache.Insert(CreateKey(L"a.jpg"), CreatePyramid(1600, 1200));
+	EXPECT_TRUE(cache.Find(CreateKey(L"a.jpg"), 200) == nullptr);
+	EXPECT_TRUE(cache.Find(CreateKey(L"c.jpg"), 200) != nullptr);
+	EXPECT_EQ(pyramidBytes, cache.GetStatistics().cachedBytes);
+
+	// 上限を下げると超過分を破棄し、0の場合は全て破棄する
+	cache.Insert(CreateKey(L"b.jpg"), CreatePyramid(400, 300));
+	cache.SetCapacity(pyramidBytes);
+	EXPECT_TRUE(cache.Find(CreateKey(L"b.jpg"), 200) != nullptr);
+	EXPECT_TRUE(cache.Find(CreateKey(L"c.jpg"), 200) == nullptr);
+
+	cache.SetCapacity(0);
+	statistics = cache.GetStatistics();
+	EXPECT_EQ(size_t{ 0 }, statistics.entryCount);
+	EXPECT_EQ(size_t{ 0 }, statistics.cachedBytes);
+}
+
+TEST_CASE(PyramidLoaderRequestedSizeTest)
+{
+	Test::TemporaryDirectory directory("ImageControllerTest_PyramidLoader");
+	const std::wstring imagePath = (directory.path() / "image.jpg").wstring();
+	std::ofstream(directory.path() / "image.jpg").put('\0');
+
+	RecordingImageController imageController;
+	Cache::PyramidLoader loader(std::make_shared<Memory::BufferPool>(0), imageController, imageController, std::make_shared<Diagnostics::DecodeStatistics>(), PyramidCacheSettings{ 256 * 1024 * 1024, 1024 });
+
+	ImageReadSettings imageReadSettings{};
+	imageReadSettings.isThumbnailMode = true;
+
+	// ピラミッドを作る最小値より小さい要求は、ピラミッドを作らずに要求された長辺でデコードする
+	imageReadSettings.resizeLongSideLength = 350;
+	ImageData imageData{};
+	EXPECT_TRUE(loader.GetImageData(imagePath.c_str(), imageReadSettings, imageData, nullptr, nullptr));
+	EXPECT_EQ(350, imageData.width);
+	EXPECT_EQ(size_t{ 0 }, loader.GetStatistics().entryCount);
+
+	// 大きい要求は要求された長辺(拡大しない)でデコードしてピラミッドを作る
+	imageReadSettings.resizeLongSideLength = 2200;
+	ImageData largeImageData{};
+	EXPECT_TRUE(loader.GetImageData(imagePath.c_str(), imageReadSettings, largeImageData, nullptr, nullptr));
+	EXPECT_EQ(2200, largeImageData.width);
+	EXPECT_EQ(size_t{ 1 }, loader.GetStatistics().entryCount);
+
+	// 以降の小さい要求はピラミッドから提供する
+	imageReadSettings.resizeLongSideLength = 240;
+	ImageData smallImageData{};
+	EXPECT_TRUE(loader.GetImageData(imagePath.c_str(), imageReadSettings, smallImageData, nullptr, nullptr));
+	EXPECT_EQ(240, smallImageData.width);
+
+	const std::vector<int> expected = { 350, 2200 };
+	EXPECT_TRUE(imageController.requestedLongSideLengths == expected);
+
+	// 最小値を0にすると全ての要求でピラミッドを作る
+	loader.SetSettings(PyramidCacheSettings{ 256 * 1024 * 1024, 0 });
+	imageReadSettings.isRawImage = true;
+	imageReadSettings.resizeLongSideLength = 100;
+	ImageData rawImageData{};
+	EXPECT_TRUE(loader.GetImageData(imagePath.c_str(), imageReadSettings, rawImageData, nullptr, nullptr));
+	EXPECT_EQ(100, imageController.requestedLongSideLengths.back());
+	EXPECT_EQ(size_t{ 2 }, loader.GetStatistics().entryCount);
+}
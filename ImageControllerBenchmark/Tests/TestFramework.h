@@ -0,0 +1,96 @@
+/*!
+ * @file	TestFramework.h
+ * @author	kleon6436
+ * @brief	ネイティブライブラリの単体テスト用の最小限のテスト登録・検証マクロ
+ * @note	TEST_CASEで定義したテストはImageControllerTestの起動時に登録順に実行され、失敗した検証の数を終了コードとして返す
+ */
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace Kchary::ImageController::Test
+{
+	/*!
+	 * @brief 登録されたテスト
+	 */
+	struct TestCase
+	{
+		const char* name;		//!< テスト名
+		void (*function)();		//!< テスト本体
+	};
+
+	/*!
+	 * @brief	登録されたテストの一覧を取得する
+	 * @return	テストの一覧
+	 */
+	std::vector<TestCase>& GetTestCases();
+
+	/*!
+	 * @brief	検証の失敗を記録する
+	 * @param	file		ソースファイル名
+	 * @param	line		行番号
+	 * @param	expression	失敗した式
+	 */
+	void ReportFailure(const char* file, int line, const char* expression);
+
+	/*!
+	 * @brief	コマンドラインで指定された値を取得する
+	 * @param	name	オプション名("--worker"など)
+	 * @return	値(指定されていない場合は空文字列)
+	 */
+	std::string GetOption(const char* name);
+
+	/*!
+	 * @brief テストの登録(静的変数の初期化で登録する)
+	 */
+	struct TestRegistrar
+	{
+		TestRegistrar(const char* name, void (*function)())
+		{
+			GetTestCases().push_back({ name, function });
+		}
+	};
+
+	/*!
+	 * @brief テスト用の一時ディレクトリ(破棄時に中身ごと削除する)
+	 */
+	class TemporaryDirectory final
+	{
+	public:
+		explicit TemporaryDirectory(const char* name)
+			: m_path(std::filesystem::temp_directory_path() / name)
+		{
+			std::error_code errorCode;
+			std::filesystem::remove_all(m_path, errorCode);
+			std::filesystem::create_directories(m_path, errorCode);
+		}
+
+		~TemporaryDirectory()
+		{
+			std::error_code errorCode;
+			std::filesystem::remove_all(m_path, errorCode);
+		}
+
+		TemporaryDirectory(const TemporaryDirectory&) = delete;
+		TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+		const std::filesystem::path& path() const noexcept { return m_path; }
+
+	private:
+		std::filesystem::path m_path;	//!< ディレクトリのパス
+	};
+}
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static const ::Kchary::ImageController::Test::TestRegistrar name##Registrar(#name, name); \
+	static void name()
+
+#define EXPECT_TRUE(expression) \
+	do { if (!(expression)) { ::Kchary::ImageController::Test::ReportFailure(__FILE__, __LINE__, #expression); } } while (false)
+
+#define EXPECT_FALSE(expression) EXPECT_TRUE(!(expression))
+#define EXPECT_EQ(expected, actual) EXPECT_TRUE((expected) == (actual))
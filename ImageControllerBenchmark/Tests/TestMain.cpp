@@ -0,0 +1,85 @@
+/*!
+ * @file	TestMain.cpp
+ * @author	kleon6436
+ * @brief	ネイティブライブラリの単体テストの実行
+ * @note	使い方: ImageControllerTest [--worker DecodeWorkerのパス] [テスト名の一部]
+ */
+
+#include "TestFramework.h"
+#include <cstdio>				// std::printf
+#include <exception>			// std::exception
+#include <map>					// std::map
+#include <string>				// std::string
+
+namespace
+{
+	int g_failureCount = 0;								//!< 失敗した検証の数
+	std::map<std::string, std::string> g_options;		//!< コマンドラインで指定された値
+}
+
+namespace Kchary::ImageController::Test
+{
+	std::vector<TestCase>& GetTestCases()
+	{
+		static std::vector<TestCase> testCases;
+		return testCases;
+	}
+
+	void ReportFailure(const char* file, int line, const char* expression)
+	{
+		++g_failureCount;
+		std::printf("  %s(%d): failed: %s\n", file, line, expression);
+	}
+
+	std::string GetOption(const char* name)
+	{
+		const auto it = g_options.find(name);
+		return it != g_options.end() ? it->second : std::string();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	using namespace Kchary::ImageController::Test;
+
+	std::string filter;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument = argv[i];
+		if (argument.rfind("--", 0) == 0 && i + 1 < argc)
+		{
+			g_options[argument] = argv[++i];
+		}
+		else
+		{
+			filter = argument;
+		}
+	}
+
+	int failedTestCount = 0;
+	for (const auto& testCase : GetTestCases())
+	{
+		if (!filter.empty() && std::string(testCase.name).find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		const int failureCount = g_failureCount;
+		std::printf("[ RUN  ] %s\n", testCase.name);
+		try
+		{
+			testCase.function();
+		}
+		catch (const std::exception& e)
+		{
+			ReportFailure(__FILE__, __LINE__, e.what());
+		}
+
+		const bool isSucceeded = g_failureCount == failureCount;
+		failedTestCount += isSucceeded ? 0 : 1;
+		std::printf("[ %s ] %s\n", isSucceeded ? " OK " : "FAIL", testCase.name);
+	}
+
+	std::printf("\n%d test(s) failed\n", failedTestCount);
+	return failedTestCount == 0 ? 0 : 1;
+}
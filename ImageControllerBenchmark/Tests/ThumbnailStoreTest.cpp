@@ -0,0 +1,338 @@
+/*!
+ * @file	ThumbnailStoreTest.cpp
+ * @author	kleon6436
+ * @brief	サムネイルストアの永続化・異常終了からの復元・コンパクション・上限による破棄のテスト
+ */
+
+#include "TestFramework.h"
+#include "ThumbnailStore.h"
+#include <cstddef>				// std::byte
+#include <cstring>				// std::memcmp
+#include <filesystem>			// std::filesystem
+#include <fstream>				// std::fstream
+#include <string>				// std::string
+#include <vector>				// std::vector
+
+namespace
+{
+	namespace fs = std::filesystem;
+	using namespace Kchary::ImageController;
+
+	constexpr int ThumbnailWidth = 37;		//!< サムネイルの幅(行の末尾が16byte境界にそろわない幅)
+	constexpr int ThumbnailHeight = 23;		//!< サムネイルの高さ
+
+	/*!
+	 * @brief	サムネイルの画素(BGR 8bit)を生成する
+	 * @param	seed	画素値の種
+	 * @return	画素
+	 */
+	std::vector<std::byte> CreatePixels(int seed)
+	{
+		std::vector<std::byte> pixels(static_cast<size_t>(ThumbnailWidth) * ThumbnailHeight * 3);
+		for (size_t i = 0; i < pixels.size(); ++i)
+		{
+			pixels[i] = static_cast<std::byte>((i * 7 + seed * 31) & 0xFF);
+		}
+
+		return pixels;
+	}
+
+	/*!
+	 * @brief	画素を参照する画像データを作る
+	 * @param	pixels	画素
+	 * @return	画像データ
+	 */
+	ImageData CreateImageData(std::vector<std::byte>& pixels)
+	{
+		ImageData imageData{};
+		imageData.destination = pixels.data();
+		imageData.destinationCapacity = pixels.size();
+		imageData.size = static_cast<unsigned int>(pixels.size());
+		imageData.stride = ThumbnailWidth * 3;
+		imageData.width = ThumbnailWidth;
+		imageData.height = ThumbnailHeight;
+		imageData.pixelFormat = ImagePixelFormat::Bgr24;
+		return imageData;
+	}
+
+	Cache::ThumbnailKey CreateKey(const char* path, long long lastWriteTime)
+	{
+		Cache::ThumbnailKey key;
+		key.path = path;
+		key.resizeLongSideLength = 256;
+		key.fileStatus = IO::FileStatus{ lastWriteTime, 1000 };
+		return key;
+	}
+
+	/*!
+	 * @brief	元画像とするファイルを作る(コンパクションは元画像が存在しないサムネイルを破棄するため)
+	 * @return	UTF-8のファイルパス
+	 */
+	std::string CreateSourceFile(const fs::path& directory, const char* fileName)
+	{
+		const fs::path path = directory / fileName;
+		std::ofstream(path).put('\0');
+		return IO::ToUtf8Path(path.wstring().c_str());
+	}
+
+	/*!
+	 * @brief	ストアから取得したサムネイルが元の画素と一致するか
+	 */
+	bool FindsPixels(Cache::ThumbnailStore& store, const Cache::ThumbnailKey& key, const std::vector<std::byte>& pixels)
+	{
+		ImageData imageData{};
+		if (!store.Find(key, imageData) || imageData.width != ThumbnailWidth || imageData.height != ThumbnailHeight)
+		{
+			return false;
+		}
+
+		const size_t rowSize = static_cast<size_t>(ThumbnailWidth) * 3;
+		for (int y = 0; y < ThumbnailHeight; ++y)
+		{
+			if (std::memcmp(imageData.buffer.data() + static_cast<size_t>(imageData.stride) * y, pixels.data() + rowSize * y, rowSize) != 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/*!
+	 * @brief	サムネイルAを保存してインデックスを書き出した後、サムネイルBを追記したストアを作る
+	 * @param	directory		ストアのディレクトリ
+	 * @param	indexedPackSize	インデックスに反映したパックファイルのサイズ(out。Bの追記前)
+	 * @note	Bの追記後、インデックスをBの追記前のものに戻し、Bを追記した直後に異常終了した状態にする
+	 */
+	void CreateStoreWithUnindexedRecord(const fs::path& directory, std::vector<std::byte>& pixelsA, std::vector<std::byte>& pixelsB, unsigned long long& indexedPackSize)
+	{
+		const fs::path indexPath = directory / "thumbnails.idx";
+		const fs::path indexBackupPath = directory / "thumbnails.idx.bak";
+
+		Cache::ThumbnailStore store(nullptr);
+		EXPECT_TRUE(store.Open(directory.wstring().c_str()));
+		EXPECT_TRUE(store.Store(CreateKey("a.jpg", 1), CreateImageData(pixelsA)));
+		EXPECT_TRUE(store.Flush());
+		indexedPackSize = fs::file_size(directory / "thumbnails.pack");
+		fs::copy_file(indexPath, indexBackupPath, fs::copy_options::overwrite_existing);
+
+		EXPECT_TRUE(store.Store(CreateKey("b.jpg", 1), CreateImageData(pixelsB)));
+		store.Close();
+
+		fs::copy_file(indexBackupPath, indexPath, fs::copy_options::overwrite_existing);
+	}
+}
+
+TEST_CASE(ThumbnailStoreRoundTripTest)
+{
+	Test::TemporaryDirectory directory("ImageControllerTest_ThumbnailStoreRoundTrip");
+	auto pixels = CreatePixels(1);
+	const auto key = CreateKey("a.jpg", 1);
+
+	{
+		Cache::ThumbnailStore store(nullptr);
+		EXPECT_TRUE(store.Open(directory.path().wstring().c_str()));
+		EXPECT_TRUE(store.Store(key, CreateImageData(pixels)));
+		EXPECT_TRUE(FindsPixels(store, key, pixels));
+	}
+
+	// 閉じた後も取得でき、元画像が更新された(更新日時が異なる)場合は取得しない
+	Cache::ThumbnailStore store(nullptr);
+	EXPECT_TRUE(store.Open(directory.path().wstring().c_str()));
+	EXPECT_TRUE(FindsPixels(store, key, pixels));
+
+	ImageData imageData{};
+	EXPECT_FALSE(store.Find(CreateKey("a.jpg", 2), imageData));
+	EXPECT_EQ(size_t{ 1 }, store.GetStatistics().entryCount);
+}
+
+TEST_CASE(ThumbnailStoreRecoversUnindexedRecordTest)
+{
+	Test::TemporaryDirectory directory("ImageControllerTest_ThumbnailStoreRecover");
+	auto pixelsA = CreatePixels(1);
+	auto pixelsB = CreatePixels(2);
+	unsigned long long indexedPackSize = 0;
+	CreateStoreWithUnindexedRecord(directory.path(), pixelsA, pixelsB, indexedPackSize);
+
+	// インデックスに反映されていないレコードはチェックサムを検証して復元する
+	Cache::ThumbnailStore store(nullptr);
+	EXPECT_TRUE(store.Open(directory.path().wstring().c_str()));
+	EXPECT_TRUE(FindsPixels(store, CreateKey("a.jpg", 1), pixelsA));
+	EXPECT_TRUE(FindsPixels(store, CreateKey("b.jpg", 1), pixelsB));
+}
+
+TEST_CASE(ThumbnailStoreTruncatesTornTailTest)
+{
+	Test::TemporaryDirectory directory("ImageControllerTest_ThumbnailStoreTornTail");
+	auto pixelsA = CreatePixels(1);
+	auto pixelsB = CreatePixels(2);
+	unsigned long long indexedPackSize = 0;
+	CreateStoreWithUnindexedRecord(directory.path(), pixelsA, pixelsB, indexedPackSize);
+
+	// Bの書き込み途中で異常終了した状態(レコードの途中で途切れている)
+	const fs::path packPath = directory.path() / "thumbnails.pack";
+	fs::resize_file(packPath, indexedPackSize + 100);
+
+	{
+		Cache::ThumbnailStore store(nullptr);
+		EXPECT_TRUE(store.Open(directory.path().wstring().c_str()));
+		EXPECT_TRUE(FindsPixels(store, CreateKey("a.jpg", 1), pixelsA));
+
+		ImageData imageData{};
+		EXPECT_FALSE(store.Find(CreateKey("b.jpg", 1), imageData));
+	}
+
+	// 途切れたレコードは切り詰め、以降の追記が壊れたレコードの後ろに続かないようにする
+	EXPECT_EQ(indexedPackSize, fs::file_size(packPath));
+}
+
+TEST_CASE(ThumbnailStoreRejectsChecksumMismatchTest)
+{
+	Test::TemporaryDirectory directory("ImageControllerTest_ThumbnailStoreChecksum");
+	auto pixelsA = CreatePixels(1);
+	auto pixelsB = CreatePixels(2);
+	unsigned long long indexedPackSize = 0;
+	CreateStoreWithUnindexedRecord(directory.path(), pixelsA, pixelsB, indexedPackSize);
+
+	// Bの画素データの1byteを書き換える(レコードの長さは正しいまま)
+	const fs::path packPath = directory.path() / "thumbnails.pack";
+	{
+		const auto packSize = fs::file_size(packPath);
+		std::fstream pack(packPath, std::ios::in | std::ios::out | std::ios::binary);
+		pack.seekg(static_cast<std::streamoff>(packSize - 64));
+		const char value = static_cast<char>(pack.get() ^ 0x5A);
+		pack.seekp(static_cast<std::streamoff>(packSize - 64));
+		pack.put(value);
+	}
+
+	{
+		Cache::ThumbnailStore store(nullptr);
+		EXPECT_TRUE(store.Open(directory.path().wstring().c_str()));
+		EXPECT_TRUE(FindsPixels(store, CreateKey("a.jpg", 1), pixelsA));
+
+		ImageData imageData{};
+		EXPECT_FALSE(store.Find(CreateKey("b.jpg", 1), imageData));
+	}
+
+	EXPECT_EQ(indexedPackSize, fs::file_size(packPath));
+}
+
+TEST_CASE(ThumbnailStoreCompactionTest)
+{
+	Test::TemporaryDirectory directory("ImageControllerTest_ThumbnailStoreCompaction");
+	auto pixelsA = CreatePixels(1);
+	auto pixelsB = CreatePixels(2);
+	auto updatedPixelsA = CreatePixels(3);
+	const fs::path packPath = directory.path() / "thumbnails.pack";
+	const std::string pathA = CreateSourceFile(directory.path(), "a.jpg");
+	const std::string pathB = CreateSourceFile(directory.path(), "b.jpg");
+
+	Cache::ThumbnailStore store(nullptr);
+	EXPECT_TRUE(store.Open(directory.path().wstring().c_str()));
+	EXPECT_TRUE(store.Store(CreateKey(pathA.c_str(), 1), CreateImageData(pixelsA)));
+	EXPECT_TRUE(store.Store(CreateKey(pathB.c_str(), 1), CreateImageData(pixelsB)));
+
+	// 元画像が更新されたサムネイルを置き換えると、古いレコードは不要な領域になる
+	EXPECT_TRUE(store.Store(CreateKey(pathA.c_str(), 2), CreateImageData(updatedPixelsA)));
+	const auto statistics = store.GetStatistics();
+	EXPECT_EQ(size_t{ 2 }, statistics.entryCount);
+	EXPECT_TRUE(statistics.deadBytes > 0);
+	EXPECT_TRUE(store.Flush());
+	const auto packSize = fs::file_size(packPath);
+
+	EXPECT_TRUE(store.Compact());
+	const auto compactedStatistics = store.GetStatistics();
+	EXPECT_EQ(0ULL, compactedStatistics.deadBytes);
+	EXPECT_EQ(statistics.liveBytes, compactedStatistics.liveBytes);
+	EXPECT_EQ(packSize - statistics.deadBytes, fs::file_size(packPath));
+
+	EXPECT_TRUE(FindsPixels(store, CreateKey(pathA.c_str(), 2), updatedPixelsA));
+	EXPECT_TRUE(FindsPixels(store, CreateKey(pathB.c_str(), 1), pixelsB));
+
+	// コンパクション後のインデックスで開き直しても同じサムネイルを取得できる
+	store.Close();
+	EXPECT_TRUE(store.Open(directory.path().wstring().c_str()));
+	EXPECT_TRUE(FindsPixels(store, CreateKey(pathA.c_str(), 2), updatedPixelsA));
+	EXPECT_TRUE(FindsPixels(store, CreateKey(pathB.c_str(), 1), pixelsB));
+	EXPECT_EQ(0ULL, store.GetStatistics().deadBytes);
+
+	// 元画像が削除されたサムネイルはコンパクションで破棄する
+	fs::remove(directory.path() / "b.jpg");
+	EXPECT_TRUE(store.Compact());
+	EXPECT_EQ(size_t{ 1 }, store.GetStatistics().entryCount);
+	EXPECT_TRUE(FindsPixels(store, CreateKey(pathA.c_str(), 2), updatedPixelsA));
+
+	ImageData imageData{};
+	EXPECT_FALSE(store.Find(CreateKey(pathB.c_str(), 1), imageData));
+}
+
+TEST_CASE(ThumbnailStoreCapacityTest)
+{
+	Test::TemporaryDirectory directory("ImageControllerTest_ThumbnailStoreCapacity");
+	std::vector<std::string> paths;
+	std::vector<std::vector<std::byte>> pixels;
+	for (const char* fileName : { "a.jpg", "b.jpg", "c.jpg", "d.jpg" })
+	{
+		paths.push_back(CreateSourceFile(directory.path(), fileName));
+		pixels.push_back(CreatePixels(static_cast<int>(pixels.size())));
+	}
+
+	Cache::ThumbnailStore store(nullptr);
+	EXPECT_TRUE(store.Open(directory.path().wstring().c_str()));
+	EXPECT_TRUE(store.Store(CreateKey(paths[0].c_str(), 1), CreateImageData(pixels[0])));
+	const unsigned long long recordSize = store.GetStatistics().liveBytes;
+
+	// 3.5レコード分を上限とすると、4つ目の追加で上限の3/4(2レコード)まで古いものから破棄する
+	store.SetCapacity(recordSize * 7 / 2);
+	for (size_t i = 1; i < paths.size(); ++i)
+	{
+		EXPECT_TRUE(store.Store(CreateKey(paths[i].c_str(), 1), CreateImageData(pixels[i])));
+	}
+
+	const auto statistics = store.GetStatistics();
+	EXPECT_EQ(size_t{ 2 }, statistics.entryCount);
+	EXPECT_EQ(recordSize * 2, statistics.liveBytes);
+	EXPECT_EQ(0ULL, statistics.deadBytes);
+
+	ImageData imageData{};
+	EXPECT_FALSE(store.Find(CreateKey(paths[0].c_str(), 1), imageData));
+	EXPECT_FALSE(store.Find(CreateKey(paths[1].c_str(), 1), imageData));
+	EXPECT_TRUE(FindsPixels(store, CreateKey(paths[2].c_str(), 1), pixels[2]));
+	EXPECT_TRUE(FindsPixels(store, CreateKey(paths[3].c_str(), 1), pixels[3]));
+
+	// 上限を0にすると全て破棄し、以降は追加しない
+	store.SetCapacity(0);
+	EXPECT_EQ(size_t{ 0 }, store.GetStatistics().entryCount);
+	EXPECT_FALSE(store.Store(CreateKey(paths[0].c_str(), 1), CreateImageData(pixels[0])));
+}
+
+TEST_CASE(ThumbnailStoreRejectsCorruptedIndexedRecordTest)
+{
+	Test::TemporaryDirectory directory("ImageControllerTest_ThumbnailStoreCorrupted");
+	auto pixelsA = CreatePixels(1);
+	auto pixelsB = CreatePixels(2);
+	{
+		Cache::ThumbnailStore store(nullptr);
+		EXPECT_TRUE(store.Open(directory.path().wstring().c_str()));
+		EXPECT_TRUE(store.Store(CreateKey("a.jpg", 1), CreateImageData(pixelsA)));
+		EXPECT_TRUE(store.Store(CreateKey("b.jpg", 1), CreateImageData(pixelsB)));
+	}
+
+	// インデックスに反映済みのAのレコードヘッダーの高さを書き換える(インデックスのチェックサムは一致したまま)
+	{
+		constexpr std::streamoff HeightOffset = 16 + 16;	// パックファイルのヘッダー + レコードの識別子・パス長・長辺・幅
+		std::fstream pack(directory.path() / "thumbnails.pack", std::ios::in | std::ios::out | std::ios::binary);
+		pack.seekp(HeightOffset + 3);
+		pack.put(static_cast<char>(0x40));
+	}
+
+	// 範囲外を読まずに取得できないものとして扱い、エントリを削除する
+	Cache::ThumbnailStore store(nullptr);
+	EXPECT_TRUE(store.Open(directory.path().wstring().c_str()));
+	EXPECT_EQ(size_t{ 2 }, store.GetStatistics().entryCount);
+
+	ImageData imageData{};
+	EXPECT_FALSE(store.Find(CreateKey("a.jpg", 1), imageData));
+	EXPECT_EQ(size_t{ 1 }, store.GetStatistics().entryCount);
+	EXPECT_TRUE(FindsPixels(store, CreateKey("b.jpg", 1), pixelsB));
+}
@@ -0,0 +1,271 @@
+/*!
+ * @file	TileLoaderTest.cpp
+ * @author	kleon6436
+ * @brief	タイル読み込みの境界(タイルをまたぐ範囲・画像の端)と、縮小レベルの画像の再利用のテスト
+ */
+
+#include "TestFramework.h"
+#include "BufferPool.h"
+#include "TileLoader.h"
+#include <algorithm>			// std::max
+#include <fstream>				// std::ofstream
+#include <memory>				// std::make_shared
+
+namespace
+{
+	using namespace Kchary::ImageController;
+
+	constexpr int ImageWidth = 1100;	//!< 画像の幅(タイルの一辺で割り切れない幅)
+	constexpr int ImageHeight = 700;	//!< 画像の高さ
+	constexpr int TileSize = Cache::TileLoader::TileSize;
+	constexpr size_t TileBytes = static_cast<size_t>(TileSize) * TileSize * 3;
+
+	/*!
+	 * @brief	等倍の座標から画素値を求める(縮小レベルの画像も等倍の座標で表す)
+	 */
+	cv::Vec3b GetPixel(int x, int y)
+	{
+		return cv::Vec3b(x & 0xFF, y & 0xFF, (x >> 8) | ((y >> 8) << 4));
+	}
+
+	/*!
+	 * @brief 座標から画素値が決まる画像を出力するデコーダー
+	 */
+	class PatternImageController final : public IImageController
+	{
+	public:
+		/*!
+		 * @param	shortage	縮小デコード時に幅・高さを縮小レベルのサイズより何画素小さく出力するか(縮小時の丸めの再現)
+		 */
+		explicit PatternImageController(int shortage = 0)
+			: m_shortage(shortage)
+		{
+		}
+
+		bool GetImageData(const wchar_t*, const ImageReadSettings& imageReadSettings, ImageData& imageData, ImageMetadata*, const Threading::CancellationToken*) override
+		{
+			++decodeCount;
+
+			// 縮小レベルは長辺から求める(TileLoader::GetLevelSizeと同じく2^levelで割って切り上げる)
+			int level = 0;
+			if (imageReadSettings.resizeLongSideLength > 0)
+			{
+				while ((((std::max)(ImageWidth, ImageHeight) - 1) >> level) + 1 > imageReadSettings.resizeLongSideLength)
+				{
+					++level;
+				}
+			}
+
+			const cv::Size levelSize = Cache::TileLoader::GetLevelSize(cv::Size(ImageWidth, ImageHeight), level);
+			const int width = levelSize.width - (level > 0 ? m_shortage : 0);
+			const int height = levelSize.height - (level > 0 ? m_shortage : 0);
+
+			imageData.stride = width * 3;
+			imageData.width = width;
+			imageData.height = height;
+			imageData.size = static_cast<unsigned int>(imageData.stride) * height;
+			imageData.pixelFormat = ImagePixelFormat::Bgr24;
+			imageData.buffer.Allocate(imageData.size, nullptr);
+
+			cv::Mat image(height, width, CV_8UC3, imageData.buffer.data(), static_cast<size_t>(imageData.stride));
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					image.at<cv::Vec3b>(y, x) = GetPixel(x << level, y << level);
+				}
+			}
+
+			return true;
+		}
+
+		bool GetImageSize(const wchar_t*, int& width, int& height) override
+		{
+			width = ImageWidth;
+			height = ImageHeight;
+			return true;
+		}
+
+		int decodeCount = 0;	//!< デコードした回数
+
+	private:
+		int m_shortage;			//!< 縮小デコード時に不足させる画素数
+	};
+
+	/*!
+	 * @brief テスト用のタイル読み込み(更新日時を取得するため、空の画像ファイルを作る)
+	 */
+	class TileLoaderFixture
+	{
+	public:
+		TileLoaderFixture(const char* name, size_t capacity, size_t levelCapacity, int shortage = 0)
+			: m_directory(name)
+			, m_imagePath((m_directory.path() / "image.jpg").wstring())
+			, m_imageController(shortage)
+			, m_tileLoader(std::make_shared<Memory::BufferPool>(0), m_imageController, m_imageController, std::make_shared<Diagnostics::DecodeStatistics>(), capacity, levelCapacity)
+		{
+			std::ofstream(m_directory.path() / "image.jpg").put('\0');
+		}
+
+		/*!
+		 * @brief	範囲を取得し、全ての画素が等倍の座標から求めた画素値と一致するか確かめる
+		 * @return	取得した範囲の幅・高さ(取得できなかった場合は0)
+		 */
+		cv::Size ReadAndVerify(int level, int x, int y, int width, int height)
+		{
+			const TileReadSettings tileReadSettings{ false, level, x, y, width, height };
+			ImageData imageData{};
+			if (!m_tileLoader.GetTile(m_imagePath.c_str(), tileReadSettings, imageData))
+			{
+				return cv::Size();
+			}
+
+			const cv::Mat image(imageData.height, imageData.width, CV_8UC3, imageData.buffer.data(), static_cast<size_t>(imageData.stride));
+			for (int row = 0; row < image.rows; ++row)
+			{
+				for (int column = 0; column < image.cols; ++column)
+				{
+					const auto actual = image.at<cv::Vec3b>(row, column);
+					const auto expected = GetPixel((x + column) << level, (y + row) << level);
+					if (actual[0] != expected[0] || actual[1] != expected[1] || actual[2] != expected[2])
+					{
+						Test::ReportFailure(__FILE__, __LINE__, "pixel mismatch");
+						return cv::Size();
+					}
+				}
+			}
+
+			return cv::Size(imageData.width, imageData.height);
+		}
+
+		Cache::TileLoader& GetTileLoader() { return m_tileLoader; }
+		const std::wstring& GetImagePath() const { return m_imagePath; }
+		int GetDecodeCount() const { return m_imageController.decodeCount; }
+
+	private:
+		Test::TemporaryDirectory m_directory;
+		std::wstring m_imagePath;
+		PatternImageController m_imageController;
+		Cache::TileLoader m_tileLoader;
+	};
+}
+
+TEST_CASE(TileLoaderLevelSizeTest)
+{
+	EXPECT_TRUE(Cache::TileLoader::GetLevelSize(cv::Size(ImageWidth, ImageHeight), 0) == cv::Size(1100, 700));
+	EXPECT_TRUE(Cache::TileLoader::GetLevelSize(cv::Size(ImageWidth, ImageHeight), 1) == cv::Size(550, 350));
+	EXPECT_TRUE(Cache::TileLoader::GetLevelSize(cv::Size(ImageWidth, ImageHeight), 2) == cv::Size(275, 175));
+	EXPECT_TRUE(Cache::TileLoader::GetLevelSize(cv::Size(ImageWidth, ImageHeight), 3) == cv::Size(138, 88));
+	EXPECT_TRUE(Cache::TileLoader::GetLevelSize(cv::Size(1, 1), 5) == cv::Size(1, 1));
+
+	// 最も小さいレベル(275x175)が1タイルに収まる
+	TileLoaderFixture fixture("ImageControllerTest_TileLoaderLevelSize", 64 * TileBytes, 64 * TileBytes);
+	TiledImageInfo info{};
+	EXPECT_TRUE(fixture.GetTileLoader().GetTiledImageInfo(fixture.GetImagePath().c_str(), false, info));
+	EXPECT_EQ(ImageWidth, info.width);
+	EXPECT_EQ(ImageHeight, info.height);
+	EXPECT_EQ(TileSize, info.tileSize);
+	EXPECT_EQ(3, info.levelCount);
+}
+
+TEST_CASE(TileLoaderTileEdgeTest)
+{
+	TileLoaderFixture fixture("ImageControllerTest_TileLoaderTileEdge", 64 * TileBytes, 64 * TileBytes);
+
+	// 4タイルの境界(512, 512)をまたぐ範囲
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 500, 500, 30, 30) == cv::Size(30, 30));
+
+	// 右端・下端の端数のタイル(等倍は3x2タイル、最後の列は76px・最後の行は188px)
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 1020, 600, 80, 100) == cv::Size(80, 100));
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 0, 0, ImageWidth, ImageHeight) == cv::Size(ImageWidth, ImageHeight));
+
+	// 画像からはみ出す範囲は画像内に切り詰める
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 1000, 650, 500, 500) == cv::Size(100, 50));
+	EXPECT_TRUE(fixture.ReadAndVerify(1, 540, 340, 100, 100) == cv::Size(10, 10));
+
+	// 1画素だけの範囲と、画像の外側の範囲
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 1099, 699, 1, 1) == cv::Size(1, 1));
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 1100, 0, 10, 10) == cv::Size());
+	EXPECT_TRUE(fixture.ReadAndVerify(Cache::TileLoader::MaxLevel + 1, 0, 0, 10, 10) == cv::Size());
+}
+
+TEST_CASE(TileLoaderShortDecodeTest)
+{
+	// 縮小デコードの結果が縮小レベルより1画素小さい場合も、縮小レベルのサイズで取得でき、不足分は端の画素で埋める
+	TileLoaderFixture fixture("ImageControllerTest_TileLoaderShortDecode", 64 * TileBytes, 64 * TileBytes, 1);
+	const TileReadSettings tileReadSettings{ false, 1, 0, 0, 550, 350 };
+	ImageData imageData{};
+	EXPECT_TRUE(fixture.GetTileLoader().GetTile(fixture.GetImagePath().c_str(), tileReadSettings, imageData));
+	EXPECT_EQ(550, imageData.width);
+	EXPECT_EQ(350, imageData.height);
+
+	const cv::Mat image(imageData.height, imageData.width, CV_8UC3, imageData.buffer.data(), static_cast<size_t>(imageData.stride));
+	const auto lastPixel = image.at<cv::Vec3b>(349, 549);
+	const auto expected = GetPixel(548 << 1, 348 << 1);
+	EXPECT_TRUE(lastPixel[0] == expected[0] && lastPixel[1] == expected[1] && lastPixel[2] == expected[2]);
+}
+
+TEST_CASE(TileLoaderReusesDecodedLevelTest)
+{
+	// タイルキャッシュは1タイル分のみ。隣のタイルは保持している縮小レベルの画像から切り出し、デコードし直さない
+	TileLoaderFixture fixture("ImageControllerTest_TileLoaderReuseLevel", TileBytes, 64 * TileBytes);
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 0, 0, 100, 100) == cv::Size(100, 100));
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 600, 0, 100, 100) == cv::Size(100, 100));
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 600, 600, 100, 100) == cv::Size(100, 100));
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 0, 0, 100, 100) == cv::Size(100, 100));
+	EXPECT_EQ(1, fixture.GetDecodeCount());
+
+	auto statistics = fixture.GetTileLoader().GetStatistics();
+	EXPECT_EQ(size_t{ 1 }, statistics.decodeCount);
+	EXPECT_EQ(size_t{ 3 }, statistics.levelHitCount);
+	EXPECT_EQ(size_t{ 1 }, statistics.levelCount);
+	EXPECT_TRUE(statistics.cachedBytes <= TileBytes);
+
+	// 要求範囲がタイルキャッシュの上限を超えても、要求範囲は全て取得できる
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 0, 0, ImageWidth, ImageHeight) == cv::Size(ImageWidth, ImageHeight));
+	EXPECT_EQ(1, fixture.GetDecodeCount());
+
+	// 別の縮小レベルは別にデコードする
+	EXPECT_TRUE(fixture.ReadAndVerify(1, 0, 0, 550, 350) == cv::Size(550, 350));
+	EXPECT_EQ(2, fixture.GetDecodeCount());
+	statistics = fixture.GetTileLoader().GetStatistics();
+	EXPECT_EQ(size_t{ 2 }, statistics.levelCount);
+	EXPECT_TRUE(statistics.cachedLevelBytes <= statistics.levelCapacity);
+}
+
+TEST_CASE(TileLoaderLevelCapacityTest)
+{
+	// 縮小レベルの画像を保持しない場合は、タイルキャッシュにないタイルのたびにデコードする
+	TileLoaderFixture fixture("ImageControllerTest_TileLoaderLevelCapacity", TileBytes, 0);
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 0, 0, 100, 100) == cv::Size(100, 100));
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 600, 0, 100, 100) == cv::Size(100, 100));
+	EXPECT_EQ(2, fixture.GetDecodeCount());
+	EXPECT_EQ(size_t{ 0 }, fixture.GetTileLoader().GetStatistics().levelCount);
+
+	// タイルキャッシュにあるタイルはデコードしない
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 620, 20, 50, 50) == cv::Size(50, 50));
+	EXPECT_EQ(2, fixture.GetDecodeCount());
+}
+
+TEST_CASE(TileLoaderLevelOverCapacityTest)
+{
+	// 縮小レベル(3x2タイル)が保持する上限より大きい場合は、要求範囲に近いタイルからタイルキャッシュの上限(2タイル)まで切り出す
+	TileLoaderFixture fixture("ImageControllerTest_TileLoaderLevelOverCapacity", 2 * TileBytes, TileBytes);
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 0, 0, 100, 100) == cv::Size(100, 100));
+	EXPECT_EQ(1, fixture.GetDecodeCount());
+	EXPECT_EQ(size_t{ 0 }, fixture.GetTileLoader().GetStatistics().levelCount);
+	EXPECT_EQ(size_t{ 2 }, fixture.GetTileLoader().GetStatistics().tileCount);
+
+	// 切り出した隣のタイルはデコードし直さず、上限に収まらなかったタイルはデコードする
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 600, 0, 100, 100) == cv::Size(100, 100));
+	EXPECT_EQ(1, fixture.GetDecodeCount());
+	EXPECT_TRUE(fixture.ReadAndVerify(0, 0, 600, 100, 100) == cv::Size(100, 100));
+	EXPECT_EQ(2, fixture.GetDecodeCount());
+
+	// タイルキャッシュが縮小レベル全体(端のタイルは画像内の部分のみ)を保持できる場合は、以降どの範囲もデコードしない
+	TileLoaderFixture largeFixture("ImageControllerTest_TileLoaderLevelOverCapacityLarge", 3 * TileBytes, TileBytes);
+	EXPECT_TRUE(largeFixture.ReadAndVerify(0, 0, 0, 100, 100) == cv::Size(100, 100));
+	EXPECT_TRUE(largeFixture.ReadAndVerify(0, 1050, 650, 50, 50) == cv::Size(50, 50));
+	EXPECT_TRUE(largeFixture.ReadAndVerify(0, 0, 0, ImageWidth, ImageHeight) == cv::Size(ImageWidth, ImageHeight));
+	EXPECT_EQ(1, largeFixture.GetDecodeCount());
+}
@@ -0,0 +1,102 @@
+/*!
+ * @file	FolderIndexerWrapper.cpp
+ * @author	kleon6436
+ */
+
+#include "FolderIndexerWrapper.h"
+#include < vcclr.h >
+
+namespace
+{
+	/*!
+	 * @brief	マネージドの文字列の配列をネイティブの文字列の配列へ変換する
+	 */
+	std::vector<std::wstring> ToNativeStrings(array<System::String^>^ strings)
+	{
+		std::vector<std::wstring> nativeStrings;
+		nativeStrings.reserve(strings->Length);
+		for (int i = 0; i < strings->Length; ++i)
+		{
+			pin_ptr<const wchar_t> text = PtrToStringChars(strings[i]);
+			nativeStrings.emplace_back(text);
+		}
+
+		return nativeStrings;
+	}
+}
+
+FolderIndexEntryWrapper::FolderIndexEntryWrapper(const FolderIndexEntry& entry)
+	: m_filePath(gcnew System::String(entry.path.c_str()))
+	, m_isRawImage(entry.isRawImage)
+	, m_lastWriteTime(System::DateTime::FromFileTime(entry.lastWriteTime))
+	, m_fileSize(entry.fileSize)
+	, m_hasHeader(entry.hasHeader)
+	, m_width(entry.width)
+	, m_height(entry.height)
+	, m_orientation(entry.orientation)
+	, m_dateTime(gcnew System::String(entry.dateTime))
+{
+}
+
+FolderIndexerWrapper::FolderIndexerWrapper(ImageReaderWrapper^ imageReader)
+	: m_indexerPtr(new FolderIndexer(*imageReader->m_imageReaderPtr, FolderIndexSettings{}))
+	, m_imageReader(imageReader)
+{
+}
+
+FolderIndexerWrapper::~FolderIndexerWrapper()
+{
+	this->!FolderIndexerWrapper();
+}
+
+FolderIndexerWrapper::!FolderIndexerWrapper()
+{
+	if (m_indexerPtr)
+	{
+		delete m_indexerPtr;
+		m_indexerPtr = nullptr;
+	}
+}
+
+array<FolderIndexEntryWrapper^>^ FolderIndexerWrapper::Scan(System::String^ directory, array<System::String^>^ extensions, array<System::String^>^ rawExtensions)
+{
+	const auto nativeExtensions = ToNativeStrings(extensions);
+	const auto nativeRawExtensions = ToNativeStrings(rawExtensions);
+	pin_ptr<const wchar_t> directoryPath = PtrToStringChars(directory);
+
+	std::vector<FolderIndexEntry> entries;
+	if (!m_indexerPtr->Scan(directoryPath, nativeExtensions, nativeRawExtensions, entries))
+	{
+		return nullptr;
+	}
+
+	auto entryWrappers = gcnew array<FolderIndexEntryWrapper^>(static_cast<int>(entries.size()));
+	for (int i = 0; i < entryWrappers->Length; ++i)
+	{
+		entryWrappers[i] = gcnew FolderIndexEntryWrapper(entries[i]);
+	}
+
+	return entryWrappers;
+}
+
+void FolderIndexerWrapper::Cancel()
+{
+	m_indexerPtr->Cancel();
+}
+
+void FolderIndexerWrapper::ResetCancel()
+{
+	m_indexerPtr->ResetCancel();
+}
+
+System::Boolean FolderIndexerWrapper::Load(System::String^ indexPath)
+{
+	pin_ptr<const wchar_t> path = PtrToStringChars(indexPath);
+	return m_indexerPtr->Load(path);
+}
+
+System::Boolean FolderIndexerWrapper::Save(System::String^ indexPath)
+{
+	pin_ptr<const wchar_t> path = PtrToStringChars(indexPath);
+	return m_indexerPtr->Save(path);
+}
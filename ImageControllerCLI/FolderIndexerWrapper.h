@@ -0,0 +1,203 @@
+/*!
+ * @file	FolderIndexerWrapper.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "FolderIndexer.h"
+#include "ImageReaderWrapper.h"
+
+using namespace Kchary::ImageController::Library;
+
+/// <summary>
+/// フォルダインデックスに記録した1画像分の情報(ネイティブの値を複製して保持する)
+/// </summary>
+public ref class FolderIndexEntryWrapper
+{
+public:
+	/// <summary>
+	/// 画像パス
+	/// </summary>
+	property System::String^ FilePath
+	{
+		System::String^ get()
+		{
+			return m_filePath;
+		}
+	}
+
+	/// <summary>
+	/// Raw画像か
+	/// </summary>
+	property System::Boolean IsRawImage
+	{
+		System::Boolean get()
+		{
+			return m_isRawImage;
+		}
+	}
+
+	/// <summary>
+	/// 最終更新日時(ローカル時刻)
+	/// </summary>
+	property System::DateTime LastWriteTime
+	{
+		System::DateTime get()
+		{
+			return m_lastWriteTime;
+		}
+	}
+
+	/// <summary>
+	/// ファイルサイズ
+	/// </summary>
+	property System::UInt64 FileSize
+	{
+		System::UInt64 get()
+		{
+			return m_fileSize;
+		}
+	}
+
+	/// <summary>
+	/// ヘッダーを読み取れたか(Falseの場合、幅・高さは0、向きは1、撮影日時は空文字列)
+	/// </summary>
+	property System::Boolean HasHeader
+	{
+		System::Boolean get()
+		{
+			return m_hasHeader;
+		}
+	}
+
+	/// <summary>
+	/// 幅(EXIFの向きを適用した表示上の幅)
+	/// </summary>
+	property System::Int32 Width
+	{
+		System::Int32 get()
+		{
+			return m_width;
+		}
+	}
+
+	/// <summary>
+	/// 高さ(EXIFの向きを適用した表示上の高さ)
+	/// </summary>
+	property System::Int32 Height
+	{
+		System::Int32 get()
+		{
+			return m_height;
+		}
+	}
+
+	/// <summary>
+	/// EXIFの向き(1～8)
+	/// </summary>
+	property System::Int32 Orientation
+	{
+		System::Int32 get()
+		{
+			return m_orientation;
+		}
+	}
+
+	/// <summary>
+	/// 撮影日時("YYYY:MM:DD HH:MM:SS"。記録がない場合は空文字列)
+	/// </summary>
+	property System::String^ DateTime
+	{
+		System::String^ get()
+		{
+			return m_dateTime;
+		}
+	}
+
+internal:
+	/*!
+	* @brief コンストラクタ
+	* @param entry	ネイティブのフォルダインデックスの情報
+	*/
+	FolderIndexEntryWrapper(const FolderIndexEntry& entry);
+
+private:
+	System::String^ m_filePath;				//!< 画像パス
+	System::Boolean m_isRawImage;			//!< Raw画像か
+	System::DateTime m_lastWriteTime;		//!< 最終更新日時
+	System::UInt64 m_fileSize;				//!< ファイルサイズ
+	System::Boolean m_hasHeader;			//!< ヘッダーを読み取れたか
+	System::Int32 m_width;					//!< 幅
+	System::Int32 m_height;					//!< 高さ
+	System::Int32 m_orientation;			//!< EXIFの向き
+	System::String^ m_dateTime;				//!< 撮影日時
+};
+
+public ref class FolderIndexerWrapper
+{
+public:
+	/*!
+	* @brief コンストラクタ
+	* @param imageReader	ヘッダーの読み取りに使う画像リーダー
+	*/
+	FolderIndexerWrapper(ImageReaderWrapper^ imageReader);
+
+	/*!
+	* @brief アンマネージド、マネージドリソースの開放
+	*/
+	~FolderIndexerWrapper();
+
+	/*!
+	* @brief アンマネージドリソースの解放
+	*/
+	!FolderIndexerWrapper();
+
+	/// <summary>
+	/// フォルダを1回走査して対象の拡張子の画像を列挙し、更新された画像のみヘッダーを読み直す
+	/// </summary>
+	/// <param name="directory">フォルダパス</param>
+	/// <param name="extensions">対象とする拡張子(大文字・小文字を区別しない)</param>
+	/// <param name="rawExtensions">Raw画像として読み込む拡張子</param>
+	/// <returns>フォルダ内の画像の情報(列挙できない、または中断した場合はnull)</returns>
+	array<FolderIndexEntryWrapper^>^ Scan(System::String^ directory, array<System::String^>^ extensions, array<System::String^>^ rawExtensions);
+
+	/// <summary>
+	/// 実行中のScanを中断する(ResetCancelを呼び出すまで、以降のScanも中断する)
+	/// </summary>
+	void Cancel();
+
+	/// <summary>
+	/// Cancelによる中断要求を取り消す(Scanを実行していない間に呼び出す)
+	/// </summary>
+	void ResetCancel();
+
+	/// <summary>
+	/// 保存したインデックスを読み込む
+	/// </summary>
+	/// <param name="indexPath">インデックスファイルのパス</param>
+	/// <returns>成功: True, 失敗: False(ファイルがない・破損している)</returns>
+	System::Boolean Load(System::String^ indexPath);
+
+	/// <summary>
+	/// インデックスをファイルへ保存する
+	/// </summary>
+	/// <param name="indexPath">インデックスファイルのパス</param>
+	/// <returns>成功: True, 失敗: False</returns>
+	System::Boolean Save(System::String^ indexPath);
+
+	/// <summary>
+	/// 最後に保存・読み込みしてからインデックスが変わったか
+	/// </summary>
+	property System::Boolean HasUnsavedChanges
+	{
+		System::Boolean get()
+		{
+			return m_indexerPtr->HasUnsavedChanges();
+		}
+	}
+
+private:
+	FolderIndexer* m_indexerPtr;			//!< フォルダインデックスのポインタ
+	ImageReaderWrapper^ m_imageReader;		//!< ヘッダーの読み取りに使う画像リーダー(インデックスより先に破棄されないよう保持する)
+};
@@ -7,6 +7,18 @@
 
 #include "ImageData.h"
 
+/// <summary>
+/// 画素の形式(ImagePixelFormatと同じ値)
+/// </summary>
+public enum class ImagePixelFormatWrapper
+{
+	Unknown = static_cast<int>(ImagePixelFormat::Unknown),
+	Bgr24 = static_cast<int>(ImagePixelFormat::Bgr24),
+	Bgra32 = static_cast<int>(ImagePixelFormat::Bgra32),
+	Bgr48 = static_cast<int>(ImagePixelFormat::Bgr48),
+	Bgra64 = static_cast<int>(ImagePixelFormat::Bgra64),
+};
+
 public ref class ImageDataWrapper
 {
 public:
@@ -44,6 +56,27 @@ public:
 		}
 	}
 
+	/// <summary>
+	/// 画像バッファの先頭ポインタ(コピーせずに参照する。ImageDataWrapperの生存中のみ有効)
+	/// </summary>
+	property System::IntPtr BufferPointer
+	{
+		System::IntPtr get()
+		{
+			if (!m_imageDataPtr)
+			{
+				return System::IntPtr::Zero;
+			}
+
+			if (m_imageDataPtr->destination)
+			{
+				return System::IntPtr(m_imageDataPtr->destination);
+			}
+
+			return m_imageDataPtr->buffer.empty() ? System::IntPtr::Zero : System::IntPtr(m_imageDataPtr->buffer.data());
+		}
+	}
+
 	/// <summary>
 	/// 画像バッファサイズ
 	/// </summary>
@@ -88,6 +121,30 @@ public:
 		}
 	}
 
+	/// <summary>
+	/// 画素の形式
+	/// </summary>
+	property ImagePixelFormatWrapper PixelFormat
+	{
+		ImagePixelFormatWrapper get()
+		{
+			return static_cast<ImagePixelFormatWrapper>(m_imageDataPtr->pixelFormat);
+		}
+	}
+
+	/// <summary>
+	/// 呼び出し元が用意した書き込み先を設定する
+	/// </summary>
+	/// <param name="destination">書き込み先の先頭ポインタ</param>
+	/// <param name="capacity">書き込み先の容量(Byte)</param>
+	/// <param name="stride">書き込み先のストライド(0の場合は詰めて書き込む)</param>
+	void SetDestination(System::IntPtr destination, System::UInt64 capacity, System::Int32 stride)
+	{
+		m_imageDataPtr->destination = static_cast<std::byte*>(destination.ToPointer());
+		m_imageDataPtr->destinationCapacity = static_cast<size_t>(capacity);
+		m_imageDataPtr->destinationStride = stride;
+	}
+
 internal:
 	ImageData* m_imageDataPtr;
 };
\ No newline at end of file
@@ -0,0 +1,27 @@
+/*!
+ * @file	ImageMetadataWrapper.cpp
+ * @author	kleon6436
+ */
+
+#include "ImageMetadataWrapper.h"
+#include "ImageHeader.h"
+
+ImageMetadataWrapper::ImageMetadataWrapper()
+	: m_metadataPtr(new ImageMetadata())
+{
+	Kchary::ImageController::Decode::ClearImageMetadata(*m_metadataPtr);
+}
+
+ImageMetadataWrapper::~ImageMetadataWrapper()
+{
+	this->!ImageMetadataWrapper();
+}
+
+ImageMetadataWrapper::!ImageMetadataWrapper()
+{
+	if (m_metadataPtr)
+	{
+		delete m_metadataPtr;
+		m_metadataPtr = nullptr;
+	}
+}
@@ -0,0 +1,217 @@
+/*!
+ * @file	ImageMetadataWrapper.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ImageData.h"
+
+public ref class ImageMetadataWrapper
+{
+public:
+	/*!
+	* @brief コンストラクタ(記録なしの状態で作る)
+	*/
+	ImageMetadataWrapper();
+
+	/*!
+	* @brief アンマネージド、マネージドリソースの開放
+	*/
+	~ImageMetadataWrapper();
+
+	/*!
+	* @brief アンマネージドリソースの解放
+	*/
+	!ImageMetadataWrapper();
+
+	/// <summary>
+	/// 幅(ファイルに保存されている向き)
+	/// </summary>
+	property System::Int32 Width
+	{
+		System::Int32 get()
+		{
+			return m_metadataPtr->width;
+		}
+	}
+
+	/// <summary>
+	/// 高さ(ファイルに保存されている向き)
+	/// </summary>
+	property System::Int32 Height
+	{
+		System::Int32 get()
+		{
+			return m_metadataPtr->height;
+		}
+	}
+
+	/// <summary>
+	/// EXIFの向き(1～8)
+	/// </summary>
+	property System::Int32 Orientation
+	{
+		System::Int32 get()
+		{
+			return m_metadataPtr->orientation;
+		}
+	}
+
+	/// <summary>
+	/// ビット深度(0: 不明)
+	/// </summary>
+	property System::Int32 BitDepth
+	{
+		System::Int32 get()
+		{
+			return m_metadataPtr->bitDepth;
+		}
+	}
+
+	/// <summary>
+	/// 水平解像度(dpi。0: 記録なし)
+	/// </summary>
+	property System::Double XResolution
+	{
+		System::Double get()
+		{
+			return m_metadataPtr->xResolution;
+		}
+	}
+
+	/// <summary>
+	/// 垂直解像度(dpi。0: 記録なし)
+	/// </summary>
+	property System::Double YResolution
+	{
+		System::Double get()
+		{
+			return m_metadataPtr->yResolution;
+		}
+	}
+
+	/// <summary>
+	/// 露光時間(秒。0: 記録なし)
+	/// </summary>
+	property System::Double ExposureTime
+	{
+		System::Double get()
+		{
+			return m_metadataPtr->exposureTime;
+		}
+	}
+
+	/// <summary>
+	/// F値(0: 記録なし)
+	/// </summary>
+	property System::Double FNumber
+	{
+		System::Double get()
+		{
+			return m_metadataPtr->fNumber;
+		}
+	}
+
+	/// <summary>
+	/// ISO感度(0: 記録なし)
+	/// </summary>
+	property System::Int32 IsoSpeed
+	{
+		System::Int32 get()
+		{
+			return m_metadataPtr->isoSpeed;
+		}
+	}
+
+	/// <summary>
+	/// 焦点距離(mm。0: 記録なし)
+	/// </summary>
+	property System::Double FocalLength
+	{
+		System::Double get()
+		{
+			return m_metadataPtr->focalLength;
+		}
+	}
+
+	/// <summary>
+	/// 35mm判換算の焦点距離(mm。0: 記録なし)
+	/// </summary>
+	property System::Int32 FocalLengthIn35mm
+	{
+		System::Int32 get()
+		{
+			return m_metadataPtr->focalLengthIn35mm;
+		}
+	}
+
+	/// <summary>
+	/// 露出プログラム(EXIFの値。-1: 記録なし)
+	/// </summary>
+	property System::Int32 ExposureProgram
+	{
+		System::Int32 get()
+		{
+			return m_metadataPtr->exposureProgram;
+		}
+	}
+
+	/// <summary>
+	/// 測光モード(EXIFの値。-1: 記録なし)
+	/// </summary>
+	property System::Int32 MeteringMode
+	{
+		System::Int32 get()
+		{
+			return m_metadataPtr->meteringMode;
+		}
+	}
+
+	/// <summary>
+	/// ホワイトバランス(EXIFの値。-1: 記録なし)
+	/// </summary>
+	property System::Int32 WhiteBalance
+	{
+		System::Int32 get()
+		{
+			return m_metadataPtr->whiteBalance;
+		}
+	}
+
+	/// <summary>
+	/// メーカー名(記録がない場合は空文字列)
+	/// </summary>
+	property System::String^ Make
+	{
+		System::String^ get()
+		{
+			return gcnew System::String(m_metadataPtr->make);
+		}
+	}
+
+	/// <summary>
+	/// モデル名(記録がない場合は空文字列)
+	/// </summary>
+	property System::String^ Model
+	{
+		System::String^ get()
+		{
+			return gcnew System::String(m_metadataPtr->model);
+		}
+	}
+
+	/// <summary>
+	/// 撮影日時("YYYY:MM:DD HH:MM:SS"。記録がない場合は空文字列)
+	/// </summary>
+	property System::String^ DateTime
+	{
+		System::String^ get()
+		{
+			return gcnew System::String(m_metadataPtr->dateTime);
+		}
+	}
+
+internal:
+	ImageMetadata* m_metadataPtr;	//!< メタデータのポインタ
+};
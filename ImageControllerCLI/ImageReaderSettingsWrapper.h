@@ -70,6 +70,66 @@ public:
 		}
 	}
 
+	/// <summary>
+	/// ピラミッドキャッシュを使わないフラグ(1回だけ読む画像の場合)
+	/// </summary>
+	property System::Boolean BypassPyramidCache
+	{
+		System::Boolean get()
+		{
+			return m_imageReaderSettingsPtr->bypassPyramidCache;
+		}
+		void set(System::Boolean bypassPyramidCache)
+		{
+			m_imageReaderSettingsPtr->bypassPyramidCache = bypassPyramidCache;
+		}
+	}
+
+	/// <summary>
+	/// 16ビットの画素を8ビットへ落とさずに取得するフラグ(RAW画像・16ビットのPNG/TIFFなど)
+	/// </summary>
+	property System::Boolean IsHighBitDepth
+	{
+		System::Boolean get()
+		{
+			return m_imageReaderSettingsPtr->isHighBitDepth;
+		}
+		void set(System::Boolean isHighBitDepth)
+		{
+			m_imageReaderSettingsPtr->isHighBitDepth = isHighBitDepth;
+		}
+	}
+
+	/// <summary>
+	/// アルファチャンネルを残すフラグ(アルファを持つ画像はBGRAで取得する)
+	/// </summary>
+	property System::Boolean PreserveAlpha
+	{
+		System::Boolean get()
+		{
+			return m_imageReaderSettingsPtr->preserveAlpha;
+		}
+		void set(System::Boolean preserveAlpha)
+		{
+			m_imageReaderSettingsPtr->preserveAlpha = preserveAlpha;
+		}
+	}
+
+	/// <summary>
+	/// 出力に適用するEXIFの向き(0: ファイルの記録に従う、1～8: 指定した向き)
+	/// </summary>
+	property System::Int32 Orientation
+	{
+		System::Int32 get()
+		{
+			return m_imageReaderSettingsPtr->orientation;
+		}
+		void set(System::Int32 orientation)
+		{
+			m_imageReaderSettingsPtr->orientation = orientation;
+		}
+	}
+
 internal:
 	ImageReadSettings* m_imageReaderSettingsPtr;
 };
\ No newline at end of file
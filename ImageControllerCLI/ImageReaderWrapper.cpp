@@ -8,6 +8,26 @@
 
 using namespace Kchary::ImageController::Library;
 
+/*!
+ * @brief CancellationTokenの中断要求を非同期デコードへ伝えるクラス
+ */
+ref class DecodeCancellation
+{
+public:
+	DecodeCancellation(const DecodeHandle* handle)
+		: m_handle(handle)
+	{
+	}
+
+	void Cancel()
+	{
+		m_handle->Cancel();
+	}
+
+private:
+	const DecodeHandle* m_handle;	//!< 非同期デコードのハンドル(登録を解除するまで生存すること)
+};
+
 ImageReaderWrapper::ImageReaderWrapper()
 	: m_imageReaderPtr(new ImageReader())
 {
@@ -41,3 +61,107 @@ System::Boolean ImageReaderWrapper::GetImageData(System::String^ imagePath, Imag
 
 	return true;
 }
+
+System::Boolean ImageReaderWrapper::GetImageData(System::String^ imagePath, ImageReaderSettingsWrapper^ imageReaderSettings, ImageDataWrapper^ imageData, System::Threading::CancellationToken cancellationToken)
+{
+	return GetImageData(imagePath, imageReaderSettings, imageData, nullptr, cancellationToken);
+}
+
+System::Boolean ImageReaderWrapper::GetImageData(System::String^ imagePath, ImageReaderSettingsWrapper^ imageReaderSettings, ImageDataWrapper^ imageData, ImageMetadataWrapper^ metadata, System::Threading::CancellationToken cancellationToken)
+{
+	ImageMetadata* metadataPtr = metadata ? metadata->m_metadataPtr : nullptr;
+	pin_ptr<const wchar_t> path = PtrToStringChars(imagePath);
+	if (!cancellationToken.CanBeCanceled || imageData->m_imageDataPtr->destination)
+	{
+		try
+		{
+			return m_imageReaderPtr->GetImageData(path, *imageReaderSettings->m_imageReaderSettingsPtr, *imageData->m_imageDataPtr, metadataPtr, nullptr);
+		}
+		catch (...)
+		{
+			return false;
+		}
+	}
+
+	try
+	{
+		const auto handle = m_imageReaderPtr->GetImageDataAsync(path, *imageReaderSettings->m_imageReaderSettingsPtr, nullptr);
+
+		// 登録時に中断済みの場合は、その場でCancel()が呼ばれる
+		System::IDisposable^ registration = cancellationToken.Register(gcnew System::Action(gcnew DecodeCancellation(&handle), &DecodeCancellation::Cancel));
+		bool result = false;
+		try
+		{
+			result = handle.Wait();
+		}
+		finally
+		{
+			// 実行中のCancel()の完了を待ってから登録を解除する
+			delete registration;
+		}
+
+		if (!result)
+		{
+			return false;
+		}
+
+		*imageData->m_imageDataPtr = std::move(handle.GetImageData());
+		if (metadataPtr)
+		{
+			*metadataPtr = handle.GetMetadata();
+		}
+	}
+	catch (...)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+System::Boolean ImageReaderWrapper::GetImageSize(System::String^ imagePath, System::Boolean isRawImage, System::Int32% width, System::Int32% height)
+{
+	width = 0;
+	height = 0;
+
+	pin_ptr<const wchar_t> path = PtrToStringChars(imagePath);
+	int imageWidth = 0;
+	int imageHeight = 0;
+	try
+	{
+		if (!m_imageReaderPtr->GetImageSize(path, isRawImage, imageWidth, imageHeight))
+		{
+			return false;
+		}
+	}
+	catch (...)
+	{
+		return false;
+	}
+
+	width = imageWidth;
+	height = imageHeight;
+	return true;
+}
+
+System::Boolean ImageReaderWrapper::ConvertToDisplayFormat(ImageDataWrapper^ source, ImageDataWrapper^ displayData)
+{
+	return m_imageReaderPtr->ConvertToDisplayFormat(*source->m_imageDataPtr, *displayData->m_imageDataPtr);
+}
+
+System::Boolean ImageReaderWrapper::OpenThumbnailStore(System::String^ directory)
+{
+	pin_ptr<const wchar_t> path = PtrToStringChars(directory);
+	return m_imageReaderPtr->OpenThumbnailStore(path);
+}
+
+void ImageReaderWrapper::CloseThumbnailStore()
+{
+	m_imageReaderPtr->CloseThumbnailStore();
+}
+
+System::String^ ImageReaderWrapper::GetDecodeStatisticsJson()
+{
+	const auto json = m_imageReaderPtr->GetDecodeStatisticsJson();
+	return gcnew System::String(json.c_str(), 0, static_cast<int>(json.size()), System::Text::Encoding::UTF8);
+}
@@ -7,6 +7,7 @@
 
 #include "ImageReader.h"
 #include "ImageDataWrapper.h"
+#include "ImageMetadataWrapper.h"
 #include "ImageReaderSettingsWrapper.h"
 
 using namespace Kchary::ImageController::Library;
@@ -38,7 +39,64 @@ public:
 	/// <returns>成否</returns>
 	System::Boolean GetImageData(System::String^ imagePath, ImageReaderSettingsWrapper^ imageReaderSettings, ImageDataWrapper^ imageData);
 
-private:
+	/// <summary>
+	/// 画像を取得する(キャンセルトークンの中断要求でデコードを打ち切る)
+	/// </summary>
+	/// <param name="imagePath">ファイルパス</param>
+	/// <param name="imageReaderSettings">画像読み込み設定</param>
+	/// <param name="imageData">画像データ</param>
+	/// <param name="cancellationToken">キャンセルトークン(中断できないトークン、または書き込み先を指定した場合は同期的に読み込む)</param>
+	/// <returns>成否(中断した場合はFalse)</returns>
+	System::Boolean GetImageData(System::String^ imagePath, ImageReaderSettingsWrapper^ imageReaderSettings, ImageDataWrapper^ imageData, System::Threading::CancellationToken cancellationToken);
+
+	/// <summary>
+	/// 画像と、同じファイルの読み込みで得たメタデータを取得する(キャンセルトークンの中断要求でデコードを打ち切る)
+	/// </summary>
+	/// <param name="imagePath">ファイルパス</param>
+	/// <param name="imageReaderSettings">画像読み込み設定</param>
+	/// <param name="imageData">画像データ</param>
+	/// <param name="metadata">メタデータ(nullptrの場合は取得しない)</param>
+	/// <param name="cancellationToken">キャンセルトークン(中断できないトークン、または書き込み先を指定した場合は同期的に読み込む)</param>
+	/// <returns>成否(中断した場合はFalse)</returns>
+	System::Boolean GetImageData(System::String^ imagePath, ImageReaderSettingsWrapper^ imageReaderSettings, ImageDataWrapper^ imageData, ImageMetadataWrapper^ metadata, System::Threading::CancellationToken cancellationToken);
+
+	/// <summary>
+	/// 画素をデコードせずに、等倍でデコードした場合の画像サイズを取得する
+	/// </summary>
+	/// <param name="imagePath">ファイルパス</param>
+	/// <param name="isRawImage">RAW画像か(埋め込みプレビューではなく、現像後の画像のサイズを返す)</param>
+	/// <param name="width">幅(EXIFの向き・RAWの回転を適用後)</param>
+	/// <param name="height">高さ(EXIFの向き・RAWの回転を適用後)</param>
+	/// <returns>成否</returns>
+	System::Boolean GetImageSize(System::String^ imagePath, System::Boolean isRawImage, [System::Runtime::InteropServices::Out] System::Int32% width, [System::Runtime::InteropServices::Out] System::Int32% height);
+
+	/// <summary>
+	/// 16ビット・アルファ付きの画像を、表示用の8ビットの画像(BGRはBGR24、BGRAはBGRA32)へ変換する
+	/// </summary>
+	/// <param name="source">変換元の画像データ</param>
+	/// <param name="displayData">変換後の画像データ(書き込み先を設定した場合はそこへ出力する)</param>
+	/// <returns>成否</returns>
+	System::Boolean ConvertToDisplayFormat(ImageDataWrapper^ source, ImageDataWrapper^ displayData);
+
+	/// <summary>
+	/// ディスクに永続化するサムネイルストアを開く(以降、サムネイル作成パイプラインのサムネイルはストアから取得する)
+	/// </summary>
+	/// <param name="directory">ストアのファイルを置くディレクトリ(作成済みであること)</param>
+	/// <returns>成否</returns>
+	System::Boolean OpenThumbnailStore(System::String^ directory);
+
+	/// <summary>
+	/// サムネイルストアを閉じる
+	/// </summary>
+	void CloseThumbnailStore();
+
+	/// <summary>
+	/// デコードの統計情報(工程ごとの処理時間、読み込み・出力バイト数、形式ごとのデコード回数)をJSON形式で取得する
+	/// </summary>
+	/// <returns>JSON</returns>
+	System::String^ GetDecodeStatisticsJson();
+
+internal:
 	ImageReader *m_imageReaderPtr;		//!< 画像リーダーのポインタ
 };
 
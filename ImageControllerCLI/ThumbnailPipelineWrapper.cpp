@@ -0,0 +1,101 @@
+/*!
+ * @file	ThumbnailPipelineWrapper.cpp
+ * @author	kleon6436
+ */
+
+#include "ThumbnailPipelineWrapper.h"
+#include < vcclr.h >
+
+/*!
+ * @brief パイプラインのスレッドからの通知をイベントへ伝えるクラス
+ * @note ラッパーを弱参照で保持し、通知先の登録がラッパーの破棄を妨げないようにする
+ */
+struct ResultsAvailableNotifier
+{
+	gcroot<System::WeakReference^> wrapper;	//!< 通知先のラッパー
+
+	void operator()() const
+	{
+		auto target = dynamic_cast<ThumbnailPipelineWrapper^>(static_cast<System::WeakReference^>(wrapper)->Target);
+		if (target)
+		{
+			target->RaiseResultsAvailable();
+		}
+	}
+};
+
+ThumbnailPipelineWrapper::ThumbnailPipelineWrapper(ImageReaderWrapper^ imageReader)
+	: m_pipelinePtr(new ThumbnailPipeline(*imageReader->m_imageReaderPtr, ThumbnailPipelineSettings{}))
+	, m_imageReader(imageReader)
+{
+	m_pipelinePtr->SetResultsAvailableCallback(ResultsAvailableNotifier{ gcnew System::WeakReference(this) });
+}
+
+ThumbnailPipelineWrapper::~ThumbnailPipelineWrapper()
+{
+	this->!ThumbnailPipelineWrapper();
+}
+
+ThumbnailPipelineWrapper::!ThumbnailPipelineWrapper()
+{
+	if (m_pipelinePtr)
+	{
+		delete m_pipelinePtr;
+		m_pipelinePtr = nullptr;
+	}
+}
+
+void ThumbnailPipelineWrapper::Start(array<System::String^>^ imagePaths, array<System::Boolean>^ isRawImages, System::Int32 longSideLength)
+{
+	std::vector<ThumbnailSource> sources;
+	sources.reserve(imagePaths->Length);
+	for (int i = 0; i < imagePaths->Length; ++i)
+	{
+		pin_ptr<const wchar_t> path = PtrToStringChars(imagePaths[i]);
+		sources.push_back(ThumbnailSource{ path, isRawImages[i] });
+	}
+
+	ImageReadSettings thumbnailSettings{};
+	thumbnailSettings.isThumbnailMode = true;
+	thumbnailSettings.resizeLongSideLength = longSideLength;
+	m_pipelinePtr->Start(std::move(sources), thumbnailSettings);
+}
+
+System::Boolean ThumbnailPipelineWrapper::TryDequeue(System::Int32% index, System::Boolean% result, ImageDataWrapper^ imageData)
+{
+	index = -1;
+	result = false;
+
+	ThumbnailResult thumbnailResult;
+	if (!m_pipelinePtr->TryDequeue(thumbnailResult))
+	{
+		return false;
+	}
+
+	index = static_cast<System::Int32>(thumbnailResult.index);
+	result = thumbnailResult.result;
+	if (thumbnailResult.result)
+	{
+		*imageData->m_imageDataPtr = std::move(thumbnailResult.imageData);
+	}
+
+	return true;
+}
+
+void ThumbnailPipelineWrapper::Cancel()
+{
+	m_pipelinePtr->Cancel();
+}
+
+void ThumbnailPipelineWrapper::RaiseResultsAvailable()
+{
+	// マネージドの例外はパイプラインのスレッドへ伝えない
+	try
+	{
+		ResultsAvailable(this, System::EventArgs::Empty);
+	}
+	catch (System::Exception^ e)
+	{
+		System::Diagnostics::Debug::WriteLine(e);
+	}
+}
@@ -0,0 +1,81 @@
+/*!
+ * @file	ThumbnailPipelineWrapper.h
+ * @author	kleon6436
+ */
+
+#pragma once
+
+#include "ThumbnailPipeline.h"
+#include "ImageDataWrapper.h"
+#include "ImageReaderWrapper.h"
+
+using namespace Kchary::ImageController::Library;
+
+public ref class ThumbnailPipelineWrapper
+{
+public:
+	/*!
+	* @brief コンストラクタ
+	* @param imageReader	デコードに使う画像リーダー
+	*/
+	ThumbnailPipelineWrapper(ImageReaderWrapper^ imageReader);
+
+	/*!
+	* @brief アンマネージド、マネージドリソースの開放
+	*/
+	~ThumbnailPipelineWrapper();
+
+	/*!
+	* @brief アンマネージドリソースの解放
+	*/
+	!ThumbnailPipelineWrapper();
+
+	/// <summary>
+	/// 画像の一覧の順にサムネイルを作り始める(実行中の場合は中断してから開始する)
+	/// </summary>
+	/// <param name="imagePaths">画像パスの一覧</param>
+	/// <param name="isRawImages">画像ごとのRaw画像フラグ</param>
+	/// <param name="longSideLength">サムネイルの長辺の長さ</param>
+	void Start(array<System::String^>^ imagePaths, array<System::Boolean>^ isRawImages, System::Int32 longSideLength);
+
+	/// <summary>
+	/// 作り終えたサムネイルを1枚取り出す(ブロックしない。Start・Cancelと同時に呼び出さないこと)
+	/// </summary>
+	/// <param name="index">画像の一覧のインデックス</param>
+	/// <param name="result">サムネイルを作れたか</param>
+	/// <param name="imageData">画像データ(作れた場合のみ有効)</param>
+	/// <returns>取り出した: True, 作り終えたものがない: False</returns>
+	System::Boolean TryDequeue([System::Runtime::InteropServices::Out] System::Int32% index, [System::Runtime::InteropServices::Out] System::Boolean% result, ImageDataWrapper^ imageData);
+
+	/// <summary>
+	/// 実行中の処理を中断し、取り出されていないサムネイルを破棄する
+	/// </summary>
+	void Cancel();
+
+	/// <summary>
+	/// 作り終えたサムネイルを出力したとき、または全て出力し終えたときに発火するイベント
+	/// (パイプラインのスレッドから発火する。ハンドラー内でTryDequeue・Cancelを呼ばずに速やかに戻ること)
+	/// </summary>
+	event System::EventHandler^ ResultsAvailable;
+
+	/// <summary>
+	/// 全ての画像を処理し、サムネイルを全て取り出したか
+	/// </summary>
+	property System::Boolean IsCompleted
+	{
+		System::Boolean get()
+		{
+			return m_pipelinePtr->IsCompleted();
+		}
+	}
+
+internal:
+	/*!
+	* @brief 結果を出力したことをイベントで通知する(パイプラインのスレッドから呼ばれる)
+	*/
+	void RaiseResultsAvailable();
+
+private:
+	ThumbnailPipeline* m_pipelinePtr;		//!< サムネイルパイプラインのポインタ
+	ImageReaderWrapper^ m_imageReader;		//!< デコードに使う画像リーダー(パイプラインより先に破棄されないよう保持する)
+};
@@ -1,4 +1,5 @@
-﻿using Reactive.Bindings;
+﻿using Kchary.PhotoViewer.Helpers;
+using Reactive.Bindings;
 using Reactive.Bindings.Schedulers;
 using System;
 using System.Diagnostics;
@@ -141,6 +142,9 @@ namespace Kchary.PhotoViewer
         /// <param name="e">引数情報</param>
         private void App_OnExit(object sender, ExitEventArgs e)
         {
+            // 終了時はファイナライザーが実行されないため、次回の起動時に使えるようサムネイルストアを閉じる
+            ImageUtil.CloseThumbnailStore();
+
             if (Mutex == null)
             {
                 return;
@@ -1,10 +1,7 @@
-﻿using Kchary.PhotoViewer.Models;
-using System;
-using System.Runtime.InteropServices;
+﻿using System;
+using System.IO;
 using System.Threading;
-using System.Threading.Tasks;
 using System.Windows;
-using System.Windows.Interop;
 using System.Windows.Media;
 using System.Windows.Media.Imaging;
 
@@ -15,116 +12,119 @@ namespace Kchary.PhotoViewer.Helpers
     /// </summary>
     public static class ImageUtil
     {
-        [DllImport("shell32.dll", CharSet = CharSet.Unicode, PreserveSig = false)]
-        private static extern void SHCreateItemFromParsingName(
-            [In] string pszPath,
-            [In] IntPtr pbc,
-            [In] ref Guid riid,
-            [Out] out IShellItemImageFactory ppv);
-
-        [DllImport("gdi32.dll")]
-        [return: MarshalAs(UnmanagedType.Bool)]
-        private static extern bool DeleteObject(IntPtr hObject);
-
-        private static readonly Guid IShellItemImageFactoryGuid = new("bcc18b79-ba16-442f-80c4-8a59c30c463b");
+        /// <summary>
+        /// 画像リーダー(画素バッファのプールを再利用するため共有する。ネイティブ側はスレッドセーフ)
+        /// </summary>
+        private static readonly ImageReaderWrapper imageReaderWrapper = new();
 
         /// <summary>
-        /// OS標準のキャッシュされたサムネイル（ThumbCache）を使用してサムネイル画像を作成します
+        /// ディスクに永続化するサムネイルストアを開く(以降、サムネイル作成パイプラインのサムネイルはストアから取得し、なければデコードして追加する)
         /// </summary>
-        /// <param name="filePath">ファイルパス</param>
-        /// <param name="size">画像サイズ</param>
-        /// <returns>サムネイル画像</returns>
-        public static BitmapSource GetThumbnail(string filePath, int size)
+        /// <param name="directory">ストアのファイルを置くディレクトリ(存在しない場合は作成する)</param>
+        /// <returns>成否</returns>
+        public static bool OpenThumbnailStore(string directory)
         {
-            var localGuid = IShellItemImageFactoryGuid;
-            SHCreateItemFromParsingName(filePath, IntPtr.Zero, ref localGuid, out var factory);
-            if (factory == null) return null;
-
-            var sz = new SIZE { cx = size, cy = size };
-            factory.GetImage(sz, SIIGBF.RESIZETOFIT, out var hBitmap);
-
-            if (hBitmap == IntPtr.Zero) return null;
-
-            var source = Imaging.CreateBitmapSourceFromHBitmap(
-                hBitmap,
-                IntPtr.Zero,
-                Int32Rect.Empty,
-                BitmapSizeOptions.FromEmptyOptions());
-
-            DeleteObject(hBitmap);
-            source.Freeze();
-            return source;
+            Directory.CreateDirectory(directory);
+            return imageReaderWrapper.OpenThumbnailStore(directory);
         }
 
-        [ComImport]
-        [Guid("bcc18b79-ba16-442f-80c4-8a59c30c463b")]
-        [InterfaceType(ComInterfaceType.InterfaceIsIUnknown)]
-        internal interface IShellItemImageFactory
+        /// <summary>
+        /// サムネイルストアを閉じる(次回の起動時に使えるようインデックスを保存する)
+        /// </summary>
+        public static void CloseThumbnailStore()
         {
-            void GetImage(SIZE size, SIIGBF flags, out IntPtr phbm);
+            imageReaderWrapper.CloseThumbnailStore();
         }
 
-        [StructLayout(LayoutKind.Sequential)]
-        internal struct SIZE
+        /// <summary>
+        /// フォルダ内のサムネイル画像を並行に作成するパイプラインを作成する
+        /// </summary>
+        /// <returns>パイプライン(画素バッファのプールを画像リーダーと共有する)</returns>
+        public static ThumbnailPipelineWrapper CreateThumbnailPipeline()
         {
-            public int cx;
-            public int cy;
+            return new ThumbnailPipelineWrapper(imageReaderWrapper);
         }
 
-        [Flags]
-        internal enum SIIGBF
+        /// <summary>
+        /// フォルダ内の画像を列挙し、ヘッダーの情報(サイズ・向き・撮影日時)を記録するインデックスを作成する
+        /// </summary>
+        /// <returns>フォルダインデックス(ヘッダーの読み取りに画像リーダーを使う)</returns>
+        public static FolderIndexerWrapper CreateFolderIndexer()
         {
-            RESIZETOFIT = 0x00,
-            BIGGERSIZEOK = 0x01,
-            MEMORYONLY = 0x02,
-            ICONONLY = 0x04,
-            THUMBNAILONLY = 0x08,
-            INCACHEONLY = 0x10,
+            return new FolderIndexerWrapper(imageReaderWrapper);
         }
 
         /// <summary>
-        /// サムネイル画像をロードする
+        /// 画像をデコードする
         /// </summary>
-        /// <returns>True: 成功、False: 失敗</returns>
-        public static async Task<BitmapSource> LoadThumbnailAsync(PhotoInfo photo, CancellationToken cancellationToken)
+        /// <param name="filePath">画像ファイルパス</param>
+        /// <param name="longSideLength">長辺の長さ(この長さにあわせて画像がリサイズされる)</param>
+        /// <param name="isRawImage">RAW画像フラグ</param>
+        /// <param name="cancellationToken">キャンセルトークン</param>
+        /// <returns>BitmapSource</returns>
+        public static BitmapSource DecodePicture(string filePath, int longSideLength, bool isRawImage = false, CancellationToken cancellationToken = default)
         {
-            try
-            {
-                return await Task.Run(() => ThumbnailCache.GetOrCreate(photo.FilePath, ThumbnailQuality.Small), cancellationToken);
-            }
-            catch (Exception ex)
-            {
-                App.LogException(ex);
-                return null;
-            }
+            return DecodePicture(filePath, longSideLength, isRawImage, null, cancellationToken);
         }
 
         /// <summary>
-        /// 画像をデコードする
+        /// 画像をデコードし、同じファイルの読み込みでメタデータを取得する
         /// </summary>
         /// <param name="filePath">画像ファイルパス</param>
         /// <param name="longSideLength">長辺の長さ(この長さにあわせて画像がリサイズされる)</param>
         /// <param name="isRawImage">RAW画像フラグ</param>
+        /// <param name="metadata">メタデータの格納先(nullの場合は取得しない)</param>
         /// <param name="cancellationToken">キャンセルトークン</param>
         /// <returns>BitmapSource</returns>
-        public static BitmapSource DecodePicture(string filePath, int longSideLength, bool isRawImage = false, CancellationToken cancellationToken = default)
+        public static BitmapSource DecodePicture(string filePath, int longSideLength, bool isRawImage, ImageMetadataWrapper metadata, CancellationToken cancellationToken)
+        {
+            const bool isThumbnailMode = true;
+            using ImageReaderSettingsWrapper imageReadSettings = new()
+            {
+                IsRawImage = isRawImage,
+                IsThumbnailMode = isThumbnailMode,
+                ResizeLongSideLength = longSideLength,
+            };
+
+            return DecodePicture(filePath, imageReadSettings, metadata, cancellationToken);
+        }
+
+        /// <summary>
+        /// 保存用に画像をデコードする
+        /// </summary>
+        /// <param name="filePath">画像ファイルパス</param>
+        /// <param name="longSideLength">長辺の長さ(この長さにあわせて画像がリサイズされる)</param>
+        /// <param name="isRawImage">RAW画像フラグ</param>
+        /// <returns>BitmapSource(EXIFの向きを適用済み)</returns>
+        /// <remarks>EXIFの向きはネイティブのデコードで縮小と同時に適用する</remarks>
+        public static BitmapSource DecodeSaveImage(string filePath, int longSideLength, bool isRawImage)
+        {
+            // RAW画像はサムネイルではなく現像した画像を縮小する
+            using ImageReaderSettingsWrapper imageReadSettings = new()
+            {
+                IsRawImage = isRawImage,
+                IsThumbnailMode = !isRawImage,
+                ResizeLongSideLength = longSideLength,
+                BypassPyramidCache = true,
+            };
+
+            return DecodePicture(filePath, imageReadSettings, null, CancellationToken.None);
+        }
+
+        /// <summary>
+        /// 読み込み設定に従って画像をデコードする
+        /// </summary>
+        private static BitmapSource DecodePicture(string filePath, ImageReaderSettingsWrapper imageReadSettings, ImageMetadataWrapper metadata, CancellationToken cancellationToken)
         {
-            ImageReaderWrapper imageReaderWrapper = new();
             BitmapSource image;
             try
             {
-                // 画像を読み込む
-                const bool isThumbnailMode = true;
-                ImageReaderSettingsWrapper imageReadSettings = new()
-                {
-                    IsRawImage = isRawImage,
-                    IsThumbnailMode = isThumbnailMode,
-                    ResizeLongSideLength = longSideLength,
-                };
-
-                ImageDataWrapper imageData = new();
-                if (!imageReaderWrapper.GetImageData(filePath, imageReadSettings, imageData))
+                // 破棄時に画素バッファをプールへ返却する
+                // (キャンセルされた場合はデコードを途中で打ち切る)
+                using ImageDataWrapper imageData = new();
+                if (!imageReaderWrapper.GetImageData(filePath, imageReadSettings, imageData, metadata, cancellationToken))
                 {
+                    cancellationToken.ThrowIfCancellationRequested();
                     throw new Exception("Failed to get image");
                 }
 
@@ -146,27 +146,16 @@ namespace Kchary.PhotoViewer.Helpers
         }
 
         /// <summary>
-        /// 画像を回転させる
+        /// 画素をデコードせずに、等倍でデコードした場合の画像サイズを取得する
         /// </summary>
-        /// <param name="metaData">Metadata</param>
-        /// <param name="image">BitmapSource</param>
-        /// <returns>BitmapSource</returns>
-        public static BitmapSource RotateImage(BitmapMetadata metaData, BitmapSource image)
+        /// <param name="filePath">画像ファイルパス</param>
+        /// <param name="isRawImage">RAW画像フラグ(埋め込みプレビューではなく、現像後の画像のサイズを返す)</param>
+        /// <param name="width">幅(EXIFの向き・RAWの回転を適用後)</param>
+        /// <param name="height">高さ(EXIFの向き・RAWの回転を適用後)</param>
+        /// <returns>成否</returns>
+        public static bool GetImageSize(string filePath, bool isRawImage, out int width, out int height)
         {
-            var rotation = GetRotation(metaData);
-
-            return rotation switch
-            {
-                1 => image,
-                3 => TransformBitmap(image, new RotateTransform(180)),
-                6 => TransformBitmap(image, new RotateTransform(90)),
-                8 => TransformBitmap(image, new RotateTransform(270)),
-                2 => TransformBitmap(image, new ScaleTransform(-1, 1, 0, 0)),
-                4 => TransformBitmap(image, new ScaleTransform(1, -1, 0, 0)),
-                5 => TransformBitmap(TransformBitmap(image, new RotateTransform(90)), new ScaleTransform(-1, 1, 0, 0)),
-                7 => TransformBitmap(TransformBitmap(image, new RotateTransform(270)), new ScaleTransform(-1, 1, 0, 0)),
-                _ => image,
-            };
+            return imageReaderWrapper.GetImageSize(filePath, isRawImage, out width, out height);
         }
 
         /// <summary>
@@ -186,34 +175,31 @@ namespace Kchary.PhotoViewer.Helpers
         /// <param name="imageData">画像データ情報</param>
         /// <param name="cancellationToken">キャンセルトークン</param>
         /// <returns>WriteableBitmap</returns>
-        private static WriteableBitmap CreateBitmapSourceFromImageStruct(ImageDataWrapper imageData, CancellationToken cancellationToken = default)
+        internal static WriteableBitmap CreateBitmapSourceFromImageStruct(ImageDataWrapper imageData, CancellationToken cancellationToken = default)
         {
             cancellationToken.ThrowIfCancellationRequested();
 
-            var imgData = imageData.Buffer;
-            if (imgData == null)
+            // WPFはBGR順の16ビット形式を持たないため、16ビットの画像は表示用の8ビットへ変換してから作成する
+            if (imageData.PixelFormat is ImagePixelFormatWrapper.Bgr48 or ImagePixelFormatWrapper.Bgra64)
+            {
+                using ImageDataWrapper displayData = new();
+                return imageReaderWrapper.ConvertToDisplayFormat(imageData, displayData) ? CreateBitmapSourceFromImageStruct(displayData, cancellationToken) : null;
+            }
+
+            // ネイティブのバッファを直接参照し、マネージド配列へのコピーを省く
+            var bufferPointer = imageData.BufferPointer;
+            if (bufferPointer == IntPtr.Zero)
             {
                 return null;
             }
 
-            var bitmap = new WriteableBitmap(imageData.Width, imageData.Height, 96, 96, PixelFormats.Bgr24, null);
-            bitmap.WritePixels(new Int32Rect(0, 0, imageData.Width, imageData.Height), imgData, imageData.Stride, 0, 0);
+            var pixelFormat = imageData.PixelFormat == ImagePixelFormatWrapper.Bgra32 ? PixelFormats.Bgra32 : PixelFormats.Bgr24;
+            var bitmap = new WriteableBitmap(imageData.Width, imageData.Height, 96, 96, pixelFormat, null);
+            bitmap.WritePixels(new Int32Rect(0, 0, imageData.Width, imageData.Height), bufferPointer, (int)imageData.BufferSize, imageData.Stride);
             bitmap.Freeze();
+            GC.KeepAlive(imageData);
 
             return bitmap;
         }
-
-        /// <summary>
-        /// 画像を回転させる
-        /// </summary>
-        private static TransformedBitmap TransformBitmap(BitmapSource source, Transform transform)
-        {
-            var result = new TransformedBitmap();
-            result.BeginInit();
-            result.Source = source;
-            result.Transform = transform;
-            result.EndInit();
-            return result;
-        }
     }
 }
\ No newline at end of file
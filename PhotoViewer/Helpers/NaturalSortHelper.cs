@@ -25,4 +25,12 @@ namespace Kchary.PhotoViewer.Helpers
             return SafeNativeMethods.StrCmpLogicalW(x?.Name, y?.Name);
         }
     }
+
+    public sealed class NaturalFilePathNameComparer : IComparer<string>
+    {
+        public int Compare(string x, string y)
+        {
+            return SafeNativeMethods.StrCmpLogicalW(Path.GetFileName(x), Path.GetFileName(y));
+        }
+    }
 }
\ No newline at end of file
@@ -81,5 +81,15 @@ namespace Kchary.PhotoViewer.Models
         /// アプリケーション設定ファイルの絶対パス
         /// </summary>
         public static readonly string AppConfigFilePath = $"{Environment.GetFolderPath(Environment.SpecialFolder.ApplicationData)}\\KcharyPhotoViewer\\Setting.conf";
+
+        /// <summary>
+        /// フォルダインデックス(画像のサイズ・撮影日時)を保存するファイルの絶対パス
+        /// </summary>
+        public static readonly string FolderIndexFilePath = $"{Environment.GetFolderPath(Environment.SpecialFolder.LocalApplicationData)}\\KcharyPhotoViewer\\FolderIndex.bin";
+
+        /// <summary>
+        /// サムネイルストア(作成したサムネイル画像)を保存するディレクトリの絶対パス
+        /// </summary>
+        public static readonly string ThumbnailStoreDirectory = $"{Environment.GetFolderPath(Environment.SpecialFolder.LocalApplicationData)}\\KcharyPhotoViewer\\ThumbnailStore";
     }
 }
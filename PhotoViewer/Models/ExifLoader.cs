@@ -1,18 +1,6 @@
 ﻿using FastEnumUtility;
 using Kchary.PhotoViewer.Helpers;
-using MetadataExtractor;
-using MetadataExtractor.Formats.Bmp;
-using MetadataExtractor.Formats.Exif;
-using MetadataExtractor.Formats.Gif;
-using MetadataExtractor.Formats.Jpeg;
-using MetadataExtractor.Formats.Png;
-using MetadataExtractor.Formats.Tiff;
 using System;
-using System.Collections.Generic;
-using System.Linq;
-using System.Text;
-using System.Threading;
-using System.Threading.Tasks;
 
 namespace Kchary.PhotoViewer.Models
 {
@@ -100,7 +88,7 @@ namespace Kchary.PhotoViewer.Models
     }
 
     /// <summary>
-    /// Exif情報を写真情報から読み込むクラス
+    /// Exif情報を写真のメタデータから作成するクラス
     /// </summary>
     public sealed class ExifLoader
     {
@@ -156,167 +144,70 @@ namespace Kchary.PhotoViewer.Models
         }
 
         /// <summary>
-        /// 写真情報からExif情報のリストを作成する
+        /// 画像のデコード時に読み取ったメタデータからExif情報のリストを作成する
         /// </summary>
-        /// <param name="cancellationToken">キャンセルトークン</param>
+        /// <param name="metadata">メタデータ</param>
         /// <returns>Exif情報のリスト</returns>
-        public ExifInfo[] CreateExifInfoList(CancellationToken cancellationToken)
+        public ExifInfo[] CreateExifInfoList(ImageMetadataWrapper metadata)
         {
             ExifInfo[] exifInfos = CreateExifDefaultList();
 
-            var filePath = PhotoInfo.FilePath;
-            var fileExtensionType = PhotoInfo.FileExtensionType;
-            var directories = GetMetadataDirectories(fileExtensionType).ToArray();
-            var subIfdDirectories = directories.OfType<ExifSubIfdDirectory>().ToArray();
-
-            var parallelOptions = new ParallelOptions
-            {
-                CancellationToken = cancellationToken
-            };
-
-            Parallel.ForEach(exifInfos, parallelOptions, exifInfo =>
+            foreach (var exifInfo in exifInfos)
             {
-                cancellationToken.ThrowIfCancellationRequested();
-
-                switch (exifInfo.ExifPropertyType)
+                exifInfo.ExifParameterValue = exifInfo.ExifPropertyType switch
                 {
-                    case PropertyType.FileName:
-                        exifInfo.ExifParameterValue = FileUtil.GetFileName(filePath, false);
-                        break;
-
-                    case PropertyType.Date:
-                        exifInfo.ExifParameterValue = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagDateTime);
-                        break;
-
-                    case PropertyType.CameraModel:
-                        exifInfo.ExifParameterValue = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagModel);
-                        break;
-
-                    case PropertyType.CameraManufacturer:
-                        exifInfo.ExifParameterValue = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagMake);
-                        break;
-
-                    case PropertyType.ImageWidth:
-                        exifInfo.ExifParameterValue = PhotoInfo.IsRawImage
-                            ? $"{GetExifDataFromMetadata(subIfdDirectories, ExifDirectoryBase.TagImageWidth)} pixel"
-                            : $"{GetExifDataFromMetadata(directories, ExifDirectoryBase.TagExifImageWidth)} pixel";
-                        break;
-
-                    case PropertyType.ImageHeight:
-                        exifInfo.ExifParameterValue = PhotoInfo.IsRawImage
-                            ? $"{GetExifDataFromMetadata(subIfdDirectories, ExifDirectoryBase.TagImageHeight)} pixel"
-                            : $"{GetExifDataFromMetadata(directories, ExifDirectoryBase.TagExifImageHeight)} pixel";
-                        break;
-
-                    case PropertyType.HorizonResolution:
-                        var horizonResolution = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagXResolution);
-                        exifInfo.ExifParameterValue = !string.IsNullOrEmpty(horizonResolution) ? $"{horizonResolution} dpi" : horizonResolution;
-                        break;
-
-                    case PropertyType.VerticalResolution:
-                        var verticalResolution = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagYResolution);
-                        exifInfo.ExifParameterValue = !string.IsNullOrEmpty(verticalResolution) ? $"{verticalResolution} dpi" : verticalResolution;
-                        break;
-
-                    case PropertyType.BitDepth:
-                        var bitDepth = fileExtensionType switch
-                        {
-                            FileExtensionType.Jpeg => GetExifDataFromMetadata(directories, JpegDirectory.TagDataPrecision),
-                            FileExtensionType.Bmp => GetExifDataFromMetadata(directories, BmpHeaderDirectory.TagBitsPerPixel),
-                            FileExtensionType.Png => GetExifDataFromMetadata(directories, PngDirectory.TagBitsPerSample),
-                            FileExtensionType.Gif => GetExifDataFromMetadata(directories, GifHeaderDirectory.TagBitsPerPixel),
-                            FileExtensionType.Tiff or FileExtensionType.Dng or FileExtensionType.Nef => GetExifDataFromMetadata(directories, ExifDirectoryBase.TagBitsPerSample).AsSpan(0, 1),
-                            _ => throw new ArgumentOutOfRangeException(nameof(fileExtensionType), $"Unsupported extension: {fileExtensionType}")
-                        };
-                        exifInfo.ExifParameterValue = $"{bitDepth} bits";
-                        break;
-
-                    case PropertyType.ShutterSpeed:
-                        var shutterSpeed = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagExposureTime);
-                        exifInfo.ExifParameterValue = !string.IsNullOrEmpty(shutterSpeed) ? $"{shutterSpeed} sec" : shutterSpeed;
-                        break;
-
-                    case PropertyType.FNumber:
-                        var fNumber = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagFNumber);
-                        exifInfo.ExifParameterValue = !string.IsNullOrEmpty(fNumber) ? $"F/{fNumber}" : "";
-                        break;
-
-                    case PropertyType.Iso:
-                        exifInfo.ExifParameterValue = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagIsoEquivalent);
-                        break;
-
-                    case PropertyType.FocalLength:
-                        var focalLength = GetExifDataFromMetadata(directories, ExifDirectoryBase.Tag35MMFilmEquivFocalLength);
-                        exifInfo.ExifParameterValue = !string.IsNullOrEmpty(focalLength) ? $"{focalLength} mm" : focalLength;
-                        break;
-
-                    case PropertyType.ExposureProgram:
-                        var exposureProgram = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagExposureProgram);
-                        exifInfo.ExifParameterValue = !string.IsNullOrEmpty(exposureProgram) ? FastEnum.Parse<ExposureProgramType>(exposureProgram).ToString() : exposureProgram;
-                        break;
-
-                    case PropertyType.WhiteBalance:
-                        var whiteBalance = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagWhiteBalance);
-                        exifInfo.ExifParameterValue = !string.IsNullOrEmpty(whiteBalance) ? FastEnum.Parse<WhiteBalanceType>(whiteBalance).ToString() : whiteBalance;
-                        break;
-
-                    case PropertyType.MeteringMode:
-                        var meteringMode = GetExifDataFromMetadata(directories, ExifDirectoryBase.TagMeteringMode);
-                        exifInfo.ExifParameterValue = !string.IsNullOrEmpty(meteringMode) ? FastEnum.Parse<MeteringModeType>(meteringMode).ToString() : meteringMode;
-                        break;
-
-                    default:
-                        throw new ArgumentOutOfRangeException(nameof(exifInfo.ExifPropertyType), $"Unsupported property: {exifInfo.ExifPropertyType}");
-                }
-            });
+                    PropertyType.FileName => FileUtil.GetFileName(PhotoInfo.FilePath, false),
+                    PropertyType.Date => metadata.DateTime,
+                    PropertyType.CameraModel => metadata.Model,
+                    PropertyType.CameraManufacturer => metadata.Make,
+                    PropertyType.ImageWidth => metadata.Width > 0 ? $"{metadata.Width} pixel" : "",
+                    PropertyType.ImageHeight => metadata.Height > 0 ? $"{metadata.Height} pixel" : "",
+                    PropertyType.HorizonResolution => metadata.XResolution > 0 ? $"{metadata.XResolution:0.##} dpi" : "",
+                    PropertyType.VerticalResolution => metadata.YResolution > 0 ? $"{metadata.YResolution:0.##} dpi" : "",
+                    PropertyType.BitDepth => metadata.BitDepth > 0 ? $"{metadata.BitDepth} bits" : "",
+                    PropertyType.ShutterSpeed => FormatExposureTime(metadata.ExposureTime),
+                    PropertyType.FNumber => metadata.FNumber > 0 ? $"F/{metadata.FNumber:0.#}" : "",
+                    PropertyType.Iso => metadata.IsoSpeed > 0 ? $"{metadata.IsoSpeed}" : "",
+                    PropertyType.FocalLength => FormatFocalLength(metadata.FocalLengthIn35mm, metadata.FocalLength),
+                    PropertyType.ExposureProgram => metadata.ExposureProgram >= 0 ? ((ExposureProgramType)metadata.ExposureProgram).ToString() : "",
+                    PropertyType.WhiteBalance => metadata.WhiteBalance >= 0 ? ((WhiteBalanceType)metadata.WhiteBalance).ToString() : "",
+                    PropertyType.MeteringMode => metadata.MeteringMode >= 0 ? ((MeteringModeType)metadata.MeteringMode).ToString() : "",
+                    _ => throw new ArgumentOutOfRangeException(nameof(exifInfo.ExifPropertyType), $"Unsupported property: {exifInfo.ExifPropertyType}")
+                };
+            }
 
             return exifInfos;
         }
 
         /// <summary>
-        /// メタデータの構造データを取得する
+        /// 露光時間を表示用の文字列にする(1秒未満は分数で表す)
         /// </summary>
-        /// <param name="fileExtensionType">ファイルの拡張子</param>
-        /// <returns>メタデータの構造データ</returns>
-        private IEnumerable<Directory> GetMetadataDirectories(FileExtensionType fileExtensionType)
+        /// <param name="exposureTime">露光時間(秒。0の場合は記録なし)</param>
+        /// <returns>表示用の文字列</returns>
+        private static string FormatExposureTime(double exposureTime)
         {
-            return fileExtensionType switch
+            if (exposureTime <= 0)
             {
-                FileExtensionType.Jpeg => JpegMetadataReader.ReadMetadata(PhotoInfo.FilePath),
-                FileExtensionType.Bmp => BmpMetadataReader.ReadMetadata(PhotoInfo.FilePath),
-                FileExtensionType.Png => PngMetadataReader.ReadMetadata(PhotoInfo.FilePath),
-                FileExtensionType.Gif => GifMetadataReader.ReadMetadata(PhotoInfo.FilePath),
-                FileExtensionType.Tiff or FileExtensionType.Dng or FileExtensionType.Nef => TiffMetadataReader.ReadMetadata(PhotoInfo.FilePath),
-                FileExtensionType.Unknown or _ => throw new ArgumentOutOfRangeException(nameof(fileExtensionType)),
-            };
+                return "";
+            }
+
+            return exposureTime < 1 ? $"1/{Math.Round(1 / exposureTime)} sec" : $"{exposureTime:0.#} sec";
         }
 
         /// <summary>
-        /// Exif情報をメタデータから取得する
+        /// 焦点距離を表示用の文字列にする(35mm判換算の記録がある場合はそれを優先する)
         /// </summary>
-        /// <typeparam name="T">MetadataExtractor.Directory</typeparam>
-        /// <param name="metadataDirectories">メタデータの構造データ</param>
-        /// <param name="tag">取得したいExifのタグ番号</param>
-        private static string GetExifDataFromMetadata<T>(IEnumerable<T> metadataDirectories, int tag)
-            where T : Directory
+        /// <param name="focalLengthIn35mm">35mm判換算の焦点距離(0の場合は記録なし)</param>
+        /// <param name="focalLength">焦点距離(0の場合は記録なし)</param>
+        /// <returns>表示用の文字列</returns>
+        private static string FormatFocalLength(int focalLengthIn35mm, double focalLength)
         {
-            foreach (var metadataDirectory in metadataDirectories)
+            if (focalLengthIn35mm > 0)
             {
-                if (metadataDirectory is not Directory exifDirectory)
-                {
-                    continue;
-                }
-
-                // 該当データが見つかった場合は、すぐにその値を返す
-                var metadata = exifDirectory.GetString(tag);
-                if (!string.IsNullOrEmpty(metadata))
-                {
-                    return metadata;
-                }
+                return $"{focalLengthIn35mm} mm";
             }
 
-            // 見つからなかった場合、空文字とする
-            return "";
+            return focalLength > 0 ? $"{focalLength:0.#} mm" : "";
         }
 
         /// <summary>
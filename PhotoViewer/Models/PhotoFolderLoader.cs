@@ -53,24 +53,49 @@ namespace Kchary.PhotoViewer.Models
         private bool firstImageLoaded;
 
         /// <summary>
-        /// サムネイル画像生成処理のキャンセルトークン
+        /// サムネイル画像を読み込み・デコードの工程に分けて並行に作成するパイプライン
         /// </summary>
-        private CancellationTokenSource thumbnailLoadCts = new();
+        private readonly ThumbnailPipelineWrapper thumbnailPipeline = ImageUtil.CreateThumbnailPipeline();
 
         /// <summary>
-        /// サムネイル画像を作成するための画像情報キュー
+        /// フォルダ内の画像を1回の走査で列挙し、ヘッダーの情報(サイズ・向き・撮影日時)を記録するインデックス
         /// </summary>
-        private readonly Queue<PhotoInfo> thumbnailQueue = new();
+        private readonly FolderIndexerWrapper folderIndexer = ImageUtil.CreateFolderIndexer();
 
         /// <summary>
-        /// サムネイル画像を非同期で作成するためのタイマー処理
+        /// 保存したフォルダインデックスを読み込んだか(最初の読み込み処理で読み込む)
         /// </summary>
-        private readonly System.Timers.Timer thumbnailTimer;
+        private bool isFolderIndexLoaded;
 
         /// <summary>
-        /// 1フレームあたりのサムネイル生成数
+        /// サムネイルストアを開いたか(最初の読み込み処理で開く)
         /// </summary>
-        private const int MaxThumbnailsPerTick = 5;
+        private bool isThumbnailStoreOpened;
+
+        /// <summary>
+        /// パイプラインの開始・中断・取り出しを1スレッドずつに制限するロック
+        /// </summary>
+        private readonly object thumbnailPipelineLock = new();
+
+        /// <summary>
+        /// サムネイル画像を作成中の写真一覧(パイプラインのインデックス順)
+        /// </summary>
+        private PhotoInfo[] thumbnailTargets = [];
+
+        /// <summary>
+        /// 作成済みのサムネイル画像の反映処理を予約済みか(0: 未予約, 1: 予約済み)
+        /// </summary>
+        private int isThumbnailApplyScheduled;
+
+        /// <summary>
+        /// 1回の反映処理でUIへ反映するサムネイル数の上限
+        /// </summary>
+        private const int MaxThumbnailsPerApply = 200;
+
+        /// <summary>
+        /// サムネイル画像の長辺の長さ
+        /// </summary>
+        private const int ThumbnailLongSideLength = 100;
 
         /// <summary>
         /// コンストラクタ
@@ -80,9 +105,8 @@ namespace Kchary.PhotoViewer.Models
             // 複数スレッドからコレクション操作できるようにする
             BindingOperations.EnableCollectionSynchronization(PhotoList, new object());
 
-            // サムネイル読み込み用のタイマースレッドの設定
-            thumbnailTimer = new System.Timers.Timer(150);  // 150msはネットワークドライブからの画像読み込み速度を考慮して設定
-            thumbnailTimer.Elapsed += ThumbnailTimer_Elapsed;
+            // サムネイルの出力通知の設定(デコードはパイプラインが並行に行い、通知を受けて作成済みのものを取り出すのみ)
+            thumbnailPipeline.ResultsAvailable += ThumbnailPipeline_ResultsAvailable;
 
             // バックグラウンドスレッドの設定
             loadPhotoFolderWorker.DoWork += LoadPhotoFolderDoWork;
@@ -91,43 +115,51 @@ namespace Kchary.PhotoViewer.Models
         }
 
         /// <summary>
-        /// タイマーで動作するサムネイル画像生成処理
+        /// パイプラインがサムネイルを出力したときの処理
         /// </summary>
-        /// <param name="sender">タイマー</param>
+        /// <param name="sender">パイプライン</param>
         /// <param name="e">引数情報</param>
-        private async void ThumbnailTimer_Elapsed(object sender, System.Timers.ElapsedEventArgs e)
+        private void ThumbnailPipeline_ResultsAvailable(object sender, EventArgs e)
         {
-            List<PhotoInfo> itemsToLoad = [];
-
-            lock (thumbnailQueue)
+            // パイプラインのスレッドを止めないよう、取り出しはスレッドプールで行う(予約済みの場合はその処理に任せる)
+            if (Interlocked.Exchange(ref isThumbnailApplyScheduled, 1) == 0)
             {
-                while (thumbnailQueue.Count > 0 && itemsToLoad.Count < MaxThumbnailsPerTick)
-                {
-                    if (thumbnailLoadCts.Token.IsCancellationRequested)
-                    {
-                        // キャンセルされたらループを即座に抜ける
-                        break;
-                    }
-                    itemsToLoad.Add(thumbnailQueue.Dequeue());
-                }
+                ThreadPool.QueueUserWorkItem(_ => ApplyLoadedThumbnails());
             }
+        }
 
-            // 読み込んだサムネイルをためる
+        /// <summary>
+        /// 作成済みのサムネイル画像をまとめてUIへ反映する
+        /// </summary>
+        private void ApplyLoadedThumbnails()
+        {
+            // 作成済みのサムネイルをためる
             List<(PhotoInfo photo, BitmapSource thumbnail)> loadedThumbnails = [];
-            foreach (var photo in itemsToLoad)
+            lock (thumbnailPipelineLock)
             {
-                if (thumbnailLoadCts.Token.IsCancellationRequested)
-                {
-                    // キャンセルされたらループを即座に抜ける
-                    break;
-                }
-
+                // 取り出す前に予約を解除し、取り出し中に出力されたサムネイルは次の反映処理に任せる
+                Volatile.Write(ref isThumbnailApplyScheduled, 0);
                 try
                 {
-                    var thumbnail = await ImageUtil.LoadThumbnailAsync(photo, thumbnailLoadCts.Token);
-                    if (thumbnail != null)
+                    while (loadedThumbnails.Count < MaxThumbnailsPerApply)
                     {
-                        loadedThumbnails.Add((photo, thumbnail));
+                        // 破棄時に画素バッファをプールへ返却する
+                        using ImageDataWrapper imageData = new();
+                        if (!thumbnailPipeline.TryDequeue(out var index, out var result, imageData))
+                        {
+                            break;
+                        }
+
+                        if (!result)
+                        {
+                            continue;
+                        }
+
+                        var thumbnail = ImageUtil.CreateBitmapSourceFromImageStruct(imageData);
+                        if (thumbnail != null)
+                        {
+                            loadedThumbnails.Add((thumbnailTargets[index], thumbnail));
+                        }
                     }
                 }
                 catch (Exception ex)
@@ -136,23 +168,22 @@ namespace Kchary.PhotoViewer.Models
                 }
             }
 
+            // 上限まで取り出した場合は、通知を待たずに残りを反映する
+            if (loadedThumbnails.Count == MaxThumbnailsPerApply)
+            {
+                ThumbnailPipeline_ResultsAvailable(thumbnailPipeline, EventArgs.Empty);
+            }
+
             // ある程度たまったら、UI側で表示処理する
             if (loadedThumbnails.Count > 0)
             {
-                try
+                Application.Current.Dispatcher.InvokeAsync(() =>
                 {
-                    await Application.Current.Dispatcher.InvokeAsync(() =>
+                    foreach (var (photo, thumbnail) in loadedThumbnails)
                     {
-                        foreach (var (photo, thumbnail) in loadedThumbnails)
-                        {
-                            photo.ThumbnailImage = thumbnail;
-                        }
-                    }, DispatcherPriority.Normal, thumbnailLoadCts.Token);
-                }
-                catch (Exception ex)
-                {
-                    App.LogException(ex);
-                }
+                        photo.ThumbnailImage = thumbnail;
+                    }
+                }, DispatcherPriority.Normal);
             }
         }
 
@@ -193,9 +224,9 @@ namespace Kchary.PhotoViewer.Models
                 return;
             }
 
+            // 前回の読み込みで要求した中断は、停止を確認してから取り消す
+            folderIndexer.ResetCancel();
             PhotoList.Clear();
-            thumbnailLoadCts?.Dispose();
-            thumbnailLoadCts = new CancellationTokenSource();
             loadPhotoFolderWorker.RunWorkerAsync();
         }
 
@@ -211,6 +242,7 @@ namespace Kchary.PhotoViewer.Models
             }
 
             loadPhotoFolderWorker.CancelAsync();
+            folderIndexer.Cancel();
             return false;
         }
 
@@ -219,14 +251,24 @@ namespace Kchary.PhotoViewer.Models
         /// </summary>
         public void CancelThumbnailLoad()
         {
-            // キャンセルトークンを発行
-            thumbnailLoadCts.Cancel();
+            // デコード中の画像を中断して作成済みのサムネイルを破棄する
+            lock (thumbnailPipelineLock)
+            {
+                thumbnailPipeline.Cancel();
+                thumbnailTargets = [];
+            }
+        }
 
-            // タイマーを停止し、キューをクリーンアップ
-            thumbnailTimer.Stop();
-            lock (thumbnailQueue)
+        /// <summary>
+        /// 写真一覧の順にサムネイル画像の作成を始める
+        /// </summary>
+        /// <param name="photos">写真一覧</param>
+        private void StartThumbnailLoad(List<PhotoInfo> photos)
+        {
+            lock (thumbnailPipelineLock)
             {
-                thumbnailQueue.Clear();
+                thumbnailTargets = [.. photos];
+                thumbnailPipeline.Start(photos.Select(photo => photo.FilePath).ToArray(), photos.Select(photo => photo.IsRawImage).ToArray(), ThumbnailLongSideLength);
             }
         }
 
@@ -249,14 +291,49 @@ namespace Kchary.PhotoViewer.Models
                 return;
             }
 
-            var fileList = Const.SupportPictureExtensions
-                .SelectMany(ext => new DirectoryInfo(folderPath).EnumerateFiles($"*{ext}", SearchOption.TopDirectoryOnly))
-                .OrderBy(f => f, new NaturalFileInfoNameComparer())
+            if (!isFolderIndexLoaded)
+            {
+                folderIndexer.Load(Const.FolderIndexFilePath);
+                isFolderIndexLoaded = true;
+            }
+
+            // 前回までに作成したサムネイル画像はストアから取得し、デコードしない
+            if (!isThumbnailStoreOpened)
+            {
+                OpenThumbnailStore();
+                isThumbnailStoreOpened = true;
+            }
+
+            // フォルダを1回だけ走査し、前回から更新された画像のみヘッダーを読み直す(画素はデコードしない)
+            var entries = folderIndexer.Scan(folderPath, Const.SupportPictureExtensions, Const.SupportRawPictureExtensions);
+            if (entries == null)
+            {
+                if (worker.CancellationPending)
+                {
+                    e.Cancel = true;
+                }
+
+                return;
+            }
+
+            SaveFolderIndex();
+
+            var photos = entries
+                .OrderBy(entry => entry.FilePath, new NaturalFilePathNameComparer())
+                .Select(entry => new PhotoInfo(entry))
                 .ToList();
 
+            if (worker.CancellationPending)
+            {
+                e.Cancel = true;
+                return;
+            }
+
+            // 一覧への追加と並行して、一覧の順にサムネイル画像を作成する
+            StartThumbnailLoad(photos);
+
             const int batchSize = 20;
-            var batch = new List<PhotoInfo>(batchSize);
-            foreach (var file in fileList)
+            foreach (var batch in photos.Chunk(batchSize))
             {
                 if (worker.CancellationPending)
                 {
@@ -264,27 +341,49 @@ namespace Kchary.PhotoViewer.Models
                     return;
                 }
 
-                try
-                {
-                    batch.Add(new PhotoInfo(file.FullName));
-                }
-                catch (Exception ex)
+                worker.ReportProgress(0, new List<PhotoInfo>(batch));
+            }
+        }
+
+        /// <summary>
+        /// サムネイルストアを開く(開けない場合はストアを使わずにデコードする)
+        /// </summary>
+        private static void OpenThumbnailStore()
+        {
+            try
+            {
+                if (!ImageUtil.OpenThumbnailStore(Const.ThumbnailStoreDirectory))
                 {
-                    Debug.WriteLine($"ファイル読み込み失敗: {file.FullName} ({ex.Message})");
-                    continue;
+                    Debug.WriteLine($"サムネイルストアを開けない: {Const.ThumbnailStoreDirectory}");
                 }
+            }
+            catch (Exception ex)
+            {
+                App.LogException(ex);
+            }
+        }
+
+        /// <summary>
+        /// フォルダインデックスが変わった場合は、次回の起動時に使えるようファイルへ保存する
+        /// </summary>
+        private void SaveFolderIndex()
+        {
+            if (!folderIndexer.HasUnsavedChanges)
+            {
+                return;
+            }
 
-                if (batch.Count >= batchSize)
+            try
+            {
+                Directory.CreateDirectory(Path.GetDirectoryName(Const.FolderIndexFilePath));
+                if (!folderIndexer.Save(Const.FolderIndexFilePath))
                 {
-                    worker.ReportProgress(0, new List<PhotoInfo>(batch));
-                    batch.Clear();
+                    Debug.WriteLine($"フォルダインデックスの保存失敗: {Const.FolderIndexFilePath}");
                 }
             }
-
-            // 最後に残った分を送信
-            if (batch.Count > 0)
+            catch (Exception ex)
             {
-                worker.ReportProgress(0, new List<PhotoInfo>(batch));
+                App.LogException(ex);
             }
         }
 
@@ -309,12 +408,6 @@ namespace Kchary.PhotoViewer.Models
                 }
 
                 PhotoList.Add(photo);
-
-                // サムネイル画像のためのキューに積む
-                lock (thumbnailQueue)
-                {
-                    thumbnailQueue.Enqueue(photo);
-                }
             }
 
             if (worker.CancellationPending)
@@ -327,12 +420,6 @@ namespace Kchary.PhotoViewer.Models
                 firstImageLoaded = true;
                 FirstImageLoaded?.Invoke(this, EventArgs.Empty);
             }
-
-            // タイマー起動
-            if (!thumbnailTimer.Enabled)
-            {
-                thumbnailTimer.Start();
-            }
         }
 
         /// <summary>
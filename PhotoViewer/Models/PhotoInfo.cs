@@ -1,9 +1,9 @@
 ﻿using CommunityToolkit.Mvvm.ComponentModel;
 using Kchary.PhotoViewer.Helpers;
+using System;
 using System.IO;
 using System.Linq;
 using System.Threading;
-using System.Windows.Media;
 using System.Windows.Media.Imaging;
 
 namespace Kchary.PhotoViewer.Models
@@ -48,6 +48,17 @@ namespace Kchary.PhotoViewer.Models
             FileName = FileUtil.GetFileName(filePath, false);
         }
 
+        /// <summary>
+        /// コンストラクタ(フォルダインデックスで列挙した画像から作成する)
+        /// </summary>
+        /// <param name="entry">フォルダインデックスの情報</param>
+        public PhotoInfo(FolderIndexEntryWrapper entry)
+        {
+            // 列挙したばかりのファイルのため、存在の確認は省く
+            FilePath = entry.FilePath;
+            FileName = FileUtil.GetFileName(FilePath, false);
+        }
+
         /// <summary>
         /// サポート画像フラグ
         /// </summary>
@@ -91,12 +102,13 @@ namespace Kchary.PhotoViewer.Models
         /// <summary>
         /// ピクチャビューに表示する画像を作成する
         /// </summary>
+        /// <param name="metadata">画像と同じファイルの読み込みで取得するメタデータの格納先</param>
         /// <param name="cancellationToken">キャンセルトークン</param>
         /// <returns>BitmapSource</returns>
-        public BitmapSource CreatePictureViewImage(CancellationToken cancellationToken)
+        public BitmapSource CreatePictureViewImage(ImageMetadataWrapper metadata, CancellationToken cancellationToken)
         {
             const int LongSideLength = 2200;
-            return ImageUtil.DecodePicture(FilePath, LongSideLength, IsRawImage, cancellationToken);
+            return ImageUtil.DecodePicture(FilePath, LongSideLength, IsRawImage, metadata, cancellationToken);
         }
 
         /// <summary>
@@ -117,6 +129,14 @@ namespace Kchary.PhotoViewer.Models
             defaultPictureHeight = bitmapFrame.PixelHeight;
             rotation = ImageUtil.GetRotation(bitmapFrame.Metadata as BitmapMetadata);
 
+            // RAW画像はWICが埋め込みプレビューのサイズを返すため、現像後のサイズ(回転適用済み)を使う
+            if (IsRawImage && ImageUtil.GetImageSize(FilePath, true, out var rawWidth, out var rawHeight))
+            {
+                defaultPictureWidth = rawWidth;
+                defaultPictureHeight = rawHeight;
+                rotation = 1;
+            }
+
             var longSideLength = rotation is 5 or 6 or 7 or 8 ? 240 : 350;
             return ImageUtil.DecodePicture(FilePath, longSideLength, IsRawImage);
         }
@@ -130,24 +150,21 @@ namespace Kchary.PhotoViewer.Models
         {
             using var sourceStream = new FileStream(FilePath, FileMode.Open, FileAccess.Read);
 
-            sourceStream.Seek(0, SeekOrigin.Begin);
-            var bitmapFrame = BitmapFrame.Create(sourceStream);
-
-            // 回転情報をメタデータから取得
-            var metaData = bitmapFrame.Metadata as BitmapMetadata;
-
-            // 画像を指定サイズにリサイズ
-            BitmapSource saveImage = bitmapFrame;
-            saveImage = new TransformedBitmap(saveImage, new ScaleTransform(scale, scale));
-
-            // リサイズ後に回転
-            saveImage = ImageUtil.RotateImage(metaData, saveImage);
-
-            // リサイズ、回転した画像を書き出す
-            var decodeImage = new WriteableBitmap(saveImage);
-            decodeImage.Freeze();
+            // 画素はデコードせず、元画像のサイズのみ取得する
+            // RAW画像はWICが埋め込みプレビューのサイズを返すため、ネイティブのデコードで出力される現像後のサイズを使う
+            int sourceWidth;
+            int sourceHeight;
+            if (!IsRawImage || !ImageUtil.GetImageSize(FilePath, true, out sourceWidth, out sourceHeight))
+            {
+                sourceStream.Seek(0, SeekOrigin.Begin);
+                var bitmapFrame = BitmapFrame.Create(sourceStream, BitmapCreateOptions.DelayCreation, BitmapCacheOption.None);
+                sourceWidth = bitmapFrame.PixelWidth;
+                sourceHeight = bitmapFrame.PixelHeight;
+            }
+            var longSideLength = (int)Math.Round(Math.Max(sourceWidth, sourceHeight) * scale);
 
-            return decodeImage;
+            // リサイズと回転はネイティブのデコードで書き込み先への出力と同時に行う
+            return ImageUtil.DecodeSaveImage(FilePath, longSideLength, IsRawImage);
         }
     }
 }
\ No newline at end of file
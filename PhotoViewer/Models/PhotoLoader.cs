@@ -78,23 +78,23 @@ namespace Kchary.PhotoViewer.Models
         /// 選択されたメディア情報を非同期で読み込み、画像、Exif情報を取得する
         /// </summary>
         /// <returns>画像とExif情報</returns>
-        private async Task<(BitmapSource Image, ExifInfo[] ExifInfos)> LoadImageAndExifAsync(CancellationToken cancellationToken)
+        private Task<(BitmapSource Image, ExifInfo[] ExifInfos)> LoadImageAndExifAsync(CancellationToken cancellationToken)
         {
-            var loadImageTask = Task.Run(() =>
+            return Task.Run<(BitmapSource, ExifInfo[])>(() =>
             {
                 cancellationToken.ThrowIfCancellationRequested();
-                return PhotoInfo.CreatePictureViewImage(cancellationToken);
-            }, cancellationToken);
 
-            var loadExifTask = Task.Run(() =>
-            {
-                cancellationToken.ThrowIfCancellationRequested();
+                // Exif情報はデコードのために開いたファイルから読み取り、ファイルを開き直さない
+                using ImageMetadataWrapper metadata = new();
+                var image = PhotoInfo.CreatePictureViewImage(metadata, cancellationToken);
+                if (image == null)
+                {
+                    return (null, null);
+                }
+
                 exifLoader.PhotoInfo = PhotoInfo;
-                return exifLoader.CreateExifInfoList(cancellationToken);
+                return (image, exifLoader.CreateExifInfoList(metadata));
             }, cancellationToken);
-
-            await Task.WhenAll(loadImageTask, loadExifTask);
-            return (await loadImageTask, await loadExifTask);
         }
     }
 }
@@ -1,4 +1,6 @@
 using Microsoft.VisualStudio.TestTools.UnitTesting;
+using System;
+using System.Linq;
 
 namespace PhotoViewerUnitTest
 {
@@ -58,5 +60,159 @@ namespace PhotoViewerUnitTest
             Assert.AreEqual(3264, imageData.Height);
             Assert.AreEqual(14784, imageData.Stride);
         }
+
+        [TestMethod]
+        public void GetHighBitDepthImageDataTest()
+        {
+            const string ImagePath = @"..\..\..\..\TestData\Mountain.jpg";
+
+            // JPEGは8ビットのため、16ビットを要求してもBGR24で取得する
+            ImageReaderSettingsWrapper imageReadSettings = new()
+            {
+                IsRawImage = false,
+                IsThumbnailMode = true,
+                ResizeLongSideLength = 1000,
+                IsHighBitDepth = true,
+                PreserveAlpha = true,
+            };
+
+            ImageDataWrapper imageData = new();
+            ImageReaderWrapper imageReader = new();
+            if (!imageReader.GetImageData(ImagePath, imageReadSettings, imageData))
+            {
+                Assert.Fail("Failed to get image");
+            }
+
+            Assert.AreEqual(ImagePixelFormatWrapper.Bgr24, imageData.PixelFormat);
+
+            // 表示用の形式への変換は8ビットの画像をそのまま複写する
+            ImageDataWrapper displayData = new();
+            if (!imageReader.ConvertToDisplayFormat(imageData, displayData))
+            {
+                Assert.Fail("Failed to convert image");
+            }
+
+            Assert.AreEqual(ImagePixelFormatWrapper.Bgr24, displayData.PixelFormat);
+            Assert.AreEqual(imageData.Width, displayData.Width);
+            Assert.AreEqual(imageData.Height, displayData.Height);
+            Assert.AreEqual(imageData.Width * 3, displayData.Stride);
+        }
+
+        [TestMethod]
+        [DataRow(@"..\..\..\..\TestData\Gradient16.png", false)]
+        [DataRow(@"..\..\..\..\TestData\Gradient16Alpha.png", true)]
+        [DataRow(@"..\..\..\..\TestData\Gradient16.tif", false)]
+        [DataRow(@"..\..\..\..\TestData\Gradient16Alpha.tif", true)]
+        public void GetHighBitDepthAlphaImageDataTest(string imagePath, bool hasAlpha)
+        {
+            // 16x4の16ビット画像(R = 257 * x * 15, G = 257 * y * 60, B = 257 * (255 - x * 15), A = 257 * (255 - x * 10 - y))
+            const int Width = 16;
+            const int Height = 4;
+            var channelCount = hasAlpha ? 4 : 3;
+
+            ImageReaderSettingsWrapper imageReadSettings = new()
+            {
+                IsRawImage = false,
+                IsThumbnailMode = false,
+                ResizeLongSideLength = 0,
+                IsHighBitDepth = true,
+                PreserveAlpha = true,
+            };
+
+            ImageDataWrapper imageData = new();
+            ImageReaderWrapper imageReader = new();
+            if (!imageReader.GetImageData(imagePath, imageReadSettings, imageData))
+            {
+                Assert.Fail("Failed to get image");
+            }
+
+            // 16ビットとアルファを落とさずにBGR(A)の順で取得する
+            Assert.AreEqual(hasAlpha ? ImagePixelFormatWrapper.Bgra64 : ImagePixelFormatWrapper.Bgr48, imageData.PixelFormat);
+            Assert.AreEqual(Width, imageData.Width);
+            Assert.AreEqual(Height, imageData.Height);
+            Assert.AreEqual(Width * channelCount * 2, imageData.Stride);
+
+            var buffer = imageData.Buffer;
+            foreach (var (x, y) in new[] { (0, 0), (1, 0), (15, 0), (7, 2), (15, 3) })
+            {
+                var offset = y * imageData.Stride + x * channelCount * 2;
+                Assert.AreEqual(257 * (255 - x * 15), BitConverter.ToUInt16(buffer, offset));
+                Assert.AreEqual(257 * y * 60, BitConverter.ToUInt16(buffer, offset + 2));
+                Assert.AreEqual(257 * x * 15, BitConverter.ToUInt16(buffer, offset + 4));
+                if (hasAlpha)
+                {
+                    Assert.AreEqual(257 * (255 - x * 10 - y), BitConverter.ToUInt16(buffer, offset + 6));
+                }
+            }
+
+            // 表示用の形式へは、チャンネル数を保ったまま8ビットへ変換する(257の倍数は割り切れる)
+            ImageDataWrapper displayData = new();
+            if (!imageReader.ConvertToDisplayFormat(imageData, displayData))
+            {
+                Assert.Fail("Failed to convert image");
+            }
+
+            Assert.AreEqual(hasAlpha ? ImagePixelFormatWrapper.Bgra32 : ImagePixelFormatWrapper.Bgr24, displayData.PixelFormat);
+            Assert.AreEqual(Width, displayData.Width);
+            Assert.AreEqual(Height, displayData.Height);
+            Assert.AreEqual(Width * channelCount, displayData.Stride);
+
+            var displayBuffer = displayData.Buffer;
+            foreach (var (x, y) in new[] { (0, 0), (1, 0), (15, 0), (7, 2), (15, 3) })
+            {
+                var offset = y * displayData.Stride + x * channelCount;
+                Assert.AreEqual(255 - x * 15, displayBuffer[offset]);
+                Assert.AreEqual(y * 60, displayBuffer[offset + 1]);
+                Assert.AreEqual(x * 15, displayBuffer[offset + 2]);
+                if (hasAlpha)
+                {
+                    Assert.AreEqual(255 - x * 10 - y, displayBuffer[offset + 3]);
+                }
+            }
+        }
+
+        [TestMethod]
+        public void ScanFolderIndexTest()
+        {
+            const string FolderPath = @"..\..\..\..\TestData";
+            const string ImagePath = @"..\..\..\..\TestData\Mountain.jpg";
+
+            ImageReaderWrapper imageReader = new();
+            FolderIndexerWrapper folderIndexer = new(imageReader);
+            var entries = folderIndexer.Scan(FolderPath, [".JPG"], []);
+            if (entries == null)
+            {
+                Assert.Fail("Failed to scan folder");
+            }
+
+            // 拡張子は大文字・小文字を区別せずに選り分け、ヘッダーのサイズは画素をデコードした場合と一致する
+            var entry = entries.Single(x => x.FilePath.EndsWith("Mountain.jpg"));
+            Assert.IsTrue(entry.HasHeader);
+            Assert.IsFalse(entry.IsRawImage);
+
+            ImageReaderSettingsWrapper imageReadSettings = new()
+            {
+                IsRawImage = false,
+                IsThumbnailMode = false,
+                ResizeLongSideLength = 0,
+            };
+
+            ImageDataWrapper imageData = new();
+            if (!imageReader.GetImageData(ImagePath, imageReadSettings, imageData))
+            {
+                Assert.Fail("Failed to get image");
+            }
+
+            Assert.AreEqual(imageData.Width, entry.Width);
+            Assert.AreEqual(imageData.Height, entry.Height);
+
+            // 変更されていないフォルダを走査し直してもインデックスは変わらない
+            Assert.IsTrue(folderIndexer.HasUnsavedChanges);
+            var indexPath = System.IO.Path.GetTempFileName();
+            Assert.IsTrue(folderIndexer.Save(indexPath));
+            Assert.AreEqual(entries.Length, folderIndexer.Scan(FolderPath, [".jpg"], []).Length);
+            Assert.IsFalse(folderIndexer.HasUnsavedChanges);
+            System.IO.File.Delete(indexPath);
+        }
     }
 }